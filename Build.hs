@@ -133,6 +133,12 @@ script = do
     Clean     "tools"           *>>  into "user/tool/"          $ make_clean
     DistClean "tools"           *>>  into "user/tool/"          $ cmake_distclean
 
+    Configure "bench"           *>>  into "user/bench/"         $ cmake
+    Build     "bench"           *>>  into "user/bench/"         $ make              `requires` [Install "pfq-cpplib", Configure "bench"]
+    Install   "bench"           *>>  into "user/bench/"         $ make_install      `requires` [Build   "bench"]
+    Clean     "bench"           *>>  into "user/bench/"         $ make_clean
+    DistClean "bench"           *>>  into "user/bench/"         $ cmake_distclean
+
 
 main = simpleBuilder script =<< getArgs
 
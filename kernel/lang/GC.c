@@ -36,6 +36,8 @@ void GC_reset(struct GC_data *gc)
 		GC_log_init(&gc->log[n]);
 	}
 	gc->pool.len = 0;
+
+	pfq_endpoint_info_reset(&gc->endpoints);
 }
 
 
@@ -107,6 +109,7 @@ GC_copy_buff(struct GC_data *gc, struct sk_buff __GC * orig)
 	ret = GC_make_buff(gc, skb);
 
 	PFQ_CB(ret)->group_mask = PFQ_CB(orig)->group_mask;
+	PFQ_CB(ret)->class_mask = PFQ_CB(orig)->class_mask;
 	PFQ_CB(ret)->direct     = PFQ_CB(orig)->direct;
 	PFQ_CB(ret)->monad      = PFQ_CB(orig)->monad;
 
@@ -115,21 +118,36 @@ GC_copy_buff(struct GC_data *gc, struct sk_buff __GC * orig)
 
 
 
-void
-GC_get_lazy_endpoints(struct GC_data *gc, struct pfq_endpoint_info *ts)
+/*
+ * Annotate the skb for a lazy transmission to the given device.
+ * Return 1 if annotated, 0 if already annotated for the same device
+ * and -1 if the endpoint table of this batch is full.
+ */
+
+int
+GC_log_dev(struct GC_data *gc, struct sk_buff __GC *skb, struct net_device *dev)
 {
-	size_t n, i;
+	struct GC_log *log = PFQ_CB(skb)->log;
+	int slot = pfq_endpoint_slot(dev, &gc->endpoints);
 
-	ts->num = 0;
-        ts->cnt_total = 0;
+	if (unlikely(slot < 0))
+		return -1;
 
-	for(n = 0; n < gc->pool.len; ++n)
-	{
-		for(i = 0; i < gc->log[n].num_devs; i++)
-		{
-			add_dev_to_endpoints(gc->log[n].dev[i], ts);
-		}
-	}
+	if (__test_and_set_bit(slot, log->dev_mask))
+		return 0;
+
+	gc->endpoints.cnt[slot]++;
+	gc->endpoints.cnt_total++;
+	log->num_devs++;
+	return 1;
+}
+
+
+int
+pfq_lang_log_dev(struct sk_buff __GC *skb, struct net_device *dev)
+{
+	struct pfq_percpu_data *data = this_cpu_ptr(percpu_data);
+	return GC_log_dev(data->GC, skb, dev);
 }
 
 
@@ -27,6 +27,7 @@
 #include <pragma/diagnostic_push>
 #include <linux/string.h>
 #include <linux/skbuff.h>
+#include <linux/bitmap.h>
 #include <pragma/diagnostic_pop>
 
 #include <pf_q-endpoint.h>
@@ -40,7 +41,7 @@ typedef struct sk_buff __GC * SkBuff;
 
 struct GC_log
 {
-	struct net_device * dev[Q_GC_LOG_QUEUE_LEN];
+	unsigned long dev_mask[BITS_TO_LONGS(Q_GC_LOG_QUEUE_LEN)];	/* endpoint slots */
 	size_t num_devs;
 	size_t to_kernel;
 	size_t xmit_todo;
@@ -64,6 +65,9 @@ struct GC_data
 {
 	struct GC_log		log[Q_GC_POOL_QUEUE_LEN];
 	struct GC_skbuff_queue	pool;
+	struct pfq_endpoint_info endpoints;
+	u32			lazy[Q_GC_LAZY_QUEUE_LEN];	/* lazy xmit: queue_mapping << 16 | pool index */
+	size_t			lazy_off[Q_GC_LOG_QUEUE_LEN];	/* lazy xmit: first entry of each slot */
 };
 
 
@@ -78,21 +82,15 @@ struct sk_buff __GC * pfq_lang_alloc_buff(size_t size);
 struct sk_buff __GC * pfq_lang_copy_buff(struct sk_buff __GC * skb);
 
 
-struct skb_lazy_targets;
+extern int GC_log_dev(struct GC_data *gc, struct sk_buff __GC *skb, struct net_device *dev);
 
-extern void  GC_get_lazy_endpoints(struct GC_data *gc, struct pfq_endpoint_info *info);
+int pfq_lang_log_dev(struct sk_buff __GC *skb, struct net_device *dev);
 
 
-static inline size_t
-GC_count_dev_in_log(struct net_device *dev, struct GC_log *log)
+static inline bool
+GC_log_has_slot(struct GC_log const *log, size_t slot)
 {
-	size_t n, ret = 0;
-	for(n = 0; n < log->num_devs; n++)
-	{
-		if (dev == log->dev[n])
-			ret++;
-	}
-	return ret;
+	return test_bit(slot, log->dev_mask);
 }
 
 
@@ -106,6 +104,9 @@ void GC_data_init(struct GC_data *gc)
 static inline
 void GC_log_init(struct GC_log *log)
 {
+	if (log->num_devs)
+		bitmap_zero(log->dev_mask, Q_GC_LOG_QUEUE_LEN);
+
 	log->to_kernel = 0;
 	log->xmit_todo = 0;
 	log->num_devs  = 0;
@@ -0,0 +1,260 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifdef __KERNEL__
+
+#include <pragma/diagnostic_push>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/errno.h>
+#include <linux/ctype.h>
+#include <linux/vmalloc.h>
+#include <pragma/diagnostic_pop>
+
+#define ac_alloc(size)		vmalloc(size)
+#define ac_free(ptr)		vfree(ptr)
+
+#else  /* user space */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+
+#define ac_alloc(size)		malloc(size)
+#define ac_free(ptr)		free(ptr)
+
+#endif
+
+#include <lang/aho-corasick.h>
+
+
+static int
+hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+
+/* literal bytes, and |..| blocks of hex bytes (spaces allowed) */
+
+int pfq_ac_parse(const char *pattern, uint8_t *out, size_t *len)
+{
+	bool hex = false;
+	size_t n = 0;
+	int hi = -1;
+
+	for(; *pattern; pattern++)
+	{
+		int v;
+
+		if (*pattern == '|') {
+			if (hi != -1)
+				return -EINVAL;
+			hex = !hex;
+			continue;
+		}
+
+		if (!hex) {
+			if (n == AC_MAX_PATTERN_LEN)
+				return -EINVAL;
+			out[n++] = (uint8_t)*pattern;
+			continue;
+		}
+
+		if (*pattern == ' ')
+			continue;
+
+		v = hex_value(*pattern);
+		if (v < 0)
+			return -EINVAL;
+
+		if (hi == -1) {
+			hi = v;
+			continue;
+		}
+
+		if (n == AC_MAX_PATTERN_LEN)
+			return -EINVAL;
+
+		out[n++] = (uint8_t)(hi << 4 | v);
+		hi = -1;
+	}
+
+	if (hex || n == 0)
+		return -EINVAL;
+
+	*len = n;
+	return 0;
+}
+
+
+/*
+ * Build the trie (goto function), then the DFA in BFS order: the failure
+ * state of a state is shallower, so its row is already complete.
+ */
+
+int pfq_ac_compile(struct pfq_ac *ac, const char * const *patterns, size_t n)
+{
+	uint8_t buf[AC_MAX_PATTERN_LEN];
+	int32_t *go = NULL;
+	uint16_t *fail = NULL, *queue = NULL;
+	uint8_t *out = NULL;
+	size_t i, j, len, total = 1;
+	uint32_t s, c, head, tail, nstates = 1;
+	int ret = 0;
+
+	memset(ac, 0, sizeof(*ac));
+
+	/* byte classes and upper bound of states */
+
+	for(i = 0; i < n; i++)
+	{
+		if (pfq_ac_parse(patterns[i], buf, &len) < 0)
+			return -EINVAL;
+
+		for(j = 0; j < len; j++)
+			ac->cls[buf[j]] = 1;
+
+		total += len;
+	}
+
+	if (total > AC_MAX_STATES)
+		return -E2BIG;
+
+	for(c = 0, s = 0; c < 256; c++)
+		s += ac->cls[c];
+
+	if (s == 256) {			/* every byte used: no spare class 0 */
+		for(c = 0; c < 256; c++)
+			ac->cls[c] = (uint8_t)c;
+		ac->nclasses = 256;
+	}
+	else {
+		ac->nclasses = 1;
+		for(c = 0; c < 256; c++)
+			if (ac->cls[c])
+				ac->cls[c] = (uint8_t)ac->nclasses++;
+	}
+
+	go    = ac_alloc(sizeof(int32_t) * total * ac->nclasses);
+	fail  = ac_alloc(sizeof(uint16_t) * total);
+	queue = ac_alloc(sizeof(uint16_t) * total);
+	out   = ac_alloc(total);
+
+	if (go == NULL || fail == NULL || queue == NULL || out == NULL) {
+		ret = -ENOMEM;
+		goto done;
+	}
+
+	memset(go, 0xff, sizeof(int32_t) * total * ac->nclasses);
+	memset(out, 0, total);
+
+	/* trie */
+
+	for(i = 0; i < n; i++)
+	{
+		pfq_ac_parse(patterns[i], buf, &len);
+
+		for(j = 0, s = 0; j < len; j++)
+		{
+			int32_t *t = &go[s * ac->nclasses + ac->cls[buf[j]]];
+			if (*t < 0)
+				*t = (int32_t)nstates++;
+			s = (uint32_t)*t;
+		}
+
+		out[s] = 1;
+	}
+
+	for(c = 0; c < 256; c++)
+		if (go[ac->cls[c]] >= 0)
+			ac->first[c >> 6] |= 1ULL << (c & 63);
+
+	/* DFA */
+
+	head = tail = 0;
+
+	for(c = 0; c < ac->nclasses; c++)
+	{
+		int32_t *t = &go[c];
+		if (*t < 0)
+			*t = 0;
+		else {
+			fail[*t] = 0;
+			queue[tail++] = (uint16_t)*t;
+		}
+	}
+
+	while (head != tail)
+	{
+		s = queue[head++];
+
+		for(c = 0; c < ac->nclasses; c++)
+		{
+			int32_t *t = &go[s * ac->nclasses + c];
+			if (*t < 0)
+				*t = go[fail[s] * ac->nclasses + c];
+			else {
+				fail[*t] = (uint16_t)go[fail[s] * ac->nclasses + c];
+				out[*t] |= out[fail[*t]];
+				queue[tail++] = (uint16_t)*t;
+			}
+		}
+	}
+
+	/* compact table: 16-bit transitions, accepting targets marked */
+
+	ac->delta = ac_alloc(sizeof(uint16_t) * nstates * ac->nclasses);
+	if (ac->delta == NULL) {
+		ret = -ENOMEM;
+		goto done;
+	}
+
+	for(i = 0; i < (size_t)nstates * ac->nclasses; i++)
+		ac->delta[i] = (uint16_t)(go[i] | (out[go[i]] ? AC_MATCH : 0));
+
+	ac->nstates = nstates;
+done:
+	ac_free(out);
+	ac_free(queue);
+	ac_free(fail);
+	ac_free(go);
+	return ret;
+}
+
+
+void pfq_ac_free(struct pfq_ac *ac)
+{
+	ac_free(ac->delta);
+	ac->delta = NULL;
+	ac->nstates = 0;
+}
+
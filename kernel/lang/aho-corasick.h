@@ -0,0 +1,96 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PFQ_LANG_AHO_CORASICK_H
+#define PFQ_LANG_AHO_CORASICK_H
+
+/* self-contained: this header builds in user space too (misc/pattern) */
+
+#include <pragma/diagnostic_push>
+#include <linux/types.h>
+#include <pragma/diagnostic_pop>
+
+
+/*
+ * Multi-pattern matcher: Aho-Corasick compiled into a DFA over byte classes
+ * (the bytes that appear in no pattern share class 0), so that a state is a
+ * row of nclasses 16-bit transitions. The high bit of a transition marks an
+ * accepting target state: the scan stops at the first match.
+ *
+ * In the root state the bytes that start no pattern are skipped by a
+ * bitmap test, without touching the transition table.
+ *
+ * Patterns are strings where |..| encloses hex bytes (Snort-like), e.g.
+ * "GET |2f|index" or "|de ad be ef|".
+ */
+
+#define AC_MATCH		0x8000
+#define AC_MAX_STATES		0x7fff
+#define AC_MAX_PATTERN_LEN	256
+
+
+struct pfq_ac
+{
+	uint8_t		cls[256];		/* byte -> class */
+	uint64_t	first[4];		/* bitmap: bytes leaving the root state */
+	uint32_t	nclasses;
+	uint32_t	nstates;
+	uint16_t	*delta;			/* nstates x nclasses */
+};
+
+
+extern int  pfq_ac_parse(const char *pattern, uint8_t *out, size_t *len);
+extern int  pfq_ac_compile(struct pfq_ac *ac, const char * const *patterns, size_t n);
+extern void pfq_ac_free(struct pfq_ac *ac);
+
+
+/* resumable scan: the state is carried over the fragments of a buffer */
+
+static inline bool
+pfq_ac_scan(struct pfq_ac const *ac, uint16_t *state, const uint8_t *p, size_t len)
+{
+	const uint8_t *end = p + len;
+	uint16_t s = *state;
+
+	while (p != end)
+	{
+		if (s == 0) {
+			while (!(ac->first[*p >> 6] & (1ULL << (*p & 63))))
+				if (++p == end)
+					goto out;
+		}
+
+		s = ac->delta[s * ac->nclasses + ac->cls[*p++]];
+		if (s & AC_MATCH) {
+			*state = s & ~AC_MATCH;
+			return true;
+		}
+	}
+out:
+	*state = s;
+	return false;
+}
+
+
+#endif /* PFQ_LANG_AHO_CORASICK_H */
@@ -32,47 +32,32 @@
 #include <lang/module.h>
 #include <lang/bloom.h>
 
+#include <pf_q-group.h>
+#include <pf_q-bloom.h>
 
-static bool
-bloom_src(arguments_t args, SkBuff skb)
-{
-	if (eth_hdr(PFQ_SKB(skb))->h_proto == __constant_htons(ETH_P_IP))
-	{
-		struct iphdr _iph;
-		const struct iphdr *ip;
-		uint32_t fold, addr;
-		__be32 mask;
-		char *mem;
 
-		ip = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_iph), &_iph);
-		if (ip == NULL)
-			return false;
+#define BLOOM_SRC	1
+#define BLOOM_DST	2
 
-		fold = GET_ARG_0(uint32_t, args);
-		mem  = GET_ARG_1(char *,   args);
-		mask = GET_ARG_2(__be32,   args);
-
-		addr = ntohl(ip->saddr & mask);
-
-		if ( BF_TEST(mem, hfun1(addr) & fold) &&
-		     BF_TEST(mem, hfun2(addr) & fold) &&
-		     BF_TEST(mem, hfun3(addr) & fold) &&
-		     BF_TEST(mem, hfun4(addr) & fold) )
-			return true;
-	}
 
-	return false;
+static inline bool
+bloom_test(const char *mem, uint32_t fold, uint32_t addr)
+{
+	return  BF_TEST(mem, hfun1(addr) & fold) &&
+		BF_TEST(mem, hfun2(addr) & fold) &&
+		BF_TEST(mem, hfun3(addr) & fold) &&
+		BF_TEST(mem, hfun4(addr) & fold);
 }
 
 
 static bool
-bloom_dst(arguments_t args, SkBuff skb)
+bloom_match(arguments_t args, SkBuff skb, int dir)
 {
 	if (eth_hdr(PFQ_SKB(skb))->h_proto == __constant_htons(ETH_P_IP))
 	{
 		struct iphdr _iph;
 		const struct iphdr *ip;
-		uint32_t fold, addr;
+		uint32_t fold;
 		__be32 mask;
 		char *mem;
 
@@ -84,55 +69,35 @@ bloom_dst(arguments_t args, SkBuff skb)
 		mem  = GET_ARG_1(char *,   args);
 		mask = GET_ARG_2(__be32,   args);
 
-		addr = ntohl(ip->daddr & mask);
+		if ((dir & BLOOM_DST) && bloom_test(mem, fold, ntohl(ip->daddr & mask)))
+			return true;
 
-		if ( BF_TEST(mem, hfun1(addr) & fold) &&
-		     BF_TEST(mem, hfun2(addr) & fold) &&
-		     BF_TEST(mem, hfun3(addr) & fold) &&
-		     BF_TEST(mem, hfun4(addr) & fold) )
+		if ((dir & BLOOM_SRC) && bloom_test(mem, fold, ntohl(ip->saddr & mask)))
 			return true;
 	}
 
 	return false;
 }
 
+
 static bool
-bloom(arguments_t args, SkBuff skb)
+bloom_src(arguments_t args, SkBuff skb)
 {
-	if (eth_hdr(PFQ_SKB(skb))->h_proto == __constant_htons(ETH_P_IP))
-	{
-		struct iphdr _iph;
-		const struct iphdr *ip;
-		uint32_t fold, addr;
-		__be32 mask;
-		char *mem;
-
-		ip = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_iph), &_iph);
-		if (ip == NULL)
-			return false;
-
-		fold = GET_ARG_0(uint32_t, args);
-		mem  = GET_ARG_1(char *,   args);
-		mask = GET_ARG_2(__be32,   args);
+	return bloom_match(args, skb, BLOOM_SRC);
+}
 
-		addr = ntohl(ip->daddr & mask);
 
-		if ( BF_TEST(mem, hfun1(addr) & fold) &&
-		     BF_TEST(mem, hfun2(addr) & fold) &&
-		     BF_TEST(mem, hfun3(addr) & fold) &&
-		     BF_TEST(mem, hfun4(addr) & fold) )
-			return true;
+static bool
+bloom_dst(arguments_t args, SkBuff skb)
+{
+	return bloom_match(args, skb, BLOOM_DST);
+}
 
-		addr = ntohl(ip->saddr & mask);
 
-		if ( BF_TEST(mem, hfun1(addr) & fold) &&
-		     BF_TEST(mem, hfun2(addr) & fold) &&
-		     BF_TEST(mem, hfun3(addr) & fold) &&
-		     BF_TEST(mem, hfun4(addr) & fold) )
-			return true;
-	}
-
-	return false;
+static bool
+bloom(arguments_t args, SkBuff skb)
+{
+	return bloom_match(args, skb, BLOOM_SRC|BLOOM_DST);
 }
 
 
@@ -231,6 +196,177 @@ static int bloom_fini(arguments_t args)
 }
 
 
+/* named bloom filters of the group, updated at runtime (Q_SO_GROUP_BLOOM) */
+
+
+/* the packet is parsed once, according to the key of the table */
+
+static bool
+bloom_table_match(arguments_t args, SkBuff skb, int dir)
+{
+	struct pfq_bloom_table *bt;
+	__be16 proto = eth_hdr(PFQ_SKB(skb))->h_proto;
+
+	bt = pfq_bloom_table_get(PFQ_CB(skb)->monad->group->bloom, GET_ARG_0(uint32_t, args));
+	if (bt == NULL)
+		return false;
+
+	switch(bt->key)
+	{
+	case Q_BLOOM_KEY_IPV4: {
+
+		struct iphdr _iph;
+		const struct iphdr *ip;
+
+		if (proto != __constant_htons(ETH_P_IP))
+			return false;
+
+		ip = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_iph), &_iph);
+		if (ip == NULL)
+			return false;
+
+		return ((dir & BLOOM_DST) && pfq_bloom_table_test(bt, &ip->daddr)) ||
+		       ((dir & BLOOM_SRC) && pfq_bloom_table_test(bt, &ip->saddr));
+	}
+
+	case Q_BLOOM_KEY_IPV6: {
+
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6;
+
+		if (proto != __constant_htons(ETH_P_IPV6))
+			return false;
+
+		ip6 = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_ip6h), &_ip6h);
+		if (ip6 == NULL)
+			return false;
+
+		return ((dir & BLOOM_DST) && pfq_bloom_table_test(bt, &ip6->daddr)) ||
+		       ((dir & BLOOM_SRC) && pfq_bloom_table_test(bt, &ip6->saddr));
+	}
+
+	case Q_BLOOM_KEY_TUPLE: {
+
+		/* the direction is part of the key: the tuple is tested as it is */
+
+		struct pfq_bloom_tuple key;
+		const __be16 *ports;
+		__be16 _ports[2];
+		int offset;
+
+		memset(&key, 0, sizeof(key));
+
+		if (proto == __constant_htons(ETH_P_IP)) {
+
+			struct iphdr _iph;
+			const struct iphdr *ip;
+
+			ip = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_iph), &_iph);
+			if (ip == NULL)
+				return false;
+
+			key.saddr[0] = ip->saddr;
+			key.daddr[0] = ip->daddr;
+			key.proto = ip->protocol;
+			offset = skb->mac_len + (ip->ihl<<2);
+		}
+		else if (proto == __constant_htons(ETH_P_IPV6)) {
+
+			struct ipv6hdr _ip6h;
+			const struct ipv6hdr *ip6;
+
+			ip6 = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_ip6h), &_ip6h);
+			if (ip6 == NULL)
+				return false;
+
+			memcpy(key.saddr, &ip6->saddr, sizeof(key.saddr));
+			memcpy(key.daddr, &ip6->daddr, sizeof(key.daddr));
+			key.proto = ip6->nexthdr;
+			offset = skb->mac_len + sizeof(struct ipv6hdr);
+		}
+		else
+			return false;
+
+		if (key.proto == IPPROTO_TCP || key.proto == IPPROTO_UDP) {
+
+			ports = skb_header_pointer(PFQ_SKB(skb), offset, sizeof(_ports), _ports);
+			if (ports == NULL)
+				return false;
+
+			key.sport = ports[0];
+			key.dport = ports[1];
+		}
+
+		return pfq_bloom_table_test(bt, &key);
+	}
+	}
+
+	return false;
+}
+
+
+static bool
+bloom_table(arguments_t args, SkBuff skb)
+{
+	return bloom_table_match(args, skb, BLOOM_SRC|BLOOM_DST);
+}
+
+
+static bool
+bloom_table_src(arguments_t args, SkBuff skb)
+{
+	return bloom_table_match(args, skb, BLOOM_SRC);
+}
+
+
+static bool
+bloom_table_dst(arguments_t args, SkBuff skb)
+{
+	return bloom_table_match(args, skb, BLOOM_DST);
+}
+
+
+static ActionSkBuff
+bloom_table_filter(arguments_t args, SkBuff skb)
+{
+	if (bloom_table(args, skb))
+		return Pass(skb);
+	return Drop(skb);
+}
+
+
+static ActionSkBuff
+bloom_table_src_filter(arguments_t args, SkBuff skb)
+{
+	if (bloom_table_src(args, skb))
+		return Pass(skb);
+	return Drop(skb);
+}
+
+
+static ActionSkBuff
+bloom_table_dst_filter(arguments_t args, SkBuff skb)
+{
+	if (bloom_table_dst(args, skb))
+		return Pass(skb);
+	return Drop(skb);
+}
+
+
+static int bloom_table_init(arguments_t args)
+{
+	const char *name = GET_ARG_0(const char *, args);
+	uint32_t id = pfq_bloom_table_id(name);
+
+	pr_devel("[PFQ|init] bloom table: '%s' -> id=%x\n", name, id);
+
+	/* the table is looked up by id: it may be created (or replaced) later */
+
+	SET_ARG_0(args, id);
+	return 0;
+}
+
+
 struct pfq_lang_function_descr bloom_functions[] = {
 
 	{"bloom",		"CInt -> [Word32] -> CInt -> SkBuff -> Bool",		bloom,			bloom_init,	bloom_fini},
@@ -239,5 +375,12 @@ struct pfq_lang_function_descr bloom_functions[] = {
 	{"bloom_filter",	"CInt -> [Word32] -> CInt -> SkBuff -> Action SkBuff",	bloom_filter,		bloom_init,	bloom_fini},
 	{"bloom_src_filter",	"CInt -> [Word32] -> CInt -> SkBuff -> Action SkBuff",	bloom_src_filter,	bloom_init,	bloom_fini},
 	{"bloom_dst_filter",	"CInt -> [Word32] -> CInt -> SkBuff -> Action SkBuff",	bloom_dst_filter,	bloom_init,	bloom_fini},
+
+	{"bloom_table",			"String -> SkBuff -> Bool",		bloom_table,		  bloom_table_init },
+	{"bloom_table_src",		"String -> SkBuff -> Bool",		bloom_table_src,	  bloom_table_init },
+	{"bloom_table_dst",		"String -> SkBuff -> Bool",		bloom_table_dst,	  bloom_table_init },
+	{"bloom_table_filter",		"String -> SkBuff -> Action SkBuff",	bloom_table_filter,	  bloom_table_init },
+	{"bloom_table_src_filter",	"String -> SkBuff -> Action SkBuff",	bloom_table_src_filter,	  bloom_table_init },
+	{"bloom_table_dst_filter",	"String -> SkBuff -> Action SkBuff",	bloom_table_dst_filter,	  bloom_table_init },
 	{ NULL }};
 
@@ -25,7 +25,11 @@
 #define PFQ_LANG_BLOOM_H
 
 
-#include <lang/module.h>
+/* self-contained: this header builds in user space too (misc/bloom) */
+
+#include <pragma/diagnostic_push>
+#include <linux/types.h>
+#include <pragma/diagnostic_pop>
 
 
 /* macros to test/set bits in bitwise array */
@@ -33,6 +37,7 @@
 
 #define BF_TEST(mem, x)  (mem[(x) >> 3] &  (1<<((x) & 7)))
 #define BF_SET(mem, x)   (mem[(x) >> 3] |= (1<<((x) & 7)))
+#define BF_CLEAR(mem, x) (mem[(x) >> 3] &= ~(1<<((x) & 7)))
 
 #define A(value)   (((value) & 0xff000000) >> 24)
 #define B(value)   (((value) & 0x00ff0000) >> 16)
@@ -84,4 +89,85 @@ unsigned clp2(unsigned int x)
 }
 
 
+/*
+ * Blocked bloom filter: every key maps into a single cache line (512 bits).
+ * One 64-bit hash of the key is computed: the high half selects the block,
+ * the low half gives the BBF_K probes within the block (double hashing).
+ */
+
+#define BBF_BLOCK_BITS		512
+#define BBF_BLOCK_WORDS		(BBF_BLOCK_BITS/64)
+#define BBF_K			6
+#define BBF_KEY_WORDS		10	/* the largest key: 5-tuple */
+
+
+static inline uint64_t bbf_hash(const uint32_t *key, size_t n)
+{
+	uint64_t h = 0x9e3779b97f4a7c15ULL * (n + 1);
+	size_t i = 0;
+
+	/* 64 bits at a time */
+
+	for(; i + 1 < n; i += 2)
+	{
+		h = (h ^ (key[i] | (uint64_t)key[i+1] << 32)) * 0xff51afd7ed558ccdULL;
+		h = (h << 31) | (h >> 33);
+	}
+
+	if (i < n)
+		h = (h ^ key[i]) * 0xff51afd7ed558ccdULL;
+
+	/* final mix, from MurmurHash3 */
+
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+
+static inline uint32_t bbf_block(uint64_t h, uint32_t nblocks)
+{
+	return (uint32_t)(h >> 32) & (nblocks - 1);
+}
+
+
+#define bbf_for_each_probe(h, i, bit) \
+	for((i) = 0, (bit) = (uint32_t)(h) & 0xffff; (i) < BBF_K; \
+	    (i)++, (bit) += ((uint32_t)(h) >> 16) | 1)
+
+
+/* branch-free: all the probes hit the same cache line */
+
+static inline bool bbf_test(const uint64_t *mem, uint32_t nblocks, uint64_t h)
+{
+	const uint64_t *blk = mem + bbf_block(h, nblocks) * BBF_BLOCK_WORDS;
+	uint64_t ret = 1;
+	uint32_t bit;
+	int i;
+
+	bbf_for_each_probe(h, i, bit)
+	{
+		uint32_t b = bit & (BBF_BLOCK_BITS-1);
+		ret &= blk[b >> 6] >> (b & 63);
+	}
+
+	return ret & 1;
+}
+
+
+static inline void bbf_set(uint64_t *mem, uint32_t nblocks, uint64_t h)
+{
+	uint64_t *blk = mem + bbf_block(h, nblocks) * BBF_BLOCK_WORDS;
+	uint32_t bit;
+	int i;
+
+	bbf_for_each_probe(h, i, bit)
+	{
+		uint32_t b = bit & (BBF_BLOCK_BITS-1);
+		blk[b >> 6] |= 1ULL << (b & 63);
+	}
+}
+
+
 #endif /* PFQ_LANG_BLOOM_H */
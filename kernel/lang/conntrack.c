@@ -0,0 +1,235 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pragma/diagnostic_push>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <pragma/diagnostic_pop>
+
+#include <lang/module.h>
+#include <lang/hash.h>
+
+#include <pf_q-conntrack.h>
+
+
+/*
+ * Connection tracking (lite): conntrack updates the state of the TCP/UDP
+ * connection of the packet, the predicates test it. The table is taken by
+ * the init functions and stored in the (unused) arg 0. Updates are done
+ * with the entry claimed, the predicates read it lock-free.
+ */
+
+#define CT_TCP_FIN	0x01
+#define CT_TCP_SYN	0x02
+#define CT_TCP_RST	0x04
+#define CT_TCP_ACK	0x10
+
+
+struct ct_lookup
+{
+	struct pfq_flow_key	key;
+	uint32_t		tag;
+	uint32_t		index;
+	int			dir;
+	uint8_t			tcp_flags;
+};
+
+
+static bool
+ct_lookup(SkBuff skb, struct pfq_ct_table *ct, struct ct_lookup *l, struct pfq_ct_entry **e)
+{
+	if (!flow_key(skb, &l->key, &l->tcp_flags))
+		return false;
+
+	if (l->key.proto != IPPROTO_TCP && l->key.proto != IPPROTO_UDP)
+		return false;
+
+	l->dir = pfq_ct_key(&l->key);
+	l->tag = pfq_ct_tag(&l->key, &l->index);
+
+	*e = pfq_ct_find(ct, &l->key, l->tag, l->index);
+	return true;
+}
+
+
+static void
+ct_tcp(struct pfq_ct_table *ct, struct ct_lookup *l, struct pfq_ct_entry *e)
+{
+	const uint8_t flags = l->tcp_flags;
+
+	if (e == NULL) {
+		if ((flags & (CT_TCP_SYN|CT_TCP_ACK|CT_TCP_RST)) == CT_TCP_SYN)
+			pfq_ct_insert(ct, &l->key, l->tag, l->index, (uint8_t)l->dir);
+		return;
+	}
+
+	if (!pfq_ct_claim(e, &l->key, l->tag))
+		return;
+
+	if (flags & CT_TCP_RST) {
+		pfq_ct_release(e, PFQ_CT_TAG_FREE);
+		return;
+	}
+
+	switch(e->state)
+	{
+	case PFQ_CT_NEW:
+		if ((flags & (CT_TCP_SYN|CT_TCP_ACK)) == (CT_TCP_SYN|CT_TCP_ACK) && l->dir != e->orig)
+			WRITE_ONCE(e->state, PFQ_CT_SYN_RECV);
+		break;
+	case PFQ_CT_SYN_RECV:
+		if ((flags & (CT_TCP_SYN|CT_TCP_ACK)) == CT_TCP_ACK && l->dir == e->orig)
+			WRITE_ONCE(e->state, PFQ_CT_ESTABLISHED);
+		break;
+	}
+
+	if (flags & CT_TCP_FIN) {
+		WRITE_ONCE(e->fin, e->fin | (1 << l->dir));
+		if (e->state == PFQ_CT_ESTABLISHED)
+			WRITE_ONCE(e->state, PFQ_CT_CLOSING);
+	}
+
+	WRITE_ONCE(e->last, jiffies);
+	pfq_ct_release(e, l->tag);
+}
+
+
+static void
+ct_udp(struct pfq_ct_table *ct, struct ct_lookup *l, struct pfq_ct_entry *e)
+{
+	if (e == NULL) {
+		pfq_ct_insert(ct, &l->key, l->tag, l->index, (uint8_t)l->dir);
+		return;
+	}
+
+	if (!pfq_ct_claim(e, &l->key, l->tag))
+		return;
+
+	if (e->state == PFQ_CT_NEW && l->dir != e->orig)
+		WRITE_ONCE(e->state, PFQ_CT_ESTABLISHED);
+
+	WRITE_ONCE(e->last, jiffies);
+	pfq_ct_release(e, l->tag);
+}
+
+
+static ActionSkBuff
+conntrack(arguments_t args, SkBuff skb)
+{
+	struct pfq_ct_table *ct = GET_ARG_0(struct pfq_ct_table *, args);
+	struct pfq_ct_entry *e;
+	struct ct_lookup l;
+
+	if (ct_lookup(skb, ct, &l, &e)) {
+		if (l.key.proto == IPPROTO_TCP)
+			ct_tcp(ct, &l, e);
+		else
+			ct_udp(ct, &l, e);
+	}
+
+	return Pass(skb);
+}
+
+
+/* established (or closing) connection, in either direction */
+
+static bool
+is_established(arguments_t args, SkBuff skb)
+{
+	struct pfq_ct_table *ct = GET_ARG_0(struct pfq_ct_table *, args);
+	struct pfq_ct_entry *e;
+	struct ct_lookup l;
+	uint8_t state;
+
+	if (!ct_lookup(skb, ct, &l, &e) || e == NULL)
+		return false;
+
+	state = READ_ONCE(e->state);
+	return state == PFQ_CT_ESTABLISHED || state == PFQ_CT_CLOSING;
+}
+
+
+/* packet of the originator of a connection not yet established */
+
+static bool
+is_new_flow(arguments_t args, SkBuff skb)
+{
+	struct pfq_ct_table *ct = GET_ARG_0(struct pfq_ct_table *, args);
+	struct pfq_ct_entry *e;
+	struct ct_lookup l;
+
+	if (!ct_lookup(skb, ct, &l, &e) || e == NULL)
+		return false;
+
+	return READ_ONCE(e->state) == PFQ_CT_NEW && l.dir == e->orig;
+}
+
+
+/* packet from the responder of a tracked connection */
+
+static bool
+is_reply(arguments_t args, SkBuff skb)
+{
+	struct pfq_ct_table *ct = GET_ARG_0(struct pfq_ct_table *, args);
+	struct pfq_ct_entry *e;
+	struct ct_lookup l;
+
+	if (!ct_lookup(skb, ct, &l, &e) || e == NULL)
+		return false;
+
+	return l.dir != e->orig;
+}
+
+
+static int ct_init(arguments_t args)
+{
+	struct pfq_ct_table *ct = pfq_conntrack_get();
+
+	if (ct == NULL) {
+		printk(KERN_INFO "[PFQ|init] conntrack: could not create the table!\n");
+		return -ENOMEM;
+	}
+
+	SET_ARG_0(args, ct);
+	return 0;
+}
+
+
+static int ct_fini(arguments_t args)
+{
+	pfq_conntrack_put();
+	return 0;
+}
+
+
+struct pfq_lang_function_descr conntrack_functions[] = {
+
+	{ "conntrack",		"SkBuff -> Action SkBuff",	conntrack,	ct_init, ct_fini },
+	{ "is_established",	"SkBuff -> Bool",		is_established,	ct_init, ct_fini },
+	{ "is_new_flow",	"SkBuff -> Bool",		is_new_flow,	ct_init, ct_fini },
+	{ "is_reply",		"SkBuff -> Bool",		is_reply,	ct_init, ct_fini },
+	{ NULL }};
+
@@ -163,9 +163,11 @@ pfq_lang_run(SkBuff skb, struct pfq_lang_computation_tree *prg)
 struct pfq_lang_computation_tree *
 pfq_lang_computation_alloc (struct pfq_lang_computation_descr const *descr)
 {
-        struct pfq_lang_computation_tree * c = kzalloc(sizeof(size_t) + descr->size * sizeof(struct pfq_lang_functional_node),
+        struct pfq_lang_computation_tree * c = kzalloc(sizeof(struct pfq_lang_computation_tree) +
+						       descr->size * sizeof(struct pfq_lang_functional_node),
 						  GFP_KERNEL);
-        c->size = descr->size;
+	if (c)
+		c->size = descr->size;
         return c;
 }
 
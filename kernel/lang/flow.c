@@ -0,0 +1,154 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pragma/diagnostic_push>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/ktime.h>
+
+#include <pragma/diagnostic_pop>
+
+#include <lang/module.h>
+#include <lang/hash.h>
+
+#include <pf_q-group.h>
+#include <pf_q-flow.h>
+
+
+static inline struct pfq_flow_table *
+flow_table(SkBuff skb)
+{
+	return (struct pfq_flow_table *)atomic_long_read(&PFQ_CB(skb)->monad->group->flows);
+}
+
+
+static inline uint64_t
+flow_now(SkBuff skb)
+{
+	ktime_t now = PFQ_SKB(skb)->tstamp;
+	if (ktime_to_ns(now) == 0)
+		now = ktime_get_real();
+	return ktime_to_ns(now);
+}
+
+
+static struct pfq_flow_entry *
+flow_entry(SkBuff skb, bool insert, uint64_t *hash, uint8_t *tcp_flags, uint64_t *now)
+{
+	struct pfq_flow_table *ft = flow_table(skb);
+	struct pfq_flow_key key;
+
+	if (ft == NULL || !flow_key(skb, &key, tcp_flags))
+		return NULL;
+
+	*hash = pfq_flow_hash(&key);
+
+	if (!insert)
+		return pfq_flow_find(ft, &key, *hash);
+
+	*now = flow_now(skb);
+	return pfq_flow_find_or_insert(PFQ_CB(skb)->monad->group, ft, &key, *hash, *now);
+}
+
+
+static ActionSkBuff
+flow_update(arguments_t args, SkBuff skb)
+{
+	struct pfq_flow_entry *e;
+	uint64_t hash, now;
+	uint8_t tcp_flags;
+
+	e = flow_entry(skb, true, &hash, &tcp_flags, &now);
+	if (e)
+		pfq_flow_account(PFQ_CB(skb)->monad->group, flow_table(skb), e, skb->len, tcp_flags, now);
+
+	return Pass(skb);
+}
+
+
+static ActionSkBuff
+flow_set_state(arguments_t args, SkBuff skb)
+{
+	uint32_t state = GET_ARG(uint32_t, args);
+	struct pfq_flow_entry *e;
+	uint64_t hash, now;
+	uint8_t tcp_flags;
+
+	e = flow_entry(skb, true, &hash, &tcp_flags, &now);
+	if (e)
+		pfq_flow_set_state(e, state);
+
+	return Pass(skb);
+}
+
+
+static bool
+flow_match(arguments_t args, SkBuff skb)
+{
+	uint64_t hash, now;
+	uint8_t tcp_flags;
+
+	return flow_entry(skb, false, &hash, &tcp_flags, &now) != NULL;
+}
+
+
+static bool
+flow_has_state(arguments_t args, SkBuff skb)
+{
+	uint32_t state = GET_ARG(uint32_t, args);
+	struct pfq_flow_entry *e;
+	uint64_t hash, now;
+	uint8_t tcp_flags;
+
+	e = flow_entry(skb, false, &hash, &tcp_flags, &now);
+	return e && e->d.state == state;
+}
+
+
+static ActionSkBuff
+flow_steer(arguments_t args, SkBuff skb)
+{
+	uint64_t hash, now;
+	uint8_t tcp_flags;
+
+	if (flow_entry(skb, false, &hash, &tcp_flags, &now))
+		return Steering(skb, (uint32_t)(hash ^ (hash >> 32)));
+
+	return Drop(skb);
+}
+
+
+struct pfq_lang_function_descr flow_functions[] = {
+
+	{ "flow_update",	"SkBuff -> Action SkBuff",		flow_update	},
+	{ "flow_set_state",	"Word32 -> SkBuff -> Action SkBuff",	flow_set_state	},
+	{ "flow_steer",		"SkBuff -> Action SkBuff",		flow_steer	},
+
+	{ "flow_match",		"SkBuff -> Bool",			flow_match	},
+	{ "flow_has_state",	"Word32 -> SkBuff -> Bool",		flow_has_state	},
+	{ NULL }};
+
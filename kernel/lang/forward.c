@@ -26,6 +26,8 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/cache.h>
+#include <linux/nsproxy.h>
+#include <net/net_namespace.h>
 
 #include <pragma/diagnostic_pop>
 
@@ -105,7 +107,12 @@ static int
 forward_init(arguments_t args)
 {
 	const char *name = GET_ARG(const char *, args);
-	struct net_device *dev = dev_get_by_name(&init_net, name);
+	struct net_device *dev;
+
+	/* init functions run in the context of the setsockopt caller:
+	 * resolve the device in its network namespace... */
+
+	dev = dev_get_by_name(current->nsproxy->net_ns, name);
 
 	if (dev == NULL) {
                 printk(KERN_INFO "[PFQ|init] forward: %s no such device!\n", name);
@@ -0,0 +1,164 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PFQ_LANG_HASH_H
+#define PFQ_LANG_HASH_H
+
+#include <pragma/diagnostic_push>
+#include <linux/jhash.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/udp.h>
+#include <linux/pf_q.h>
+#include <pragma/diagnostic_pop>
+
+#include <lang/module.h>
+
+
+/*
+ * Symmetric hash of the 5-tuple (both directions of a flow give the same
+ * value), for IPv4 and IPv6. Return false if the packet is not IP or broken.
+ */
+
+static inline bool
+flow_hash_symmetric(SkBuff skb, uint32_t *ret)
+{
+	__be16 proto = eth_hdr(PFQ_SKB(skb))->h_proto;
+	struct udphdr _udp;
+	const struct udphdr *udp;
+	uint32_t hash;
+	int offset;
+	u8 l4;
+
+	if (proto == __constant_htons(ETH_P_IP)) {
+
+		struct iphdr _iph;
+		const struct iphdr *ip;
+
+		ip = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_iph), &_iph);
+		if (ip == NULL)
+			return false;
+
+		hash = (__force uint32_t)(ip->saddr ^ ip->daddr);
+		offset = skb->mac_len + (ip->ihl<<2);
+		l4 = ip->protocol;
+	}
+	else if (proto == __constant_htons(ETH_P_IPV6)) {
+
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6;
+		int i;
+
+		ip6 = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_ip6h), &_ip6h);
+		if (ip6 == NULL)
+			return false;
+
+		for(i = 0, hash = 0; i < 4; i++)
+			hash ^= (__force uint32_t)(ip6->saddr.s6_addr32[i] ^ ip6->daddr.s6_addr32[i]);
+
+		offset = skb->mac_len + sizeof(struct ipv6hdr);
+		l4 = ip6->nexthdr;
+	}
+	else
+		return false;
+
+	if (l4 == IPPROTO_UDP || l4 == IPPROTO_TCP) {
+
+		udp = skb_header_pointer(PFQ_SKB(skb), offset, sizeof(_udp), &_udp);
+		if (udp == NULL)
+			return false;
+
+		hash ^= (__force uint32_t)(udp->source ^ udp->dest);
+	}
+
+	*ret = jhash_2words(hash, l4, 0x9e3779b9);
+	return true;
+}
+
+
+/* the 5-tuple of the packet, and the flags of TCP segments */
+
+static inline bool
+flow_key(SkBuff skb, struct pfq_flow_key *key, uint8_t *tcp_flags)
+{
+	__be16 proto = eth_hdr(PFQ_SKB(skb))->h_proto;
+	const uint8_t *l4;
+	uint8_t _l4[14];
+	int offset;
+
+	memset(key, 0, sizeof(*key));
+
+	if (proto == __constant_htons(ETH_P_IP)) {
+
+		struct iphdr _iph;
+		const struct iphdr *ip;
+
+		ip = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_iph), &_iph);
+		if (ip == NULL)
+			return false;
+
+		key->saddr[0] = ip->saddr;
+		key->daddr[0] = ip->daddr;
+		key->proto  = ip->protocol;
+		key->family = 4;
+		offset = skb->mac_len + (ip->ihl<<2);
+	}
+	else if (proto == __constant_htons(ETH_P_IPV6)) {
+
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6;
+
+		ip6 = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_ip6h), &_ip6h);
+		if (ip6 == NULL)
+			return false;
+
+		memcpy(key->saddr, &ip6->saddr, sizeof(key->saddr));
+		memcpy(key->daddr, &ip6->daddr, sizeof(key->daddr));
+		key->proto  = ip6->nexthdr;
+		key->family = 6;
+		offset = skb->mac_len + sizeof(struct ipv6hdr);
+	}
+	else
+		return false;
+
+	*tcp_flags = 0;
+
+	if (key->proto == IPPROTO_TCP || key->proto == IPPROTO_UDP) {
+
+		l4 = skb_header_pointer(PFQ_SKB(skb), offset, key->proto == IPPROTO_TCP ? 14 : 4, _l4);
+		if (l4 == NULL)
+			return false;
+
+		memcpy(&key->sport, l4, 2);
+		memcpy(&key->dport, l4 + 2, 2);
+
+		if (key->proto == IPPROTO_TCP)
+			*tcp_flags = l4[13];
+	}
+
+	return true;
+}
+
+
+#endif /* PFQ_LANG_HASH_H */
@@ -0,0 +1,166 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifdef __KERNEL__
+
+#include <pragma/diagnostic_push>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/errno.h>
+#include <linux/vmalloc.h>
+#include <pragma/diagnostic_pop>
+
+#define lpm_zalloc(size)	vzalloc(size)
+#define lpm_free(ptr)		vfree(ptr)
+
+#else  /* user space */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define lpm_zalloc(size)	calloc(1, size)
+#define lpm_free(ptr)		free(ptr)
+
+#endif
+
+#include <lang/lpm.h>
+
+
+#define LPM_CHUNK_SIZE		(1U << LPM_CHUNK_BITS)
+
+
+int pfq_lpm_trie_init(struct pfq_lpm_trie *t, int bits)
+{
+	t->bits = bits;
+	t->nchunks = 0;
+	t->maxchunks = 0;
+	t->chunks = NULL;
+
+	t->root = lpm_zalloc(sizeof(uint32_t) << LPM_ROOT_BITS);
+	if (t->root == NULL)
+		return -ENOMEM;
+	return 0;
+}
+
+
+void pfq_lpm_trie_free(struct pfq_lpm_trie *t)
+{
+	lpm_free(t->root);
+	lpm_free(t->chunks);
+	t->root = NULL;
+	t->chunks = NULL;
+	t->nchunks = 0;
+	t->maxchunks = 0;
+}
+
+
+/* new chunk inheriting the value of the (shorter) prefix that covers it */
+
+static int
+pfq_lpm_trie_new_chunk(struct pfq_lpm_trie *t, uint32_t value)
+{
+	uint32_t n;
+
+	if (t->nchunks == t->maxchunks) {
+
+		uint32_t max = t->maxchunks ? t->maxchunks * 2 : 64;
+		uint32_t *chunks;
+
+		if (max >= LPM_CHUNK)
+			return -ENOSPC;
+
+		chunks = lpm_zalloc((size_t)max * LPM_CHUNK_SIZE * sizeof(uint32_t));
+		if (chunks == NULL)
+			return -ENOMEM;
+
+		if (t->chunks)
+			memcpy(chunks, t->chunks, (size_t)t->nchunks * LPM_CHUNK_SIZE * sizeof(uint32_t));
+
+		lpm_free(t->chunks);
+		t->chunks = chunks;
+		t->maxchunks = max;
+	}
+
+	for(n = 0; n < LPM_CHUNK_SIZE; n++)
+		t->chunks[t->nchunks * LPM_CHUNK_SIZE + n] = value;
+
+	return (int)t->nchunks++;
+}
+
+
+int pfq_lpm_trie_insert(struct pfq_lpm_trie *t, const uint8_t *addr, int prefix, uint32_t value)
+{
+	uint32_t *table = t->root;	/* the table of the current level */
+	int chunk = -1;
+	int pos = 0, stride = LPM_ROOT_BITS;
+	uint32_t index = ((uint32_t)addr[0] << 8) | addr[1];
+
+	if (prefix < 0 || prefix > t->bits || value == 0 || value >= LPM_CHUNK)
+		return -EINVAL;
+
+	for(;;)
+	{
+		uint32_t e;
+
+		if (prefix <= pos + stride) {
+
+			/* expand the prefix over the entries it covers (longer prefixes come later) */
+
+			uint32_t span = 1U << (pos + stride - prefix);
+			uint32_t n, first = index & ~(span - 1);
+
+			for(n = first; n < first + span; n++)
+			{
+				if (table[n] & LPM_CHUNK)
+					return -EINVAL; /* not sorted by ascending length */
+				table[n] = value;
+			}
+
+			return 0;
+		}
+
+		e = table[index];
+
+		if (!(e & LPM_CHUNK)) {
+
+			int c = pfq_lpm_trie_new_chunk(t, e);
+			if (c < 0)
+				return c;
+
+			/* the chunks may have been reallocated */
+
+			table = chunk < 0 ? t->root : t->chunks + (size_t)chunk * LPM_CHUNK_SIZE;
+			table[index] = LPM_CHUNK | (uint32_t)c;
+			e = table[index];
+		}
+
+		chunk = (int)(e & ~LPM_CHUNK);
+		table = t->chunks + (size_t)chunk * LPM_CHUNK_SIZE;
+
+		pos += stride;
+		stride = LPM_CHUNK_BITS;
+		index = addr[pos >> 3];
+	}
+}
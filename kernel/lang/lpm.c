@@ -0,0 +1,150 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pragma/diagnostic_push>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+
+#include <pragma/diagnostic_pop>
+
+#include <lang/module.h>
+#include <lang/lpm.h>
+
+#include <pf_q-group.h>
+#include <pf_q-lpm.h>
+
+
+#define LPM_SRC		1
+#define LPM_DST		2
+
+
+/* the destination address is looked up first */
+
+static bool
+lpm_lookup(arguments_t args, SkBuff skb, int dir, uint32_t *value)
+{
+	struct pfq_lpm_table *lt;
+	__be16 proto = eth_hdr(PFQ_SKB(skb))->h_proto;
+
+	lt = pfq_lpm_table_get(PFQ_CB(skb)->monad->group->lpm, GET_ARG_0(uint32_t, args));
+	if (lt == NULL)
+		return false;
+
+	if (lt->family == 4) {
+
+		struct iphdr _iph;
+		const struct iphdr *ip;
+
+		if (proto != __constant_htons(ETH_P_IP))
+			return false;
+
+		ip = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_iph), &_iph);
+		if (ip == NULL)
+			return false;
+
+		return ((dir & LPM_DST) && pfq_lpm_table_lookup(lt, &ip->daddr, value)) ||
+		       ((dir & LPM_SRC) && pfq_lpm_table_lookup(lt, &ip->saddr, value));
+	}
+	else {
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6;
+
+		if (proto != __constant_htons(ETH_P_IPV6))
+			return false;
+
+		ip6 = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_ip6h), &_ip6h);
+		if (ip6 == NULL)
+			return false;
+
+		return ((dir & LPM_DST) && pfq_lpm_table_lookup(lt, &ip6->daddr, value)) ||
+		       ((dir & LPM_SRC) && pfq_lpm_table_lookup(lt, &ip6->saddr, value));
+	}
+}
+
+
+static bool
+lpm_src(arguments_t args, SkBuff skb)
+{
+	uint32_t value;
+	return lpm_lookup(args, skb, LPM_SRC, &value);
+}
+
+
+static bool
+lpm_dst(arguments_t args, SkBuff skb)
+{
+	uint32_t value;
+	return lpm_lookup(args, skb, LPM_DST, &value);
+}
+
+
+static ActionSkBuff
+lpm_class(arguments_t args, SkBuff skb)
+{
+	uint32_t value;
+
+	if (lpm_lookup(args, skb, LPM_SRC|LPM_DST, &value))
+		return Deliver(skb, value);
+
+	return Drop(skb);
+}
+
+
+static ActionSkBuff
+lpm_steer(arguments_t args, SkBuff skb)
+{
+	uint32_t value;
+
+	if (lpm_lookup(args, skb, LPM_SRC|LPM_DST, &value))
+		return Steering(skb, value);
+
+	return Drop(skb);
+}
+
+
+static int lpm_init(arguments_t args)
+{
+	const char *name = GET_ARG_0(const char *, args);
+	uint32_t id = pfq_lpm_table_id(name);
+
+	pr_devel("[PFQ|init] lpm table: '%s' -> id=%x\n", name, id);
+
+	/* the table is looked up by id: it may be created (or replaced) later */
+
+	SET_ARG_0(args, id);
+	return 0;
+}
+
+
+struct pfq_lang_function_descr lpm_functions[] = {
+
+	{"lpm_src",	"String -> SkBuff -> Bool",		lpm_src,	lpm_init },
+	{"lpm_dst",	"String -> SkBuff -> Bool",		lpm_dst,	lpm_init },
+	{"lpm_class",	"String -> SkBuff -> Action SkBuff",	lpm_class,	lpm_init },
+	{"lpm_steer",	"String -> SkBuff -> Action SkBuff",	lpm_steer,	lpm_init },
+	{ NULL }};
+
@@ -0,0 +1,82 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PFQ_LANG_LPM_H
+#define PFQ_LANG_LPM_H
+
+/* self-contained: this header builds in user space too (misc/lpm) */
+
+#include <pragma/diagnostic_push>
+#include <linux/types.h>
+#include <pragma/diagnostic_pop>
+
+
+/*
+ * Longest-prefix-match multibit trie (DIR-16-8-...):
+ * a root table indexed by the first 16 bits of the address, then chunks
+ * of 256 entries indexed by the next bytes (2 levels for IPv4, up to 14
+ * for IPv6). Prefixes are expanded into the entries they cover.
+ *
+ * entry: 0 (no match), LPM_CHUNK|index (next level), value otherwise.
+ */
+
+#define LPM_CHUNK		(1U << 31)
+#define LPM_ROOT_BITS		16
+#define LPM_CHUNK_BITS		8
+
+
+struct pfq_lpm_trie
+{
+	int		bits;		/* 32 (IPv4) or 128 (IPv6) */
+	uint32_t	*root;		/* 2^LPM_ROOT_BITS entries */
+	uint32_t	*chunks;	/* maxchunks x 2^LPM_CHUNK_BITS entries */
+	uint32_t	nchunks;
+	uint32_t	maxchunks;
+};
+
+
+extern int  pfq_lpm_trie_init(struct pfq_lpm_trie *t, int bits);
+extern void pfq_lpm_trie_free(struct pfq_lpm_trie *t);
+
+/* prefixes must be inserted by ascending length; value in [1, LPM_CHUNK) */
+
+extern int  pfq_lpm_trie_insert(struct pfq_lpm_trie *t, const uint8_t *addr, int prefix, uint32_t value);
+
+
+/* addr in network order: returns the value of the longest prefix, 0 if none */
+
+static inline
+uint32_t pfq_lpm_trie_lookup(const struct pfq_lpm_trie *t, const uint8_t *addr)
+{
+	uint32_t e = t->root[((uint32_t)addr[0] << 8) | addr[1]];
+	const uint8_t *next = addr + 2;
+
+	while (e & LPM_CHUNK)
+		e = t->chunks[((e & ~LPM_CHUNK) << LPM_CHUNK_BITS) | *next++];
+
+	return e;
+}
+
+
+#endif /* PFQ_LANG_LPM_H */
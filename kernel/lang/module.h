@@ -241,6 +241,13 @@ eval_function(function_t f, SkBuff skb)
 
 extern struct pfq_lang_function_descr  filter_functions[];
 extern struct pfq_lang_function_descr  bloom_functions[];
+extern struct pfq_lang_function_descr  lpm_functions[];
+extern struct pfq_lang_function_descr  flow_functions[];
+extern struct pfq_lang_function_descr  sample_functions[];
+extern struct pfq_lang_function_descr  policer_functions[];
+extern struct pfq_lang_function_descr  conntrack_functions[];
+extern struct pfq_lang_function_descr  sketch_functions[];
+extern struct pfq_lang_function_descr  pattern_functions[];
 extern struct pfq_lang_function_descr  vlan_functions[];
 extern struct pfq_lang_function_descr  forward_functions[];
 extern struct pfq_lang_function_descr  steering_functions[];
@@ -0,0 +1,263 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pragma/diagnostic_push>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/skbuff.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+
+#include <pragma/diagnostic_pop>
+
+#include <lang/module.h>
+#include <lang/aho-corasick.h>
+
+
+/*
+ * Payload pattern matching: the patterns are compiled into a DFA by the init
+ * function (see aho-corasick.h), the payload is the transport payload for TCP
+ * and UDP, the IP payload otherwise.
+ */
+
+
+static bool
+payload_range(SkBuff skb, unsigned int *from, unsigned int *to)
+{
+	__be16 proto = eth_hdr(PFQ_SKB(skb))->h_proto;
+	unsigned int offset;
+	uint8_t l4proto;
+
+	if (proto == __constant_htons(ETH_P_IP)) {
+
+		struct iphdr _iph;
+		const struct iphdr *ip;
+
+		ip = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_iph), &_iph);
+		if (ip == NULL)
+			return false;
+
+		if (ip->frag_off & __constant_htons(IP_OFFSET))
+			return false;
+
+		l4proto = ip->protocol;
+		offset = skb->mac_len + (ip->ihl<<2);
+	}
+	else if (proto == __constant_htons(ETH_P_IPV6)) {
+
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6;
+
+		ip6 = skb_header_pointer(PFQ_SKB(skb), skb->mac_len, sizeof(_ip6h), &_ip6h);
+		if (ip6 == NULL)
+			return false;
+
+		l4proto = ip6->nexthdr;
+		offset = skb->mac_len + sizeof(struct ipv6hdr);
+	}
+	else
+		return false;
+
+	if (l4proto == IPPROTO_TCP) {
+
+		uint8_t _doff;
+		const uint8_t *doff;
+
+		doff = skb_header_pointer(PFQ_SKB(skb), offset + 12, 1, &_doff);
+		if (doff == NULL)
+			return false;
+
+		offset += (*doff >> 4) << 2;
+	}
+	else if (l4proto == IPPROTO_UDP)
+		offset += 8;
+
+	if (offset >= skb->len)
+		return false;
+
+	*from = offset;
+	*to = skb->len;
+	return true;
+}
+
+
+static bool
+payload_scan(struct pfq_ac const *ac, SkBuff skb, unsigned int from, unsigned int to)
+{
+	struct skb_seq_state st;
+	const u8 *data;
+	unsigned int consumed = 0, len;
+	uint16_t state = 0;
+
+	/* fast path: linear data */
+
+	if (to <= skb_headlen(PFQ_SKB(skb)))
+		return pfq_ac_scan(ac, &state, skb->data + from, to - from);
+
+	skb_prepare_seq_read(PFQ_SKB(skb), from, to, &st);
+
+	while ((len = skb_seq_read(consumed, &data, &st)) != 0)
+	{
+		if (pfq_ac_scan(ac, &state, data, len)) {
+			skb_abort_seq_read(&st);
+			return true;
+		}
+		consumed += len;
+	}
+
+	return false;
+}
+
+
+static bool
+has_pattern(arguments_t args, SkBuff skb)
+{
+	struct pfq_ac *ac = GET_ARG_1(struct pfq_ac *, args);
+	unsigned int from, to;
+
+	if (!payload_range(skb, &from, &to))
+		return false;
+
+	return payload_scan(ac, skb, from, to);
+}
+
+
+static bool
+has_pattern_at(arguments_t args, SkBuff skb)
+{
+	const int offset = GET_ARG_0(int, args);
+	const int depth  = GET_ARG_1(int, args);
+	struct pfq_ac *ac = GET_ARG_3(struct pfq_ac *, args);
+	unsigned int from, to;
+
+	if (!payload_range(skb, &from, &to))
+		return false;
+
+	from += offset;
+	if (depth > 0 && from + depth < to)
+		to = from + depth;
+
+	if (from >= to)
+		return false;
+
+	return payload_scan(ac, skb, from, to);
+}
+
+
+static ActionSkBuff
+pattern_filter(arguments_t args, SkBuff skb)
+{
+	return has_pattern(args, skb) ? Pass(skb) : Drop(skb);
+}
+
+
+static struct pfq_ac *
+pattern_compile(const char **patterns, size_t n)
+{
+	struct pfq_ac *ac;
+	int err;
+
+	if (n == 0) {
+		printk(KERN_INFO "[PFQ|init] pattern: empty set of patterns!\n");
+		return NULL;
+	}
+
+	ac = kzalloc(sizeof(struct pfq_ac), GFP_KERNEL);
+	if (ac == NULL) {
+		printk(KERN_INFO "[PFQ|init] pattern: out of memory!\n");
+		return NULL;
+	}
+
+	err = pfq_ac_compile(ac, patterns, n);
+	if (err < 0) {
+		printk(KERN_INFO "[PFQ|init] pattern: could not compile patterns (%d)!\n", err);
+		kfree(ac);
+		return NULL;
+	}
+
+	pr_devel("[PFQ|init] pattern: %zu patterns, %u states, %u classes\n", n, ac->nstates, ac->nclasses);
+	return ac;
+}
+
+
+static void
+pattern_free(struct pfq_ac *ac)
+{
+	if (ac) {
+		pfq_ac_free(ac);
+		kfree(ac);
+	}
+}
+
+
+static int has_pattern_init(arguments_t args)
+{
+	struct pfq_ac *ac = pattern_compile(GET_ARRAY_0(const char *, args), LEN_ARRAY_0(args));
+	if (ac == NULL)
+		return -EINVAL;
+
+	SET_ARG_1(args, ac);
+	return 0;
+}
+
+static int has_pattern_fini(arguments_t args)
+{
+	pattern_free(GET_ARG_1(struct pfq_ac *, args));
+	return 0;
+}
+
+
+static int has_pattern_at_init(arguments_t args)
+{
+	struct pfq_ac *ac;
+
+	if (GET_ARG_0(int, args) < 0 || GET_ARG_1(int, args) < 0) {
+		printk(KERN_INFO "[PFQ|init] has_pattern_at: bad offset/depth!\n");
+		return -EINVAL;
+	}
+
+	ac = pattern_compile(GET_ARRAY_2(const char *, args), LEN_ARRAY_2(args));
+	if (ac == NULL)
+		return -EINVAL;
+
+	SET_ARG_3(args, ac);
+	return 0;
+}
+
+static int has_pattern_at_fini(arguments_t args)
+{
+	pattern_free(GET_ARG_3(struct pfq_ac *, args));
+	return 0;
+}
+
+
+struct pfq_lang_function_descr pattern_functions[] = {
+
+	{ "has_pattern",    "[String] -> SkBuff -> Bool",			has_pattern,	has_pattern_init,    has_pattern_fini },
+	{ "has_pattern_at", "CInt -> CInt -> [String] -> SkBuff -> Bool",	has_pattern_at,	has_pattern_at_init, has_pattern_at_fini },
+	{ "pattern_filter", "[String] -> SkBuff -> Action SkBuff",		pattern_filter,	has_pattern_init,    has_pattern_fini },
+	{ NULL }};
+
@@ -0,0 +1,305 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pragma/diagnostic_push>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+
+#include <pragma/diagnostic_pop>
+
+#include <lang/module.h>
+#include <lang/hash.h>
+#include <lang/policer.h>
+
+
+/*
+ * Token-bucket policers. The state is allocated by the init function and
+ * stored in the first unused argument:
+ *
+ * limit_pps, limit_bps, police: a shared bucket with per-cpu caches,
+ * police_flow: per-cpu arrays of buckets indexed by the flow hash (RSS
+ * keeps a flow on the same cpu, so no state is shared).
+ */
+
+#define POLICE_FLOW_BUCKETS	1024
+
+
+struct policer
+{
+	spinlock_t		lock;
+	struct tb_params	params;
+	struct token_bucket	bucket;
+	struct tb_cache __percpu *cache;
+};
+
+
+struct flow_policer
+{
+	struct token_bucket	bucket[POLICE_FLOW_BUCKETS];
+};
+
+
+static inline uint64_t
+policer_now(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+
+static bool
+policer_conform(struct policer *p, uint64_t cost)
+{
+	struct tb_cache *c = this_cpu_ptr(p->cache);
+	uint64_t now;
+
+	if (likely(tb_cache_consume(c, cost)))
+		return true;
+
+	now = policer_now();
+	if ((int64_t)(now - c->retry) < 0)
+		return false;
+
+	spin_lock(&p->lock);
+	tb_cache_refill(c, &p->bucket, &p->params, cost, now);
+	spin_unlock(&p->lock);
+
+	return tb_cache_consume(c, cost);
+}
+
+
+static ActionSkBuff
+limit_pps(arguments_t args, SkBuff skb)
+{
+	struct policer *p = GET_ARG_1(struct policer *, args);
+
+	return policer_conform(p, 1) ? Pass(skb) : Drop(skb);
+}
+
+
+static ActionSkBuff
+limit_bps(arguments_t args, SkBuff skb)
+{
+	struct policer *p = GET_ARG_1(struct policer *, args);
+
+	return policer_conform(p, skb->len << 3) ? Pass(skb) : Drop(skb);
+}
+
+
+/* out-of-profile packets are not dropped, but re-classified */
+
+static ActionSkBuff
+police(arguments_t args, SkBuff skb)
+{
+	const int c = GET_ARG_1(int, args);
+	struct policer *p = GET_ARG_2(struct policer *, args);
+
+	if (policer_conform(p, 1))
+		return Pass(skb);
+
+	return Pass(class(skb, 1ULL << c));
+}
+
+
+static ActionSkBuff
+police_flow(arguments_t args, SkBuff skb)
+{
+	struct flow_policer __percpu *fp = GET_ARG_1(struct flow_policer __percpu *, args);
+	struct tb_params *params = GET_ARG_2(struct tb_params *, args);
+	struct token_bucket *tb;
+	uint32_t hash;
+
+	if (!flow_hash_symmetric(skb, &hash))
+		return Pass(skb);
+
+	tb = &this_cpu_ptr(fp)->bucket[hash & (POLICE_FLOW_BUCKETS-1)];
+
+	return tb_conform(tb, params, 1, policer_now()) ? Pass(skb) : Drop(skb);
+}
+
+
+/* burst: 100 ms worth of tokens, at least one full-size frame for limit_bps */
+
+static struct policer *
+policer_alloc(uint64_t rate, uint64_t min_burst)
+{
+	struct policer *p;
+	uint64_t burst;
+	int cpu;
+
+	p = kzalloc(sizeof(struct policer), GFP_KERNEL);
+	if (p == NULL)
+		return NULL;
+
+	p->cache = alloc_percpu(struct tb_cache);
+	if (p->cache == NULL) {
+		kfree(p);
+		return NULL;
+	}
+
+	burst = max(rate / 10, min_burst);
+
+	spin_lock_init(&p->lock);
+	tb_params_init(&p->params, rate, burst);
+	tb_init(&p->bucket, &p->params, policer_now());
+
+	for_each_possible_cpu(cpu)
+	{
+		per_cpu_ptr(p->cache, cpu)->tokens = 0;
+		per_cpu_ptr(p->cache, cpu)->retry = 0;
+	}
+
+	return p;
+}
+
+
+static void
+policer_free(struct policer *p)
+{
+	if (p) {
+		free_percpu(p->cache);
+		kfree(p);
+	}
+}
+
+
+static int limit_init(arguments_t args, uint64_t min_burst, int slot)
+{
+	const uint64_t rate = GET_ARG_0(uint64_t, args);
+	struct policer *p;
+
+	if (rate == 0) {
+		printk(KERN_INFO "[PFQ|init] policer: rate must be greater than 0!\n");
+		return -EINVAL;
+	}
+
+	p = policer_alloc(rate, min_burst);
+	if (p == NULL) {
+		printk(KERN_INFO "[PFQ|init] policer: out of memory!\n");
+		return -ENOMEM;
+	}
+
+	if (slot == 1)
+		SET_ARG_1(args, p);
+	else
+		SET_ARG_2(args, p);
+
+	pr_devel("[PFQ|init] policer: rate:%llu burst:%llu@%p\n", rate, p->params.burst, p);
+	return 0;
+}
+
+
+static int limit_pps_init(arguments_t args)
+{
+	return limit_init(args, 1, 1);
+}
+
+static int limit_bps_init(arguments_t args)
+{
+	return limit_init(args, 1514 << 3, 1);
+}
+
+static int limit_fini(arguments_t args)
+{
+	policer_free(GET_ARG_1(struct policer *, args));
+	return 0;
+}
+
+
+static int police_init(arguments_t args)
+{
+	const int c = GET_ARG_1(int, args);
+
+	if (c <= 0 || c >= (int)Q_CLASS_MAX - 1) {
+		printk(KERN_INFO "[PFQ|init] police: bad class (%d)!\n", c);
+		return -EINVAL;
+	}
+
+	return limit_init(args, 1, 2);
+}
+
+static int police_fini(arguments_t args)
+{
+	policer_free(GET_ARG_2(struct policer *, args));
+	return 0;
+}
+
+
+static int police_flow_init(arguments_t args)
+{
+	const uint64_t rate = GET_ARG_0(uint64_t, args);
+	struct flow_policer __percpu *fp;
+	struct tb_params *params;
+	uint64_t now = policer_now();
+	int cpu, n;
+
+	if (rate == 0) {
+		printk(KERN_INFO "[PFQ|init] police_flow: rate must be greater than 0!\n");
+		return -EINVAL;
+	}
+
+	params = kzalloc(sizeof(struct tb_params), GFP_KERNEL);
+	fp = alloc_percpu(struct flow_policer);
+	if (params == NULL || fp == NULL) {
+		printk(KERN_INFO "[PFQ|init] police_flow: out of memory!\n");
+		free_percpu(fp);
+		kfree(params);
+		return -ENOMEM;
+	}
+
+	tb_params_init(params, rate, max_t(uint64_t, rate / 10, 1));
+
+	for_each_possible_cpu(cpu)
+	{
+		for(n = 0; n < POLICE_FLOW_BUCKETS; n++)
+			tb_init(&per_cpu_ptr(fp, cpu)->bucket[n], params, now);
+	}
+
+	SET_ARG_1(args, fp);
+	SET_ARG_2(args, params);
+
+	pr_devel("[PFQ|init] police_flow: rate:%llu@%p\n", rate, fp);
+	return 0;
+}
+
+static int police_flow_fini(arguments_t args)
+{
+	free_percpu(GET_ARG_1(struct flow_policer __percpu *, args));
+	kfree(GET_ARG_2(struct tb_params *, args));
+	return 0;
+}
+
+
+struct pfq_lang_function_descr policer_functions[] = {
+
+	{ "limit_pps",	 "Word64 -> SkBuff -> Action SkBuff",		limit_pps,	limit_pps_init,	  limit_fini },
+	{ "limit_bps",	 "Word64 -> SkBuff -> Action SkBuff",		limit_bps,	limit_bps_init,	  limit_fini },
+	{ "police",	 "Word64 -> CInt -> SkBuff -> Action SkBuff",	police,		police_init,	  police_fini },
+	{ "police_flow", "Word64 -> SkBuff -> Action SkBuff",		police_flow,	police_flow_init, police_flow_fini },
+	{ NULL }};
+
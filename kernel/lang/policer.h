@@ -0,0 +1,164 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PFQ_LANG_POLICER_H
+#define PFQ_LANG_POLICER_H
+
+/* self-contained: this header builds in user space too (misc/policer) */
+
+#include <pragma/diagnostic_push>
+#include <linux/types.h>
+#include <pragma/diagnostic_pop>
+
+
+/*
+ * Token buckets: tokens are kept in millionths (TB_SCALE), time in ns.
+ * The rate is in tokens per second (packets or bits), the burst in tokens.
+ *
+ * A policer shared by all the cpus is a two-level bucket: each cpu spends
+ * the tokens of a private cache, and only when the cache is dry it takes
+ * (under lock) a quantum from the shared bucket. The quantum is about 1 ms
+ * worth of tokens, which bounds the error due to the tokens left in the
+ * caches of idle cpus.
+ */
+
+#define TB_SCALE		1000000ULL
+#define TB_MAX_IDLE_NS		1000000000ULL
+
+
+struct tb_params
+{
+	uint64_t	rate;		/* tokens per second */
+	uint64_t	burst;		/* tokens */
+	uint64_t	quantum;	/* scaled tokens taken by a cache at a time */
+};
+
+
+struct token_bucket
+{
+	uint64_t	tokens;		/* scaled */
+	uint64_t	last;		/* ns */
+};
+
+
+struct tb_cache
+{
+	uint64_t	tokens;		/* scaled */
+	uint64_t	retry;		/* ns: don't take the lock before this time */
+};
+
+
+static inline void
+tb_params_init(struct tb_params *p, uint64_t rate, uint64_t burst)
+{
+	p->rate    = rate;
+	p->burst   = burst;
+	p->quantum = rate * (TB_SCALE / 1000);
+	if (p->quantum > burst * TB_SCALE / 4)
+		p->quantum = burst * TB_SCALE / 4;
+}
+
+
+static inline void
+tb_init(struct token_bucket *tb, const struct tb_params *p, uint64_t now)
+{
+	tb->tokens = p->burst * TB_SCALE;
+	tb->last = now;
+}
+
+
+static inline void
+tb_refill(struct token_bucket *tb, const struct tb_params *p, uint64_t now)
+{
+	uint64_t delta, us;
+
+	if ((int64_t)(now - tb->last) <= 0)
+		return;
+
+	delta = now - tb->last;
+
+	if (delta > TB_MAX_IDLE_NS) {
+		tb->tokens += (TB_MAX_IDLE_NS / 1000) * p->rate;
+		tb->last = now;
+	}
+	else {
+		/* whole microseconds only: the remainder is kept in last */
+		us = delta / 1000;
+		tb->tokens += us * p->rate;
+		tb->last += us * 1000;
+	}
+
+	if (tb->tokens > p->burst * TB_SCALE)
+		tb->tokens = p->burst * TB_SCALE;
+}
+
+
+/* single-level bucket (the caller owns it): cost in tokens */
+
+static inline bool
+tb_conform(struct token_bucket *tb, const struct tb_params *p, uint64_t cost, uint64_t now)
+{
+	tb_refill(tb, p, now);
+	if (tb->tokens < cost * TB_SCALE)
+		return false;
+	tb->tokens -= cost * TB_SCALE;
+	return true;
+}
+
+
+/* two-level bucket, fast path: spend the tokens of the cache, if any */
+
+static inline bool
+tb_cache_consume(struct tb_cache *c, uint64_t cost)
+{
+	if (c->tokens < cost * TB_SCALE)
+		return false;
+	c->tokens -= cost * TB_SCALE;
+	return true;
+}
+
+
+/* two-level bucket, slow path (shared bucket locked): refill the cache */
+
+static inline void
+tb_cache_refill(struct tb_cache *c, struct token_bucket *tb, const struct tb_params *p, uint64_t cost, uint64_t now)
+{
+	uint64_t want, grant;
+
+	tb_refill(tb, p, now);
+
+	want = p->quantum + cost * TB_SCALE - c->tokens;
+	grant = tb->tokens < want ? tb->tokens : want;
+
+	tb->tokens -= grant;
+	c->tokens += grant;
+
+	/* shared bucket short of tokens: back off until it has refilled enough */
+
+	if (c->tokens < cost * TB_SCALE)
+		c->retry = now + (cost * TB_SCALE - c->tokens) * 1000 / (p->rate ? p->rate : 1);
+}
+
+
+#endif /* PFQ_LANG_POLICER_H */
@@ -0,0 +1,155 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pragma/diagnostic_push>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/random.h>
+
+#include <pragma/diagnostic_pop>
+
+#include <lang/module.h>
+#include <lang/hash.h>
+
+
+/*
+ * Sampling functions: the state (counter and random generator) is per-cpu,
+ * allocated by the init function and stored in the (unused) arg 1.
+ * Probabilities are 32-bit thresholds: UINT32_MAX stands for 1.
+ */
+
+struct sample_state
+{
+	uint32_t	count;
+	uint32_t	rnd;	/* xorshift32 */
+};
+
+
+static inline bool
+sample_threshold(uint32_t value, uint32_t threshold)
+{
+	return value < threshold || threshold == UINT32_MAX;
+}
+
+
+static ActionSkBuff
+sample_every(arguments_t args, SkBuff skb)
+{
+	const uint32_t n = GET_ARG_0(uint32_t, args);
+	struct sample_state *st = this_cpu_ptr(GET_ARG_1(struct sample_state __percpu *, args));
+
+	if (++st->count >= n) {
+		st->count = 0;
+		return Pass(skb);
+	}
+
+	return Drop(skb);
+}
+
+
+static ActionSkBuff
+sample_rand(arguments_t args, SkBuff skb)
+{
+	const uint32_t threshold = GET_ARG_0(uint32_t, args);
+	struct sample_state *st = this_cpu_ptr(GET_ARG_1(struct sample_state __percpu *, args));
+	uint32_t x = st->rnd;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	st->rnd = x;
+
+	return sample_threshold(x, threshold) ? Pass(skb) : Drop(skb);
+}
+
+
+/* consistent per-flow sampling: symmetric hash of the 5-tuple, the same on every cpu */
+
+static ActionSkBuff
+sample_flow(arguments_t args, SkBuff skb)
+{
+	const uint32_t threshold = GET_ARG_0(uint32_t, args);
+	uint32_t hash;
+
+	if (!flow_hash_symmetric(skb, &hash))
+		return Drop(skb);
+
+	return sample_threshold(hash, threshold) ? Pass(skb) : Drop(skb);
+}
+
+
+static int sample_init(arguments_t args)
+{
+	struct sample_state __percpu *st;
+	int cpu;
+
+	st = alloc_percpu(struct sample_state);
+	if (st == NULL) {
+		printk(KERN_INFO "[PFQ|init] sample: out of memory!\n");
+		return -ENOMEM;
+	}
+
+	for_each_possible_cpu(cpu)
+	{
+		per_cpu_ptr(st, cpu)->count = 0;
+		per_cpu_ptr(st, cpu)->rnd = prandom_u32() | 1;
+	}
+
+	SET_ARG_1(args, st);
+
+	pr_devel("[PFQ|init] sample: per-cpu state@%p\n", st);
+	return 0;
+}
+
+
+static int sample_every_init(arguments_t args)
+{
+	if (GET_ARG_0(int, args) <= 0) {
+		printk(KERN_INFO "[PFQ|init] sample_every: bad argument (%d)!\n", GET_ARG_0(int, args));
+		return -EINVAL;
+	}
+
+	return sample_init(args);
+}
+
+
+static int sample_fini(arguments_t args)
+{
+	struct sample_state __percpu *st = GET_ARG_1(struct sample_state __percpu *, args);
+
+	free_percpu(st);
+	pr_devel("[PFQ|fini] sample: per-cpu state freed@%p\n", st);
+	return 0;
+}
+
+
+struct pfq_lang_function_descr sample_functions[] = {
+
+	{ "sample_every",	"CInt -> SkBuff -> Action SkBuff",	sample_every,	sample_every_init,	sample_fini },
+	{ "sample_rand",	"Word32 -> SkBuff -> Action SkBuff",	sample_rand,	sample_init,		sample_fini },
+	{ "sample_flow",	"Word32 -> SkBuff -> Action SkBuff",	sample_flow },
+	{ NULL }};
+
@@ -0,0 +1,96 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pragma/diagnostic_push>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+
+#include <pragma/diagnostic_pop>
+
+#include <lang/module.h>
+#include <lang/hash.h>
+
+#include <pf_q-group.h>
+#include <pf_q-sketch.h>
+
+
+/* update the sketch of the group for the given key (if created) */
+
+static inline ActionSkBuff
+sketch_update(SkBuff skb, int which)
+{
+	struct pfq_sketch *sk;
+	struct pfq_flow_key key;
+	uint8_t tcp_flags;
+
+	sk = (struct pfq_sketch *)atomic_long_read(&PFQ_CB(skb)->monad->group->sketch[which]);
+	if (sk == NULL || !flow_key(skb, &key, &tcp_flags))
+		return Pass(skb);
+
+	switch(which)
+	{
+	case Q_SKETCH_KEY_SRC:
+		memset(key.daddr, 0, sizeof(key.daddr));
+		key.sport = key.dport = 0;
+		key.proto = 0;
+		break;
+	case Q_SKETCH_KEY_DST:
+		memset(key.saddr, 0, sizeof(key.saddr));
+		key.sport = key.dport = 0;
+		key.proto = 0;
+		break;
+	}
+
+	pfq_sketch_update(sk, &key, (sk->flags & Q_SKETCH_BYTES) ? skb->len : 1);
+	return Pass(skb);
+}
+
+
+static ActionSkBuff
+sketch_src(arguments_t args, SkBuff skb)
+{
+	return sketch_update(skb, Q_SKETCH_KEY_SRC);
+}
+
+static ActionSkBuff
+sketch_dst(arguments_t args, SkBuff skb)
+{
+	return sketch_update(skb, Q_SKETCH_KEY_DST);
+}
+
+static ActionSkBuff
+sketch_flow(arguments_t args, SkBuff skb)
+{
+	return sketch_update(skb, Q_SKETCH_KEY_FLOW);
+}
+
+
+struct pfq_lang_function_descr sketch_functions[] = {
+
+	{ "sketch_src",		"SkBuff -> Action SkBuff",	sketch_src	},
+	{ "sketch_dst",		"SkBuff -> Action SkBuff",	sketch_dst	},
+	{ "sketch_flow",	"SkBuff -> Action SkBuff",	sketch_flow	},
+	{ NULL }};
+
@@ -100,9 +100,11 @@ static inline void smp_wmb() { barrier(); }
 #define Q_SO_SET_RX_CAPLEN		3
 #define Q_SO_SET_RX_SLOTS		4
 #define Q_SO_SET_RX_OFFSET		5
+#define Q_SO_SET_RX_OVERLOAD		6	/* overload policy of the Rx queue */
 #define Q_SO_SET_TX_SLOTS		7
 #define Q_SO_SET_WEIGHT			8
 
+#define Q_SO_GROUP_BLOOM		9	/* named bloom filters of the group */
 #define Q_SO_GROUP_BIND			10
 #define Q_SO_GROUP_UNBIND		11
 #define Q_SO_GROUP_JOIN			12
@@ -129,11 +131,27 @@ static inline void smp_wmb() { barrier(); }
 #define Q_SO_GET_GROUP_STATS		31
 #define Q_SO_GET_GROUP_COUNTERS		32
 #define Q_SO_GET_WEIGHT			33
+#define Q_SO_GET_RX_OVERLOAD		34
+
+/* options from 35 on are listed in numeric order */
+
+#define Q_SO_GROUP_LPM			35	/* named longest-prefix-match tables of the group */
+#define Q_SO_GROUP_FLOWS		36	/* flow table of the group */
+#define Q_SO_GET_GROUP_FLOWS		37	/* export of the flow table of the group */
+#define Q_SO_SET_FLOW_RING		38	/* ring of exported flow records (records) */
+#define Q_SO_GROUP_SKETCH		39	/* sketches of the group (count-min, top-k, hyperloglog) */
 
 #define Q_SO_TX_BIND			40
 #define Q_SO_TX_UNBIND			41
 #define Q_SO_TX_QUEUE			42
 
+#define Q_SO_GET_GROUP_SKETCH		43	/* read of a sketch of the group (cpus merged) */
+#define Q_SO_SET_RX_WATERMARK		44	/* wake-up watermark of the Rx queue */
+#define Q_SO_SET_RX_EVENTFD		45	/* eventfd signaled on wake-up (-1 = none) */
+#define Q_SO_GET_RX_WATERMARK		46
+#define Q_SO_SET_RX_VLAN_INSERT		47	/* re-insert the 802.1Q tag into the captured packet */
+#define Q_SO_GET_RX_VLAN_INSERT		48
+
 
 /* general placeholders */
 
@@ -148,6 +166,14 @@ static inline void smp_wmb() { barrier(); }
 #define Q_TSTAMP_ON			1
 
 
+/*Rx overload policies*/
+
+#define Q_OVERLOAD_DROP_TAIL		0	/*default*/
+#define Q_OVERLOAD_DROP_CLASS		1	/* shed packets not in class_mask */
+#define Q_OVERLOAD_DROP_STATE		2	/* shed packets with (state & state_mask) != state_value */
+#define Q_OVERLOAD_RED			3	/* random early drop */
+
+
 /*vlan*/
 
 #define Q_VLAN_PRIO_MASK		0xe000
@@ -180,6 +206,73 @@ static inline void smp_wmb() { barrier(); }
 
 #define Q_MAX_COUNTERS			64
 #define Q_MAX_TX_QUEUES			4
+#define Q_MAX_RX_QUEUES			4	/* Rx sub-queues per socket (0 is the default one) */
+#define Q_MAX_GROUP_BLOOMS		8	/* named bloom filters per group */
+#define Q_BLOOM_NAME_LEN		16
+#define Q_MAX_GROUP_LPMS		4	/* named LPM tables per group */
+#define Q_LPM_NAME_LEN			16
+#define Q_LPM_MAX_RULES			(1 << 20)
+#define Q_FLOW_MAX_CAPACITY		(1 << 22)	/* flow entries per cpu */
+#define Q_MAX_FLOW_RING_LEN		(1 << 18)	/* flow records per socket */
+#define Q_SKETCH_DEPTH			4		/* count-min rows */
+#define Q_SKETCH_MAX_WIDTH		(1 << 16)	/* count-min columns */
+#define Q_SKETCH_MAX_TOPK		256		/* heavy hitters per cpu */
+#define Q_SKETCH_HLL_BITS		12
+#define Q_SKETCH_HLL_REGS		(1 << Q_SKETCH_HLL_BITS)	/* hyperloglog registers */
+
+
+/*group bloom filter operations*/
+
+#define Q_BLOOM_CREATE			0	/* m bins, network prefix */
+#define Q_BLOOM_DESTROY			1
+#define Q_BLOOM_ADD			2	/* add addresses (incremental) */
+#define Q_BLOOM_REMOVE			3	/* remove addresses (incremental) */
+#define Q_BLOOM_LOAD			4	/* replace the content with the given keys */
+
+/*group LPM table operations*/
+
+#define Q_LPM_CREATE			0	/* family: 4 or 6 */
+#define Q_LPM_DESTROY			1
+#define Q_LPM_ADD			2	/* add (or update) rules */
+#define Q_LPM_REMOVE			3	/* remove the rules with the given prefixes */
+#define Q_LPM_LOAD			4	/* replace the rules */
+
+/*group flow table operations*/
+
+#define Q_FLOW_CREATE			0	/* capacity: entries per cpu */
+#define Q_FLOW_DESTROY			1
+#define Q_FLOW_CLEAR			2
+#define Q_FLOW_TIMEOUTS			3	/* active/idle timeouts of the exported records */
+
+/*flow records: reason of the export*/
+
+#define Q_FLOW_SNAPSHOT			0	/* bulk export (getsockopt) */
+#define Q_FLOW_EXPIRED_IDLE		1
+#define Q_FLOW_EXPIRED_ACTIVE		2
+#define Q_FLOW_EVICTED			3	/* the table is full */
+
+/*group sketch operations*/
+
+#define Q_SKETCH_CREATE			0	/* width, topk, flags */
+#define Q_SKETCH_DESTROY		1
+#define Q_SKETCH_CLEAR			2
+
+/*group sketch keys*/
+
+#define Q_SKETCH_KEY_SRC		0	/* source address */
+#define Q_SKETCH_KEY_DST		1	/* destination address */
+#define Q_SKETCH_KEY_FLOW		2	/* 5-tuple */
+#define Q_SKETCH_KEYS			3
+
+/*group sketch flags*/
+
+#define Q_SKETCH_BYTES			1	/* count bytes rather than packets */
+
+/*group bloom filter keys*/
+
+#define Q_BLOOM_KEY_IPV4		0	/* uint32_t, network prefix */
+#define Q_BLOOM_KEY_IPV6		1	/* struct in6_addr, network prefix */
+#define Q_BLOOM_KEY_TUPLE		2	/* struct pfq_bloom_tuple */
 
 
 /* PFQ socket queue */
@@ -218,11 +311,44 @@ struct pfq_tx_queue
 } __attribute__((aligned(64)));
 
 
+/*
+ * Rx sub-queues 1..Q_MAX_RX_QUEUES-1 (rx_class[0..]) are mapped after the Tx
+ * async queues, each one taking the memory of the default Rx queue.
+ * A sub-queue is in use if its len is not zero.
+ */
+
+/*
+ * Ring of the flow records exported by the groups of the socket (struct
+ * pfq_flow_stat): multiple producers (the kernel), single consumer.
+ */
+
+struct pfq_flow_queue
+{
+        unsigned int            len;        /* records (power of 2), 0 = disabled */
+        size_t                  off;        /* offset of the records from the shared memory */
+
+        struct
+        {
+                unsigned long   index;
+                unsigned long   lost;
+
+        } prod __attribute__((aligned(64)));
+
+        struct
+        {
+                unsigned long   index;
+
+        } cons __attribute__((aligned(64)));
+};
+
+
 struct pfq_shared_queue
 {
         struct pfq_rx_queue rx;
         struct pfq_tx_queue tx;
         struct pfq_tx_queue tx_async[Q_MAX_TX_QUEUES];
+        struct pfq_rx_queue rx_class[Q_MAX_RX_QUEUES-1];
+        struct pfq_flow_queue flow;
 };
 
 
@@ -382,6 +508,150 @@ struct pfq_group_join
         int gid;
         int policy;
         unsigned long class_mask;
+        unsigned long queue_mask;   /* classes delivered to a dedicated Rx sub-queue */
+};
+
+/*
+ * Rx overload policy: evaluated before the copy, when the fill of the Rx queue
+ * reaches threshold (percent of its slots). Random early drop sheds packets with
+ * a probability that grows linearly from threshold to the full queue.
+ */
+
+struct pfq_rx_overload
+{
+        int policy;
+        unsigned int threshold;         /* percent of the Rx queue, 0..100 */
+        unsigned long class_mask;       /* DROP_CLASS: classes retained under overload */
+        uint32_t state_mask;            /* DROP_STATE: packets retained if (state & state_mask) == state_value */
+        uint32_t state_value;
+};
+
+/*
+ * Rx wake-up watermark: waiters (poll/epoll, eventfd) are woken when an Rx
+ * queue reaches packets, or usecs after the first packet entered the empty
+ * queue (0 = no timeout). The default (1 packet) wakes on the first packet.
+ * packets can not exceed the Rx slots, and a full queue always wakes.
+ */
+
+struct pfq_rx_watermark
+{
+        unsigned int packets;
+        unsigned int usecs;
+};
+
+/*
+ * Named bloom filter of a group: a counting (blocked) filter updated while the
+ * computation is running, and read lock-free by the bloom_table functions.
+ */
+
+struct pfq_bloom_tuple
+{
+        uint32_t saddr[4];                      /* IPv4 addresses in saddr[0]/daddr[0], the rest zeroed */
+        uint32_t daddr[4];
+        uint16_t sport;                         /* network order */
+        uint16_t dport;
+        uint8_t  proto;
+        uint8_t  pad[3];
+};
+
+struct pfq_group_bloom
+{
+        int gid;
+        int op;                                 /* Q_BLOOM_CREATE, Q_BLOOM_ADD... */
+        char name[Q_BLOOM_NAME_LEN];
+        unsigned int m;                         /* CREATE: number of bins (rounded up to a power of 2) */
+        int prefix;                             /* CREATE: network prefix (IPv4, IPv6 keys) */
+        int key;                                /* CREATE: Q_BLOOM_KEY_IPV4, Q_BLOOM_KEY_IPV6... */
+        const void __user *keys;                /* ADD, REMOVE, LOAD: keys (addresses in network order) */
+        size_t n;
+};
+
+/*
+ * Named longest-prefix-match table of a group: IPv4 or IPv6 prefixes mapped
+ * to class masks or steering keys, read lock-free by the lpm functions.
+ */
+
+struct pfq_lpm_rule
+{
+        uint32_t addr[4];                       /* network order: IPv4 in addr[0] */
+        int      prefix;
+        uint32_t value;                         /* class mask (lpm_class) or steering key (lpm_steer) */
+};
+
+struct pfq_group_lpm
+{
+        int gid;
+        int op;                                 /* Q_LPM_CREATE, Q_LPM_ADD... */
+        char name[Q_LPM_NAME_LEN];
+        int family;                             /* CREATE: 4 or 6 */
+        const struct pfq_lpm_rule __user *rules;/* ADD, REMOVE, LOAD */
+        size_t n;
+};
+
+/*
+ * Flow table of a group: per-cpu cuckoo hash tables keyed by 5-tuple, updated
+ * by the flow functions and exported (per cpu) to user space.
+ */
+
+struct pfq_flow_key
+{
+        uint32_t saddr[4];                      /* IPv4 addresses in saddr[0]/daddr[0], the rest zeroed */
+        uint32_t daddr[4];
+        uint16_t sport;                         /* network order */
+        uint16_t dport;
+        uint8_t  proto;
+        uint8_t  family;                        /* 4 or 6 */
+        uint16_t reserved;
+};
+
+struct pfq_flow_stat
+{
+        struct pfq_flow_key key;
+        uint64_t packets;
+        uint64_t bytes;
+        uint64_t first;                         /* timestamps, in nsec */
+        uint64_t last;
+        uint32_t state;                         /* user-defined (flow_set_state) */
+        int      cpu;
+        uint8_t  tcp_flags;                     /* OR of the TCP flags */
+        uint8_t  reason;                        /* Q_FLOW_SNAPSHOT, Q_FLOW_EXPIRED_IDLE... */
+        uint16_t reserved;
+};
+
+struct pfq_group_flows
+{
+        int gid;
+        int op;                                 /* setsockopt: Q_FLOW_CREATE, Q_FLOW_DESTROY... */
+        size_t capacity;                        /* CREATE: entries per cpu */
+        struct pfq_flow_stat __user *flows;     /* getsockopt: the exported flows */
+        size_t n;                               /* getsockopt: size of flows (in), exported flows (out) */
+        unsigned int active_timeout;            /* TIMEOUTS: seconds, 0 = none */
+        unsigned int idle_timeout;              /* TIMEOUTS: seconds, 0 = none */
+};
+
+/*
+ * Sketches of a group, one per key: count-min (with the top-k heavy hitters)
+ * and hyperloglog, updated per cpu by the sketch functions and merged on read.
+ */
+
+struct pfq_sketch_item
+{
+        struct pfq_flow_key key;                /* the fields of the sketch key, the rest zeroed */
+        uint64_t count;                         /* count-min estimate */
+};
+
+struct pfq_group_sketch
+{
+        int gid;
+        int op;                                 /* setsockopt: Q_SKETCH_CREATE, Q_SKETCH_DESTROY... */
+        int key;                                /* Q_SKETCH_KEY_SRC, Q_SKETCH_KEY_DST, Q_SKETCH_KEY_FLOW */
+        uint32_t width;                         /* CREATE: count-min columns (power of 2) */
+        uint32_t topk;                          /* CREATE: heavy hitters tracked per cpu */
+        uint32_t flags;                         /* CREATE: Q_SKETCH_BYTES */
+        struct pfq_sketch_item __user *items;   /* getsockopt: heavy hitters, by count */
+        size_t n;                               /* getsockopt: size of items (in), heavy hitters (out) */
+        uint8_t __user *hll;                    /* getsockopt: Q_SKETCH_HLL_REGS registers, or NULL */
+        uint64_t total;                         /* getsockopt: packets (or bytes) counted */
 };
 
 struct pfq_group_computation
@@ -422,6 +692,11 @@ struct pfq_stats
 
 	unsigned long int frwd;		/* forwarded to devices */
 	unsigned long int kern;		/* forwarded to kernel  */
+
+	unsigned long int shed_tail;	/* overload: queue full (drop-tail) */
+	unsigned long int shed_class;	/* overload: shed by class      */
+	unsigned long int shed_state;	/* overload: shed by monad state */
+	unsigned long int shed_red;	/* overload: random early drop  */
 };
 
 
@@ -0,0 +1,377 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pragma/diagnostic_push>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/jhash.h>
+#include <linux/inetdevice.h>
+#include <linux/semaphore.h>
+#include <linux/delay.h>
+#include <linux/uaccess.h>
+
+#include <pragma/diagnostic_pop>
+
+#include <pf_q-bloom.h>
+#include <pf_q-group.h>
+#include <pf_q-define.h>
+
+#include <lang/bloom.h>
+
+
+#define Q_BLOOM_CHUNK	1024	/* keys copied from user space at a time */
+
+
+uint32_t pfq_bloom_table_id(const char *name)
+{
+	return jhash(name, strnlen(name, Q_BLOOM_NAME_LEN), 0);
+}
+
+
+static struct pfq_bloom_table *
+pfq_bloom_table_alloc(const char *name, int key, uint32_t nblocks, const __be32 mask[4])
+{
+	struct pfq_bloom_table *bt;
+
+	bt = kzalloc(sizeof(struct pfq_bloom_table), GFP_KERNEL);
+	if (bt == NULL)
+		return NULL;
+
+	/* vmalloc'd memory is page aligned: blocks are cache line aligned */
+
+	bt->mem   = vzalloc(nblocks * (BBF_BLOCK_BITS >> 3));
+	bt->count = vzalloc(nblocks * BBF_BLOCK_BITS);
+
+	if (!bt->mem || !bt->count) {
+		vfree(bt->mem);
+		vfree(bt->count);
+		kfree(bt);
+		return NULL;
+	}
+
+	strncpy(bt->name, name, Q_BLOOM_NAME_LEN-1);
+
+	bt->id      = pfq_bloom_table_id(bt->name);
+	bt->key     = key;
+	bt->nblocks = nblocks;
+	memcpy(bt->mask, mask, sizeof(bt->mask));
+	return bt;
+}
+
+
+static void
+pfq_bloom_table_destroy(struct pfq_bloom_table *bt)
+{
+	vfree(bt->mem);
+	vfree(bt->count);
+	kfree(bt);
+}
+
+
+static void
+pfq_bloom_table_add(struct pfq_bloom_table *bt, const void *key)
+{
+	uint32_t words[BBF_KEY_WORDS];
+	uint64_t h = bbf_hash(words, pfq_bloom_table_key(bt, key, words));
+	uint32_t blk = bbf_block(h, bt->nblocks);
+	uint32_t bit;
+	int i;
+
+	bbf_for_each_probe(h, i, bit)
+	{
+		uint32_t b = bit & (BBF_BLOCK_BITS-1);
+		uint8_t *count = &bt->count[blk * BBF_BLOCK_BITS + b];
+
+		if (*count != 0xff)
+			(*count)++;
+	}
+
+	bbf_set(bt->mem, bt->nblocks, h);
+}
+
+
+static void
+pfq_bloom_table_remove(struct pfq_bloom_table *bt, const void *key)
+{
+	uint32_t words[BBF_KEY_WORDS];
+	uint64_t h = bbf_hash(words, pfq_bloom_table_key(bt, key, words));
+	uint32_t blk = bbf_block(h, bt->nblocks);
+	uint64_t *mem = bt->mem + blk * BBF_BLOCK_WORDS;
+	uint32_t bit;
+	int i;
+
+	/* saturated counters are sticky: the bin is never cleared */
+
+	bbf_for_each_probe(h, i, bit)
+	{
+		uint32_t b = bit & (BBF_BLOCK_BITS-1);
+		uint8_t *count = &bt->count[blk * BBF_BLOCK_BITS + b];
+
+		if (*count == 0 || *count == 0xff)
+			continue;
+
+		if (--(*count) == 0)
+			mem[b >> 6] &= ~(1ULL << (b & 63));
+	}
+}
+
+
+static int
+pfq_bloom_table_update(struct pfq_bloom_table *bt, int op, const void __user *keys, size_t n)
+{
+	size_t size = pfq_bloom_key_size(bt->key);
+	size_t i, len;
+	char *buf;
+
+	buf = kmalloc(size * Q_BLOOM_CHUNK, GFP_KERNEL);
+	if (buf == NULL)
+		return -ENOMEM;
+
+	while (n)
+	{
+		len = min_t(size_t, n, Q_BLOOM_CHUNK);
+
+		if (copy_from_user(buf, keys, size * len)) {
+			kfree(buf);
+			return -EFAULT;
+		}
+
+		for(i = 0; i < len; i++)
+		{
+			if (op == Q_BLOOM_REMOVE)
+				pfq_bloom_table_remove(bt, buf + i * size);
+			else
+				pfq_bloom_table_add(bt, buf + i * size);
+		}
+
+		keys = (const char __user *)keys + size * len;
+		n -= len;
+	}
+
+	kfree(buf);
+	return 0;
+}
+
+
+static int
+pfq_bloom_table_slot(struct pfq_group *group, uint32_t id)
+{
+	struct pfq_bloom_table *bt;
+	int n;
+
+	for(n = 0; n < Q_MAX_GROUP_BLOOMS; n++)
+	{
+		bt = (struct pfq_bloom_table *)atomic_long_read(&group->bloom[n]);
+		if (bt && bt->id == id)
+			return n;
+	}
+
+	return -1;
+}
+
+
+static int
+pfq_bloom_table_free_slot(struct pfq_group *group)
+{
+	int n;
+	for(n = 0; n < Q_MAX_GROUP_BLOOMS; n++)
+	{
+		if (atomic_long_read(&group->bloom[n]) == 0)
+			return n;
+	}
+	return -1;
+}
+
+
+static int
+__pfq_bloom_table_ctl(struct pfq_group *group, struct pfq_group_bloom const *op, const char *name)
+{
+	struct pfq_bloom_table *bt, *old;
+	int slot = pfq_bloom_table_slot(group, pfq_bloom_table_id(name));
+	int err;
+
+	switch(op->op)
+	{
+	case Q_BLOOM_CREATE: {
+
+		unsigned int m = clp2(max_t(unsigned int, op->m, BBF_BLOCK_BITS));
+		__be32 mask[4];
+		int n;
+
+		if (slot != -1)
+			return -EEXIST;
+
+		if (m > (1UL << 24)) {
+			printk(KERN_INFO "[PFQ] bloom table '%s': maximum number of bins exceeded (2^24)!\n", name);
+			return -EPERM;
+		}
+
+		switch(op->key)
+		{
+		case Q_BLOOM_KEY_IPV4:
+			if (op->prefix < 0 || op->prefix > 32)
+				return -EINVAL;
+			break;
+		case Q_BLOOM_KEY_IPV6:
+			if (op->prefix < 0 || op->prefix > 128)
+				return -EINVAL;
+			break;
+		case Q_BLOOM_KEY_TUPLE:
+			break;
+		default:
+			return -EINVAL;
+		}
+
+		for(n = 0; n < 4; n++)
+			mask[n] = inet_make_mask(clamp(op->prefix - 32 * n, 0, 32));
+
+		slot = pfq_bloom_table_free_slot(group);
+		if (slot == -1) {
+			printk(KERN_INFO "[PFQ] bloom table '%s': too many tables (max %d)!\n", name, Q_MAX_GROUP_BLOOMS);
+			return -ENOSPC;
+		}
+
+		bt = pfq_bloom_table_alloc(name, op->key, m / BBF_BLOCK_BITS, mask);
+		if (bt == NULL) {
+			printk(KERN_INFO "[PFQ] bloom table '%s': out of memory!\n", name);
+			return -ENOMEM;
+		}
+
+		atomic_long_set(&group->bloom[slot], (long)bt);
+
+		pr_devel("[PFQ] bloom table '%s'@%p: m=%u key=%d prefix=%d\n", name, bt, m, op->key, op->prefix);
+
+	} break;
+
+	case Q_BLOOM_DESTROY: {
+
+		if (slot == -1)
+			return -ENOENT;
+
+		old = (struct pfq_bloom_table *)atomic_long_xchg(&group->bloom[slot], 0L);
+
+		msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+
+		pfq_bloom_table_destroy(old);
+
+	} break;
+
+	case Q_BLOOM_ADD:
+	case Q_BLOOM_REMOVE: {
+
+		if (slot == -1)
+			return -ENOENT;
+
+		bt = (struct pfq_bloom_table *)atomic_long_read(&group->bloom[slot]);
+
+		return pfq_bloom_table_update(bt, op->op, op->keys, op->n);
+	}
+
+	case Q_BLOOM_LOAD: {
+
+		if (slot == -1)
+			return -ENOENT;
+
+		old = (struct pfq_bloom_table *)atomic_long_read(&group->bloom[slot]);
+
+		/* the new content is built aside and then published */
+
+		bt = pfq_bloom_table_alloc(name, old->key, old->nblocks, old->mask);
+		if (bt == NULL) {
+			printk(KERN_INFO "[PFQ] bloom table '%s': out of memory!\n", name);
+			return -ENOMEM;
+		}
+
+		err = pfq_bloom_table_update(bt, Q_BLOOM_ADD, op->keys, op->n);
+		if (err < 0) {
+			pfq_bloom_table_destroy(bt);
+			return err;
+		}
+
+		old = (struct pfq_bloom_table *)atomic_long_xchg(&group->bloom[slot], (long)bt);
+
+		msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+
+		pfq_bloom_table_destroy(old);
+
+	} break;
+
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+
+int
+pfq_bloom_table_ctl(pfq_gid_t gid, struct pfq_group_bloom const *op)
+{
+	struct pfq_group *group;
+	char name[Q_BLOOM_NAME_LEN];
+	int ret;
+
+	group = pfq_get_group(gid);
+	if (group == NULL)
+		return -EINVAL;
+
+	memcpy(name, op->name, Q_BLOOM_NAME_LEN);
+	name[Q_BLOOM_NAME_LEN-1] = '\0';
+
+	down(&group_sem);
+
+	ret = __pfq_bloom_table_ctl(group, op, name);
+
+	up(&group_sem);
+	return ret;
+}
+
+
+void
+pfq_bloom_table_free_all(struct pfq_group *group)
+{
+	struct pfq_bloom_table *old[Q_MAX_GROUP_BLOOMS];
+	bool any = false;
+	int n;
+
+	for(n = 0; n < Q_MAX_GROUP_BLOOMS; n++)
+	{
+		old[n] = (struct pfq_bloom_table *)atomic_long_xchg(&group->bloom[n], 0L);
+		any |= old[n] != NULL;
+	}
+
+	if (!any)
+		return;
+
+	msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+
+	for(n = 0; n < Q_MAX_GROUP_BLOOMS; n++)
+	{
+		if (old[n])
+			pfq_bloom_table_destroy(old[n]);
+	}
+}
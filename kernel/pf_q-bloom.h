@@ -0,0 +1,133 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PF_Q_BLOOM_H
+#define PF_Q_BLOOM_H
+
+#include <pragma/diagnostic_push>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/pf_q.h>
+#include <pragma/diagnostic_pop>
+
+#include <pf_q-types.h>
+
+#include <lang/bloom.h>
+
+
+/*
+ * Named bloom filter of a group (blocked, counting variant):
+ * the data path reads the blocks lock-free, the counters are only
+ * touched by the writers (serialized by group_sem).
+ */
+
+struct pfq_bloom_table
+{
+	uint32_t	id;			/* hash of the name */
+	char		name[Q_BLOOM_NAME_LEN];
+
+	int		key;			/* Q_BLOOM_KEY_IPV4, Q_BLOOM_KEY_IPV6... */
+	uint32_t	nblocks;		/* number of cache lines (power of 2) */
+	__be32		mask[4];		/* network mask (IPv4 keys: mask[0]) */
+
+	uint64_t	*mem;			/* nblocks * BBF_BLOCK_BITS bits */
+	uint8_t		*count;			/* per-bin counters (saturating) */
+};
+
+
+struct pfq_group;
+
+extern uint32_t pfq_bloom_table_id(const char *name);
+
+extern int  pfq_bloom_table_ctl(pfq_gid_t gid, struct pfq_group_bloom const *op);
+extern void pfq_bloom_table_free_all(struct pfq_group *group);
+
+
+/* key words to be hashed: the network mask is applied to addresses */
+
+static inline
+size_t pfq_bloom_table_key(struct pfq_bloom_table const *bt, const void *key, uint32_t words[BBF_KEY_WORDS])
+{
+	const uint32_t *k = key;
+	size_t n;
+
+	switch(bt->key)
+	{
+	case Q_BLOOM_KEY_IPV4:
+		words[0] = k[0] & bt->mask[0];
+		return 1;
+	case Q_BLOOM_KEY_IPV6:
+		for(n = 0; n < 4; n++)
+			words[n] = k[n] & bt->mask[n];
+		return 4;
+	default:
+		memcpy(words, key, sizeof(struct pfq_bloom_tuple));
+		return sizeof(struct pfq_bloom_tuple)/sizeof(uint32_t);
+	}
+}
+
+
+static inline
+size_t pfq_bloom_key_size(int key)
+{
+	switch(key)
+	{
+	case Q_BLOOM_KEY_IPV4:	return sizeof(uint32_t);
+	case Q_BLOOM_KEY_IPV6:	return sizeof(uint32_t) * 4;
+	default:		return sizeof(struct pfq_bloom_tuple);
+	}
+}
+
+
+static inline
+bool pfq_bloom_table_test(struct pfq_bloom_table const *bt, const void *key)
+{
+	uint32_t words[BBF_KEY_WORDS];
+	size_t n = pfq_bloom_table_key(bt, key, words);
+
+	return bbf_test(bt->mem, bt->nblocks, bbf_hash(words, n));
+}
+
+
+/* lookup by id: lock-free, to be called from the data path */
+
+static inline
+struct pfq_bloom_table *
+pfq_bloom_table_get(atomic_long_t *tables, uint32_t id)
+{
+	struct pfq_bloom_table *bt;
+	int n;
+
+	for(n = 0; n < Q_MAX_GROUP_BLOOMS; n++)
+	{
+		bt = (struct pfq_bloom_table *)atomic_long_read(&tables[n]);
+		if (bt && bt->id == id)
+			return bt;
+	}
+
+	return NULL;
+}
+
+
+#endif /* PF_Q_BLOOM_H */
@@ -0,0 +1,227 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pragma/diagnostic_push>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/err.h>
+
+#include <pragma/diagnostic_pop>
+
+#include <pf_q-conntrack.h>
+#include <pf_q-global.h>
+
+
+static DEFINE_MUTEX(ct_lock);
+
+static struct pfq_ct_table *ct_table;
+static int ct_users;
+
+
+/* insert a new connection: on a full bucket the oldest entry is evicted.
+ * Inserts into a bucket are serialized, the connection may have been
+ * inserted by another cpu meanwhile.
+ */
+
+struct pfq_ct_entry *
+pfq_ct_insert(struct pfq_ct_table *ct, struct pfq_flow_key const *key, uint32_t tag, uint32_t index, uint8_t orig)
+{
+	struct pfq_ct_entry *b = pfq_ct_bucket(ct, index), *e;
+	spinlock_t *lock = &ct->insert_lock[(index / PFQ_CT_BUCKET_SLOTS) % PFQ_CT_INSERT_LOCKS];
+	unsigned long now = jiffies;
+	uint32_t old;
+	int n;
+
+	spin_lock(lock);
+
+	e = pfq_ct_find(ct, key, tag, index);
+	if (e)
+		goto out;
+
+	for(n = 0; n < PFQ_CT_BUCKET_SLOTS; n++)
+	{
+		old = READ_ONCE(b[n].tag);
+		if (old & PFQ_CT_TAG_LOCK)
+			continue;
+		if (old == PFQ_CT_TAG_FREE || pfq_ct_expired(&b[n], now)) {
+			e = &b[n];
+			break;
+		}
+		if (e == NULL || time_before(READ_ONCE(b[n].last), READ_ONCE(e->last)))
+			e = &b[n];
+	}
+
+	if (e == NULL)
+		goto out;
+
+	/* claim the entry: on a race with an update or the gc the packet goes untracked */
+
+	old = READ_ONCE(e->tag);
+	if ((old & PFQ_CT_TAG_LOCK) || cmpxchg(&e->tag, old, PFQ_CT_TAG_BUSY) != old) {
+		e = NULL;
+		goto out;
+	}
+
+	e->key   = *key;
+	e->state = PFQ_CT_NEW;
+	e->orig  = orig;
+	e->fin   = 0;
+	e->last  = now;
+
+	pfq_ct_release(e, tag);
+out:
+	spin_unlock(lock);
+	return e;
+}
+
+
+/* garbage collector: scan the whole table once per second */
+
+static int
+pfq_ct_gc(void *data)
+{
+	struct pfq_ct_table *ct = data;
+
+	printk(KERN_INFO "[PFQ] conntrack: gc thread started (%u entries).\n", ct->mask + 1);
+
+	while (!kthread_should_stop())
+	{
+		unsigned long now = jiffies;
+		size_t n, expired = 0;
+
+		for(n = 0; n <= ct->mask; n++)
+		{
+			struct pfq_ct_entry *e = &ct->entry[n];
+			uint32_t tag = READ_ONCE(e->tag);
+
+			/* the entry is locked while tested: the Rx path spins on it */
+
+			if (tag > PFQ_CT_TAG_BUSY && !(tag & PFQ_CT_TAG_LOCK) && pfq_ct_expired(e, now)) {
+				local_bh_disable();
+				if (cmpxchg(&e->tag, tag, tag | PFQ_CT_TAG_LOCK) == tag) {
+					if (pfq_ct_expired(e, now)) {
+						pfq_ct_release(e, PFQ_CT_TAG_FREE);
+						expired++;
+					}
+					else
+						pfq_ct_release(e, tag);
+				}
+				local_bh_enable();
+			}
+
+			if ((n & 4095) == 4095)
+				cond_resched();
+		}
+
+		if (expired)
+			pr_devel("[PFQ] conntrack: %zu entries expired.\n", expired);
+
+		schedule_timeout_interruptible(HZ);
+	}
+
+	printk(KERN_INFO "[PFQ] conntrack: gc thread stopped.\n");
+	return 0;
+}
+
+
+struct pfq_ct_table *
+pfq_conntrack_get(void)
+{
+	struct pfq_ct_table *ct;
+	size_t size;
+	int n;
+
+	mutex_lock(&ct_lock);
+
+	if (ct_table) {
+		ct_users++;
+		mutex_unlock(&ct_lock);
+		return ct_table;
+	}
+
+	size = roundup_pow_of_two(max(ct_size, PFQ_CT_BUCKET_SLOTS));
+
+	ct = kzalloc(sizeof(struct pfq_ct_table), GFP_KERNEL);
+	if (ct == NULL)
+		goto err;
+
+	ct->entry = vzalloc(size * sizeof(struct pfq_ct_entry));
+	if (ct->entry == NULL) {
+		printk(KERN_INFO "[PFQ] conntrack: could not allocate %zu entries!\n", size);
+		goto err;
+	}
+
+	ct->mask = (uint32_t)size - 1;
+
+	for(n = 0; n < PFQ_CT_INSERT_LOCKS; n++)
+		spin_lock_init(&ct->insert_lock[n]);
+
+	ct->gc = kthread_run(pfq_ct_gc, ct, "kpfq/ct");
+	if (IS_ERR(ct->gc)) {
+		printk(KERN_INFO "[PFQ] conntrack: could not start the gc thread!\n");
+		goto err;
+	}
+
+	ct_table = ct;
+	ct_users = 1;
+
+	mutex_unlock(&ct_lock);
+	return ct;
+err:
+	if (ct)
+		vfree(ct->entry);
+	kfree(ct);
+	mutex_unlock(&ct_lock);
+	return NULL;
+}
+
+
+void
+pfq_conntrack_put(void)
+{
+	struct pfq_ct_table *ct = NULL;
+
+	mutex_lock(&ct_lock);
+
+	if (ct_users > 0 && --ct_users == 0) {
+		ct = ct_table;
+		ct_table = NULL;
+	}
+
+	mutex_unlock(&ct_lock);
+
+	if (ct) {
+		kthread_stop(ct->gc);
+		vfree(ct->entry);
+		kfree(ct);
+	}
+}
+
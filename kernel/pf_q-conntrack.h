@@ -0,0 +1,230 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PF_Q_CONNTRACK_H
+#define PF_Q_CONNTRACK_H
+
+#include <pragma/diagnostic_push>
+#include <linux/kernel.h>
+#include <linux/jiffies.h>
+#include <linux/string.h>
+#include <linux/spinlock.h>
+#include <linux/pf_q.h>
+#include <pragma/diagnostic_pop>
+
+#include <lang/bloom.h>
+
+
+/*
+ * Connection tracking (lite): TCP and UDP connections, shared by all the
+ * groups. The two directions of a connection are received on any cpu,
+ * hence the table is not per-cpu: it is a lock-free open hash table of
+ * buckets of PFQ_CT_BUCKET_SLOTS entries, where an entry is claimed with
+ * a cmpxchg on its tag. Keys are canonical (the lower endpoint first), so
+ * that both directions map to the same entry.
+ *
+ * Tags are even: the low bit locks a live entry while its state is
+ * updated (lookups still match it), so that neither an eviction nor the
+ * gc can recycle it under the writer. Inserts are serialized per bucket,
+ * so that the same connection is never inserted twice.
+ *
+ * The table is created by the first pfq-lang function that uses it, and
+ * the expired entries are reclaimed by a garbage collector kthread.
+ */
+
+#define PFQ_CT_BUCKET_SLOTS		4
+#define PFQ_CT_INSERT_LOCKS		64
+
+#define PFQ_CT_TAG_FREE			0
+#define PFQ_CT_TAG_BUSY			1	/* being inserted */
+#define PFQ_CT_TAG_LOCK			1	/* being updated (tag | lock) */
+
+#define PFQ_CT_TIMEOUT_NEW		(30 * HZ)
+#define PFQ_CT_TIMEOUT_TCP		(600 * HZ)
+#define PFQ_CT_TIMEOUT_UDP		(60 * HZ)
+#define PFQ_CT_TIMEOUT_CLOSING		(10 * HZ)
+
+
+enum pfq_ct_state
+{
+	PFQ_CT_NEW = 1,			/* SYN, or first UDP datagram */
+	PFQ_CT_SYN_RECV,		/* SYN-ACK from the responder */
+	PFQ_CT_ESTABLISHED,		/* handshake completed, or UDP reply */
+	PFQ_CT_CLOSING			/* FIN seen */
+};
+
+
+struct pfq_ct_entry
+{
+	uint32_t		tag;		/* free, busy, or hash (| lock) */
+	uint8_t			state;
+	uint8_t			orig;		/* direction of the originator: 0 or 1 */
+	uint8_t			fin;		/* directions that sent a FIN (bits) */
+	uint8_t			reserved;
+	unsigned long		last;		/* jiffies */
+	struct pfq_flow_key	key;		/* canonical */
+
+} ____cacheline_aligned;
+
+
+struct pfq_ct_table
+{
+	uint32_t		mask;		/* entries - 1 */
+	struct pfq_ct_entry	*entry;
+	struct task_struct	*gc;
+	spinlock_t		insert_lock[PFQ_CT_INSERT_LOCKS];
+};
+
+
+extern struct pfq_ct_table *pfq_conntrack_get(void);
+extern void pfq_conntrack_put(void);
+
+extern struct pfq_ct_entry *
+pfq_ct_insert(struct pfq_ct_table *ct, struct pfq_flow_key const *key, uint32_t tag, uint32_t index, uint8_t orig);
+
+
+
+/* canonical key: return the direction of the packet (1 if swapped) */
+
+static inline int
+pfq_ct_key(struct pfq_flow_key *key)
+{
+	int cmp = memcmp(key->saddr, key->daddr, sizeof(key->saddr));
+	if (cmp > 0 || (cmp == 0 && key->sport > key->dport)) {
+		uint32_t addr[4];
+		uint16_t port;
+
+		memcpy(addr, key->saddr, sizeof(addr));
+		memcpy(key->saddr, key->daddr, sizeof(addr));
+		memcpy(key->daddr, addr, sizeof(addr));
+
+		port = key->sport;
+		key->sport = key->dport;
+		key->dport = port;
+		return 1;
+	}
+	return 0;
+}
+
+
+static inline uint32_t
+pfq_ct_tag(struct pfq_flow_key const *key, uint32_t *index)
+{
+	uint64_t h = bbf_hash((const uint32_t *)key, sizeof(*key)/sizeof(uint32_t));
+	uint32_t tag = (uint32_t)(h >> 32) & ~PFQ_CT_TAG_LOCK;
+
+	*index = (uint32_t)h;
+	return tag ? tag : 2;
+}
+
+
+static inline struct pfq_ct_entry *
+pfq_ct_bucket(struct pfq_ct_table *ct, uint32_t index)
+{
+	return &ct->entry[index & ct->mask & ~(PFQ_CT_BUCKET_SLOTS-1)];
+}
+
+
+static inline unsigned long
+pfq_ct_timeout(struct pfq_ct_entry const *e)
+{
+	switch(e->state)
+	{
+	case PFQ_CT_ESTABLISHED:
+		return e->key.proto == IPPROTO_TCP ? PFQ_CT_TIMEOUT_TCP : PFQ_CT_TIMEOUT_UDP;
+	case PFQ_CT_CLOSING:
+		return PFQ_CT_TIMEOUT_CLOSING;
+	default:
+		return PFQ_CT_TIMEOUT_NEW;
+	}
+}
+
+
+static inline bool
+pfq_ct_expired(struct pfq_ct_entry const *e, unsigned long now)
+{
+	return time_after(now, READ_ONCE(e->last) + pfq_ct_timeout(e));
+}
+
+
+/* lookup: the tag is read again after the key, to detect a concurrent rewrite */
+
+static inline struct pfq_ct_entry *
+pfq_ct_find(struct pfq_ct_table *ct, struct pfq_flow_key const *key, uint32_t tag, uint32_t index)
+{
+	struct pfq_ct_entry *b = pfq_ct_bucket(ct, index);
+	int n;
+
+	for(n = 0; n < PFQ_CT_BUCKET_SLOTS; n++)
+	{
+		if ((READ_ONCE(b[n].tag) & ~PFQ_CT_TAG_LOCK) != tag)
+			continue;
+
+		smp_rmb();
+
+		if (memcmp(&b[n].key, key, sizeof(*key)) == 0) {
+			smp_rmb();
+			if ((READ_ONCE(b[n].tag) & ~PFQ_CT_TAG_LOCK) == tag)
+				return &b[n];
+		}
+	}
+
+	return NULL;
+}
+
+
+/* lock an entry found by pfq_ct_find: false if it was recycled meanwhile */
+
+static inline bool
+pfq_ct_claim(struct pfq_ct_entry *e, struct pfq_flow_key const *key, uint32_t tag)
+{
+	while (cmpxchg(&e->tag, tag, tag | PFQ_CT_TAG_LOCK) != tag)
+	{
+		if ((READ_ONCE(e->tag) & ~PFQ_CT_TAG_LOCK) != tag)
+			return false;
+		cpu_relax();
+	}
+
+	/* the entry may have been reused by a connection with the same tag */
+
+	if (memcmp(&e->key, key, sizeof(*key)) != 0) {
+		WRITE_ONCE(e->tag, tag);
+		return false;
+	}
+
+	return true;
+}
+
+
+/* unlock a claimed entry: with PFQ_CT_TAG_FREE the entry is removed */
+
+static inline void
+pfq_ct_release(struct pfq_ct_entry *e, uint32_t tag)
+{
+	smp_wmb();
+	WRITE_ONCE(e->tag, tag);
+}
+
+
+#endif /* PF_Q_CONNTRACK_H */
@@ -30,8 +30,10 @@
 #define Q_MAX_GID		((int)sizeof(long)<<3)
 #define Q_SKBUFF_BATCH		((int)sizeof(long)<<3)
 
-#define Q_GC_LOG_QUEUE_LEN	16
+#define Q_GC_LOG_QUEUE_LEN	256	/* max egress devices per batch */
+#define Q_GC_LOG_HASH_LEN	512	/* power of 2, > Q_GC_LOG_QUEUE_LEN */
 #define Q_GC_POOL_QUEUE_LEN	512
+#define Q_GC_LAZY_QUEUE_LEN	4096	/* (skb, device) pairs sorted per pass */
 
 #define Q_MAX_SOCK_MASK		1024
 #define Q_MAX_DEVICE		1024
@@ -53,6 +55,7 @@
 
 #define Q_MAX_POOL_SIZE         16384
 #define Q_MAX_SOCKQUEUE_LEN	262144
+#define Q_MAX_RX_WATERMARK_USECS 1000000
 
 
 #define Q_INVALID_ID	(__force pfq_id_t)-1
@@ -27,6 +27,8 @@
 #include <linux/version.h>
 #include <linux/module.h>
 #include <linux/skbuff.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
 
 #include <pragma/diagnostic_pop>
 
@@ -35,30 +37,55 @@
 #include <pf_q-sparse.h>
 #include <pf_q-transmit.h>
 #include <pf_q-endpoint.h>
+#include <pf_q-sock.h>
 
 
-void
-add_dev_to_endpoints(struct net_device *dev, struct pfq_endpoint_info *ts)
+/*
+ * Return the slot of the device in the endpoint table of the current batch,
+ * inserting it if not present (open addressing, linear probing).
+ * Return -1 if the table is full.
+ */
+
+int
+pfq_endpoint_slot(struct net_device *dev, struct pfq_endpoint_info *ts)
 {
-	size_t n = 0;
+	unsigned int h = hash_ptr(dev, ilog2(Q_GC_LOG_HASH_LEN));
 
-	for(; n < ts->num; ++n)
+	for(;; h = (h + 1) & (Q_GC_LOG_HASH_LEN-1))
 	{
-		if (dev == ts->dev[n]) {
-			ts->cnt[n]++;
-			ts->cnt_total++;
-			return;
-		}
+		unsigned int slot = ts->hash[h];
+		if (slot == 0)
+			break;
+		if (ts->dev[slot-1] == dev)
+			return (int)slot-1;
 	}
 
-	if (n < Q_GC_LOG_QUEUE_LEN) {
-		ts->dev[n] = dev;
-		ts->cnt[n] = 1;
-		ts->cnt_total++;
-		ts->num++;
-	}
-	else
+	if (ts->num >= Q_GC_LOG_QUEUE_LEN) {
 		pr_devel("[PFQ] GC: forward pool exhausted!\n");
+		return -1;
+	}
+
+	ts->dev[ts->num]  = dev;
+	ts->cnt[ts->num]  = 0;
+	ts->hpos[ts->num] = (uint16_t)h;
+	ts->hash[h] = (uint16_t)++ts->num;
+
+	return (int)ts->num-1;
+}
+
+
+void
+pfq_endpoint_info_reset(struct pfq_endpoint_info *ts)
+{
+	size_t n;
+
+	/* clear the used buckets only */
+
+	for(n = 0; n < ts->num; ++n)
+		ts->hash[ts->hpos[n]] = 0;
+
+	ts->num = 0;
+	ts->cnt_total = 0;
 }
 
 
@@ -73,7 +100,7 @@ size_t copy_to_user_skbs(struct pfq_sock *so, struct pfq_skbuff_GC_queue *skbs,
 
 		smp_rmb();
 
-                cpy = pfq_sk_rx_queue_recv(&so->opt, skbs, mask, len, gid);
+                cpy = pfq_sk_rx_queue_recv(so, skbs, mask, len, gid, cpu);
 
 		__sparse_add(so->stats, recv, cpy, cpu);
 
@@ -93,26 +120,16 @@ static
 size_t copy_to_dev_skbs(struct pfq_sock *so, struct pfq_skbuff_GC_queue *skbs,
 			 unsigned long long mask, int cpu, pfq_gid_t gid)
 {
-	struct net_device *dev;
-	int sent;
-
-	if (so->egress_index) {
-
-		dev = dev_get_by_index(&init_net, so->egress_index);
-		if (dev == NULL) {
-			if (printk_ratelimit())
-				printk(KERN_INFO "[PFQ] egress endpoint not existing (%d)\n",
-				       so->egress_index);
-                        return false;
-		}
-
-		sent = pfq_skb_queue_lazy_xmit_by_mask(skbs, mask, dev, so->egress_queue);
+	struct net_device *dev = pfq_sock_egress_dev(so);
 
-                dev_put(dev);
-		return sent;
+	if (unlikely(dev == NULL)) {
+		if (printk_ratelimit())
+			printk(KERN_INFO "[PFQ] egress endpoint not existing (%d)\n",
+			       so->egress_index);
+		return 0;
 	}
 
-	return 0;
+	return pfq_skb_queue_lazy_xmit_by_mask(skbs, mask, dev, so->egress_queue);
 }
 
 
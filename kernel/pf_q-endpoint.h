@@ -44,10 +44,14 @@ struct pfq_endpoint_info
 	size_t cnt [Q_GC_LOG_QUEUE_LEN];
 	size_t cnt_total;
 	size_t num;
+
+	uint16_t hpos[Q_GC_LOG_QUEUE_LEN];	/* hash bucket of each slot */
+	uint16_t hash[Q_GC_LOG_HASH_LEN];	/* slot + 1 (0 = empty bucket) */
 };
 
 
-void add_dev_to_endpoints(struct net_device *dev, struct pfq_endpoint_info *ts);
+int  pfq_endpoint_slot(struct net_device *dev, struct pfq_endpoint_info *ts);
+void pfq_endpoint_info_reset(struct pfq_endpoint_info *ts);
 
 
 extern size_t copy_to_endpoint_skbs(struct pfq_sock *so,
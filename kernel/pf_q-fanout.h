@@ -0,0 +1,50 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PF_Q_FANOUT_H
+#define PF_Q_FANOUT_H
+
+#include <lang/engine.h>
+#include <lang/GC.h>
+
+struct pfq_percpu_sock;
+
+
+/*
+ * Fan-out of a batch: every packet is run through the groups bound to its
+ * device/queue (bpf and vlan filters, computation, steering) and delivered
+ * to the endpoints of the eligible sockets. Forwarding to devices and to
+ * the kernel is up to the caller.
+ */
+
+extern void pfq_fanout_batch(struct pfq_percpu_sock *sock, struct GC_data *GC_ptr, int cpu);
+
+
+/* with PFQ_FANOUT_LANG_HOOK the computations are run by the embedder (misc/sim) */
+
+#ifdef PFQ_FANOUT_LANG_HOOK
+extern SkBuff pfq_fanout_lang_run(SkBuff buff, struct pfq_lang_computation_tree *prg);
+#endif
+
+#endif /* PF_Q_FANOUT_H */
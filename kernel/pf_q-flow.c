@@ -0,0 +1,515 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pragma/diagnostic_push>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/random.h>
+#include <linux/semaphore.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/uaccess.h>
+
+#include <pragma/diagnostic_pop>
+
+#include <pf_q-flow.h>
+#include <pf_q-group.h>
+#include <pf_q-define.h>
+#include <pf_q-bitops.h>
+#include <pf_q-shared-queue.h>
+
+
+#define PFQ_FLOW_EXPORT_BATCH	64
+#define PFQ_FLOW_EMIT_BATCH	8
+#define PFQ_FLOW_SCAN_MIN	16	/* buckets scanned per tick */
+
+
+static void
+pfq_flow_record(struct pfq_flow_data const *d, int cpu, int reason, struct pfq_flow_stat *rec)
+{
+	rec->key	= d->key;
+	rec->packets	= d->packets;
+	rec->bytes	= d->bytes;
+	rec->first	= d->first;
+	rec->last	= d->last;
+	rec->state	= d->state;
+	rec->cpu	= cpu;
+	rec->tcp_flags	= d->tcp_flags;
+	rec->reason	= (uint8_t)reason;
+	rec->reserved	= 0;
+}
+
+
+/* push the records to the flow rings of the sockets of the group */
+
+static void
+pfq_flow_emit(struct pfq_group *group, struct pfq_flow_stat const *recs, size_t n)
+{
+	unsigned long mask = 0, bit;
+	int i;
+
+	for(i = 0; i < Q_CLASS_MAX; i++)
+		mask |= atomic_long_read(&group->sock_mask[i]);
+
+	pfq_bitwise_foreach(mask, bit,
+	{
+		pfq_id_t id = pfq_ctz(bit);
+		struct pfq_sock *so = pfq_get_sock_by_id(id);
+		if (so)
+			pfq_flow_queue_push(so, recs, n);
+	})
+}
+
+
+/* export the counters of a long-lived flow and restart them */
+
+void
+pfq_flow_expire_active(struct pfq_group *group, struct pfq_flow_entry *e)
+{
+	struct pfq_flow_stat rec;
+
+	pfq_flow_record(&e->d, smp_processor_id(), Q_FLOW_EXPIRED_ACTIVE, &rec);
+
+	raw_write_seqcount_begin(&e->seq);
+	e->d.packets   = 0;
+	e->d.bytes     = 0;
+	e->d.tcp_flags = 0;
+	raw_write_seqcount_end(&e->seq);
+
+	pfq_flow_emit(group, &rec, 1);
+}
+
+
+/* idle flows of a slice of the table of the cpu: exported and removed */
+
+static void
+pfq_flow_scan(struct pfq_group *group, struct pfq_flow_table *ft, int cpu, uint64_t now)
+{
+	struct pfq_flow_cpu *fc = per_cpu_ptr(ft->cpu, cpu);
+	struct pfq_flow_stat recs[PFQ_FLOW_EMIT_BATCH];
+	uint64_t idle = (uint64_t)ft->idle_timeout * NSEC_PER_SEC;
+	uint32_t n, i;
+	size_t k = 0;
+	int s;
+
+	/* the whole table is scanned within the idle timeout (10 ticks per second) */
+
+	n = max_t(uint32_t, DIV_ROUND_UP(ft->nbuckets, ft->idle_timeout * 10), PFQ_FLOW_SCAN_MIN);
+	n = min_t(uint32_t, n, ft->nbuckets);
+
+	for(i = 0; i < n; i++)
+	{
+		struct pfq_flow_bucket *bk = &fc->buckets[fc->cursor++ & (ft->nbuckets - 1)];
+
+		for(s = 0; s < PFQ_FLOW_BUCKET_SLOTS; s++)
+		{
+			struct pfq_flow_entry *e = &bk->slot[s];
+
+			if (bk->hash[s] == 0 || (int64_t)(now - e->d.last) < (int64_t)idle)
+				continue;
+
+			if (e->d.packets)
+				pfq_flow_record(&e->d, cpu, Q_FLOW_EXPIRED_IDLE, &recs[k++]);
+
+			raw_write_seqcount_begin(&e->seq);
+			bk->hash[s] = 0;
+			raw_write_seqcount_end(&e->seq);
+
+			if (k == PFQ_FLOW_EMIT_BATCH) {
+				pfq_flow_emit(group, recs, k);
+				k = 0;
+			}
+		}
+	}
+
+	if (k)
+		pfq_flow_emit(group, recs, k);
+}
+
+
+/* called by the per-cpu timer (softirq), as the data path */
+
+void
+pfq_flow_timer(int cpu)
+{
+	struct pfq_flow_table *ft;
+	struct pfq_group *group;
+	uint64_t now = 0;
+	int gid;
+
+	for(gid = 0; gid < Q_MAX_GID; gid++)
+	{
+		group = pfq_get_group((__force pfq_gid_t)gid);
+		if (group == NULL)
+			continue;
+
+		ft = (struct pfq_flow_table *)atomic_long_read(&group->flows);
+		if (ft == NULL || ft->idle_timeout == 0)
+			continue;
+
+		if (now == 0)
+			now = ktime_to_ns(ktime_get_real());
+
+		pfq_flow_scan(group, ft, cpu, now);
+	}
+}
+
+
+/* the new entry is placed in one of its buckets, evicting (and moving) the old ones if needed */
+
+struct pfq_flow_entry *
+pfq_flow_insert(struct pfq_group *group, struct pfq_flow_table *ft, struct pfq_flow_key const *key, uint64_t hash, uint64_t now)
+{
+	struct pfq_flow_bucket *buckets = per_cpu_ptr(ft->cpu, smp_processor_id())->buckets;
+	struct pfq_flow_entry *ret = NULL, *e;
+	struct pfq_flow_data cur, tmp;
+	uint64_t cur_hash, tmp_hash;
+	uint32_t b[2], alt;
+	int i, s, kick;
+
+	pfq_flow_buckets(ft, hash, &b[0], &b[1]);
+
+	memset(&cur, 0, sizeof(cur));
+	cur.key = *key;
+	cur.last = now;
+	cur_hash = hash;
+
+	for(kick = 0; kick <= PFQ_FLOW_MAX_KICKS; kick++)
+	{
+		/* a free slot in one of the buckets of the current entry */
+
+		for(i = 0; i < 2; i++)
+		{
+			struct pfq_flow_bucket *bk = &buckets[b[i]];
+
+			for(s = 0; s < PFQ_FLOW_BUCKET_SLOTS; s++)
+			{
+				if (bk->hash[s])
+					continue;
+
+				e = &bk->slot[s];
+
+				raw_write_seqcount_begin(&e->seq);
+				bk->hash[s] = cur_hash;
+				e->d = cur;
+				raw_write_seqcount_end(&e->seq);
+
+				return ret ? ret : e;
+			}
+		}
+
+		if (kick == PFQ_FLOW_MAX_KICKS)
+			break;
+
+		/* evict a random entry: it moves to its alternate bucket */
+
+		alt = b[prandom_u32() & 1];
+		s = prandom_u32() % PFQ_FLOW_BUCKET_SLOTS;
+		e = &buckets[alt].slot[s];
+
+		tmp = e->d;
+		tmp_hash = buckets[alt].hash[s];
+
+		raw_write_seqcount_begin(&e->seq);
+		buckets[alt].hash[s] = cur_hash;
+		e->d = cur;
+		raw_write_seqcount_end(&e->seq);
+
+		if (ret == NULL)
+			ret = e;
+		else if (ret == e) /* the new entry has been evicted */
+			ret = NULL;
+
+		cur = tmp;
+		cur_hash = tmp_hash;
+
+		pfq_flow_buckets(ft, cur_hash, &b[0], &b[1]);
+		if (b[0] == alt)
+			b[0] = b[1];
+		else
+			b[1] = b[0];
+	}
+
+	/* the table is full: the last evicted entry is lost (and exported) */
+
+	if (cur.packets) {
+		struct pfq_flow_stat rec;
+		pfq_flow_record(&cur, smp_processor_id(), Q_FLOW_EVICTED, &rec);
+		pfq_flow_emit(group, &rec, 1);
+	}
+
+	return ret;
+}
+
+
+static void
+pfq_flow_table_destroy(struct pfq_flow_table *ft)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+	{
+		vfree(per_cpu_ptr(ft->cpu, cpu)->buckets);
+	}
+
+	free_percpu(ft->cpu);
+	kfree(ft);
+}
+
+
+static struct pfq_flow_table *
+pfq_flow_table_alloc(size_t capacity)
+{
+	struct pfq_flow_table *ft;
+	uint32_t n;
+	int cpu;
+
+	ft = kzalloc(sizeof(struct pfq_flow_table), GFP_KERNEL);
+	if (ft == NULL)
+		return NULL;
+
+	ft->capacity = capacity;
+	ft->nbuckets = roundup_pow_of_two(max_t(size_t, DIV_ROUND_UP(capacity, PFQ_FLOW_BUCKET_SLOTS), 2));
+
+	ft->cpu = alloc_percpu(struct pfq_flow_cpu);
+	if (ft->cpu == NULL) {
+		kfree(ft);
+		return NULL;
+	}
+
+	for_each_possible_cpu(cpu)
+	{
+		struct pfq_flow_bucket *buckets;
+
+		buckets = vzalloc(sizeof(struct pfq_flow_bucket) * ft->nbuckets);
+		if (buckets == NULL) {
+			pfq_flow_table_destroy(ft);
+			return NULL;
+		}
+
+		for(n = 0; n < ft->nbuckets * PFQ_FLOW_BUCKET_SLOTS; n++)
+			seqcount_init(&buckets[n / PFQ_FLOW_BUCKET_SLOTS].slot[n % PFQ_FLOW_BUCKET_SLOTS].seq);
+
+		per_cpu_ptr(ft->cpu, cpu)->buckets = buckets;
+	}
+
+	return ft;
+}
+
+
+static int
+__pfq_flow_table_ctl(struct pfq_group *group, struct pfq_group_flows const *op)
+{
+	struct pfq_flow_table *ft, *old;
+
+	old = (struct pfq_flow_table *)atomic_long_read(&group->flows);
+
+	switch(op->op)
+	{
+	case Q_FLOW_CREATE:
+	case Q_FLOW_CLEAR: {
+
+		size_t capacity = op->op == Q_FLOW_CREATE ? op->capacity : (old ? old->capacity : 0);
+
+		if (op->op == Q_FLOW_CREATE && old)
+			return -EEXIST;
+
+		if (op->op == Q_FLOW_CLEAR && old == NULL)
+			return -ENOENT;
+
+		if (capacity == 0 || capacity > Q_FLOW_MAX_CAPACITY)
+			return -EINVAL;
+
+		/* clear: a new empty table replaces the current one */
+
+		ft = pfq_flow_table_alloc(capacity);
+		if (ft == NULL) {
+			printk(KERN_INFO "[PFQ] flow table: out of memory (%zu entries per cpu)!\n", capacity);
+			return -ENOMEM;
+		}
+
+		if (old) {
+			ft->active_timeout = old->active_timeout;
+			ft->idle_timeout   = old->idle_timeout;
+		}
+
+		old = (struct pfq_flow_table *)atomic_long_xchg(&group->flows, (long)ft);
+		if (old) {
+			msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+			pfq_flow_table_destroy(old);
+		}
+
+		pr_devel("[PFQ] flow table@%p: %u buckets per cpu\n", ft, ft->nbuckets);
+		return 0;
+	}
+
+	case Q_FLOW_TIMEOUTS: {
+
+		if (old == NULL)
+			return -ENOENT;
+
+		old->active_timeout = op->active_timeout;
+		old->idle_timeout   = op->idle_timeout;
+
+		pr_devel("[PFQ] flow table@%p: active timeout=%us idle timeout=%us\n", old,
+			 op->active_timeout, op->idle_timeout);
+		return 0;
+	}
+
+	case Q_FLOW_DESTROY: {
+
+		if (old == NULL)
+			return -ENOENT;
+
+		old = (struct pfq_flow_table *)atomic_long_xchg(&group->flows, 0L);
+
+		msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+
+		pfq_flow_table_destroy(old);
+		return 0;
+	}
+	}
+
+	return -EINVAL;
+}
+
+
+int
+pfq_flow_table_ctl(pfq_gid_t gid, struct pfq_group_flows const *op)
+{
+	struct pfq_group *group;
+	int ret;
+
+	group = pfq_get_group(gid);
+	if (group == NULL)
+		return -EINVAL;
+
+	down(&group_sem);
+
+	ret = __pfq_flow_table_ctl(group, op);
+
+	up(&group_sem);
+	return ret;
+}
+
+
+static int
+__pfq_flow_table_export(struct pfq_flow_table *ft, struct pfq_flow_stat __user *flows, size_t *len)
+{
+	struct pfq_flow_stat *batch;
+	size_t n = 0, k = 0, i;
+	int cpu, ret = 0;
+
+	batch = kmalloc(sizeof(struct pfq_flow_stat) * PFQ_FLOW_EXPORT_BATCH, GFP_KERNEL);
+	if (batch == NULL)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu)
+	{
+		struct pfq_flow_bucket *buckets = per_cpu_ptr(ft->cpu, cpu)->buckets;
+
+		for(i = 0; i < (size_t)ft->nbuckets * PFQ_FLOW_BUCKET_SLOTS && n + k < *len; i++)
+		{
+			struct pfq_flow_bucket *bk = &buckets[i / PFQ_FLOW_BUCKET_SLOTS];
+			int s = i % PFQ_FLOW_BUCKET_SLOTS;
+			struct pfq_flow_data d;
+			uint64_t hash;
+			unsigned int seq;
+
+			/* the entry is being updated by its cpu */
+
+			do {
+				seq  = read_seqcount_begin(&bk->slot[s].seq);
+				hash = bk->hash[s];
+				d    = bk->slot[s].d;
+			}
+			while (read_seqcount_retry(&bk->slot[s].seq, seq));
+
+			if (hash == 0)
+				continue;
+
+			pfq_flow_record(&d, cpu, Q_FLOW_SNAPSHOT, &batch[k]);
+
+			if (++k == PFQ_FLOW_EXPORT_BATCH) {
+				if (copy_to_user(flows + n, batch, sizeof(struct pfq_flow_stat) * k)) {
+					ret = -EFAULT;
+					goto out;
+				}
+				n += k;
+				k = 0;
+			}
+		}
+	}
+
+	if (k && copy_to_user(flows + n, batch, sizeof(struct pfq_flow_stat) * k)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	*len = n + k;
+out:
+	kfree(batch);
+	return ret;
+}
+
+
+int
+pfq_flow_table_export(pfq_gid_t gid, struct pfq_group_flows *op)
+{
+	struct pfq_flow_table *ft;
+	struct pfq_group *group;
+	int ret;
+
+	group = pfq_get_group(gid);
+	if (group == NULL)
+		return -EINVAL;
+
+	/* the table cannot be released while it is exported */
+
+	down(&group_sem);
+
+	ft = (struct pfq_flow_table *)atomic_long_read(&group->flows);
+
+	ret = ft ? __pfq_flow_table_export(ft, op->flows, &op->n) : -ENOENT;
+
+	up(&group_sem);
+	return ret;
+}
+
+
+void
+pfq_flow_table_free(struct pfq_group *group)
+{
+	struct pfq_flow_table *old = (struct pfq_flow_table *)atomic_long_xchg(&group->flows, 0L);
+	if (old == NULL)
+		return;
+
+	msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+
+	pfq_flow_table_destroy(old);
+}
@@ -0,0 +1,204 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PF_Q_FLOW_H
+#define PF_Q_FLOW_H
+
+#include <pragma/diagnostic_push>
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/seqlock.h>
+#include <linux/ktime.h>
+#include <linux/string.h>
+#include <linux/pf_q.h>
+#include <pragma/diagnostic_pop>
+
+#include <pf_q-types.h>
+
+#include <lang/bloom.h>
+
+
+/*
+ * Flow table of a group: a bucketized cuckoo hash table per cpu (flows are
+ * expected to be spread across cpus by RSS), so that the data path updates
+ * the entries without locks. Each key has two candidate buckets of
+ * PFQ_FLOW_BUCKET_SLOTS entries; the hashes of a bucket share a cache line.
+ * The entries are exported under their seqcount.
+ *
+ * With timeouts, the expired flows are exported as records (NetFlow-like) to
+ * the flow rings of the sockets of the group: the active timeout is checked
+ * by the data path, the idle one by the per-cpu timer, scanning a slice of the
+ * table at each tick.
+ */
+
+#define PFQ_FLOW_BUCKET_SLOTS		4
+#define PFQ_FLOW_MAX_KICKS		32
+
+
+struct pfq_flow_data
+{
+	struct pfq_flow_key	key;
+	uint32_t		state;
+	uint8_t			tcp_flags;
+	uint64_t		packets;
+	uint64_t		bytes;
+	uint64_t		first;
+	uint64_t		last;
+};
+
+
+struct pfq_flow_entry
+{
+	seqcount_t		seq;
+	struct pfq_flow_data	d;
+};
+
+
+struct pfq_flow_bucket
+{
+	uint64_t		hash[PFQ_FLOW_BUCKET_SLOTS];	/* 0: free slot */
+	struct pfq_flow_entry	slot[PFQ_FLOW_BUCKET_SLOTS];
+
+} ____cacheline_aligned;
+
+
+struct pfq_flow_cpu
+{
+	struct pfq_flow_bucket	*buckets;
+	uint32_t		cursor;		/* idle scan */
+
+} ____cacheline_aligned;
+
+
+struct pfq_flow_table
+{
+	uint32_t		nbuckets;	/* per cpu, power of 2 */
+	size_t			capacity;
+	unsigned int		active_timeout;	/* seconds, 0 = none */
+	unsigned int		idle_timeout;	/* seconds, 0 = none */
+	struct pfq_flow_cpu __percpu *cpu;
+};
+
+
+struct pfq_group;
+
+extern int  pfq_flow_table_ctl(pfq_gid_t gid, struct pfq_group_flows const *op);
+extern int  pfq_flow_table_export(pfq_gid_t gid, struct pfq_group_flows *op);
+extern void pfq_flow_table_free(struct pfq_group *group);
+
+extern struct pfq_flow_entry *
+pfq_flow_insert(struct pfq_group *group, struct pfq_flow_table *ft, struct pfq_flow_key const *key, uint64_t hash, uint64_t now);
+
+extern void pfq_flow_expire_active(struct pfq_group *group, struct pfq_flow_entry *e);
+extern void pfq_flow_timer(int cpu);
+
+
+static inline uint64_t
+pfq_flow_hash(struct pfq_flow_key const *key)
+{
+	uint64_t h = bbf_hash((const uint32_t *)key, sizeof(*key)/sizeof(uint32_t));
+	return h ? h : 1;
+}
+
+
+static inline void
+pfq_flow_buckets(struct pfq_flow_table const *ft, uint64_t hash, uint32_t *b1, uint32_t *b2)
+{
+	*b1 = (uint32_t)hash & (ft->nbuckets - 1);
+	*b2 = (uint32_t)(hash >> 32) & (ft->nbuckets - 1);
+	if (*b2 == *b1)
+		*b2 ^= 1;
+}
+
+
+static inline struct pfq_flow_entry *
+__pfq_flow_find(struct pfq_flow_bucket *b, struct pfq_flow_key const *key, uint64_t hash)
+{
+	int s;
+	for(s = 0; s < PFQ_FLOW_BUCKET_SLOTS; s++)
+	{
+		if (b->hash[s] == hash && memcmp(&b->slot[s].d.key, key, sizeof(*key)) == 0)
+			return &b->slot[s];
+	}
+	return NULL;
+}
+
+
+/* lookup in the table of the current cpu: to be called from the data path */
+
+static inline struct pfq_flow_entry *
+pfq_flow_find(struct pfq_flow_table *ft, struct pfq_flow_key const *key, uint64_t hash)
+{
+	struct pfq_flow_bucket *buckets = per_cpu_ptr(ft->cpu, smp_processor_id())->buckets;
+	struct pfq_flow_entry *e;
+	uint32_t b1, b2;
+
+	pfq_flow_buckets(ft, hash, &b1, &b2);
+
+	e = __pfq_flow_find(&buckets[b1], key, hash);
+	if (e)
+		return e;
+
+	return __pfq_flow_find(&buckets[b2], key, hash);
+}
+
+
+static inline struct pfq_flow_entry *
+pfq_flow_find_or_insert(struct pfq_group *group, struct pfq_flow_table *ft, struct pfq_flow_key const *key,
+			uint64_t hash, uint64_t now)
+{
+	struct pfq_flow_entry *e = pfq_flow_find(ft, key, hash);
+	return e ? e : pfq_flow_insert(group, ft, key, hash, now);
+}
+
+
+static inline void
+pfq_flow_account(struct pfq_group *group, struct pfq_flow_table const *ft, struct pfq_flow_entry *e,
+		 unsigned int len, uint8_t tcp_flags, uint64_t now)
+{
+	raw_write_seqcount_begin(&e->seq);
+
+	if (e->d.packets++ == 0)
+		e->d.first = now;
+	e->d.bytes += len;
+	e->d.last = now;
+	e->d.tcp_flags |= tcp_flags;
+
+	raw_write_seqcount_end(&e->seq);
+
+	if (ft->active_timeout && now - e->d.first >= (uint64_t)ft->active_timeout * NSEC_PER_SEC)
+		pfq_flow_expire_active(group, e);
+}
+
+
+static inline void
+pfq_flow_set_state(struct pfq_flow_entry *e, uint32_t state)
+{
+	raw_write_seqcount_begin(&e->seq);
+	e->d.state = state;
+	raw_write_seqcount_end(&e->seq);
+}
+
+
+#endif /* PF_Q_FLOW_H */
@@ -46,6 +46,8 @@ int vl_untag		= 0;
 
 int skb_pool_size	= 1024;
 
+int ct_size		= 65536;
+
 int tx_affinity[Q_MAX_CPU] = {0};
 int tx_thread_nr;
 
@@ -65,6 +67,7 @@ module_param(xmit_batch_len,	int, 0644);
 
 module_param(skb_pool_size,	int, 0644);
 module_param(vl_untag,		int, 0644);
+module_param(ct_size,		int, 0644);
 module_param_array(tx_affinity, int, &tx_thread_nr, 0644);
 
 MODULE_PARM_DESC(capture_incoming," Capture incoming packets: (1 default)");
@@ -77,6 +80,7 @@ MODULE_PARM_DESC(capt_batch_len, " Capture batch queue length");
 MODULE_PARM_DESC(xmit_batch_len, " Transmit batch queue length");
 
 MODULE_PARM_DESC(vl_untag, " Enable vlan untagging (default=0)");
+MODULE_PARM_DESC(ct_size, " Connection tracking table entries (default=65536)");
 
 #ifdef PFQ_USE_SKB_POOL
 MODULE_PARM_DESC(skb_pool_size, " Socket buffer pool size (default=1024)");
@@ -46,6 +46,8 @@ extern int vl_untag;
 
 extern int skb_pool_size;
 
+extern int ct_size;
+
 extern int tx_affinity[Q_MAX_CPU];
 extern int tx_thread_nr;
 
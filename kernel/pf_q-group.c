@@ -36,6 +36,10 @@
 #include <pf_q-group.h>
 #include <pf_q-devmap.h>
 #include <pf_q-bitops.h>
+#include <pf_q-bloom.h>
+#include <pf_q-lpm.h>
+#include <pf_q-flow.h>
+#include <pf_q-sketch.h>
 
 #include <lang/engine.h>
 
@@ -176,6 +180,23 @@ __pfq_group_init(pfq_gid_t gid)
         atomic_long_set(&group->comp,     0L);
         atomic_long_set(&group->comp_ctx, 0L);
 
+        for(i = 0; i < Q_MAX_GROUP_BLOOMS; i++)
+        {
+                atomic_long_set(&group->bloom[i], 0L);
+        }
+
+        for(i = 0; i < Q_MAX_GROUP_LPMS; i++)
+        {
+                atomic_long_set(&group->lpm[i], 0L);
+        }
+
+        atomic_long_set(&group->flows, 0L);
+
+        for(i = 0; i < Q_SKETCH_KEYS; i++)
+        {
+                atomic_long_set(&group->sketch[i], 0L);
+        }
+
 	pfq_group_stats_reset(group->stats);
 	pfq_group_counters_reset(group->counters);
 }
@@ -218,6 +239,13 @@ __pfq_group_free(pfq_gid_t gid)
 	if (filter)
 		pfq_free_sk_filter(filter);
 
+	/* release the named bloom filters, lpm tables, the flow table and the sketches */
+
+	pfq_bloom_table_free_all(group);
+	pfq_lpm_table_free_all(group);
+	pfq_flow_table_free(group);
+	pfq_sketch_free_all(group);
+
         group->vlan_filt = false;
 
         pr_devel("[PFQ] group gid=%d freed.\n", gid);
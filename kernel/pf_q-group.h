@@ -59,6 +59,11 @@ struct pfq_group
         atomic_long_t comp;                             /* struct pfq_lang_computation_tree *  (new functional program) */
         atomic_long_t comp_ctx;                         /* void *: storage context (new functional program) */
 
+        atomic_long_t bloom[Q_MAX_GROUP_BLOOMS];        /* struct pfq_bloom_table *: named bloom filters */
+        atomic_long_t lpm[Q_MAX_GROUP_LPMS];            /* struct pfq_lpm_table *: named lpm tables */
+        atomic_long_t flows;                            /* struct pfq_flow_table *: flow table */
+        atomic_long_t sketch[Q_SKETCH_KEYS];            /* struct pfq_sketch *: sketches, by key */
+
 	struct pfq_group_stats __percpu *stats;
 	struct pfq_group_counters __percpu *counters;
 };
@@ -0,0 +1,405 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pragma/diagnostic_push>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/jhash.h>
+#include <linux/sort.h>
+#include <linux/semaphore.h>
+#include <linux/delay.h>
+#include <linux/uaccess.h>
+#include <linux/inetdevice.h>
+
+#include <pragma/diagnostic_pop>
+
+#include <pf_q-lpm.h>
+#include <pf_q-group.h>
+#include <pf_q-define.h>
+
+
+uint32_t pfq_lpm_table_id(const char *name)
+{
+	return jhash(name, strnlen(name, Q_LPM_NAME_LEN), 0);
+}
+
+
+static inline int
+pfq_lpm_bits(int family)
+{
+	return family == 4 ? 32 : 128;
+}
+
+
+/* rules are sorted by (prefix, address): shorter prefixes first, as required by the trie */
+
+static int
+pfq_lpm_rule_cmp(const void *a, const void *b)
+{
+	const struct pfq_lpm_rule *r1 = a, *r2 = b;
+
+	if (r1->prefix != r2->prefix)
+		return r1->prefix - r2->prefix;
+
+	return memcmp(r1->addr, r2->addr, sizeof(r1->addr));
+}
+
+
+static int
+pfq_lpm_rule_canonical(struct pfq_lpm_rule *r, int bits)
+{
+	int n;
+
+	if (r->prefix < 0 || r->prefix > bits)
+		return -EINVAL;
+
+	for(n = 0; n < 4; n++)
+		r->addr[n] = n * 32 < bits ? r->addr[n] & inet_make_mask(clamp(r->prefix - 32 * n, 0, 32)) : 0;
+
+	return 0;
+}
+
+
+static void
+pfq_lpm_table_destroy(struct pfq_lpm_table *lt)
+{
+	pfq_lpm_trie_free(&lt->trie);
+	vfree(lt->rules);
+	kfree(lt);
+}
+
+
+/* a new table takes the ownership of the rules */
+
+static struct pfq_lpm_table *
+pfq_lpm_table_alloc(const char *name, int family, struct pfq_lpm_rule *rules, size_t n, int *err)
+{
+	struct pfq_lpm_table *lt;
+	size_t i;
+
+	lt = kzalloc(sizeof(struct pfq_lpm_table), GFP_KERNEL);
+	if (lt == NULL) {
+		vfree(rules);
+		*err = -ENOMEM;
+		return NULL;
+	}
+
+	strncpy(lt->name, name, Q_LPM_NAME_LEN-1);
+
+	lt->id     = pfq_lpm_table_id(lt->name);
+	lt->family = family;
+	lt->rules  = rules;
+	lt->nrules = n;
+
+	*err = pfq_lpm_trie_init(&lt->trie, pfq_lpm_bits(family));
+	if (*err < 0) {
+		vfree(rules);
+		kfree(lt);
+		return NULL;
+	}
+
+	for(i = 0; i < n; i++)
+	{
+		*err = pfq_lpm_trie_insert(&lt->trie, (const uint8_t *)rules[i].addr, rules[i].prefix, (uint32_t)i + 1);
+		if (*err < 0) {
+			pfq_lpm_table_destroy(lt);
+			return NULL;
+		}
+	}
+
+	return lt;
+}
+
+
+/* copy the rules from user space: canonical, sorted and unique */
+
+static struct pfq_lpm_rule *
+pfq_lpm_rules_from_user(const struct pfq_lpm_rule __user *urules, size_t *n, int family, int *err)
+{
+	struct pfq_lpm_rule *rules;
+	size_t i, k;
+
+	if (*n > Q_LPM_MAX_RULES) {
+		*err = -ENOSPC;
+		return NULL;
+	}
+
+	rules = vmalloc(sizeof(struct pfq_lpm_rule) * max_t(size_t, *n, 1));
+	if (rules == NULL) {
+		*err = -ENOMEM;
+		return NULL;
+	}
+
+	if (copy_from_user(rules, urules, sizeof(struct pfq_lpm_rule) * *n)) {
+		vfree(rules);
+		*err = -EFAULT;
+		return NULL;
+	}
+
+	for(i = 0; i < *n; i++)
+	{
+		if (pfq_lpm_rule_canonical(&rules[i], pfq_lpm_bits(family)) < 0) {
+			vfree(rules);
+			*err = -EINVAL;
+			return NULL;
+		}
+	}
+
+	sort(rules, *n, sizeof(struct pfq_lpm_rule), pfq_lpm_rule_cmp, NULL);
+
+	for(i = 0, k = 0; i < *n; i++)
+	{
+		if (k && pfq_lpm_rule_cmp(&rules[k-1], &rules[i]) == 0)
+			rules[k-1] = rules[i];
+		else
+			rules[k++] = rules[i];
+	}
+
+	*n = k;
+	*err = 0;
+	return rules;
+}
+
+
+/* merge two sorted sets of rules: on equal prefixes, the new rule replaces (or removes) the old one */
+
+static struct pfq_lpm_rule *
+pfq_lpm_rules_merge(struct pfq_lpm_table const *old, struct pfq_lpm_rule const *rules, size_t n,
+		    int op, size_t *len, int *err)
+{
+	struct pfq_lpm_rule *ret;
+	size_t i = 0, j = 0, k = 0;
+
+	if (old->nrules + n > Q_LPM_MAX_RULES) {
+		*err = -ENOSPC;
+		return NULL;
+	}
+
+	ret = vmalloc(sizeof(struct pfq_lpm_rule) * max_t(size_t, old->nrules + n, 1));
+	if (ret == NULL) {
+		*err = -ENOMEM;
+		return NULL;
+	}
+
+	while (i < old->nrules || j < n)
+	{
+		int cmp = i == old->nrules ?  1 :
+			  j == n	   ? -1 : pfq_lpm_rule_cmp(&old->rules[i], &rules[j]);
+
+		if (cmp < 0) {
+			ret[k++] = old->rules[i++];
+			continue;
+		}
+
+		if (cmp == 0)
+			i++;
+
+		if (op == Q_LPM_ADD)
+			ret[k++] = rules[j];
+		j++;
+	}
+
+	*len = k;
+	*err = 0;
+	return ret;
+}
+
+
+static int
+pfq_lpm_table_slot(struct pfq_group *group, uint32_t id)
+{
+	struct pfq_lpm_table *lt;
+	int n;
+
+	for(n = 0; n < Q_MAX_GROUP_LPMS; n++)
+	{
+		lt = (struct pfq_lpm_table *)atomic_long_read(&group->lpm[n]);
+		if (lt && lt->id == id)
+			return n;
+	}
+
+	return -1;
+}
+
+
+static int
+pfq_lpm_table_free_slot(struct pfq_group *group)
+{
+	int n;
+	for(n = 0; n < Q_MAX_GROUP_LPMS; n++)
+	{
+		if (atomic_long_read(&group->lpm[n]) == 0)
+			return n;
+	}
+	return -1;
+}
+
+
+static int
+__pfq_lpm_table_ctl(struct pfq_group *group, struct pfq_group_lpm const *op, const char *name)
+{
+	struct pfq_lpm_table *lt, *old;
+	struct pfq_lpm_rule *rules, *merged;
+	int slot = pfq_lpm_table_slot(group, pfq_lpm_table_id(name));
+	size_t n = op->n, len;
+	int err;
+
+	switch(op->op)
+	{
+	case Q_LPM_CREATE: {
+
+		if (slot != -1)
+			return -EEXIST;
+
+		if (op->family != 4 && op->family != 6)
+			return -EINVAL;
+
+		slot = pfq_lpm_table_free_slot(group);
+		if (slot == -1) {
+			printk(KERN_INFO "[PFQ] lpm table '%s': too many tables (max %d)!\n", name, Q_MAX_GROUP_LPMS);
+			return -ENOSPC;
+		}
+
+		lt = pfq_lpm_table_alloc(name, op->family, NULL, 0, &err);
+		if (lt == NULL) {
+			printk(KERN_INFO "[PFQ] lpm table '%s': out of memory!\n", name);
+			return err;
+		}
+
+		atomic_long_set(&group->lpm[slot], (long)lt);
+
+		pr_devel("[PFQ] lpm table '%s'@%p: IPv%d\n", name, lt, op->family);
+		return 0;
+	}
+
+	case Q_LPM_DESTROY: {
+
+		if (slot == -1)
+			return -ENOENT;
+
+		old = (struct pfq_lpm_table *)atomic_long_xchg(&group->lpm[slot], 0L);
+
+		msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+
+		pfq_lpm_table_destroy(old);
+		return 0;
+	}
+
+	case Q_LPM_ADD:
+	case Q_LPM_REMOVE:
+	case Q_LPM_LOAD: {
+
+		if (slot == -1)
+			return -ENOENT;
+
+		old = (struct pfq_lpm_table *)atomic_long_read(&group->lpm[slot]);
+
+		rules = pfq_lpm_rules_from_user(op->rules, &n, old->family, &err);
+		if (rules == NULL)
+			return err;
+
+		if (op->op == Q_LPM_LOAD) {
+			merged = rules;
+			len = n;
+		}
+		else {
+			merged = pfq_lpm_rules_merge(old, rules, n, op->op, &len, &err);
+			vfree(rules);
+			if (merged == NULL)
+				return err;
+		}
+
+		/* the new trie is built aside and then published */
+
+		lt = pfq_lpm_table_alloc(name, old->family, merged, len, &err);
+		if (lt == NULL) {
+			printk(KERN_INFO "[PFQ] lpm table '%s': build error (%d)!\n", name, err);
+			return err;
+		}
+
+		old = (struct pfq_lpm_table *)atomic_long_xchg(&group->lpm[slot], (long)lt);
+
+		msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+
+		pfq_lpm_table_destroy(old);
+
+		pr_devel("[PFQ] lpm table '%s': %zu rules, %u chunks\n", name, len, lt->trie.nchunks);
+		return 0;
+	}
+	}
+
+	return -EINVAL;
+}
+
+
+int
+pfq_lpm_table_ctl(pfq_gid_t gid, struct pfq_group_lpm const *op)
+{
+	struct pfq_group *group;
+	char name[Q_LPM_NAME_LEN];
+	int ret;
+
+	group = pfq_get_group(gid);
+	if (group == NULL)
+		return -EINVAL;
+
+	memcpy(name, op->name, Q_LPM_NAME_LEN);
+	name[Q_LPM_NAME_LEN-1] = '\0';
+
+	down(&group_sem);
+
+	ret = __pfq_lpm_table_ctl(group, op, name);
+
+	up(&group_sem);
+	return ret;
+}
+
+
+void
+pfq_lpm_table_free_all(struct pfq_group *group)
+{
+	struct pfq_lpm_table *old[Q_MAX_GROUP_LPMS];
+	bool any = false;
+	int n;
+
+	for(n = 0; n < Q_MAX_GROUP_LPMS; n++)
+	{
+		old[n] = (struct pfq_lpm_table *)atomic_long_xchg(&group->lpm[n], 0L);
+		any |= old[n] != NULL;
+	}
+
+	if (!any)
+		return;
+
+	msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+
+	for(n = 0; n < Q_MAX_GROUP_LPMS; n++)
+	{
+		if (old[n])
+			pfq_lpm_table_destroy(old[n]);
+	}
+}
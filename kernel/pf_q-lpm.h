@@ -0,0 +1,98 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PF_Q_LPM_H
+#define PF_Q_LPM_H
+
+#include <pragma/diagnostic_push>
+#include <linux/kernel.h>
+#include <linux/pf_q.h>
+#include <pragma/diagnostic_pop>
+
+#include <pf_q-types.h>
+
+#include <lang/lpm.h>
+
+
+/*
+ * Named LPM table of a group: the rules (sorted by prefix) are kept for the
+ * updates, the trie is rebuilt aside at every update and then published.
+ */
+
+struct pfq_lpm_table
+{
+	uint32_t		id;		/* hash of the name */
+	char			name[Q_LPM_NAME_LEN];
+	int			family;		/* 4 or 6 */
+
+	struct pfq_lpm_rule	*rules;
+	size_t			nrules;
+
+	struct pfq_lpm_trie	trie;		/* entry: index of the rule + 1 */
+};
+
+
+struct pfq_group;
+
+extern uint32_t pfq_lpm_table_id(const char *name);
+
+extern int  pfq_lpm_table_ctl(pfq_gid_t gid, struct pfq_group_lpm const *op);
+extern void pfq_lpm_table_free_all(struct pfq_group *group);
+
+
+/* lookup by id: lock-free, to be called from the data path */
+
+static inline
+struct pfq_lpm_table *
+pfq_lpm_table_get(atomic_long_t *tables, uint32_t id)
+{
+	struct pfq_lpm_table *lt;
+	int n;
+
+	for(n = 0; n < Q_MAX_GROUP_LPMS; n++)
+	{
+		lt = (struct pfq_lpm_table *)atomic_long_read(&tables[n]);
+		if (lt && lt->id == id)
+			return lt;
+	}
+
+	return NULL;
+}
+
+
+/* addr in network order: the value of the longest matching prefix */
+
+static inline
+bool pfq_lpm_table_lookup(struct pfq_lpm_table const *lt, const void *addr, uint32_t *value)
+{
+	uint32_t e = pfq_lpm_trie_lookup(&lt->trie, addr);
+	if (e == 0)
+		return false;
+
+	*value = lt->rules[e-1].value;
+	return true;
+}
+
+
+#endif /* PF_Q_LPM_H */
@@ -40,6 +40,7 @@
 struct pfq_percpu_data __percpu    * percpu_data;
 struct pfq_percpu_sock __percpu    * percpu_sock;
 struct pfq_percpu_pool __percpu    * percpu_pool;
+struct pfq_xmit_dev_stats __percpu * xmit_dev_stats;
 
 extern void pfq_timer (unsigned long);
 
@@ -64,9 +65,18 @@ int pfq_percpu_alloc(void)
                 goto err1;
         }
 
+	xmit_dev_stats = alloc_percpu(struct pfq_xmit_dev_stats);
+	if (!xmit_dev_stats) {
+                printk(KERN_ERR "[PFQ] could not allocate percpu xmit stats!\n");
+                goto err2;
+        }
+
+	pfq_xmit_dev_stats_reset(xmit_dev_stats);
+
 	printk(KERN_INFO "[PFQ] number of online cpus %d\n", num_online_cpus());
         return 0;
 
+err2:	free_percpu(percpu_pool);
 err1:	free_percpu(percpu_sock);
 err0:	free_percpu(percpu_data);
 
@@ -87,6 +97,7 @@ void pfq_percpu_free(void)
 	free_percpu(percpu_data);
 	free_percpu(percpu_sock);
 	free_percpu(percpu_pool);
+	free_percpu(xmit_dev_stats);
 }
 
 
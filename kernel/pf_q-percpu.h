@@ -76,6 +76,7 @@ struct pfq_percpu_data
 extern struct pfq_percpu_data __percpu * percpu_data;
 extern struct pfq_percpu_sock __percpu * percpu_sock;
 extern struct pfq_percpu_pool __percpu * percpu_pool;
+extern struct pfq_xmit_dev_stats __percpu * xmit_dev_stats;
 
 
 static inline void
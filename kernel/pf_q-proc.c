@@ -41,6 +41,7 @@
 #include <pf_q-proc.h>
 #include <pf_q-memory.h>
 #include <pf_q-printk.h>
+#include <pf_q-percpu.h>
 
 #include <lang/printk.h>
 #include <lang/module.h>
@@ -55,6 +56,7 @@ static const char proc_computations[] = "computations";
 static const char proc_groups[]       = "groups";
 static const char proc_stats[]        = "stats";
 static const char proc_memory[]       = "memory";
+static const char proc_forward[]      = "forward";
 
 
 static void
@@ -161,6 +163,7 @@ static int pfq_proc_stats(struct seq_file *m, void *v)
 	seq_printf(m, "  forwarded : %ld\n", sparse_read(&global_stats, frwd));
 	seq_printf(m, "  discarded : %ld\n", sparse_read(&global_stats, disc));
 	seq_printf(m, "  aborted   : %ld\n", sparse_read(&global_stats, abrt));
+	seq_printf(m, "  overflow  : %ld\n", sparse_read(&global_stats, ovfl));
 	seq_printf(m, "SCHEDULE:\n");
 	seq_printf(m, "  poll      : %ld\n", sparse_read(&global_stats, poll));
 	seq_printf(m, "  wakeup    : %ld\n", sparse_read(&global_stats, wake));
@@ -193,6 +196,49 @@ static int pfq_proc_memory(struct seq_file *m, void *v)
 	return 0;
 }
 
+static int pfq_proc_forward(struct seq_file *m, void *v)
+{
+	int n;
+
+	seq_printf(m, "ifindex: batches   packets   avg.batch\n");
+
+	for(n = 0; n < Q_MAX_DEVICE; n++)
+	{
+		long batch = sparse_read(xmit_dev_stats, batch[n]);
+		long pkts  = sparse_read(xmit_dev_stats, pkts[n]);
+
+		if (batch == 0)
+			continue;
+
+		seq_printf(m, "%7d: %-9ld %-9ld %ld\n", n, batch, pkts, pkts/batch);
+	}
+
+	return 0;
+}
+
+static int pfq_proc_forward_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pfq_proc_forward, PDE_DATA(inode));
+}
+
+static ssize_t
+pfq_proc_forward_reset(struct file *file, const char __user *buf, size_t length, loff_t *ppos)
+{
+	pfq_xmit_dev_stats_reset(xmit_dev_stats);
+	return 1;
+}
+
+
+static const struct file_operations pfq_proc_forward_fops = {
+	.owner   = THIS_MODULE,
+	.open    = pfq_proc_forward_open,
+	.read    = seq_read,
+	.write   = pfq_proc_forward_reset,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+
 static int pfq_proc_memory_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, pfq_proc_memory, PDE_DATA(inode));
@@ -278,6 +324,7 @@ int pfq_proc_init(void)
 	proc_create(proc_groups,	0644, pfq_proc_dir, &pfq_proc_groups_fops);
 	proc_create(proc_stats,		0644, pfq_proc_dir, &pfq_proc_stats_fops);
 	proc_create(proc_memory,	0644, pfq_proc_dir, &pfq_proc_memory_fops);
+	proc_create(proc_forward,	0644, pfq_proc_dir, &pfq_proc_forward_fops);
 
 	return 0;
 }
@@ -289,6 +336,7 @@ int pfq_proc_destruct(void)
 	remove_proc_entry(proc_groups,		pfq_proc_dir);
 	remove_proc_entry(proc_stats,		pfq_proc_dir);
 	remove_proc_entry(proc_memory,		pfq_proc_dir);
+	remove_proc_entry(proc_forward,		pfq_proc_dir);
 	remove_proc_entry("pfq", init_net.proc_net);
 
 	return 0;
@@ -29,6 +29,8 @@
 #include <linux/printk.h>
 #include <linux/kthread.h>
 #include <linux/mm.h>
+#include <linux/random.h>
+#include <linux/if_vlan.h>
 #include <linux/pf_q.h>
 
 #include <pragma/diagnostic_pop>
@@ -54,53 +56,181 @@ void *pfq_skb_copy_from_linear_data(const struct sk_buff *skb, void *to, size_t
 
 
 
-size_t pfq_sk_rx_queue_recv(struct pfq_sock_opt *opt,
-			    struct pfq_skbuff_GC_queue *skbs,
-			    unsigned long long mask,
-			    int burst_len,
-			    pfq_gid_t gid)
+/*
+ * Copy the packet into the slot re-inserting the 802.1Q tag stripped by the
+ * driver (hw acceleration): MAC addresses, tag and the rest of the frame are
+ * copied in place, so that the user space does not need to move them.
+ * bytes is the length to be written, tag included.
+ */
+
+static
+int pfq_skb_copy_with_vlan(const struct sk_buff *skb, char *to, size_t bytes)
+{
+	__be16 tag[2] = { htons(ETH_P_8021Q), htons(vlan_tx_tag_get(skb)) };
+	size_t head = min_t(size_t, bytes, 2 * ETH_ALEN);
+
+	if (skb_copy_bits(skb, 0, to, head) != 0)
+		return -EFAULT;
+
+	if (bytes <= 2 * ETH_ALEN)
+		return 0;
+
+	memcpy(to + 2 * ETH_ALEN, tag, min_t(size_t, bytes - 2 * ETH_ALEN, VLAN_HLEN));
+
+	if (bytes <= 2 * ETH_ALEN + VLAN_HLEN)
+		return 0;
+
+	return skb_copy_bits(skb, 2 * ETH_ALEN, to + 2 * ETH_ALEN + VLAN_HLEN, bytes - 2 * ETH_ALEN - VLAN_HLEN);
+}
+
+
+/*
+ * Overload policy: packets are shed from the burst before the copy, once the
+ * fill of the Rx queue reaches the threshold. Returns the mask of the packets
+ * to be copied.
+ */
+
+static
+unsigned long long pfq_sk_rx_shed(struct pfq_sock *so,
+				  struct pfq_skbuff_GC_queue *skbs,
+				  unsigned long long mask,
+				  size_t fill,
+				  int cpu)
+{
+	struct pfq_rx_overload *ovl = &so->opt.rx_overload;
+	size_t low = (so->opt.rx_queue_len * ovl->threshold) / 100;
+	unsigned long long tmp = mask;
+	struct sk_buff __GC *skb;
+	size_t n, shed = 0;
+
+	if (fill < low)
+		return mask;
+
+	switch(ovl->policy)
+	{
+	case Q_OVERLOAD_DROP_CLASS: {
+
+		for_each_skbuff_bitmask(skbs, tmp, skb, n)
+		{
+			if (!(PFQ_CB(skb)->class_mask & ovl->class_mask)) {
+				mask &= ~(1ULL << n);
+				shed++;
+			}
+		}
+
+		__sparse_add(so->stats, shed_class, shed, cpu);
+
+	} break;
+	case Q_OVERLOAD_DROP_STATE: {
+
+		for_each_skbuff_bitmask(skbs, tmp, skb, n)
+		{
+			if ((PFQ_CB(skb)->state & ovl->state_mask) != ovl->state_value) {
+				mask &= ~(1ULL << n);
+				shed++;
+			}
+		}
+
+		__sparse_add(so->stats, shed_state, shed, cpu);
+
+	} break;
+	case Q_OVERLOAD_RED: {
+
+		/* drop probability (16 bits fixed point) grows linearly up to the full queue */
+
+		size_t range = so->opt.rx_queue_len - low;
+		u32 prob = (range && fill < so->opt.rx_queue_len) ?
+				(u32)(((fill - low) << 16) / range) : (1U << 16);
+
+		for_each_skbuff_bitmask(skbs, tmp, skb, n)
+		{
+			if ((prandom_u32() & 0xffff) < prob) {
+				mask &= ~(1ULL << n);
+				shed++;
+			}
+		}
+
+		__sparse_add(so->stats, shed_red, shed, cpu);
+
+	} break;
+	}
+
+	return mask;
+}
+
+
+static
+size_t __pfq_sk_rx_queue_recv(struct pfq_sock *so,
+			      int queue,
+			      struct pfq_skbuff_GC_queue *skbs,
+			      unsigned long long mask,
+			      int burst_len,
+			      pfq_gid_t gid,
+			      int cpu)
 {
-	struct pfq_rx_queue *rx_queue = pfq_get_rx_queue(opt);
+	struct pfq_sock_opt *opt = &so->opt;
+	struct pfq_rx_queue *rx_queue = pfq_get_rx_sub_queue(opt, queue);
 	struct pfq_pkthdr *hdr;
 	int data, qlen, qindex;
 	struct sk_buff __GC *skb;
 	size_t n, sent = 0;
+	unsigned int watermark;
 
 	if (unlikely(rx_queue == NULL))
 		return 0;
 
 	data = atomic_read((atomic_t *)&rx_queue->data);
 
-	if (Q_SHARED_QUEUE_LEN(data) > opt->rx_queue_len)
+	if (Q_SHARED_QUEUE_LEN(data) > opt->rx_queue_len) {
+		__sparse_add(so->stats, shed_tail, burst_len, cpu);
 		return 0;
+	}
+
+	if (opt->rx_overload.policy != Q_OVERLOAD_DROP_TAIL) {
+
+		mask = pfq_sk_rx_shed(so, skbs, mask, Q_SHARED_QUEUE_LEN(data), cpu);
+		burst_len = pfq_popcount(mask);
+		if (burst_len == 0)
+			return 0;
+	}
 
 	data = atomic_add_return(burst_len, (atomic_t *)&rx_queue->data);
 
 	qlen = Q_SHARED_QUEUE_LEN(data) - burst_len;
 	qindex = Q_SHARED_QUEUE_INDEX(data);
-	hdr = (struct pfq_pkthdr *) pfq_mpsc_slot_ptr(opt, rx_queue, qindex, qlen);
+	hdr = (struct pfq_pkthdr *) pfq_mpsc_slot_ptr(opt, queue, qindex, qlen);
 
 	for_each_skbuff_bitmask(skbs, mask, skb, n)
 	{
-		size_t bytes, slot_index;
+		size_t bytes, len, slot_index;
+		bool vlan_insert;
 		char *pkt;
 
-		bytes = min_t(size_t, skb->len, opt->caplen);
+		vlan_insert = opt->rx_vlan_insert && vlan_tx_tag_present(PFQ_SKB(skb)) && skb->len >= 2 * ETH_ALEN;
+		len = vlan_insert ? skb->len + VLAN_HLEN : skb->len;
+		bytes = min_t(size_t, len, opt->caplen);
 		slot_index = qlen + sent;
 		pkt = (char *)(hdr+1);
 
 		if (slot_index > opt->rx_queue_len) {
 
-			if (waitqueue_active(&opt->waitqueue)) {
-				sparse_inc(&global_stats, wake);
-				wake_up_interruptible(&opt->waitqueue);
-			}
+			__sparse_add(so->stats, shed_tail, (size_t)burst_len - sent, cpu);
 
+			pfq_sock_rx_wakeup(opt);
 			return sent;
 		}
 
 		/* copy bytes of packet */
 
+		if (vlan_insert)
+		{
+			if (pfq_skb_copy_with_vlan(PFQ_SKB(skb), pkt, bytes) != 0) {
+				printk(KERN_WARNING "[PFQ] BUG! vlan copy failed (bytes=%zu, skb_len=%d mac_len=%d)!\n",
+				       bytes, skb->len, skb->mac_len);
+				return 0;
+			}
+		}
+		else
 #ifdef PFQ_USE_SKB_LINEARIZE
 		if (unlikely(skb_is_nonlinear(PFQ_SKB(skb))))
 #else
@@ -133,7 +263,7 @@ size_t pfq_sk_rx_queue_recv(struct pfq_sock_opt *opt,
 
 		hdr->ifindex  = skb->dev->ifindex;
 		hdr->gid      = (__force int)gid;
-		hdr->len      = (uint16_t)skb->len;
+		hdr->len      = (uint16_t)len;
 		hdr->caplen   = (uint16_t)bytes;
 		hdr->vlan.tci = skb->vlan_tci & ~VLAN_TAG_PRESENT;
 		hdr->queue    = skb_rx_queue_recorded(PFQ_SKB(skb)) ? (uint8_t)(skb_get_rx_queue(PFQ_SKB(skb)) & 0xff) : 0;
@@ -144,17 +274,54 @@ size_t pfq_sk_rx_queue_recv(struct pfq_sock_opt *opt,
 
 		hdr->commit = (uint8_t)qindex;
 
-		if ((slot_index & 8191) == 0 &&
-		    waitqueue_active(&opt->waitqueue)) {
-			sparse_inc(&global_stats, wake);
-			wake_up_interruptible(&opt->waitqueue);
-		}
-
 		sent++;
 
 		hdr = Q_NEXT_PKTHDR(hdr, opt->rx_slot_size);
 	}
 
+	/* wake-up: only the producer that crosses the watermark, or arm the timeout */
+
+	watermark = pfq_rx_watermark_packets(opt);
+
+	if ((unsigned int)qlen < watermark && qlen + sent >= watermark)
+		pfq_sock_rx_wakeup(opt);
+	else if (qlen == 0 && sent && opt->rx_watermark.usecs) {
+		atomic_set(&opt->rx_watermark_expired, 0);
+		hrtimer_start(&opt->rx_watermark_timer, ns_to_ktime((u64)opt->rx_watermark.usecs * NSEC_PER_USEC), HRTIMER_MODE_REL);
+	}
+
 	return sent;
 }
 
+
+size_t pfq_sk_rx_queue_recv(struct pfq_sock *so,
+			    struct pfq_skbuff_GC_queue *skbs,
+			    unsigned long long mask,
+			    int burst_len,
+			    pfq_gid_t gid,
+			    int cpu)
+{
+	struct pfq_sock_opt *opt = &so->opt;
+	unsigned long long qmask[Q_MAX_RX_QUEUES] = { 0 };
+	unsigned long long tmp = mask;
+	struct sk_buff __GC *skb;
+	size_t n, sent = 0;
+
+	if (likely(opt->rx_num_queues == 1))
+		return __pfq_sk_rx_queue_recv(so, 0, skbs, mask, burst_len, gid, cpu);
+
+	/* split the burst among the per-class Rx sub-queues */
+
+	for_each_skbuff_bitmask(skbs, tmp, skb, n)
+	{
+		qmask[pfq_get_rx_class_queue(opt, PFQ_CB(skb)->class_mask)] |= 1ULL << n;
+	}
+
+	for(n = 0; n < opt->rx_num_queues; n++)
+	{
+		if (qmask[n])
+			sent += __pfq_sk_rx_queue_recv(so, (int)n, skbs, qmask[n], pfq_popcount(qmask[n]), gid, cpu);
+	}
+
+	return sent;
+}
@@ -37,11 +37,14 @@
 
 
 
-extern size_t pfq_sk_rx_queue_recv(struct pfq_sock_opt *opt,
+struct pfq_sock;
+
+extern size_t pfq_sk_rx_queue_recv(struct pfq_sock *so,
 		                   struct pfq_skbuff_GC_queue *skbs,
 		                   unsigned long long skbs_mask,
 		                   int burst_len,
-		                   pfq_gid_t gid);
+		                   pfq_gid_t gid,
+		                   int cpu);
 
 
 #endif /* PF_Q_RECEIVE_H */
@@ -63,24 +63,32 @@ pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr)
 
 		mapped_queue = (struct pfq_shared_queue *)so->shmem.addr;
 
-		/* initialize Rx queue */
+		/* initialize Rx queues (default and per-class sub-queues) */
 
-		mapped_queue->rx.data      = 0;
-		mapped_queue->rx.len       = so->opt.rx_queue_len;
-		mapped_queue->rx.size      = pfq_mpsc_queue_mem(so)/2;
-		mapped_queue->rx.slot_size = so->opt.rx_slot_size;
+		for(n = 0; n < Q_MAX_RX_QUEUES; n++)
+		{
+			struct pfq_rx_queue *rx = n == 0 ? &mapped_queue->rx : &mapped_queue->rx_class[n-1];
 
-		so->opt.rxq.base_addr = so->shmem.addr + sizeof(struct pfq_shared_queue);
+			rx->data      = 0;
+			rx->len       = n < so->opt.rx_num_queues ? so->opt.rx_queue_len : 0;
+			rx->size      = n < so->opt.rx_num_queues ? pfq_mpsc_queue_mem(so)/2 : 0;
+			rx->slot_size = so->opt.rx_slot_size;
 
-		/* reset Rx slots */
+			if (n >= so->opt.rx_num_queues)
+				continue;
 
-		for(i = 0; i < 2; i++)
-		{
-			char * raw = so->shmem.addr + sizeof(struct pfq_shared_queue) + i * mapped_queue->rx.size;
-			char * end = raw + mapped_queue->rx.size;
-			const int rst = !i;
-			for(;raw < end; raw += mapped_queue->rx.slot_size)
-				((struct pfq_pkthdr *)raw)->commit = rst;
+			so->opt.rxq[n].base_addr = so->shmem.addr + pfq_mpsc_queue_offset(so, (int)n);
+
+			/* reset Rx slots */
+
+			for(i = 0; i < 2; i++)
+			{
+				char * raw = so->opt.rxq[n].base_addr + i * rx->size;
+				char * end = raw + rx->size;
+				const int rst = !i;
+				for(;raw < end; raw += rx->slot_size)
+					((struct pfq_pkthdr *)raw)->commit = rst;
+			}
 		}
 
 		/* initialize TX queues */
@@ -113,11 +121,25 @@ pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr)
 				+ pfq_spsc_queue_mem(so) * (1 + n);
 		}
 
+		/* initialize the flow records ring */
+
+		mapped_queue->flow.len = (unsigned int)so->opt.flow_queue_len;
+		mapped_queue->flow.off = pfq_flow_queue_offset(so);
+		mapped_queue->flow.prod.index = 0;
+		mapped_queue->flow.prod.lost  = 0;
+		mapped_queue->flow.cons.index = 0;
+
 		/* commit queues */
 
 		smp_wmb();
 
-		atomic_long_set(&so->opt.rxq.addr, (long)&mapped_queue->rx);
+		atomic_long_set(&so->opt.rxq[0].addr, (long)&mapped_queue->rx);
+
+		for(n = 1; n < so->opt.rx_num_queues; n++)
+		{
+			atomic_long_set(&so->opt.rxq[n].addr, (long)&mapped_queue->rx_class[n-1]);
+		}
+
 		atomic_long_set(&so->opt.txq.addr, (long)&mapped_queue->tx);
 
 		for(n = 0; n < Q_MAX_TX_QUEUES; n++)
@@ -125,12 +147,15 @@ pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr)
 			atomic_long_set(&so->opt.txq_async[n].addr, (long)&mapped_queue->tx_async[n]);
 		}
 
-		pr_devel("[PFQ|%d] Rx queue: len=%zu slot_size=%zu caplen=%zu, mem=%zu bytes\n",
+		if (so->opt.flow_queue_len)
+			atomic_long_set(&so->opt.flow_queue, (long)&mapped_queue->flow);
+
+		pr_devel("[PFQ|%d] Rx queue: len=%zu slot_size=%zu caplen=%zu, mem=%zu bytes (%zu queues)\n",
 			 so->id,
 			 so->opt.rx_queue_len,
 			 so->opt.rx_slot_size,
 			 so->opt.caplen,
-			 pfq_mpsc_queue_mem(so));
+			 pfq_mpsc_queue_mem(so) * so->opt.rx_num_queues, so->opt.rx_num_queues);
 
 		pr_devel("[PFQ|%d] Tx queue: len=%zu slot_size=%zu maxlen=%d, mem=%zu bytes\n",
 			 so->id,
@@ -145,6 +170,11 @@ pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr)
 			 so->opt.tx_slot_size,
 			 xmit_slot_size,
 			 pfq_spsc_queue_mem(so) * Q_MAX_TX_QUEUES, Q_MAX_TX_QUEUES);
+
+		pr_devel("[PFQ|%d] flow records ring: len=%zu, mem=%zu bytes\n",
+			 so->id,
+			 so->opt.flow_queue_len,
+			 pfq_flow_queue_mem(so));
 	}
 
 	return 0;
@@ -158,13 +188,18 @@ pfq_shared_queue_disable(struct pfq_sock *so)
 
 	if (so->shmem.addr) {
 
-		atomic_long_set(&so->opt.rxq.addr, 0);
+		for(n = 0; n < Q_MAX_RX_QUEUES; n++)
+		{
+			atomic_long_set(&so->opt.rxq[n].addr, 0);
+		}
 
 		for(n = 0; n < Q_MAX_TX_QUEUES; n++)
 		{
 			atomic_long_set(&so->opt.txq_async[n].addr, 0);
 		}
 
+		atomic_long_set(&so->opt.flow_queue, 0);
+
 		msleep(Q_GRACE_PERIOD);
 
 		pfq_shared_memory_free(&so->shmem);
@@ -177,3 +212,44 @@ pfq_shared_queue_disable(struct pfq_sock *so)
 
 	return 0;
 }
+
+
+/*
+ * Push the records to the flow ring of the socket (from any cpu): the
+ * records that do not fit are counted as lost. The length of the ring is
+ * taken from the socket, the shared header being writable by the user.
+ */
+
+size_t
+pfq_flow_queue_push(struct pfq_sock *so, struct pfq_flow_stat const *recs, size_t n)
+{
+	struct pfq_flow_queue *fq = (struct pfq_flow_queue *)atomic_long_read(&so->opt.flow_queue);
+	struct pfq_flow_stat *ring;
+	unsigned long prod, cons;
+	size_t i, len;
+
+	if (fq == NULL)
+		return 0;
+
+	len  = so->opt.flow_queue_len;
+	ring = (struct pfq_flow_stat *)((char *)so->shmem.addr + pfq_flow_queue_offset(so));
+
+	spin_lock(&so->opt.flow_queue_lock);
+
+	prod = fq->prod.index;
+	cons = ACCESS_ONCE(fq->cons.index);
+
+	for(i = 0; i < n && prod - cons < len; i++, prod++)
+	{
+		ring[prod & (len-1)] = recs[i];
+	}
+
+	fq->prod.lost += n - i;
+
+	smp_wmb();
+
+	fq->prod.index = prod;
+
+	spin_unlock(&so->opt.flow_queue_lock);
+	return i;
+}
@@ -44,6 +44,8 @@
 int pfq_shared_queue_enable(struct pfq_sock *so, unsigned long addr);
 int pfq_shared_queue_disable(struct pfq_sock *so);
 
+size_t pfq_flow_queue_push(struct pfq_sock *so, struct pfq_flow_stat const *recs, size_t n);
+
 
 static inline size_t pfq_mpsc_queue_mem(struct pfq_sock *so)
 {
@@ -55,14 +57,23 @@ static inline size_t pfq_spsc_queue_mem(struct pfq_sock *so)
         return so->opt.tx_queue_len * so->opt.tx_slot_size * 2;
 }
 
+static inline size_t pfq_flow_queue_mem(struct pfq_sock *so)
+{
+        return so->opt.flow_queue_len * sizeof(struct pfq_flow_stat);
+}
+
 
 static inline
 size_t pfq_mpsc_queue_len(struct pfq_sock *p)
 {
 	struct pfq_shared_queue *q = pfq_get_shared_queue(p);
+	size_t n, len;
 	if (!q)
 		return 0;
-        return Q_SHARED_QUEUE_LEN(q->rx.data);
+	len = Q_SHARED_QUEUE_LEN(q->rx.data);
+	for(n = 1; n < p->opt.rx_num_queues; n++)
+		len += Q_SHARED_QUEUE_LEN(q->rx_class[n-1].data);
+        return len;
 }
 
 
@@ -77,9 +88,33 @@ int pfq_mpsc_queue_index(struct pfq_sock *p)
 
 
 static inline
-char *pfq_mpsc_slot_ptr(struct pfq_sock_opt *opt, struct pfq_rx_queue *qd, size_t qindex, size_t slot)
+char *pfq_mpsc_slot_ptr(struct pfq_sock_opt *opt, int queue, size_t qindex, size_t slot)
+{
+	return (char *)(opt->rxq[queue].base_addr) + (opt->rx_queue_len * (qindex & 1) + slot) * opt->rx_slot_size;
+}
+
+
+/* offset of the Rx sub-queue in the shared memory */
+
+static inline
+size_t pfq_mpsc_queue_offset(struct pfq_sock *so, int queue)
+{
+	if (queue == 0)
+		return sizeof(struct pfq_shared_queue);
+
+	return sizeof(struct pfq_shared_queue) + pfq_mpsc_queue_mem(so) +
+		pfq_spsc_queue_mem(so) * (1 + Q_MAX_TX_QUEUES) +
+		pfq_mpsc_queue_mem(so) * (size_t)(queue - 1);
+}
+
+
+/* offset of the flow records ring in the shared memory: after the Rx sub-queues */
+
+static inline
+size_t pfq_flow_queue_offset(struct pfq_sock *so)
 {
-	return (char *)(opt->rxq.base_addr) + (opt->rx_queue_len * (qindex & 1) + slot) * opt->rx_slot_size;
+	return sizeof(struct pfq_shared_queue) + pfq_mpsc_queue_mem(so) * so->opt.rx_num_queues +
+		pfq_spsc_queue_mem(so) * (1 + Q_MAX_TX_QUEUES);
 }
 
 
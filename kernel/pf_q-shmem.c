@@ -196,7 +196,8 @@ pfq_shared_memory_free(struct pfq_shmem_descr *shmem)
 
 size_t pfq_total_queue_mem(struct pfq_sock *so)
 {
-        return sizeof(struct pfq_shared_queue) + pfq_mpsc_queue_mem(so) + pfq_spsc_queue_mem(so) * (1 + Q_MAX_TX_QUEUES);
+        return sizeof(struct pfq_shared_queue) + pfq_mpsc_queue_mem(so) * so->opt.rx_num_queues + pfq_spsc_queue_mem(so) * (1 + Q_MAX_TX_QUEUES)
+		+ pfq_flow_queue_mem(so);
 }
 
 
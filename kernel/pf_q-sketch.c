@@ -0,0 +1,475 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <pragma/diagnostic_push>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/sort.h>
+#include <linux/semaphore.h>
+#include <linux/delay.h>
+#include <linux/uaccess.h>
+
+#include <pragma/diagnostic_pop>
+
+#include <pf_q-sketch.h>
+#include <pf_q-group.h>
+#include <pf_q-define.h>
+
+
+#define PFQ_SKETCH_EXPORT_BATCH		64
+
+
+/* min-heap of the heavy hitters of a cpu, by count */
+
+static void
+pfq_sketch_sift_down(struct pfq_sketch_hitter *heap, uint32_t len, uint32_t i)
+{
+	for(;;)
+	{
+		uint32_t l = 2*i + 1, r = l + 1, m = i;
+
+		if (l < len && heap[l].count < heap[m].count)
+			m = l;
+		if (r < len && heap[r].count < heap[m].count)
+			m = r;
+		if (m == i)
+			return;
+
+		swap(heap[i], heap[m]);
+		i = m;
+	}
+}
+
+
+static void
+pfq_sketch_sift_up(struct pfq_sketch_hitter *heap, uint32_t i)
+{
+	while (i > 0 && heap[(i - 1) / 2].count > heap[i].count)
+	{
+		swap(heap[i], heap[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+}
+
+
+static void
+pfq_sketch_heap_update(struct pfq_sketch *sk, struct pfq_sketch_cpu *c,
+		       struct pfq_flow_key const *key, uint64_t hash, uint64_t est)
+{
+	struct pfq_sketch_hitter *heap = c->heap;
+	uint32_t i;
+
+	/* only the keys that make it to the heap cost a scan of it */
+
+	if (c->heap_len == sk->topk && est <= heap[0].count)
+		return;
+
+	raw_write_seqcount_begin(&c->seq);
+
+	for(i = 0; i < c->heap_len; i++)
+	{
+		if (heap[i].hash == hash && memcmp(&heap[i].key, key, sizeof(*key)) == 0) {
+			heap[i].count = est;
+			pfq_sketch_sift_down(heap, c->heap_len, i);
+			goto done;
+		}
+	}
+
+	if (c->heap_len < sk->topk) {
+		i = c->heap_len++;
+		heap[i].hash  = hash;
+		heap[i].count = est;
+		heap[i].key   = *key;
+		pfq_sketch_sift_up(heap, i);
+	}
+	else {
+		heap[0].hash  = hash;
+		heap[0].count = est;
+		heap[0].key   = *key;
+		pfq_sketch_sift_down(heap, c->heap_len, 0);
+	}
+done:
+	raw_write_seqcount_end(&c->seq);
+}
+
+
+void
+pfq_sketch_update(struct pfq_sketch *sk, struct pfq_flow_key const *key, uint64_t value)
+{
+	struct pfq_sketch_cpu *c = this_cpu_ptr(sk->cpu);
+	uint64_t hash = pfq_sketch_hash(key), est = ~0ULL, w;
+	uint32_t reg;
+	uint8_t rank;
+	int row;
+
+	c->total += value;
+
+	for(row = 0; row < Q_SKETCH_DEPTH; row++)
+	{
+		uint64_t *cnt = &c->cm[row * sk->width + pfq_sketch_column(sk, hash, row)];
+		*cnt += value;
+		est = min(est, *cnt);
+	}
+
+	/* hyperloglog: register from the top bits, rank of the rest */
+
+	reg  = (uint32_t)(hash >> (64 - Q_SKETCH_HLL_BITS));
+	w    = hash << Q_SKETCH_HLL_BITS;
+	rank = w ? (uint8_t)(__builtin_clzll(w) + 1) : (uint8_t)(64 - Q_SKETCH_HLL_BITS + 1);
+	if (rank > c->hll[reg])
+		c->hll[reg] = rank;
+
+	pfq_sketch_heap_update(sk, c, key, hash, est);
+}
+
+
+static void
+pfq_sketch_destroy(struct pfq_sketch *sk)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+	{
+		vfree(per_cpu_ptr(sk->cpu, cpu)->cm);
+	}
+
+	free_percpu(sk->cpu);
+	kfree(sk);
+}
+
+
+/* the shard of a cpu is a single block: counters, registers and heap */
+
+static struct pfq_sketch *
+pfq_sketch_alloc(uint32_t width, uint32_t topk, uint32_t flags)
+{
+	struct pfq_sketch *sk;
+	size_t cm_size = sizeof(uint64_t) * Q_SKETCH_DEPTH * width;
+	int cpu;
+
+	sk = kzalloc(sizeof(struct pfq_sketch), GFP_KERNEL);
+	if (sk == NULL)
+		return NULL;
+
+	sk->width = width;
+	sk->topk  = topk;
+	sk->flags = flags;
+
+	sk->cpu = alloc_percpu(struct pfq_sketch_cpu);
+	if (sk->cpu == NULL) {
+		kfree(sk);
+		return NULL;
+	}
+
+	for_each_possible_cpu(cpu)
+	{
+		struct pfq_sketch_cpu *c = per_cpu_ptr(sk->cpu, cpu);
+		char *mem;
+
+		mem = vzalloc(cm_size + Q_SKETCH_HLL_REGS + sizeof(struct pfq_sketch_hitter) * topk);
+		if (mem == NULL) {
+			pfq_sketch_destroy(sk);
+			return NULL;
+		}
+
+		seqcount_init(&c->seq);
+		c->cm   = (uint64_t *)mem;
+		c->hll  = (uint8_t *)(mem + cm_size);
+		c->heap = (struct pfq_sketch_hitter *)(mem + cm_size + Q_SKETCH_HLL_REGS);
+	}
+
+	return sk;
+}
+
+
+static int
+__pfq_sketch_ctl(struct pfq_group *group, struct pfq_group_sketch const *op)
+{
+	struct pfq_sketch *sk, *old;
+
+	if (op->key < 0 || op->key >= Q_SKETCH_KEYS)
+		return -EINVAL;
+
+	old = (struct pfq_sketch *)atomic_long_read(&group->sketch[op->key]);
+
+	switch(op->op)
+	{
+	case Q_SKETCH_CREATE:
+	case Q_SKETCH_CLEAR: {
+
+		uint32_t width = op->op == Q_SKETCH_CREATE ? op->width : (old ? old->width : 0);
+		uint32_t topk  = op->op == Q_SKETCH_CREATE ? op->topk  : (old ? old->topk  : 0);
+		uint32_t flags = op->op == Q_SKETCH_CREATE ? op->flags : (old ? old->flags : 0);
+
+		if (op->op == Q_SKETCH_CREATE && old)
+			return -EEXIST;
+
+		if (op->op == Q_SKETCH_CLEAR && old == NULL)
+			return -ENOENT;
+
+		if (width == 0 || width > Q_SKETCH_MAX_WIDTH || topk == 0 || topk > Q_SKETCH_MAX_TOPK)
+			return -EINVAL;
+
+		/* clear: a new empty sketch replaces the current one */
+
+		sk = pfq_sketch_alloc(roundup_pow_of_two(width), topk, flags);
+		if (sk == NULL) {
+			printk(KERN_INFO "[PFQ] sketch: out of memory (width=%u topk=%u)!\n", width, topk);
+			return -ENOMEM;
+		}
+
+		old = (struct pfq_sketch *)atomic_long_xchg(&group->sketch[op->key], (long)sk);
+		if (old) {
+			msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+			pfq_sketch_destroy(old);
+		}
+
+		pr_devel("[PFQ] sketch@%p: key=%d width=%u topk=%u\n", sk, op->key, sk->width, sk->topk);
+		return 0;
+	}
+
+	case Q_SKETCH_DESTROY: {
+
+		if (old == NULL)
+			return -ENOENT;
+
+		old = (struct pfq_sketch *)atomic_long_xchg(&group->sketch[op->key], 0L);
+
+		msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+
+		pfq_sketch_destroy(old);
+		return 0;
+	}
+	}
+
+	return -EINVAL;
+}
+
+
+int
+pfq_sketch_ctl(pfq_gid_t gid, struct pfq_group_sketch const *op)
+{
+	struct pfq_group *group;
+	int ret;
+
+	group = pfq_get_group(gid);
+	if (group == NULL)
+		return -EINVAL;
+
+	down(&group_sem);
+
+	ret = __pfq_sketch_ctl(group, op);
+
+	up(&group_sem);
+	return ret;
+}
+
+
+static int
+pfq_sketch_cmp_hash(const void *a, const void *b)
+{
+	const struct pfq_sketch_hitter *x = a, *y = b;
+
+	if (x->hash != y->hash)
+		return x->hash < y->hash ? -1 : 1;
+	return memcmp(&x->key, &y->key, sizeof(x->key));
+}
+
+
+static int
+pfq_sketch_cmp_count(const void *a, const void *b)
+{
+	const struct pfq_sketch_hitter *x = a, *y = b;
+
+	if (x->count != y->count)
+		return x->count > y->count ? -1 : 1;
+	return 0;
+}
+
+
+static void
+pfq_sketch_swap(void *a, void *b, int size)
+{
+	swap(*(struct pfq_sketch_hitter *)a, *(struct pfq_sketch_hitter *)b);
+}
+
+
+/*
+ * merge: the counters are summed and the registers maxed over the cpus,
+ * the heavy hitters are the union of the heaps, estimated on the merged
+ * counters.
+ */
+
+static int
+__pfq_sketch_read(struct pfq_sketch *sk, struct pfq_group_sketch *op)
+{
+	struct pfq_sketch_hitter *cand = NULL;
+	struct pfq_sketch_item *batch = NULL;
+	uint64_t *cm = NULL;
+	uint8_t *hll = NULL;
+	size_t ncand = 0, n, k, i;
+	int cpu, row, ret = 0;
+
+	cm    = vzalloc(sizeof(uint64_t) * Q_SKETCH_DEPTH * sk->width);
+	hll   = kzalloc(Q_SKETCH_HLL_REGS, GFP_KERNEL);
+	cand  = vmalloc(sizeof(struct pfq_sketch_hitter) * sk->topk * num_possible_cpus());
+	batch = kmalloc(sizeof(struct pfq_sketch_item) * PFQ_SKETCH_EXPORT_BATCH, GFP_KERNEL);
+
+	if (cm == NULL || hll == NULL || cand == NULL || batch == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	op->total = 0;
+
+	for_each_possible_cpu(cpu)
+	{
+		struct pfq_sketch_cpu *c = per_cpu_ptr(sk->cpu, cpu);
+		unsigned int seq;
+		uint32_t len;
+
+		op->total += c->total;
+
+		for(i = 0; i < (size_t)Q_SKETCH_DEPTH * sk->width; i++)
+			cm[i] += c->cm[i];
+
+		for(i = 0; i < Q_SKETCH_HLL_REGS; i++)
+			hll[i] = max(hll[i], c->hll[i]);
+
+		/* the heap is being updated by its cpu */
+
+		do {
+			seq = read_seqcount_begin(&c->seq);
+			len = c->heap_len;
+			memcpy(cand + ncand, c->heap, sizeof(struct pfq_sketch_hitter) * len);
+		}
+		while (read_seqcount_retry(&c->seq, seq));
+
+		ncand += len;
+	}
+
+	/* union of the heaps: drop the duplicates, then estimate the counts */
+
+	sort(cand, ncand, sizeof(struct pfq_sketch_hitter), pfq_sketch_cmp_hash, pfq_sketch_swap);
+
+	for(i = 0, n = 0; i < ncand; i++)
+	{
+		if (n && pfq_sketch_cmp_hash(&cand[n-1], &cand[i]) == 0)
+			continue;
+
+		cand[n] = cand[i];
+		cand[n].count = ~0ULL;
+
+		for(row = 0; row < Q_SKETCH_DEPTH; row++)
+			cand[n].count = min(cand[n].count, cm[row * sk->width + pfq_sketch_column(sk, cand[n].hash, row)]);
+		n++;
+	}
+
+	sort(cand, n, sizeof(struct pfq_sketch_hitter), pfq_sketch_cmp_count, pfq_sketch_swap);
+
+	n = min(n, op->n);
+
+	for(i = 0, k = 0; i < n; i++)
+	{
+		batch[k].key   = cand[i].key;
+		batch[k].count = cand[i].count;
+
+		if (++k == PFQ_SKETCH_EXPORT_BATCH || i + 1 == n) {
+			if (copy_to_user(op->items + i + 1 - k, batch, sizeof(struct pfq_sketch_item) * k)) {
+				ret = -EFAULT;
+				goto out;
+			}
+			k = 0;
+		}
+	}
+
+	op->n = n;
+
+	if (op->hll && copy_to_user(op->hll, hll, Q_SKETCH_HLL_REGS))
+		ret = -EFAULT;
+out:
+	kfree(batch);
+	vfree(cand);
+	kfree(hll);
+	vfree(cm);
+	return ret;
+}
+
+
+int
+pfq_sketch_read(pfq_gid_t gid, struct pfq_group_sketch *op)
+{
+	struct pfq_sketch *sk;
+	struct pfq_group *group;
+	int ret;
+
+	if (op->key < 0 || op->key >= Q_SKETCH_KEYS)
+		return -EINVAL;
+
+	group = pfq_get_group(gid);
+	if (group == NULL)
+		return -EINVAL;
+
+	/* the sketch cannot be released while it is read */
+
+	down(&group_sem);
+
+	sk = (struct pfq_sketch *)atomic_long_read(&group->sketch[op->key]);
+
+	ret = sk ? __pfq_sketch_read(sk, op) : -ENOENT;
+
+	up(&group_sem);
+	return ret;
+}
+
+
+void
+pfq_sketch_free_all(struct pfq_group *group)
+{
+	struct pfq_sketch *old[Q_SKETCH_KEYS];
+	bool any = false;
+	int i;
+
+	for(i = 0; i < Q_SKETCH_KEYS; i++)
+	{
+		old[i] = (struct pfq_sketch *)atomic_long_xchg(&group->sketch[i], 0L);
+		any |= old[i] != NULL;
+	}
+
+	if (!any)
+		return;
+
+	msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
+
+	for(i = 0; i < Q_SKETCH_KEYS; i++)
+	{
+		if (old[i])
+			pfq_sketch_destroy(old[i]);
+	}
+}
+
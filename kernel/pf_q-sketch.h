@@ -0,0 +1,103 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PF_Q_SKETCH_H
+#define PF_Q_SKETCH_H
+
+#include <pragma/diagnostic_push>
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/seqlock.h>
+#include <linux/string.h>
+#include <linux/pf_q.h>
+#include <pragma/diagnostic_pop>
+
+#include <pf_q-types.h>
+
+#include <lang/bloom.h>
+
+
+/*
+ * Sketches of a group (one per key): a count-min sketch of Q_SKETCH_DEPTH
+ * rows, the top-k heavy hitters (a min-heap of the count-min estimates) and
+ * a hyperloglog. Every cpu updates its own shard without locks; the shards
+ * are merged on read (sums, union of the heaps and max of the registers).
+ * The heap is read under its seqcount.
+ */
+
+struct pfq_sketch_hitter
+{
+	uint64_t		hash;
+	uint64_t		count;		/* count-min estimate of the cpu */
+	struct pfq_flow_key	key;
+};
+
+
+struct pfq_sketch_cpu
+{
+	seqcount_t		seq;		/* heap */
+	uint64_t		total;
+	uint64_t		*cm;		/* Q_SKETCH_DEPTH x width */
+	uint8_t			*hll;		/* Q_SKETCH_HLL_REGS */
+	struct pfq_sketch_hitter *heap;		/* topk */
+	uint32_t		heap_len;
+
+} ____cacheline_aligned;
+
+
+struct pfq_sketch
+{
+	uint32_t		width;		/* power of 2 */
+	uint32_t		topk;
+	uint32_t		flags;
+	struct pfq_sketch_cpu __percpu *cpu;
+};
+
+
+struct pfq_group;
+
+extern int  pfq_sketch_ctl(pfq_gid_t gid, struct pfq_group_sketch const *op);
+extern int  pfq_sketch_read(pfq_gid_t gid, struct pfq_group_sketch *op);
+extern void pfq_sketch_free_all(struct pfq_group *group);
+
+extern void pfq_sketch_update(struct pfq_sketch *sk, struct pfq_flow_key const *key, uint64_t value);
+
+
+static inline uint64_t
+pfq_sketch_hash(struct pfq_flow_key const *key)
+{
+	return bbf_hash((const uint32_t *)key, sizeof(*key)/sizeof(uint32_t));
+}
+
+
+/* Kirsch-Mitzenmacher: the row hashes are combinations of the two halves */
+
+static inline uint32_t
+pfq_sketch_column(struct pfq_sketch const *sk, uint64_t hash, int row)
+{
+	return ((uint32_t)hash + (uint32_t)row * ((uint32_t)(hash >> 32) | 1)) & (sk->width - 1);
+}
+
+
+#endif /* PF_Q_SKETCH_H */
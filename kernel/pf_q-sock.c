@@ -27,12 +27,16 @@
 #include <linux/module.h>
 #include <linux/version.h>
 #include <linux/types.h>
+#include <linux/eventfd.h>
+#include <linux/delay.h>
 #include <pragma/diagnostic_pop>
 
 #include <pf_q-thread.h>
 #include <pf_q-netdev.h>
 #include <pf_q-sock.h>
 #include <pf_q-memory.h>
+#include <pf_q-bitops.h>
+#include <pf_q-global.h>
 
 /* vector of pointers to pfq_sock */
 
@@ -59,6 +63,17 @@ pfq_sock_finish_once(void)
 }
 
 
+static enum hrtimer_restart
+pfq_sock_rx_watermark_timeout(struct hrtimer *timer)
+{
+	struct pfq_sock_opt *opt = container_of(timer, struct pfq_sock_opt, rx_watermark_timer);
+
+	atomic_set(&opt->rx_watermark_expired, 1);
+	pfq_sock_rx_wakeup(opt);
+	return HRTIMER_NORESTART;
+}
+
+
 pfq_id_t
 pfq_get_free_id(struct pfq_sock * so)
 {
@@ -118,13 +133,45 @@ void pfq_sock_opt_init(struct pfq_sock_opt *that, size_t caplen, size_t maxlen)
 
         that->tstamp = false;
 
+	/* the vlan tag is reported in the header only */
+
+	that->rx_vlan_insert = 0;
+
         /* initialize waitqueue */
 
         init_waitqueue_head(&that->waitqueue);
 
+	/* wake-up on the first packet, no eventfd */
+
+	that->rx_watermark.packets = 1;
+	that->rx_watermark.usecs = 0;
+	hrtimer_init(&that->rx_watermark_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	that->rx_watermark_timer.function = pfq_sock_rx_watermark_timeout;
+	atomic_set(&that->rx_watermark_expired, 0);
+	atomic_long_set(&that->rx_eventfd, 0);
+
 	/* Rx queue setup */
 
-	pfq_rx_info_init(&that->rxq);
+	for(n = 0; n < Q_MAX_RX_QUEUES; ++n)
+	{
+		pfq_rx_info_init(&that->rxq[n]);
+	}
+
+	that->rx_num_queues = 1;
+	that->rx_queue_classes = 0;
+	memset(that->rx_class_queue, 0, sizeof(that->rx_class_queue));
+
+	/* drop-tail by default */
+
+	memset(&that->rx_overload, 0, sizeof(that->rx_overload));
+	that->rx_overload.policy = Q_OVERLOAD_DROP_TAIL;
+	that->rx_overload.threshold = 100;
+
+	/* flow records ring disabled by default */
+
+	that->flow_queue_len = 0;
+	atomic_long_set(&that->flow_queue, 0);
+	spin_lock_init(&that->flow_queue_lock);
 
         that->caplen = caplen;
         that->rx_queue_len = 0;
@@ -166,6 +213,10 @@ int pfq_sock_init(struct pfq_sock *so, int id)
 		local_set(&stat->drop, 0);
 		local_set(&stat->sent, 0);
 		local_set(&stat->disc, 0);
+		local_set(&stat->shed_tail, 0);
+		local_set(&stat->shed_class, 0);
+		local_set(&stat->shed_state, 0);
+		local_set(&stat->shed_red, 0);
 	}
 
 	/* setup id */
@@ -177,6 +228,7 @@ int pfq_sock_init(struct pfq_sock *so, int id)
 	so->egress_type = pfq_endpoint_socket;
 	so->egress_index = 0;
 	so->egress_queue = 0;
+	atomic_long_set(&so->egress_dev, 0);
 
 	/* default weight */
 
@@ -271,3 +323,165 @@ pfq_sock_tx_unbind(struct pfq_sock *so)
 	return 0;
 }
 
+
+
+/*
+ * Assign a dedicated Rx sub-queue to each class of queue_mask not mapped yet.
+ * Sub-queues are allocated when the socket is enabled, hence this must happen before.
+ */
+
+int
+pfq_sock_set_rx_class_queues(struct pfq_sock *so, unsigned long queue_mask)
+{
+	unsigned long new_classes = queue_mask & ~so->opt.rx_queue_classes;
+	unsigned long cbit;
+
+	if (new_classes == 0)
+		return 0;
+
+	if (so->shmem.addr) {
+		printk(KERN_INFO "[PFQ|%d] Rx class queues: socket already enabled!\n", so->id);
+		return -EPERM;
+	}
+
+	if (so->opt.rx_num_queues + hweight_long(new_classes) > Q_MAX_RX_QUEUES) {
+		printk(KERN_INFO "[PFQ|%d] Rx class queues: too many queues (max %d)!\n", so->id, Q_MAX_RX_QUEUES);
+		return -ENOSPC;
+	}
+
+	pfq_bitwise_foreach(new_classes, cbit,
+	{
+		int class = pfq_ctz(cbit);
+		so->opt.rx_class_queue[class] = (uint8_t)so->opt.rx_num_queues++;
+	})
+
+	so->opt.rx_queue_classes |= new_classes;
+	return 0;
+}
+
+
+/*
+ * Wake-up of the Rx waiters: the eventfd (if any) is signaled as well, so that
+ * a single fd can serve many sockets. Called in softirq and hrtimer context.
+ */
+
+void
+pfq_sock_rx_wakeup(struct pfq_sock_opt *opt)
+{
+	struct eventfd_ctx *efd = (struct eventfd_ctx *)atomic_long_read(&opt->rx_eventfd);
+
+	if (efd)
+		eventfd_signal(efd, 1);
+
+	if (waitqueue_active(&opt->waitqueue)) {
+		sparse_inc(&global_stats, wake);
+		wake_up_interruptible(&opt->waitqueue);
+	}
+}
+
+
+int
+pfq_sock_set_rx_eventfd(struct pfq_sock *so, int fd)
+{
+	struct eventfd_ctx *efd = NULL, *old;
+
+	if (fd >= 0) {
+		efd = eventfd_ctx_fdget(fd);
+		if (IS_ERR(efd)) {
+			printk(KERN_INFO "[PFQ|%d] Rx eventfd: bad eventfd (%d)!\n", so->id, fd);
+			return (int)PTR_ERR(efd);
+		}
+	}
+
+	old = (struct eventfd_ctx *)atomic_long_xchg(&so->opt.rx_eventfd, (long)efd);
+	if (old) {
+		msleep(Q_GRACE_PERIOD);
+		eventfd_ctx_put(old);
+	}
+
+	return 0;
+}
+
+
+/* after the grace period of the Rx path */
+
+void
+pfq_sock_rx_watermark_release(struct pfq_sock *so)
+{
+	struct eventfd_ctx *efd;
+
+	hrtimer_cancel(&so->opt.rx_watermark_timer);
+
+	efd = (struct eventfd_ctx *)atomic_long_xchg(&so->opt.rx_eventfd, 0);
+	if (efd)
+		eventfd_ctx_put(efd);
+}
+
+
+/*
+ * The egress device is resolved once, in the network namespace of the socket,
+ * and the reference is held until unbind (or until the device unregisters).
+ * The Rx path reads the cached pointer without touching the refcount:
+ * it runs in softirq context and the release is deferred by synchronize_net().
+ */
+
+int
+pfq_sock_egress_bind(struct pfq_sock *so, int ifindex, int qindex)
+{
+	struct net_device *dev;
+
+	dev = dev_get_by_index(sock_net(&so->sk), ifindex);
+	if (dev == NULL)
+		return -ENODEV;
+
+	pfq_sock_egress_unbind(so);
+
+	so->egress_index = ifindex;
+	so->egress_queue = qindex;
+
+	smp_wmb();
+
+	atomic_long_set(&so->egress_dev, (long)dev);
+	so->egress_type = pfq_endpoint_device;
+	return 0;
+}
+
+
+void
+pfq_sock_egress_unbind(struct pfq_sock *so)
+{
+	struct net_device *dev;
+
+	so->egress_type = pfq_endpoint_socket;
+
+	dev = (struct net_device *)atomic_long_xchg(&so->egress_dev, 0);
+	if (dev) {
+		synchronize_net();
+		dev_put(dev);
+	}
+
+	so->egress_index = 0;
+	so->egress_queue = 0;
+}
+
+
+void
+pfq_sock_egress_invalidate(struct net_device *dev)
+{
+	int n;
+
+	for(n = 0; n < Q_MAX_ID; n++)
+	{
+		struct pfq_sock *so = pfq_get_sock_by_id((__force pfq_id_t)n);
+		if (so == NULL)
+			continue;
+
+		if (atomic_long_cmpxchg(&so->egress_dev, (long)dev, 0) == (long)dev) {
+
+			printk(KERN_INFO "[PFQ|%d] egress device %s unregistered!\n", so->id, dev->name);
+
+			synchronize_net();
+			dev_put(dev);
+		}
+	}
+}
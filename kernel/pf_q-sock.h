@@ -27,6 +27,7 @@
 #include <pragma/diagnostic_push>
 #include <linux/kernel.h>
 #include <linux/poll.h>
+#include <linux/hrtimer.h>
 #include <linux/pf_q.h>
 #include <linux/percpu.h>
 #include <net/sock.h>
@@ -86,6 +87,7 @@ void pfq_rx_info_init(struct pfq_rx_info *info)
 struct pfq_sock_opt
 {
 	int			tstamp;
+	int			rx_vlan_insert;			/* 802.1Q tag re-inserted in the slot */
 	size_t			caplen;
 
 	size_t			rx_queue_len;
@@ -96,11 +98,26 @@ struct pfq_sock_opt
 
 	wait_queue_head_t	waitqueue;
 
+	struct pfq_rx_watermark	rx_watermark;			/* wake-up of the waiters */
+	struct hrtimer		rx_watermark_timer;		/* usecs watermark, armed by the first packet */
+	atomic_t		rx_watermark_expired;
+	atomic_long_t		rx_eventfd;			/* (struct eventfd_ctx *) */
+
         size_t			tx_num_async_queues;
 
 	struct pfq_tx_info	txq_async[Q_MAX_TX_QUEUES];
 	struct pfq_tx_info	txq;
-	struct pfq_rx_info	rxq;
+	struct pfq_rx_info	rxq[Q_MAX_RX_QUEUES];
+
+	size_t			rx_num_queues;			/* Rx sub-queues in use */
+	unsigned long		rx_queue_classes;		/* classes with a dedicated sub-queue */
+	uint8_t			rx_class_queue[Q_CLASS_MAX];	/* class -> sub-queue */
+
+	struct pfq_rx_overload	rx_overload;			/* overload policy of the Rx queues */
+
+	size_t			flow_queue_len;			/* flow records ring, 0 = disabled */
+	atomic_long_t		flow_queue;			/* (struct pfq_flow_queue *) */
+	spinlock_t		flow_queue_lock;		/* producers of the flow records */
 
 } ____cacheline_aligned_in_smp;
 
@@ -114,6 +131,7 @@ struct pfq_sock
 	int			egress_type;
         int			egress_index;
         int			egress_queue;
+	atomic_long_t		egress_dev;	/* (struct net_device *) */
 
 	int			weight;
 
@@ -129,9 +147,9 @@ struct pfq_sock
 
 static inline
 struct pfq_rx_info *
-pfq_get_rx_queue_info(struct pfq_sock_opt *that)
+pfq_get_rx_queue_info(struct pfq_sock_opt *that, int index)
 {
-	return &that->rxq;
+	return &that->rxq[index];
 }
 
 static inline
@@ -149,7 +167,33 @@ static inline
 struct pfq_rx_queue *
 pfq_get_rx_queue(struct pfq_sock_opt *that)
 {
-	return (struct pfq_rx_queue *)atomic_long_read(&that->rxq.addr);
+	return (struct pfq_rx_queue *)atomic_long_read(&that->rxq[0].addr);
+}
+
+static inline
+struct pfq_rx_queue *
+pfq_get_rx_sub_queue(struct pfq_sock_opt *that, int index)
+{
+	return (struct pfq_rx_queue *)atomic_long_read(&that->rxq[index].addr);
+}
+
+/* Rx sub-queue of a packet: the one of its first class with a dedicated queue */
+
+static inline
+int pfq_get_rx_class_queue(struct pfq_sock_opt *that, unsigned long class_mask)
+{
+	unsigned long mask = class_mask & that->rx_queue_classes;
+	if (likely(mask == 0))
+		return 0;
+	return that->rx_class_queue[__ffs(mask)];
+}
+
+/* packets watermark: a full queue always wakes up the waiters */
+
+static inline
+unsigned int pfq_rx_watermark_packets(struct pfq_sock_opt const *that)
+{
+	return (unsigned int)min_t(size_t, that->rx_watermark.packets, that->rx_queue_len);
 }
 
 static inline
@@ -192,4 +236,21 @@ void	pfq_release_sock_id(pfq_id_t id);
 int	pfq_sock_tx_bind(struct pfq_sock *so, int tid, int if_index, int queue, struct net_device *default_dev);
 int	pfq_sock_tx_unbind(struct pfq_sock *so);
 
+int	pfq_sock_set_rx_class_queues(struct pfq_sock *so, unsigned long queue_mask);
+
+int	pfq_sock_set_rx_eventfd(struct pfq_sock *so, int fd);
+void	pfq_sock_rx_wakeup(struct pfq_sock_opt *opt);
+void	pfq_sock_rx_watermark_release(struct pfq_sock *so);
+
+int	pfq_sock_egress_bind(struct pfq_sock *so, int ifindex, int qindex);
+void	pfq_sock_egress_unbind(struct pfq_sock *so);
+void	pfq_sock_egress_invalidate(struct net_device *dev);
+
+static inline
+struct net_device *
+pfq_sock_egress_dev(struct pfq_sock *so)
+{
+	return (struct net_device *)atomic_long_read(&so->egress_dev);
+}
+
 #endif /* PF_Q_SOCK_H */
@@ -27,6 +27,7 @@
 #include <linux/module.h>
 #include <linux/version.h>
 #include <linux/kthread.h>
+#include <linux/log2.h>
 #include <linux/pf_q.h>
 
 #include <pragma/diagnostic_pop>
@@ -45,6 +46,10 @@
 #include <pf_q-endpoint.h>
 #include <pf_q-shared-queue.h>
 #include <pf_q-printk.h>
+#include <pf_q-bloom.h>
+#include <pf_q-lpm.h>
+#include <pf_q-flow.h>
+#include <pf_q-sketch.h>
 
 #include <lang/engine.h>
 #include <lang/symtable.h>
@@ -72,6 +77,7 @@ int pfq_getsockopt(struct socket *sock,
         case Q_SO_GROUP_JOIN:
         {
                 struct pfq_group_join group;
+                int err;
 
                 if (len != sizeof(group))
                         return -EINVAL;
@@ -85,6 +91,17 @@ int pfq_getsockopt(struct socket *sock,
                         return -EINVAL;
                 }
 
+                if (group.queue_mask & ~group.class_mask) {
+                        printk(KERN_INFO "[PFQ|%d] join group error: bad queue_mask (%lx)!\n",
+                               so->id, group.queue_mask);
+                        return -EINVAL;
+                }
+
+		/* dedicated Rx sub-queues are set up before joining */
+
+		if ((err = pfq_sock_set_rx_class_queues(so, group.queue_mask)) < 0)
+			return err;
+
                 if (group.gid == Q_ANY_GROUP) {
 
                         group.gid = pfq_join_free_group(so->id, group.class_mask, group.policy);
@@ -109,8 +126,8 @@ int pfq_getsockopt(struct socket *sock,
                         }
                 }
 
-                pr_devel("[PFQ|%d] join group: gid=%d class_mask=%lx policy=%d\n",
-				so->id, group.gid, group.class_mask, group.policy);
+                pr_devel("[PFQ|%d] join group: gid=%d class_mask=%lx queue_mask=%lx policy=%d\n",
+				so->id, group.gid, group.class_mask, group.queue_mask, group.policy);
         } break;
 
         case Q_SO_GET_ID:
@@ -168,6 +185,11 @@ int pfq_getsockopt(struct socket *sock,
                 stat.sent = sparse_read(so->stats, sent);
                 stat.disc = sparse_read(so->stats, disc);
 
+                stat.shed_tail  = sparse_read(so->stats, shed_tail);
+                stat.shed_class = sparse_read(so->stats, shed_class);
+                stat.shed_state = sparse_read(so->stats, shed_state);
+                stat.shed_red   = sparse_read(so->stats, shed_red);
+
                 if (copy_to_user(optval, &stat, sizeof(stat)))
                         return -EFAULT;
         } break;
@@ -275,6 +297,11 @@ int pfq_getsockopt(struct socket *sock,
                 stat.sent = 0;
                 stat.disc = 0;
 
+                stat.shed_tail  = 0;
+                stat.shed_class = 0;
+                stat.shed_state = 0;
+                stat.shed_red   = 0;
+
                 if (copy_to_user(optval, &stat, sizeof(stat)))
                         return -EFAULT;
         } break;
@@ -317,6 +344,62 @@ int pfq_getsockopt(struct socket *sock,
                         return -EFAULT;
         } break;
 
+        case Q_SO_GET_GROUP_FLOWS:
+        {
+                struct pfq_group_flows tmp;
+                pfq_gid_t gid;
+                int err;
+
+                if (len != sizeof(tmp))
+                        return -EINVAL;
+
+                if (copy_from_user(&tmp, optval, sizeof(tmp)))
+                        return -EFAULT;
+
+                gid = (__force pfq_gid_t)tmp.gid;
+
+                if (!pfq_group_policy_access(gid, so->id, Q_POLICY_GROUP_UNDEFINED)) {
+                        printk(KERN_INFO "[PFQ|%d] group flows error: permission denied (gid=%d)!\n",
+                               so->id, gid);
+                        return -EACCES;
+                }
+
+                err = pfq_flow_table_export(gid, &tmp);
+                if (err < 0)
+                        return err;
+
+                if (copy_to_user(optval, &tmp, sizeof(tmp)))
+                        return -EFAULT;
+        } break;
+
+        case Q_SO_GET_GROUP_SKETCH:
+        {
+                struct pfq_group_sketch tmp;
+                pfq_gid_t gid;
+                int err;
+
+                if (len != sizeof(tmp))
+                        return -EINVAL;
+
+                if (copy_from_user(&tmp, optval, sizeof(tmp)))
+                        return -EFAULT;
+
+                gid = (__force pfq_gid_t)tmp.gid;
+
+                if (!pfq_group_policy_access(gid, so->id, Q_POLICY_GROUP_UNDEFINED)) {
+                        printk(KERN_INFO "[PFQ|%d] group sketch error: permission denied (gid=%d)!\n",
+                               so->id, gid);
+                        return -EACCES;
+                }
+
+                err = pfq_sketch_read(gid, &tmp);
+                if (err < 0)
+                        return err;
+
+                if (copy_to_user(optval, &tmp, sizeof(tmp)))
+                        return -EFAULT;
+        } break;
+
         case Q_SO_GET_WEIGHT:
         {
                 if (len != sizeof(so->weight))
@@ -326,6 +409,32 @@ int pfq_getsockopt(struct socket *sock,
                         return -EFAULT;
         } break;
 
+        case Q_SO_GET_RX_OVERLOAD:
+        {
+                if (len != sizeof(so->opt.rx_overload))
+                        return -EINVAL;
+
+                if (copy_to_user(optval, &so->opt.rx_overload, sizeof(so->opt.rx_overload)))
+                        return -EFAULT;
+        } break;
+
+        case Q_SO_GET_RX_WATERMARK:
+        {
+                if (len != sizeof(so->opt.rx_watermark))
+                        return -EINVAL;
+
+                if (copy_to_user(optval, &so->opt.rx_watermark, sizeof(so->opt.rx_watermark)))
+                        return -EFAULT;
+        } break;
+
+        case Q_SO_GET_RX_VLAN_INSERT:
+        {
+                if (len != sizeof(so->opt.rx_vlan_insert))
+                        return -EINVAL;
+                if (copy_to_user(optval, &so->opt.rx_vlan_insert, sizeof(so->opt.rx_vlan_insert)))
+                        return -EFAULT;
+        } break;
+
         default:
                 return -EFAULT;
         }
@@ -458,19 +567,15 @@ int pfq_setsockopt(struct socket *sock,
                 if (copy_from_user(&bind, optval, optlen))
                         return -EFAULT;
 
-                if (!dev_get_by_index(sock_net(&so->sk), bind.ifindex)) {
-                        printk(KERN_INFO "[PFQ|%d] egress bind: invalid ifindex=%d\n", so->id, bind.ifindex);
-                        return -EPERM;
-                }
-
                 if (bind.qindex < -1) {
                         printk(KERN_INFO "[PFQ|%d] egress bind: invalid qindex=%d\n", so->id, bind.qindex);
                         return -EPERM;
                 }
 
-		so->egress_type  = pfq_endpoint_device;
-                so->egress_index = bind.ifindex;
-                so->egress_queue = bind.qindex;
+                if (pfq_sock_egress_bind(so, bind.ifindex, bind.qindex) < 0) {
+                        printk(KERN_INFO "[PFQ|%d] egress bind: invalid ifindex=%d\n", so->id, bind.ifindex);
+                        return -EPERM;
+                }
 
                 pr_devel("[PFQ|%d] egress bind: device ifindex=%d qindex=%d\n",
 			 so->id, so->egress_index, so->egress_queue);
@@ -479,15 +584,7 @@ int pfq_setsockopt(struct socket *sock,
 
         case Q_SO_EGRESS_UNBIND:
         {
-                if (so->egress_index &&
-                    dev_put_by_index(sock_net(&so->sk), so->egress_index) < 0) {
-                        printk(KERN_INFO "[PFQ|%d] egress bind: invalid if_index=%d\n", so->id, so->egress_index);
-                        return -EPERM;
-                }
-
-		so->egress_type  = pfq_endpoint_socket;
-                so->egress_index = 0;
-                so->egress_queue = 0;
+		pfq_sock_egress_unbind(so);
 
                 pr_devel("[PFQ|%d] egress unbind.\n", so->id);
 
@@ -508,6 +605,20 @@ int pfq_setsockopt(struct socket *sock,
                 pr_devel("[PFQ|%d] timestamp enabled.\n", so->id);
         } break;
 
+        case Q_SO_SET_RX_VLAN_INSERT:
+        {
+                int insert;
+                if (optlen != sizeof(so->opt.rx_vlan_insert))
+                        return -EINVAL;
+
+                if (copy_from_user(&insert, optval, optlen))
+                        return -EFAULT;
+
+                so->opt.rx_vlan_insert = insert ? 1 : 0;
+
+                pr_devel("[PFQ|%d] vlan tag insertion %s.\n", so->id, insert ? "enabled" : "disabled");
+        } break;
+
         case Q_SO_SET_RX_CAPLEN:
         {
                 typeof(so->opt.caplen) caplen;
@@ -550,6 +661,76 @@ int pfq_setsockopt(struct socket *sock,
                 pr_devel("[PFQ|%d] rx_queue slots=%zu\n", so->id, so->opt.rx_queue_len);
         } break;
 
+        case Q_SO_SET_FLOW_RING:
+        {
+                typeof(so->opt.flow_queue_len) len;
+
+                if (optlen != sizeof(len))
+                        return -EINVAL;
+
+                if (copy_from_user(&len, optval, optlen))
+                        return -EFAULT;
+
+                if (len > Q_MAX_FLOW_RING_LEN) {
+                        printk(KERN_INFO "[PFQ|%d] invalid flow ring len=%zu (max %d)\n",
+                               so->id, len, Q_MAX_FLOW_RING_LEN);
+                        return -EPERM;
+                }
+
+                /* the ring is allocated when the socket is enabled */
+
+                if (so->shmem.addr) {
+                        printk(KERN_INFO "[PFQ|%d] flow ring: socket already enabled!\n", so->id);
+                        return -EPERM;
+                }
+
+                so->opt.flow_queue_len = len ? roundup_pow_of_two(len) : 0;
+
+                pr_devel("[PFQ|%d] flow ring len=%zu\n", so->id, so->opt.flow_queue_len);
+        } break;
+
+        case Q_SO_SET_RX_WATERMARK:
+        {
+                struct pfq_rx_watermark wm;
+
+                if (optlen != sizeof(wm))
+                        return -EINVAL;
+
+                if (copy_from_user(&wm, optval, optlen))
+                        return -EFAULT;
+
+                if (wm.packets == 0 || wm.packets > so->opt.rx_queue_len) {
+                        printk(KERN_INFO "[PFQ|%d] Rx watermark: invalid packets %u (max %zu Rx slots)!\n", so->id, wm.packets, so->opt.rx_queue_len);
+                        return -EINVAL;
+                }
+
+                if (wm.usecs > Q_MAX_RX_WATERMARK_USECS) {
+                        printk(KERN_INFO "[PFQ|%d] Rx watermark: invalid usecs %u (max %d)!\n", so->id, wm.usecs, Q_MAX_RX_WATERMARK_USECS);
+                        return -EINVAL;
+                }
+
+                so->opt.rx_watermark = wm;
+
+                pr_devel("[PFQ|%d] Rx watermark packets=%u usecs=%u\n", so->id, wm.packets, wm.usecs);
+        } break;
+
+        case Q_SO_SET_RX_EVENTFD:
+        {
+                int fd, err;
+
+                if (optlen != sizeof(fd))
+                        return -EINVAL;
+
+                if (copy_from_user(&fd, optval, optlen))
+                        return -EFAULT;
+
+                err = pfq_sock_set_rx_eventfd(so, fd);
+                if (err < 0)
+                        return err;
+
+                pr_devel("[PFQ|%d] Rx eventfd=%d\n", so->id, fd);
+        } break;
+
         case Q_SO_SET_TX_SLOTS:
         {
                 typeof (so->opt.tx_queue_len) slots;
@@ -596,6 +777,32 @@ int pfq_setsockopt(struct socket *sock,
 
         } break;
 
+        case Q_SO_SET_RX_OVERLOAD:
+        {
+                struct pfq_rx_overload ovl;
+
+                if (optlen != sizeof(ovl))
+                        return -EINVAL;
+
+                if (copy_from_user(&ovl, optval, optlen))
+                        return -EFAULT;
+
+                if (ovl.policy < Q_OVERLOAD_DROP_TAIL || ovl.policy > Q_OVERLOAD_RED) {
+                        printk(KERN_INFO "[PFQ|%d] Rx overload: invalid policy (%d)!\n", so->id, ovl.policy);
+                        return -EINVAL;
+                }
+
+                if (ovl.threshold > 100) {
+                        printk(KERN_INFO "[PFQ|%d] Rx overload: invalid threshold %u (max 100)!\n", so->id, ovl.threshold);
+                        return -EINVAL;
+                }
+
+                so->opt.rx_overload = ovl;
+
+                pr_devel("[PFQ|%d] Rx overload policy=%d threshold=%u%%\n", so->id, ovl.policy, ovl.threshold);
+
+        } break;
+
         case Q_SO_GROUP_LEAVE:
         {
                 pfq_gid_t gid;
@@ -829,6 +1036,122 @@ int pfq_setsockopt(struct socket *sock,
 
         } break;
 
+        case Q_SO_GROUP_BLOOM:
+        {
+                struct pfq_group_bloom tmp;
+                pfq_gid_t gid;
+                int err;
+
+                if (optlen != sizeof(tmp))
+                        return -EINVAL;
+
+                if (copy_from_user(&tmp, optval, optlen))
+                        return -EFAULT;
+
+		gid = (__force pfq_gid_t)tmp.gid;
+
+		if (!pfq_has_joined_group(gid, so->id)) {
+                        printk(KERN_INFO "[PFQ|%d] group bloom: gid=%d not joined!\n", so->id, tmp.gid);
+			return -EACCES;
+		}
+
+                err = pfq_bloom_table_ctl(gid, &tmp);
+                if (err < 0) {
+                        printk(KERN_INFO "[PFQ|%d] group bloom: gid=%d op=%d error (%d)!\n", so->id, tmp.gid, tmp.op, err);
+                        return err;
+                }
+
+                pr_devel("[PFQ|%d] group bloom: gid=%d op=%d n=%zu\n", so->id, tmp.gid, tmp.op, tmp.n);
+
+        } break;
+
+        case Q_SO_GROUP_LPM:
+        {
+                struct pfq_group_lpm tmp;
+                pfq_gid_t gid;
+                int err;
+
+                if (optlen != sizeof(tmp))
+                        return -EINVAL;
+
+                if (copy_from_user(&tmp, optval, optlen))
+                        return -EFAULT;
+
+		gid = (__force pfq_gid_t)tmp.gid;
+
+		if (!pfq_has_joined_group(gid, so->id)) {
+                        printk(KERN_INFO "[PFQ|%d] group lpm: gid=%d not joined!\n", so->id, tmp.gid);
+			return -EACCES;
+		}
+
+                err = pfq_lpm_table_ctl(gid, &tmp);
+                if (err < 0) {
+                        printk(KERN_INFO "[PFQ|%d] group lpm: gid=%d op=%d error (%d)!\n", so->id, tmp.gid, tmp.op, err);
+                        return err;
+                }
+
+                pr_devel("[PFQ|%d] group lpm: gid=%d op=%d n=%zu\n", so->id, tmp.gid, tmp.op, tmp.n);
+
+        } break;
+
+        case Q_SO_GROUP_FLOWS:
+        {
+                struct pfq_group_flows tmp;
+                pfq_gid_t gid;
+                int err;
+
+                if (optlen != sizeof(tmp))
+                        return -EINVAL;
+
+                if (copy_from_user(&tmp, optval, optlen))
+                        return -EFAULT;
+
+		gid = (__force pfq_gid_t)tmp.gid;
+
+		if (!pfq_has_joined_group(gid, so->id)) {
+                        printk(KERN_INFO "[PFQ|%d] group flows: gid=%d not joined!\n", so->id, tmp.gid);
+			return -EACCES;
+		}
+
+                err = pfq_flow_table_ctl(gid, &tmp);
+                if (err < 0) {
+                        printk(KERN_INFO "[PFQ|%d] group flows: gid=%d op=%d error (%d)!\n", so->id, tmp.gid, tmp.op, err);
+                        return err;
+                }
+
+                pr_devel("[PFQ|%d] group flows: gid=%d op=%d capacity=%zu\n", so->id, tmp.gid, tmp.op, tmp.capacity);
+
+        } break;
+
+        case Q_SO_GROUP_SKETCH:
+        {
+                struct pfq_group_sketch tmp;
+                pfq_gid_t gid;
+                int err;
+
+                if (optlen != sizeof(tmp))
+                        return -EINVAL;
+
+                if (copy_from_user(&tmp, optval, optlen))
+                        return -EFAULT;
+
+		gid = (__force pfq_gid_t)tmp.gid;
+
+		if (!pfq_has_joined_group(gid, so->id)) {
+                        printk(KERN_INFO "[PFQ|%d] group sketch: gid=%d not joined!\n", so->id, tmp.gid);
+			return -EACCES;
+		}
+
+                err = pfq_sketch_ctl(gid, &tmp);
+                if (err < 0) {
+                        printk(KERN_INFO "[PFQ|%d] group sketch: gid=%d op=%d error (%d)!\n", so->id, tmp.gid, tmp.op, err);
+                        return err;
+                }
+
+                pr_devel("[PFQ|%d] group sketch: gid=%d op=%d key=%d\n", so->id, tmp.gid, tmp.op, tmp.key);
+
+        } break;
+
         case Q_SO_GROUP_FUNCTION:
         {
                 struct pfq_lang_computation_descr *descr = NULL;
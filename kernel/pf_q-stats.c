@@ -40,6 +40,10 @@ void pfq_sock_stats_reset(struct pfq_sock_stats __percpu *stats)
 		local_set(&stat->drop, 0);
 		local_set(&stat->sent, 0);
 		local_set(&stat->disc, 0);
+		local_set(&stat->shed_tail, 0);
+		local_set(&stat->shed_class, 0);
+		local_set(&stat->shed_state, 0);
+		local_set(&stat->shed_red, 0);
 	}
 }
 
@@ -88,6 +92,7 @@ void pfq_global_stats_reset(struct pfq_global_stats __percpu *stats)
 		local_set(&stat->kern, 0);
 		local_set(&stat->disc, 0);
 		local_set(&stat->abrt, 0);
+		local_set(&stat->ovfl, 0);
 		local_set(&stat->poll, 0);
 		local_set(&stat->wake, 0);
 	}
@@ -117,3 +122,17 @@ void pfq_memory_stats_reset(struct pfq_memory_stats __percpu *stats)
 	}
 }
 
+
+void pfq_xmit_dev_stats_reset(struct pfq_xmit_dev_stats __percpu *stats)
+{
+	int i, n;
+	for_each_possible_cpu(i)
+	{
+		struct pfq_xmit_dev_stats * stat = per_cpu_ptr(stats, i);
+		for(n = 0; n < Q_MAX_DEVICE; n++)
+		{
+			local_set(&stat->batch[n], 0);
+			local_set(&stat->pkts[n], 0);
+		}
+	}
+}
@@ -32,6 +32,7 @@
 #include <pragma/diagnostic_pop>
 
 #include <pf_q-sparse.h>
+#include <pf_q-define.h>
 
 
 struct pfq_sock_stats
@@ -41,6 +42,11 @@ struct pfq_sock_stats
         local_t drop;		/* dropped by filters */
         local_t sent;		/* sent by the driver */
         local_t disc;		/* discarded by the driver */
+
+        local_t shed_tail;	/* overload: queue full */
+        local_t shed_class;	/* overload: shed by class */
+        local_t shed_state;	/* overload: shed by monad state */
+        local_t shed_red;	/* overload: random early drop */
 };
 
 
@@ -70,11 +76,19 @@ struct pfq_global_stats
         local_t kern;		/* passed to kernel */
         local_t disc;		/* discarded due to driver congestion */
         local_t abrt;		/* aborted (e.g. memory problems) */
+        local_t ovfl;		/* not forwarded: too many egress devices per batch */
         local_t poll;		/* number of poll */
         local_t wake;		/* number of wakeup */
 };
 
 
+struct pfq_xmit_dev_stats
+{
+	local_t batch[Q_MAX_DEVICE];	/* lazy transmissions (one per device queue and Rx batch) */
+	local_t pkts[Q_MAX_DEVICE];	/* packets forwarded by such transmissions */
+};
+
+
 struct pfq_memory_stats
 {
 	local_t os_alloc;
@@ -118,6 +132,7 @@ extern void pfq_group_stats_reset(struct pfq_group_stats __percpu *stats);
 extern void pfq_group_counters_reset(struct pfq_group_counters __percpu *counters);
 extern void pfq_global_stats_reset(struct pfq_global_stats __percpu *stats);
 extern void pfq_memory_stats_reset(struct pfq_memory_stats __percpu *stats);
+extern void pfq_xmit_dev_stats_reset(struct pfq_xmit_dev_stats __percpu *stats);
 
 
 #endif /* PF_Q_STATS_H */
@@ -35,6 +35,7 @@
 #include <linux/skbuff.h>
 #include <linux/netdevice.h>
 #include <linux/delay.h>
+#include <linux/sort.h>
 
 #include <pragma/diagnostic_pop>
 
@@ -46,6 +47,7 @@
 #include <pf_q-global.h>
 #include <pf_q-printk.h>
 #include <pf_q-netdev.h>
+#include <pf_q-percpu.h>
 
 #include <lang/GC.h>
 
@@ -569,17 +571,19 @@ intr:
 int
 pfq_lazy_xmit(struct sk_buff __GC * skb, struct net_device *dev, int queue)
 {
-	struct GC_log *skb_log = PFQ_CB(skb)->log;
+	int ret = pfq_lang_log_dev(skb, dev);
 
-	if (skb_log->num_devs >= Q_GC_LOG_QUEUE_LEN) {
+	if (unlikely(ret < 0)) {
+		sparse_inc(&global_stats, ovfl);
 		if (printk_ratelimit())
-			printk(KERN_INFO "[PFQ] bridge %s: too many annotation!\n", dev->name);
+			printk(KERN_INFO "[PFQ] bridge %s: too many endpoints!\n", dev->name);
 		return 0;
 	}
 
 	skb_set_queue_mapping(PFQ_SKB(skb), queue);
-	skb_log->dev[skb_log->num_devs++] = dev;
-	skb_log->xmit_todo++;
+
+	if (ret)
+		PFQ_CB(skb)->log->xmit_todo++;
 
 	return 1;
 }
@@ -628,77 +632,160 @@ skb_tx_clone(struct net_device *dev, struct sk_buff *skb, gfp_t mask)
 }
 
 
-size_t
-pfq_skb_queue_lazy_xmit_run(struct pfq_skbuff_GC_queue *skbs, struct pfq_endpoint_info const *endpoints)
+static int
+lazy_entry_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+	return (x > y) - (x < y);
+}
+
+
+static inline bool
+lazy_entry_sorted(u32 const *entry, size_t len)
 {
+	size_t i;
+	for(i = 1; i < len; i++)
+	{
+		if (entry[i-1] > entry[i])
+			return false;
+	}
+	return true;
+}
+
+
+/*
+ * Send a bucket of skbs (same hw queue) under a single HARD_TX_LOCK. An skb
+ * is handed to the driver only once its successor is ready, so that the last
+ * one queued is always sent with xmit_more = 0, even if a clone fails.
+ */
+
+static size_t
+lazy_xmit_bucket(struct GC_data *gc, struct net_device *dev, u32 const *entry, size_t len, int cpu)
+{
+	struct sk_buff __GC *first = gc->pool.queue[entry[0] & 0xffff];
+	struct sk_buff *prev = NULL;
 	struct netdev_queue *txq;
-	struct net_device *dev;
-	struct sk_buff __GC *skb;
-        size_t sent = 0;
-	size_t n, i;
-	int queue = -1;
+	int queue = first->queue_mapping;
+	size_t i, sent = 0;
+
+	__sparse_add(xmit_dev_stats, batch[dev->ifindex], 1, cpu);
+	__sparse_add(xmit_dev_stats, pkts[dev->ifindex], len, cpu);
 
-	/* for each net_device... */
+	txq = pfq_netdev_pick_tx(dev, PFQ_SKB(first), &queue);
 
-	for(n = 0; n < endpoints->num; n++)
+	local_bh_disable();
+	HARD_TX_LOCK(dev, txq, smp_processor_id());
+
+	for(i = 0; i < len; i++)
 	{
-		size_t sent_dev = 0;
-		dev = endpoints->dev[n];
+		struct sk_buff __GC *skb = gc->pool.queue[entry[i] & 0xffff];
+		struct sk_buff *nskb;
+		bool to_clone;
 
-		txq = NULL;
-                queue = -1;
+		to_clone = PFQ_CB(skb)->log->to_kernel || PFQ_CB(skb)->log->xmit_todo-- > 1;
 
-		/* scan the list of skbs, and forward them in batch fashion */
+		nskb = to_clone ? skb_tx_clone(dev, PFQ_SKB(skb), GFP_ATOMIC) :
+				  skb_get(PFQ_SKB(skb));
+		if (nskb == NULL) {
+			sparse_inc(&global_stats, abrt);
+			continue;
+		}
 
-		for(i = 0; i < skbs->len; i++)
-		{
-                        size_t j, num;
+		if (prev) {
+			if (__pfq_xmit(prev, dev, 1) == NETDEV_TX_OK)
+				sent++;
+			else
+				sparse_inc(&global_stats, abrt);
+		}
 
-			/* select packet and log */
+		prev = nskb;
+	}
 
-			skb = skbs->queue[i];
+	if (prev) {
+		if (__pfq_xmit(prev, dev, 0) == NETDEV_TX_OK)
+			sent++;
+		else
+			sparse_inc(&global_stats, abrt);
+	}
 
-			num = GC_count_dev_in_log(dev, PFQ_CB(skb)->log);
+	HARD_TX_UNLOCK(dev, txq);
+	local_bh_enable();
 
-			if (num == 0)
-				continue;
+	return sent;
+}
 
-			if (queue != skb->queue_mapping) {
 
-				queue = skb->queue_mapping;
+/*
+ * Transmit the skbs annotated by pfq_lazy_xmit. A single pass over the pool
+ * walks the device mask of each skb and sorts the (skb, device) pairs by
+ * endpoint slot (counting sort, offsets from endpoints.cnt[]). The entries
+ * of a slot are then ordered by hw queue, preserving the order of the skbs,
+ * and each run of the same hw queue is sent under a single HARD_TX_LOCK.
+ *
+ * Should the pairs exceed the scratch area, the slots are sorted in windows
+ * (a pass over the pool each).
+ */
 
-				if (txq) {
-					HARD_TX_UNLOCK(dev, txq);
-					local_bh_enable();
-                                }
+size_t
+pfq_skb_queue_lazy_xmit_run(struct GC_data *gc, int cpu)
+{
+	struct pfq_endpoint_info const *endpoints = &gc->endpoints;
+	size_t first = 0, sent = 0;
 
-				txq = pfq_netdev_pick_tx(dev, PFQ_SKB(skb), &queue);
+	BUILD_BUG_ON_MSG(Q_GC_POOL_QUEUE_LEN > 0x10000, "lazy xmit: pool index overflow");
+	BUILD_BUG_ON_MSG(Q_GC_POOL_QUEUE_LEN > Q_GC_LAZY_QUEUE_LEN, "lazy xmit: scratch too small");
 
-				local_bh_disable();
-				HARD_TX_LOCK(dev, txq, smp_processor_id());
-			}
+	while (first < endpoints->num)
+	{
+		size_t last, total = 0, begin, n, i;
 
-			/* forward this skb `num` times (to this device) */
+		/* offsets of the slots in this window */
 
-			for (j = 0; j < num; j++)
-			{
-				const int xmit_more  = ++sent_dev != endpoints->cnt[n];
-				const bool to_clone  = PFQ_CB(skb)->log->to_kernel || PFQ_CB(skb)->log->xmit_todo-- > 1;
+		for(last = first; last < endpoints->num &&
+		    total + endpoints->cnt[last] <= Q_GC_LAZY_QUEUE_LEN; last++)
+		{
+			gc->lazy_off[last] = total;
+			total += endpoints->cnt[last];
+		}
 
-				struct sk_buff *nskb = to_clone ? skb_tx_clone(dev, PFQ_SKB(skb), GFP_ATOMIC) :
-								  skb_get(PFQ_SKB(skb));
+		/* counting sort by slot */
 
-				if (nskb && __pfq_xmit(nskb, dev, xmit_more) == NETDEV_TX_OK)
-					sent++;
-				else
-					sparse_inc(&global_stats, abrt);
-			}
+		for(i = 0; i < gc->pool.len; i++)
+		{
+			struct GC_log const *log = &gc->log[i];
+			u32 key;
+
+			if (log->num_devs == 0)
+				continue;
+
+			key = (u32)gc->pool.queue[i]->queue_mapping << 16 | (u32)i;
+
+			for(n = find_next_bit(log->dev_mask, last, first); n < last;
+			    n = find_next_bit(log->dev_mask, last, n + 1))
+				gc->lazy[gc->lazy_off[n]++] = key;
 		}
 
-		if (txq) {
-			HARD_TX_UNLOCK(dev, txq);
-			local_bh_enable();
+		/* for each net_device, one bucket per hw queue */
+
+		for(n = first, begin = 0; n < last; begin = gc->lazy_off[n++])
+		{
+			u32 *entry = &gc->lazy[begin];
+			size_t len = gc->lazy_off[n] - begin, run;
+
+			if (!lazy_entry_sorted(entry, len))
+				sort(entry, len, sizeof(u32), lazy_entry_cmp, NULL);
+
+			for(i = 0; i < len; i += run)
+			{
+				run = 1;
+				while (i + run < len && (entry[i + run] >> 16) == (entry[i] >> 16))
+					run++;
+
+				sent += lazy_xmit_bucket(gc, endpoints->dev[n], entry + i, run, cpu);
+			}
 		}
+
+		first = last;
 	}
 
 	return sent;
@@ -75,7 +75,7 @@ extern int pfq_skb_queue_lazy_xmit(struct pfq_skbuff_GC_queue *queue, struct net
 extern int pfq_skb_queue_lazy_xmit_by_mask(struct pfq_skbuff_GC_queue *queue, unsigned long long mask,
 					   struct net_device *dev, int queue_index);
 
-extern size_t pfq_skb_queue_lazy_xmit_run(struct pfq_skbuff_GC_queue *queue, struct pfq_endpoint_info const *info);
+extern size_t pfq_skb_queue_lazy_xmit_run(struct GC_data *gc, int cpu);
 
 
 #endif /* PF_Q_TRANSMIT_H */
@@ -0,0 +1,195 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include <lang/bloom.h>
+
+
+/*
+ * Micro-benchmark of the bloom filter layouts:
+ *
+ * legacy:  m bits, 4 probes (hfun1..4) scattered over the whole array (IPv4 only)
+ * blocked: m bits in cache lines of BBF_BLOCK_BITS, BBF_K probes within a single line
+ *
+ * usage: test-bloom [m (bits)] [n (keys)] [lookups]
+ */
+
+
+static uint64_t rnd_state = 0x2545f4914f6cdd1dULL;
+
+static uint64_t rnd(void)
+{
+	rnd_state ^= rnd_state >> 12;
+	rnd_state ^= rnd_state << 25;
+	rnd_state ^= rnd_state >> 27;
+	return rnd_state * 0x2545f4914f6cdd1dULL;
+}
+
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/* legacy layout */
+
+#define legacy_set(mem, m, key, words) \
+	do { \
+		BF_SET(mem, hfun1(*(key)) & ((m)-1)); \
+		BF_SET(mem, hfun2(*(key)) & ((m)-1)); \
+		BF_SET(mem, hfun3(*(key)) & ((m)-1)); \
+		BF_SET(mem, hfun4(*(key)) & ((m)-1)); \
+	} while(0)
+
+#define legacy_test(mem, m, key, words) \
+	(BF_TEST(mem, hfun1(*(key)) & ((m)-1)) && \
+	 BF_TEST(mem, hfun2(*(key)) & ((m)-1)) && \
+	 BF_TEST(mem, hfun3(*(key)) & ((m)-1)) && \
+	 BF_TEST(mem, hfun4(*(key)) & ((m)-1)))
+
+
+/* blocked layout */
+
+#define blocked_set(mem, m, key, words) \
+	bbf_set((uint64_t *)(mem), (m) / BBF_BLOCK_BITS, bbf_hash(key, words))
+
+#define blocked_test(mem, m, key, words) \
+	bbf_test((const uint64_t *)(mem), (m) / BBF_BLOCK_BITS, bbf_hash(key, words))
+
+
+/*
+ * keys:    the n keys of the set
+ * members: lookups keys of the set, in random order
+ * probes:  lookups keys not in the set (false positives)
+ */
+
+#define BENCH(name, layout, m, words, keys, members, probes, n, lookups) \
+	do { \
+		char *mem = aligned_alloc(64, (m) >> 3); \
+		size_t i, hits = 0; \
+		double t0, t1, t2; \
+		assert(mem); \
+		memset(mem, 0, (m) >> 3); \
+		for(i = 0; i < (n); i++) \
+			layout##_set(mem, m, (keys) + i * (words), words); \
+		t0 = now_ns(); \
+		for(i = 0; i < (lookups); i++) \
+			hits += layout##_test(mem, m, (members) + i * (words), words); \
+		t1 = now_ns(); \
+		assert(hits == (lookups)); \
+		hits = 0; \
+		for(i = 0; i < (lookups); i++) \
+			hits += layout##_test(mem, m, (probes) + i * (words), words); \
+		t2 = now_ns(); \
+		printf("%-24s fpr = %.6f  %6.2f ns/lookup (members: %6.2f ns/lookup)\n", name, \
+		       (double)hits/(lookups), (t2 - t1)/(lookups), (t1 - t0)/(lookups)); \
+		free(mem); \
+	} while(0)
+
+
+/* key sets: random, or consecutive addresses (as in a blocklist of networks) */
+
+static uint32_t *make_keys(size_t n, size_t words, bool sequential, uint32_t base)
+{
+	uint32_t *keys = malloc(n * words * sizeof(uint32_t));
+	size_t i, w;
+
+	assert(keys);
+	for(i = 0; i < n; i++)
+		for(w = 0; w < words; w++)
+			keys[i * words + w] = sequential ? (w == 0 ? base + (uint32_t)i : 0) : (uint32_t)rnd();
+	return keys;
+}
+
+
+static uint32_t *make_members(const uint32_t *keys, size_t n, size_t words, size_t lookups)
+{
+	uint32_t *members = malloc(lookups * words * sizeof(uint32_t));
+	size_t i;
+
+	assert(members);
+	for(i = 0; i < lookups; i++)
+		memcpy(members + i * words, keys + (rnd() % n) * words, words * sizeof(uint32_t));
+	return members;
+}
+
+
+int main(int argc, char *argv[])
+{
+	uint32_t m = argc > 1 ? clp2(atoi(argv[1])) : (1U << 20);
+	size_t   n = argc > 2 ? (size_t)atoi(argv[2]) : 65536;
+	size_t   lookups = argc > 3 ? (size_t)atoi(argv[3]) : 4000000;
+	int seq;
+
+	if (m < BBF_BLOCK_BITS || m > (1U << 24) || n == 0) {
+		fprintf(stderr, "usage: %s [m (bits) in [%d, 2^24]] [n (keys)] [lookups]\n", argv[0], BBF_BLOCK_BITS);
+		return 1;
+	}
+
+	printf("m = %u bits, n = %zu keys (%.1f bits/key), %zu lookups, k = 4 (legacy), %d (blocked)\n\n",
+	       m, n, (double)m/n, lookups, BBF_K);
+
+	for(seq = 0; seq < 2; seq++)
+	{
+		/* IPv4: random probes are (almost surely) not in the set, sequential ones are disjoint */
+
+		uint32_t *keys    = make_keys(n, 1, seq, 0x0a000000);
+		uint32_t *members = make_members(keys, n, 1, lookups);
+		uint32_t *probes  = make_keys(lookups, 1, seq, 0x0b000000);
+
+		BENCH(seq ? "legacy/ipv4 (seq)"  : "legacy/ipv4",  legacy,  m, 1, keys, members, probes, n, lookups);
+		BENCH(seq ? "blocked/ipv4 (seq)" : "blocked/ipv4", blocked, m, 1, keys, members, probes, n, lookups);
+
+		free(keys); free(members); free(probes);
+	}
+
+	{
+		uint32_t *keys    = make_keys(n, 4, false, 0);
+		uint32_t *members = make_members(keys, n, 4, lookups);
+		uint32_t *probes  = make_keys(lookups, 4, false, 0);
+
+		BENCH("blocked/ipv6", blocked, m, 4, keys, members, probes, n, lookups);
+
+		free(keys); free(members); free(probes);
+	}
+
+	{
+		uint32_t *keys    = make_keys(n, BBF_KEY_WORDS, false, 0);
+		uint32_t *members = make_members(keys, n, BBF_KEY_WORDS, lookups);
+		uint32_t *probes  = make_keys(lookups, BBF_KEY_WORDS, false, 0);
+
+		BENCH("blocked/tuple", blocked, m, BBF_KEY_WORDS, keys, members, probes, n, lookups);
+
+		free(keys); free(members); free(probes);
+	}
+
+	return 0;
+}
@@ -0,0 +1,191 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include <lang/lpm.h>
+
+
+/*
+ * Check the LPM trie against a linear search over random prefixes
+ * (IPv4 and IPv6), and measure the lookup time.
+ *
+ * usage: test-lpm [prefixes] [lookups]
+ */
+
+
+struct rule
+{
+	uint8_t  addr[16];
+	int      prefix;
+	uint32_t value;
+};
+
+
+static uint64_t rnd_state = 0x2545f4914f6cdd1dULL;
+
+static uint64_t rnd(void)
+{
+	rnd_state ^= rnd_state >> 12;
+	rnd_state ^= rnd_state << 25;
+	rnd_state ^= rnd_state >> 27;
+	return rnd_state * 0x2545f4914f6cdd1dULL;
+}
+
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static void mask_addr(uint8_t *addr, int bytes, int prefix)
+{
+	int i;
+	for(i = 0; i < bytes; i++)
+	{
+		int bits = prefix - i * 8;
+		addr[i] &= bits >= 8 ? 0xff : bits <= 0 ? 0 : (uint8_t)(0xff << (8 - bits));
+	}
+}
+
+
+static int by_prefix(const void *a, const void *b)
+{
+	return ((const struct rule *)a)->prefix - ((const struct rule *)b)->prefix;
+}
+
+
+static uint32_t linear_lookup(const struct rule *rules, size_t n, int bytes, const uint8_t *addr)
+{
+	uint32_t value = 0;
+	int best = -1;
+	size_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		uint8_t tmp[16];
+		memcpy(tmp, addr, bytes);
+		mask_addr(tmp, bytes, rules[i].prefix);
+
+		if (rules[i].prefix >= best && memcmp(tmp, rules[i].addr, bytes) == 0) {
+			best = rules[i].prefix;
+			value = rules[i].value;
+		}
+	}
+
+	return value;
+}
+
+
+static void test(int bits, size_t n, size_t lookups)
+{
+	int bytes = bits / 8;
+	struct pfq_lpm_trie t;
+	struct rule *rules = malloc(n * sizeof(struct rule));
+	uint8_t *addrs = malloc(lookups * 16);
+	size_t i, hits = 0;
+	double t0, t1;
+
+	assert(rules && addrs);
+
+	/* prefixes clustered in a few networks, so that they nest */
+
+	for(i = 0; i < n; i++)
+	{
+		int b;
+		for(b = 0; b < bytes; b++)
+			rules[i].addr[b] = (uint8_t)rnd();
+
+		rules[i].addr[0] = 10;
+		rules[i].addr[1] = (uint8_t)(rnd() & 3);
+		rules[i].prefix = 8 + (int)(rnd() % (bits - 7));
+		rules[i].value = (uint32_t)i + 1;
+		mask_addr(rules[i].addr, bytes, rules[i].prefix);
+	}
+
+	/* equal prefixes: the last one wins in both the trie and the linear search */
+
+	qsort(rules, n, sizeof(struct rule), by_prefix);
+
+	assert(pfq_lpm_trie_init(&t, bits) == 0);
+
+	for(i = 0; i < n; i++)
+		assert(pfq_lpm_trie_insert(&t, rules[i].addr, rules[i].prefix, rules[i].value) == 0);
+
+	for(i = 0; i < lookups; i++)
+	{
+		int b;
+		uint8_t *a = addrs + i * 16;
+		for(b = 0; b < bytes; b++)
+			a[b] = (uint8_t)rnd();
+		a[0] = 10;
+		a[1] = (uint8_t)(rnd() & 3);
+
+		/* half of the addresses inside a prefix */
+
+		if (i & 1) {
+			const struct rule *r = &rules[rnd() % n];
+			memcpy(a, r->addr, (r->prefix + 7) / 8);
+		}
+	}
+
+	for(i = 0; i < lookups && i < 20000; i++)
+		assert(pfq_lpm_trie_lookup(&t, addrs + i * 16) == linear_lookup(rules, n, bytes, addrs + i * 16));
+
+	t0 = now_ns();
+	for(i = 0; i < lookups; i++)
+		hits += pfq_lpm_trie_lookup(&t, addrs + i * 16) != 0;
+	t1 = now_ns();
+
+	printf("IPv%d: %zu prefixes, %u chunks (%zu KB), %zu/%zu matches, %.2f ns/lookup\n",
+	       bits == 32 ? 4 : 6, n, t.nchunks,
+	       (((size_t)t.nchunks << LPM_CHUNK_BITS) + (1U << LPM_ROOT_BITS)) * sizeof(uint32_t) >> 10,
+	       hits, lookups, (t1 - t0) / lookups);
+
+	pfq_lpm_trie_free(&t);
+	free(rules);
+	free(addrs);
+}
+
+
+int main(int argc, char *argv[])
+{
+	size_t n = argc > 1 ? (size_t)atoi(argv[1]) : 4096;
+	size_t lookups = argc > 2 ? (size_t)atoi(argv[2]) : 1000000;
+
+	if (n == 0) {
+		fprintf(stderr, "usage: %s [prefixes] [lookups]\n", argv[0]);
+		return 1;
+	}
+
+	test(32, n, lookups);
+	test(128, n, lookups);
+	return 0;
+}
@@ -0,0 +1,370 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <lang/aho-corasick.h>
+
+
+/*
+ * Correctness and throughput of the payload matcher (has_pattern):
+ * the payloads of a pcap corpus (or a synthetic one) are scanned with the
+ * compiled DFA, in one piece and split in two fragments (as for non-linear
+ * skbs), and the result is checked against a naive memmem search.
+ * The throughput is that of a single core.
+ *
+ * usage: test-pattern [file.pcap] [rounds]
+ */
+
+#define MAX_PATTERNS	128
+#define SYNTH_PACKETS	100000
+
+
+struct payload
+{
+	const uint8_t	*data;
+	size_t		len;
+};
+
+
+static const char *fixed_patterns[] =
+{
+	"GET /", "POST /", "HEAD /", "HTTP/1.", "Host: ", "User-Agent: ",
+	"|16 03 01|", "|16 03 03|", "SSH-2.0-", "|ff fb 01|", "USER ", "PASS ",
+	"cmd.exe", "/bin/sh", "|90 90 90 90|", "|de ad be ef|",
+};
+
+
+static uint32_t rnd_state = 2463534242U;
+
+static uint32_t rnd(void)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state;
+}
+
+
+/* random printable patterns, to reach a realistic set size */
+
+static size_t
+make_patterns(const char **patterns, char store[][16], size_t n)
+{
+	size_t i, j, k = 0;
+
+	for(i = 0; i < sizeof(fixed_patterns)/sizeof(fixed_patterns[0]); i++)
+		patterns[k++] = fixed_patterns[i];
+
+	for(i = 0; k < n; i++, k++)
+	{
+		size_t len = 4 + rnd() % 8;
+		for(j = 0; j < len; j++)
+			store[i][j] = (char)('a' + rnd() % 26);
+		store[i][len] = '\0';
+		patterns[k] = store[i];
+	}
+
+	return k;
+}
+
+
+/* payload of the packet: as payload_range() in lang/pattern.c */
+
+static bool
+payload_of(const uint8_t *pkt, size_t caplen, struct payload *p)
+{
+	size_t off = 14;
+	uint16_t proto;
+	uint8_t l4;
+
+	if (caplen < off)
+		return false;
+
+	proto = (uint16_t)(pkt[12] << 8 | pkt[13]);
+
+	if (proto == 0x0800) {
+		if (caplen < off + 20)
+			return false;
+		l4 = pkt[off + 9];
+		off += (pkt[off] & 0xf) << 2;
+	}
+	else if (proto == 0x86dd) {
+		if (caplen < off + 40)
+			return false;
+		l4 = pkt[off + 6];
+		off += 40;
+	}
+	else
+		return false;
+
+	if (l4 == 6) {
+		if (caplen < off + 13)
+			return false;
+		off += (pkt[off + 12] >> 4) << 2;
+	}
+	else if (l4 == 17)
+		off += 8;
+
+	if (off >= caplen)
+		return false;
+
+	p->data = pkt + off;
+	p->len  = caplen - off;
+	return true;
+}
+
+
+/* classic pcap file (any byte order, us or ns timestamps) */
+
+static uint32_t
+rd32(const uint8_t *p, bool swap)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return swap ? __builtin_bswap32(v) : v;
+}
+
+
+static size_t
+load_pcap(const char *file, uint8_t **buf, struct payload **out)
+{
+	struct payload *pl = NULL;
+	size_t size, off, n = 0, cap = 0;
+	uint32_t magic;
+	bool swap;
+	FILE *f;
+
+	f = fopen(file, "rb");
+	if (f == NULL) {
+		perror(file);
+		exit(EXIT_FAILURE);
+	}
+
+	fseek(f, 0, SEEK_END);
+	size = (size_t)ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	*buf = malloc(size);
+	if (*buf == NULL || fread(*buf, 1, size, f) != size || size < 24) {
+		fprintf(stderr, "%s: could not read pcap file!\n", file);
+		exit(EXIT_FAILURE);
+	}
+	fclose(f);
+
+	memcpy(&magic, *buf, 4);
+	if (magic == 0xa1b2c3d4 || magic == 0xa1b23c4d)
+		swap = false;
+	else if (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1)
+		swap = true;
+	else {
+		fprintf(stderr, "%s: not a pcap file!\n", file);
+		exit(EXIT_FAILURE);
+	}
+
+	if (rd32(*buf + 20, swap) != 1) {
+		fprintf(stderr, "%s: not an ethernet capture!\n", file);
+		exit(EXIT_FAILURE);
+	}
+
+	for(off = 24; off + 16 <= size; )
+	{
+		uint32_t caplen = rd32(*buf + off + 8, swap);
+		struct payload p;
+
+		off += 16;
+		if (off + caplen > size)
+			break;
+
+		if (payload_of(*buf + off, caplen, &p)) {
+			if (n == cap) {
+				cap = cap ? cap * 2 : 1024;
+				pl = realloc(pl, cap * sizeof(*pl));
+				if (pl == NULL) {
+					fprintf(stderr, "out of memory!\n");
+					exit(EXIT_FAILURE);
+				}
+			}
+			pl[n++] = p;
+		}
+
+		off += caplen;
+	}
+
+	*out = pl;
+	return n;
+}
+
+
+/* random payloads, sizes of an IMIX-like mix, some with a planted pattern */
+
+static size_t
+make_corpus(const uint8_t patterns[][AC_MAX_PATTERN_LEN], const size_t *plen, size_t np,
+	    uint8_t **buf, struct payload **out)
+{
+	static const size_t sizes[] = { 6, 6, 6, 6, 6, 6, 6, 530, 530, 530, 530, 1460 };
+	struct payload *pl = malloc(SYNTH_PACKETS * sizeof(*pl));
+	uint8_t *mem = malloc(SYNTH_PACKETS * 1460);
+	size_t i, j;
+
+	if (pl == NULL || mem == NULL) {
+		fprintf(stderr, "out of memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for(i = 0; i < SYNTH_PACKETS; i++)
+	{
+		size_t len = sizes[rnd() % (sizeof(sizes)/sizeof(sizes[0]))];
+		uint8_t *p = mem + i * 1460;
+
+		for(j = 0; j < len; j++)
+			p[j] = (uint8_t)rnd();
+
+		if (rnd() % 10 == 0) {
+			size_t k = rnd() % np;
+			if (plen[k] <= len)
+				memcpy(p + rnd() % (len - plen[k] + 1), patterns[k], plen[k]);
+		}
+
+		pl[i].data = p;
+		pl[i].len = len;
+	}
+
+	*buf = mem;
+	*out = pl;
+	return SYNTH_PACKETS;
+}
+
+
+static bool
+naive(const uint8_t patterns[][AC_MAX_PATTERN_LEN], const size_t *plen, size_t np, struct payload const *p)
+{
+	size_t k;
+	for(k = 0; k < np; k++)
+		if (memmem(p->data, p->len, patterns[k], plen[k]))
+			return true;
+	return false;
+}
+
+
+static double
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+int main(int argc, char *argv[])
+{
+	static uint8_t bytes[MAX_PATTERNS][AC_MAX_PATTERN_LEN];
+	static char store[MAX_PATTERNS][16];
+	const char *patterns[MAX_PATTERNS];
+	size_t plen[MAX_PATTERNS];
+	struct payload *corpus;
+	struct pfq_ac ac;
+	uint8_t *buf;
+	size_t np, n, i, r, hits = 0, errors = 0, total = 0;
+	int rounds = argc > 2 ? atoi(argv[2]) : 20;
+	double start, elapsed;
+
+	if (rounds <= 0) {
+		fprintf(stderr, "usage: %s [file.pcap] [rounds]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	np = make_patterns(patterns, store, MAX_PATTERNS);
+	for(i = 0; i < np; i++)
+		if (pfq_ac_parse(patterns[i], bytes[i], &plen[i]) < 0) {
+			fprintf(stderr, "bad pattern: %s\n", patterns[i]);
+			return EXIT_FAILURE;
+		}
+
+	if (pfq_ac_compile(&ac, patterns, np) < 0) {
+		fprintf(stderr, "could not compile patterns!\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		n = load_pcap(argv[1], &buf, &corpus);
+	else
+		n = make_corpus((const uint8_t (*)[AC_MAX_PATTERN_LEN])bytes, plen, np, &buf, &corpus);
+
+	printf("patterns:%zu states:%u classes:%u table:%zu KB payloads:%zu\n", np, ac.nstates, ac.nclasses,
+	       (size_t)ac.nstates * ac.nclasses * sizeof(uint16_t) / 1024, n);
+
+	/* correctness */
+
+	for(i = 0; i < n; i++)
+	{
+		bool expect = naive((const uint8_t (*)[AC_MAX_PATTERN_LEN])bytes, plen, np, &corpus[i]);
+		size_t cut = corpus[i].len / 2;
+		uint16_t state = 0;
+		bool whole, split;
+
+		whole = pfq_ac_scan(&ac, &state, corpus[i].data, corpus[i].len);
+
+		state = 0;
+		split = pfq_ac_scan(&ac, &state, corpus[i].data, cut) ||
+			pfq_ac_scan(&ac, &state, corpus[i].data + cut, corpus[i].len - cut);
+
+		if (whole != expect || split != expect)
+			errors++;
+
+		hits += expect;
+	}
+
+	printf("matching:%zu errors:%zu\n", hits, errors);
+
+	/* throughput */
+
+	start = now_ns();
+
+	for(r = 0; r < (size_t)rounds; r++)
+		for(i = 0; i < n; i++)
+		{
+			uint16_t state = 0;
+			hits += pfq_ac_scan(&ac, &state, corpus[i].data, corpus[i].len);
+			total += corpus[i].len;
+		}
+
+	elapsed = now_ns() - start;
+
+	printf("scanned:%zu bytes in %.3f sec: %.2f Gbps/core, %.1f Mpps/core\n", total, elapsed / 1e9,
+	       total * 8 / elapsed, n * rounds * 1e3 / elapsed);
+
+	pfq_ac_free(&ac);
+	free(corpus);
+	free(buf);
+
+	printf("%s\n", errors ? "FAILED" : "OK");
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
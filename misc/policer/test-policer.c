@@ -0,0 +1,176 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <lang/policer.h>
+
+
+/*
+ * Policing accuracy of the two-level token bucket (limit_pps, limit_bps):
+ * packets of a flood, offered at a multiple of the rate, are spread over
+ * the cpus and time is simulated. The conforming rate is compared with
+ * the configured one (the initial burst aside).
+ *
+ * usage: test-policer [cpus] [seconds]
+ */
+
+#define MAX_CPUS	64
+
+
+static uint64_t rnd_state = 0x2545f4914f6cdd1dULL;
+
+static uint64_t rnd(void)
+{
+	rnd_state ^= rnd_state >> 12;
+	rnd_state ^= rnd_state << 25;
+	rnd_state ^= rnd_state >> 27;
+	return rnd_state * 0x2545f4914f6cdd1dULL;
+}
+
+
+/* the lock-free part of policer_conform() in lang/policer.c */
+
+static bool
+conform(struct token_bucket *tb, struct tb_cache *c, const struct tb_params *p, uint64_t cost, uint64_t now)
+{
+	if (tb_cache_consume(c, cost))
+		return true;
+
+	if ((int64_t)(now - c->retry) < 0)
+		return false;
+
+	tb_cache_refill(c, tb, p, cost, now);
+	return tb_cache_consume(c, cost);
+}
+
+
+static int
+run(const char *what, uint64_t rate, bool bits, double load, int cpus, int seconds)
+{
+	struct tb_cache cache[MAX_CPUS];
+	struct token_bucket tb;
+	struct tb_params p;
+	uint64_t burst, now = 1000000000ULL, end, gap, passed = 0, offered = 0, cost;
+	double avg_cost = bits ? ((64 + 1514) / 2) * 8 : 1, expected, err, slack;
+
+	burst = bits ? rate / 10 > 1514 * 8 ? rate / 10 : 1514 * 8
+		     : rate / 10 > 1 ? rate / 10 : 1;
+
+	tb_params_init(&p, rate, burst);
+	tb_init(&tb, &p, now);
+	memset(cache, 0, sizeof(cache));
+
+	/* mean inter-arrival time of the flood, in ns */
+
+	gap = (uint64_t)(1e9 * avg_cost / (rate * load));
+	if (gap == 0)
+		gap = 1;
+
+	end = now + (uint64_t)seconds * 1000000000ULL;
+
+	for(; now < end; now += gap / 2 + rnd() % (gap + 1))
+	{
+		cost = bits ? (64 + rnd() % (1514 - 64 + 1)) * 8 : 1;
+		offered += cost;
+		if (conform(&tb, &cache[rnd() % cpus], &p, cost, now))
+			passed += cost;
+	}
+
+	expected = (double)rate * seconds;
+	err = (double)passed - (double)burst - expected;
+
+	/* tokens left in the caches: at most a quantum and a packet per cpu */
+
+	slack = (double)cpus * ((double)p.quantum / TB_SCALE + (bits ? 1514 * 8 : 1));
+
+	printf("%-9s rate:%12llu load:%4.1fx offered:%14llu passed:%14llu error:%+7.3f%%\n",
+	       what, (unsigned long long)rate, load, (unsigned long long)offered,
+	       (unsigned long long)passed, 100.0 * err / expected);
+
+	return fabs(err) <= fmax(expected / 100, slack) ? 0 : 1;
+}
+
+
+static int
+run_flow(uint64_t rate, int seconds)
+{
+	struct token_bucket tb;
+	struct tb_params p;
+	uint64_t now = 1000000000ULL, end, gap, passed = 0;
+	double expected, err;
+
+	tb_params_init(&p, rate, rate / 10 > 1 ? rate / 10 : 1);
+	tb_init(&tb, &p, now);
+
+	gap = 1000000000ULL / (rate * 4);
+	end = now + (uint64_t)seconds * 1000000000ULL;
+
+	for(; now < end; now += gap)
+		passed += tb_conform(&tb, &p, 1, now);
+
+	expected = (double)rate * seconds;
+	err = (double)passed - (double)p.burst - expected;
+
+	printf("%-9s rate:%12llu load: 4.0x passed:%14llu error:%+7.3f%%\n",
+	       "flow", (unsigned long long)rate, (unsigned long long)passed, 100.0 * err / expected);
+
+	return fabs(err) <= fmax(expected / 100, 1) ? 0 : 1;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int cpus = argc > 1 ? atoi(argv[1]) : 8;
+	int seconds = argc > 2 ? atoi(argv[2]) : 2;
+	static const uint64_t pps[] = { 100, 10000, 1000000, 10000000 };
+	static const uint64_t bps[] = { 1000000, 100000000, 10000000000ULL };
+	static const double load[] = { 1.5, 10 };
+	int fail = 0;
+	size_t i, j;
+
+	if (cpus <= 0 || cpus > MAX_CPUS || seconds <= 0) {
+		fprintf(stderr, "usage: %s [cpus] [seconds]\n", argv[0]);
+		return 1;
+	}
+
+	printf("cpus:%d seconds:%d\n", cpus, seconds);
+
+	for(i = 0; i < sizeof(pps)/sizeof(pps[0]); i++)
+		for(j = 0; j < sizeof(load)/sizeof(load[0]); j++)
+			fail |= run("limit_pps", pps[i], false, load[j], cpus, seconds);
+
+	for(i = 0; i < sizeof(bps)/sizeof(bps[0]); i++)
+		for(j = 0; j < sizeof(load)/sizeof(load[0]); j++)
+			fail |= run("limit_bps", bps[i], true, load[j], cpus, seconds);
+
+	for(i = 0; i < 3; i++)
+		fail |= run_flow(pps[i], seconds);
+
+	printf("%s\n", fail ? "FAILED" : "OK");
+	return fail;
+}
@@ -0,0 +1,489 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+/*
+ * Minimal sk_buff and net_device: linear buffers only, the packet data
+ * starting at the mac header (as seen by pfq_receive).
+ */
+
+#ifndef __KCOMPAT_NET__
+#define __KCOMPAT_NET__
+
+#include <linux/in.h>
+#include <linux/in6.h>
+#include <linux/if_ether.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/udp.h>
+#include <linux/tcp.h>
+#include <linux/icmp.h>
+#include <linux/filter.h>
+
+
+/**** net device ****/
+
+#define IFNAMSIZ		16
+
+struct net
+{
+	int dummy;
+};
+
+extern struct net init_net;
+
+struct net_device_stats
+{
+	unsigned long	tx_packets;
+};
+
+struct net_device
+{
+	char		name[IFNAMSIZ];
+	int		ifindex;
+	unsigned int	real_num_tx_queues;
+	unsigned int	mtu;
+	struct net	*net;
+	struct { int dummy; } dev;
+	struct net_device_stats stats;
+};
+
+struct netdev_queue
+{
+	struct net_device *dev;
+};
+
+struct napi_struct
+{
+	int dummy;
+};
+
+#define HARD_TX_LOCK(dev, txq, cpu)	((void)(txq), (void)(cpu))
+#define HARD_TX_UNLOCK(dev, txq)	((void)(txq))
+
+#define NETDEV_TX_OK		0
+#define NETDEV_TX_BUSY		0x10
+
+extern struct net_device *dev_get_by_name(struct net *net, const char *name);
+extern struct net_device *dev_get_by_index(struct net *net, int ifindex);
+extern void dev_put(struct net_device *dev);
+
+#define dev_get_by_index_rcu(net, ifindex)	dev_get_by_index(net, ifindex)
+
+extern void sim_devices_reset(void);
+
+
+/**** sk_buff ****/
+
+#define CHECKSUM_NONE		0
+#define PACKET_HOST		0
+#define PACKET_OTHERHOST	3
+
+#define VLAN_HLEN		4
+#define VLAN_ETH_HLEN		18
+#define VLAN_VID_MASK		0x0fff
+#define VLAN_PRIO_MASK		0xe000
+#define VLAN_PRIO_SHIFT		13
+#define VLAN_TAG_PRESENT	0x1000
+
+struct skb_shared_info
+{
+	unsigned char	nr_frags;
+	atomic_t	dataref;
+};
+
+struct sk_buff
+{
+	struct sk_buff		*next;
+	struct net_device	*dev;
+	ktime_t			tstamp;
+
+	char			cb[48] __attribute__((aligned(8)));
+
+	unsigned int		len;
+	unsigned int		data_len;
+	u16			mac_len;
+	u16			queue_mapping;
+	u8			pkt_type;
+	u8			peeked;
+	u8			cloned;
+	u8			ip_summed;
+
+	__be16			protocol;
+	__be16			vlan_proto;
+	u16			vlan_tci;
+	u16			mac_header;
+	u16			network_header;
+	u16			transport_header;
+
+	u32			mark;
+	u32			hash;
+	u32			priority;
+
+	unsigned char		*head;
+	unsigned char		*data;
+	unsigned char		*tail;
+	unsigned char		*end;
+
+	struct skb_shared_info	shinfo;
+	atomic_t		users;
+};
+
+#define skb_shinfo(skb)		(&(skb)->shinfo)
+
+static inline unsigned int skb_headlen(const struct sk_buff *skb)
+{
+	return skb->len - skb->data_len;
+}
+
+static inline bool skb_is_nonlinear(const struct sk_buff *skb)
+{
+	return skb->data_len != 0;
+}
+
+static inline int skb_cloned(const struct sk_buff *skb)
+{
+	return skb->cloned;
+}
+
+static inline unsigned int skb_headroom(const struct sk_buff *skb)
+{
+	return (unsigned int)(skb->data - skb->head);
+}
+
+static inline int skb_tailroom(const struct sk_buff *skb)
+{
+	return (int)(skb->end - skb->tail);
+}
+
+static inline unsigned char *skb_mac_header(const struct sk_buff *skb)
+{
+	return skb->head + skb->mac_header;
+}
+
+static inline unsigned char *skb_network_header(const struct sk_buff *skb)
+{
+	return skb->head + skb->network_header;
+}
+
+static inline unsigned char *skb_transport_header(const struct sk_buff *skb)
+{
+	return skb->head + skb->transport_header;
+}
+
+static inline void skb_reset_mac_header(struct sk_buff *skb)
+{
+	skb->mac_header = (u16)(skb->data - skb->head);
+}
+
+static inline void skb_reset_network_header(struct sk_buff *skb)
+{
+	skb->network_header = (u16)(skb->data - skb->head);
+}
+
+static inline void skb_set_network_header(struct sk_buff *skb, int offset)
+{
+	skb->network_header = (u16)(skb->data - skb->head + offset);
+}
+
+static inline void skb_reset_transport_header(struct sk_buff *skb)
+{
+	skb->transport_header = (u16)(skb->data - skb->head);
+}
+
+static inline void skb_reset_tail_pointer(struct sk_buff *skb)
+{
+	skb->tail = skb->data;
+}
+
+#define NET_IP_ALIGN	2
+
+static inline void skb_reserve(struct sk_buff *skb, int len)
+{
+	skb->data += len;
+	skb->tail += len;
+}
+
+static inline unsigned char *skb_put(struct sk_buff *skb, unsigned int len)
+{
+	unsigned char *tmp = skb->tail;
+	skb->tail += len;
+	skb->len  += len;
+	return tmp;
+}
+
+static inline unsigned char *skb_push(struct sk_buff *skb, unsigned int len)
+{
+	skb->data -= len;
+	skb->len  += len;
+	return skb->data;
+}
+
+static inline unsigned char *skb_pull(struct sk_buff *skb, unsigned int len)
+{
+	if (len > skb->len)
+		return NULL;
+	skb->len -= len;
+	return skb->data += len;
+}
+
+static inline void *skb_header_pointer(const struct sk_buff *skb, int offset, int len, void *buffer)
+{
+	(void)buffer;
+	if (offset < 0 || (unsigned int)(offset + len) > skb->len)
+		return NULL;
+	return skb->data + offset;
+}
+
+static inline int skb_copy_bits(const struct sk_buff *skb, int offset, void *to, int len)
+{
+	if (offset < 0 || (unsigned int)(offset + len) > skb->len)
+		return -EFAULT;
+	memcpy(to, skb->data + offset, (size_t)len);
+	return 0;
+}
+
+static inline bool skb_rx_queue_recorded(const struct sk_buff *skb)
+{
+	return skb->queue_mapping != 0;
+}
+
+static inline u16 skb_get_rx_queue(const struct sk_buff *skb)
+{
+	return skb->queue_mapping - 1;
+}
+
+static inline void skb_record_rx_queue(struct sk_buff *skb, u16 rx_queue)
+{
+	skb->queue_mapping = rx_queue + 1;
+}
+
+static inline u16 skb_get_queue_mapping(const struct sk_buff *skb)
+{
+	return skb->queue_mapping;
+}
+
+static inline void skb_set_queue_mapping(struct sk_buff *skb, u16 queue_mapping)
+{
+	skb->queue_mapping = queue_mapping;
+}
+
+static inline void skb_dst_drop(struct sk_buff *skb)
+{
+	(void)skb;
+}
+
+static inline struct sk_buff *skb_get(struct sk_buff *skb)
+{
+	atomic_inc(&skb->users);
+	return skb;
+}
+
+extern struct sk_buff *skb_clone(struct sk_buff *skb, gfp_t gfp);
+extern struct sk_buff *skb_copy(const struct sk_buff *skb, gfp_t gfp);
+extern struct sk_buff *alloc_skb(unsigned int size, gfp_t gfp);
+extern void kfree_skb(struct sk_buff *skb);
+extern int netif_receive_skb(struct sk_buff *skb);
+
+/* sequential read of the (linear) payload */
+
+struct skb_seq_state
+{
+	const struct sk_buff *skb;
+	unsigned int lower_offset;
+	unsigned int upper_offset;
+	int done;
+};
+
+static inline void skb_prepare_seq_read(struct sk_buff *skb, unsigned int from, unsigned int to, struct skb_seq_state *st)
+{
+	st->skb = skb;
+	st->lower_offset = from;
+	st->upper_offset = to;
+	st->done = 0;
+}
+
+static inline unsigned int skb_seq_read(unsigned int consumed, const u8 **data, struct skb_seq_state *st)
+{
+	unsigned int from = st->lower_offset + consumed;
+	(void)consumed;
+	if (st->done || from >= st->upper_offset || from >= st->skb->len)
+		return 0;
+	st->done = 1;
+	*data = st->skb->data + from;
+	return min(st->upper_offset, st->skb->len) - from;
+}
+
+static inline void skb_abort_seq_read(struct skb_seq_state *st)
+{
+	(void)st;
+}
+
+
+/**** protocol headers ****/
+
+static inline struct ethhdr *eth_hdr(const struct sk_buff *skb)
+{
+	return (struct ethhdr *)skb_mac_header(skb);
+}
+
+static inline struct iphdr *ip_hdr(const struct sk_buff *skb)
+{
+	return (struct iphdr *)skb_network_header(skb);
+}
+
+static inline struct ipv6hdr *ipv6_hdr(const struct sk_buff *skb)
+{
+	return (struct ipv6hdr *)skb_network_header(skb);
+}
+
+static inline struct tcphdr *tcp_hdr(const struct sk_buff *skb)
+{
+	return (struct tcphdr *)skb_transport_header(skb);
+}
+
+static inline struct udphdr *udp_hdr(const struct sk_buff *skb)
+{
+	return (struct udphdr *)skb_transport_header(skb);
+}
+
+struct vlan_hdr
+{
+	__be16	h_vlan_TCI;
+	__be16	h_vlan_encapsulated_proto;
+};
+
+struct vlan_ethhdr
+{
+	unsigned char	h_dest[ETH_ALEN];
+	unsigned char	h_source[ETH_ALEN];
+	__be16		h_vlan_proto;
+	__be16		h_vlan_TCI;
+	__be16		h_vlan_encapsulated_proto;
+};
+
+#define vlan_tx_tag_present(skb)	((skb)->vlan_tci & VLAN_TAG_PRESENT)
+#define vlan_tx_tag_get(skb)		((skb)->vlan_tci & ~VLAN_TAG_PRESENT)
+#define vlan_tx_tag_get_id(skb)		((skb)->vlan_tci & VLAN_VID_MASK)
+#define skb_vlan_tag_present(skb)	vlan_tx_tag_present(skb)
+#define skb_vlan_tag_get(skb)		vlan_tx_tag_get(skb)
+
+static inline __be32 inet_make_mask(int logmask)
+{
+	if (logmask)
+		return htonl(~((1U << (32 - logmask)) - 1));
+	return 0;
+}
+
+static inline bool ipv4_is_multicast(__be32 addr)
+{
+	return (addr & htonl(0xf0000000)) == htonl(0xe0000000);
+}
+
+static inline bool ipv4_is_loopback(__be32 addr)
+{
+	return (addr & htonl(0xff000000)) == htonl(0x7f000000);
+}
+
+static inline bool ipv4_is_lbcast(__be32 addr)
+{
+	return addr == htonl(INADDR_BROADCAST);
+}
+
+static inline bool ipv4_is_zeronet(__be32 addr)
+{
+	return (addr & htonl(0xff000000)) == htonl(0x00000000);
+}
+
+static inline bool ipv4_is_private_10(__be32 addr)
+{
+	return (addr & htonl(0xff000000)) == htonl(0x0a000000);
+}
+
+/* ip_hdr() -> transport header */
+
+#define IP_MF			0x2000
+#define IP_OFFSET		0x1FFF
+
+static inline bool ip_is_fragment(const struct iphdr *iph)
+{
+	return (iph->frag_off & htons(IP_MF | IP_OFFSET)) != 0;
+}
+
+
+/**** bpf ****/
+
+struct sk_filter
+{
+	atomic_t		refcnt;
+	unsigned int		len;
+	struct sock_filter	insns[0];
+};
+
+/* no socket filter is ever attached to the groups of the simulation */
+
+#define SK_RUN_FILTER(filter, ctx)	((void)(filter), (void)(ctx), 0xffffffffu)
+
+
+/**** sockets ****/
+
+struct sock
+{
+	int sk_rcvbuf;
+};
+
+struct socket
+{
+	struct sock *sk;
+};
+
+struct proto_ops;
+struct proto;
+struct poll_table_struct;
+typedef struct poll_table_struct poll_table;
+struct file;
+struct vm_area_struct;
+struct page;
+struct timer_list { unsigned long expires; };
+struct hrtimer { int dummy; };
+typedef struct { int dummy; } wait_queue_head_t;
+struct eventfd_ctx;
+
+/* setsockopt context: the sim runs in the initial namespace */
+
+struct nsproxy { struct net *net_ns; };
+struct task_struct { int tgid; struct nsproxy *nsproxy; };
+
+extern struct task_struct *current;
+
+/* kernel threads are never started: the sim is single threaded */
+
+#define kthread_run(fn, data, name)	((void)(fn), (void)(data), current)
+#define kthread_should_stop()		1
+#define cond_resched()			do { } while (0)
+
+static inline int kthread_stop(struct task_struct *t) { (void)t; return 0; }
+static inline long schedule_timeout_interruptible(long t) { return t; }
+struct inode;
+struct seq_file;
+
+#endif /* __KCOMPAT_NET__ */
@@ -0,0 +1,237 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+/*
+ * Kernel services required by the sources built in user space:
+ * clock, random numbers, devices and sk_buff allocation.
+ */
+
+#include <kcompat.h>
+
+#include <linux/crc16.h>
+
+#include <sim.h>
+
+
+int sim_verbose;
+
+/* time, driven by the timestamps of the packets */
+
+unsigned long jiffies;
+ktime_t sim_ktime;
+
+/* the setsockopt caller */
+
+struct net init_net;
+
+static struct nsproxy sim_nsproxy = { .net_ns = &init_net };
+static struct task_struct sim_task = { .tgid = 1, .nsproxy = &sim_nsproxy };
+
+struct task_struct *current = &sim_task;
+
+
+/* random numbers: xorshift, reproducible across runs */
+
+static u32 sim_seed = 2463534242U;
+
+u32 prandom_u32(void)
+{
+	u32 x = sim_seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return sim_seed = x;
+}
+
+
+void get_random_bytes(void *buf, int nbytes)
+{
+	u8 *p = buf;
+	while (nbytes-- > 0)
+		*p++ = (u8)prandom_u32();
+}
+
+
+/* CRC16 (polynomial 0x8005, reflected), as lib/crc16.c */
+
+u16 crc16(u16 crc, const u8 *buffer, size_t len)
+{
+	while (len--) {
+		int i;
+		crc ^= *buffer++;
+		for (i = 0; i < 8; i++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+	}
+	return crc;
+}
+
+
+/* devices: created on first use, never released */
+
+#define SIM_MAX_DEVICES		16
+
+static struct net_device sim_devices[SIM_MAX_DEVICES];
+static int sim_devices_num;
+
+
+struct net_device *
+dev_get_by_name(struct net *net, const char *name)
+{
+	struct net_device *dev;
+	int n;
+
+	(void)net;
+
+	for(n = 0; n < sim_devices_num; n++)
+	{
+		if (strcmp(sim_devices[n].name, name) == 0)
+			return &sim_devices[n];
+	}
+
+	if (sim_devices_num == SIM_MAX_DEVICES || strlen(name) >= IFNAMSIZ)
+		return NULL;
+
+	dev = &sim_devices[sim_devices_num++];
+	strcpy(dev->name, name);
+	dev->ifindex = sim_devices_num;
+	dev->real_num_tx_queues = 1;
+	dev->mtu = 1500;
+	dev->net = &init_net;
+	return dev;
+}
+
+
+struct net_device *
+dev_get_by_index(struct net *net, int ifindex)
+{
+	(void)net;
+
+	if (ifindex < 1 || ifindex > sim_devices_num)
+		return NULL;
+	return &sim_devices[ifindex-1];
+}
+
+
+void dev_put(struct net_device *dev)
+{
+	(void)dev;
+}
+
+
+void sim_devices_reset(void)
+{
+	memset(sim_devices, 0, sizeof(sim_devices));
+	sim_devices_num = 0;
+}
+
+
+int sim_device(const char *name)
+{
+	struct net_device *dev = dev_get_by_name(&init_net, name);
+	return dev ? dev->ifindex : -ENODEV;
+}
+
+
+unsigned long sim_device_tx(int ifindex)
+{
+	struct net_device *dev = dev_get_by_index(&init_net, ifindex);
+	return dev ? dev->stats.tx_packets : 0;
+}
+
+
+/* sk_buff: linear buffers, copies instead of clones */
+
+struct sk_buff *
+alloc_skb(unsigned int size, gfp_t gfp)
+{
+	struct sk_buff *skb = kzalloc(sizeof(struct sk_buff), gfp);
+	if (skb == NULL)
+		return NULL;
+
+	skb->head = kmalloc(size, gfp);
+	if (skb->head == NULL) {
+		kfree(skb);
+		return NULL;
+	}
+
+	skb->data = skb->tail = skb->head;
+	skb->end  = skb->head + size;
+	atomic_set(&skb->users, 1);
+	return skb;
+}
+
+
+struct sk_buff *
+skb_copy(const struct sk_buff *skb, gfp_t gfp)
+{
+	struct sk_buff *n = alloc_skb((unsigned int)(skb->end - skb->head), gfp);
+	if (n == NULL)
+		return NULL;
+
+	memcpy(n->head, skb->head, (size_t)(skb->end - skb->head));
+
+	n->dev		  = skb->dev;
+	n->tstamp	  = skb->tstamp;
+	n->len		  = skb->len;
+	n->mac_len	  = skb->mac_len;
+	n->queue_mapping  = skb->queue_mapping;
+	n->pkt_type	  = skb->pkt_type;
+	n->protocol	  = skb->protocol;
+	n->vlan_proto	  = skb->vlan_proto;
+	n->vlan_tci	  = skb->vlan_tci;
+	n->mac_header	  = skb->mac_header;
+	n->network_header = skb->network_header;
+	n->transport_header = skb->transport_header;
+	n->mark		  = skb->mark;
+	n->hash		  = skb->hash;
+	n->priority	  = skb->priority;
+	n->data		  = n->head + (skb->data - skb->head);
+	n->tail		  = n->head + (skb->tail - skb->head);
+
+	memcpy(n->cb, skb->cb, sizeof(skb->cb));
+	return n;
+}
+
+
+struct sk_buff *
+skb_clone(struct sk_buff *skb, gfp_t gfp)
+{
+	return skb_copy(skb, gfp);
+}
+
+
+void kfree_skb(struct sk_buff *skb)
+{
+	if (skb == NULL || !atomic_dec_and_test(&skb->users))
+		return;
+
+	kfree(skb->head);
+	kfree(skb);
+}
+
+
+int netif_receive_skb(struct sk_buff *skb)
+{
+	kfree_skb(skb);
+	return 0;
+}
@@ -0,0 +1,652 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+/*
+ * User-space shim of the kernel API used by pfq-lang and by the group
+ * fan-out: the headers in linux/, asm/ and net/ of this directory all
+ * resolve here (the uapi protocol headers are included first).
+ *
+ * The simulation is single threaded and runs on cpu 0: locks are no-ops
+ * and per-cpu data has a single instance.
+ */
+
+#ifndef __KCOMPAT__
+#define __KCOMPAT__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include <linux/types.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+/**** compiler ****/
+
+#define __force
+#define __bitwise
+#define __user
+#define __percpu
+#define __rcu
+#define __iomem
+#define __must_check
+#define __read_mostly
+#define __init
+#define __exit
+#ifndef __always_inline
+#define __always_inline		inline __attribute__((always_inline))
+#endif
+#define ____cacheline_aligned	__attribute__((aligned(64)))
+#define ____cacheline_aligned_in_smp ____cacheline_aligned
+#define __cacheline_aligned	____cacheline_aligned
+#define SMP_CACHE_BYTES		64
+#define L1_CACHE_BYTES		64
+
+#define likely(x)		__builtin_expect(!!(x),1)
+#define unlikely(x)		__builtin_expect(!!(x),0)
+
+#define barrier()		__asm__ volatile ("" ::: "memory")
+#define smp_mb()		__sync_synchronize()
+#define smp_rmb()		barrier()
+#define smp_wmb()		barrier()
+#define mb()			__sync_synchronize()
+#define rmb()			barrier()
+#define wmb()			barrier()
+#define cpu_relax()		barrier()
+
+#define ACCESS_ONCE(x)		(*(volatile typeof(x) *)&(x))
+#define READ_ONCE(x)		ACCESS_ONCE(x)
+#define WRITE_ONCE(x, v)	(ACCESS_ONCE(x) = (v))
+
+#define BUILD_BUG_ON(c)		((void)sizeof(char[1 - 2*!!(c)]))
+#define BUILD_BUG_ON_MSG(c, m)	BUILD_BUG_ON(c)
+#define BUG_ON(c)		do { if (c) abort(); } while(0)
+#define BUG()			abort()
+#define WARN_ON(c)		({ int __c = !!(c); if (__c) fprintf(stderr, "WARN_ON %s:%d\n", __FILE__, __LINE__); __c; })
+#define WARN_ON_ONCE(c)		WARN_ON(c)
+
+#define ARRAY_SIZE(a)		(sizeof(a)/sizeof((a)[0]))
+#define ALIGN(x, a)		(((x) + ((typeof(x))(a) - 1)) & ~((typeof(x))(a) - 1))
+
+#ifndef container_of
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
+
+#define min(x,y)		({ typeof(x) _x = (x); typeof(y) _y = (y); _x < _y ? _x : _y; })
+#define max(x,y)		({ typeof(x) _x = (x); typeof(y) _y = (y); _x > _y ? _x : _y; })
+#define min_t(t,x,y)		({ t _x = (x); t _y = (y); _x < _y ? _x : _y; })
+#define max_t(t,x,y)		({ t _x = (x); t _y = (y); _x > _y ? _x : _y; })
+#define clamp(v,lo,hi)		min(max(v, lo), hi)
+#define swap(a,b)		do { typeof(a) _t = (a); (a) = (b); (b) = _t; } while (0)
+#define DIV_ROUND_UP(n,d)	(((n) + (d) - 1) / (d))
+
+#define LINUX_VERSION_CODE	KERNEL_VERSION(4,1,0)
+#define KERNEL_VERSION(a,b,c)	(((a) << 16) + ((b) << 8) + (c))
+
+
+/**** types ****/
+
+typedef __u8  u8;
+typedef __u16 u16;
+typedef __u32 u32;
+typedef __u64 u64;
+typedef __s8  s8;
+typedef __s16 s16;
+typedef __s32 s32;
+typedef __s64 s64;
+
+/* as in the kernel: u64 is unsigned long long (see lang/maybe.h) */
+
+typedef __u8  uint8_t;
+typedef __u16 uint16_t;
+typedef __u32 uint32_t;
+typedef __u64 uint64_t;
+typedef unsigned long uintptr_t;
+
+#ifndef UINT32_MAX
+#define UINT32_MAX	(4294967295U)
+#endif
+
+typedef uint64_t cycles_t;
+typedef int64_t  ktime_t;
+typedef unsigned gfp_t;
+
+
+/**** module ****/
+
+#define MODULE_LICENSE(x)
+#define MODULE_AUTHOR(x)
+#define MODULE_DESCRIPTION(x)
+#define MODULE_VERSION(x)
+#define MODULE_PARM_DESC(x, y)
+#define EXPORT_SYMBOL(x)
+#define EXPORT_SYMBOL_GPL(x)
+#define module_param(n, t, p)
+#define module_param_array(n, t, c, p)
+#define module_init(x)
+#define module_exit(x)
+#define THIS_MODULE		NULL
+
+
+/**** printk ****/
+
+#define KERN_EMERG		""
+#define KERN_ALERT		""
+#define KERN_CRIT		""
+#define KERN_ERR		""
+#define KERN_WARNING		""
+#define KERN_NOTICE		""
+#define KERN_INFO		""
+#define KERN_DEBUG		""
+
+extern int sim_verbose;
+
+#define printk(...)		({ if (sim_verbose) fprintf(stderr, __VA_ARGS__); 0; })
+#define pr_devel(...)		({ if (sim_verbose > 1) fprintf(stderr, __VA_ARGS__); 0; })
+#define pr_info(...)		printk(__VA_ARGS__)
+#define pr_warn(...)		printk(__VA_ARGS__)
+#define pr_err(...)		printk(__VA_ARGS__)
+#define pr_debug(...)		pr_devel(__VA_ARGS__)
+#define printk_ratelimit()	0
+
+
+/**** memory ****/
+
+#define GFP_KERNEL		0u
+#define GFP_ATOMIC		1u
+#define __GFP_ZERO		2u
+
+static inline void *kmalloc(size_t size, gfp_t flags) { return (flags & __GFP_ZERO) ? calloc(1, size) : malloc(size); }
+static inline void *kzalloc(size_t size, gfp_t flags) { (void)flags; return calloc(1, size); }
+static inline void *kcalloc(size_t n, size_t size, gfp_t flags) { (void)flags; return calloc(n, size); }
+static inline void  kfree(const void *p) { free((void *)p); }
+static inline void *vmalloc(size_t size) { return malloc(size); }
+static inline void *vzalloc(size_t size) { return calloc(1, size); }
+static inline void  vfree(const void *p) { free((void *)p); }
+
+/* user memory is process memory: the descriptors are built in place */
+
+#define copy_from_user(to, from, n)	(memcpy((to), (from), (n)), 0)
+#define copy_to_user(to, from, n)	(memcpy((to), (from), (n)), 0)
+#define strlen_user(s)			(strlen(s) + 1)
+
+
+/**** atomic ****/
+
+typedef struct { int counter; } atomic_t;
+typedef struct { long counter; } atomic_long_t;
+typedef struct { long a; } local_t;
+
+#define ATOMIC_INIT(i)			{ (i) }
+#define atomic_read(v)			ACCESS_ONCE((v)->counter)
+#define atomic_set(v, i)		(ACCESS_ONCE((v)->counter) = (i))
+#define atomic_inc(v)			__sync_fetch_and_add(&(v)->counter, 1)
+#define atomic_dec(v)			__sync_fetch_and_sub(&(v)->counter, 1)
+#define atomic_dec_and_test(v)		(__sync_sub_and_fetch(&(v)->counter, 1) == 0)
+#define atomic_add(i, v)		__sync_fetch_and_add(&(v)->counter, (i))
+#define atomic_sub(i, v)		__sync_fetch_and_sub(&(v)->counter, (i))
+#define atomic_inc_return(v)		__sync_add_and_fetch(&(v)->counter, 1)
+#define atomic_add_return(i, v)		__sync_add_and_fetch(&(v)->counter, (i))
+#define atomic_cmpxchg(v, o, n)		__sync_val_compare_and_swap(&(v)->counter, (o), (n))
+
+#define atomic_long_read(v)		ACCESS_ONCE((v)->counter)
+#define atomic_long_set(v, i)		(ACCESS_ONCE((v)->counter) = (long)(i))
+#define atomic_long_inc(v)		__sync_fetch_and_add(&(v)->counter, 1)
+#define atomic_long_add(i, v)		__sync_fetch_and_add(&(v)->counter, (i))
+#define atomic_long_xchg(v, n)		__sync_lock_test_and_set(&(v)->counter, (long)(n))
+#define atomic_long_cmpxchg(v, o, n)	__sync_val_compare_and_swap(&(v)->counter, (long)(o), (long)(n))
+
+#define cmpxchg(p, o, n)		__sync_val_compare_and_swap((p), (o), (n))
+#define xchg(p, n)			__sync_lock_test_and_set((p), (n))
+
+#define local_read(l)			((l)->a)
+#define local_set(l, i)			((l)->a = (i))
+#define local_inc(l)			((l)->a++)
+#define local_dec(l)			((l)->a--)
+#define local_add(i, l)			((l)->a += (i))
+#define local_sub(i, l)			((l)->a -= (i))
+
+
+/**** per-cpu (a single cpu) ****/
+
+#define NR_CPUS				1
+#define nr_cpu_ids			1
+#define smp_processor_id()		0
+#define raw_smp_processor_id()		0
+#define get_cpu()			0
+#define put_cpu()			do {} while(0)
+#define num_online_cpus()		1
+#define num_possible_cpus()		1
+#define for_each_possible_cpu(cpu)	for((cpu) = 0; (cpu) < 1; (cpu)++)
+#define for_each_online_cpu(cpu)	for_each_possible_cpu(cpu)
+#define cpu_online(cpu)			((cpu) == 0)
+
+/* per-cpu structures are cache aligned */
+
+static inline void *__alloc_percpu(size_t size, size_t align)
+{
+	void *p = aligned_alloc(align, ALIGN(size, align));
+	if (p)
+		memset(p, 0, size);
+	return p;
+}
+
+#define alloc_percpu(type)		((type *)__alloc_percpu(sizeof(type), __alignof__(type)))
+#define free_percpu(p)			free(p)
+#define this_cpu_ptr(p)			(p)
+#define per_cpu_ptr(p, cpu)		((void)(cpu), (p))
+#define raw_cpu_ptr(p)			(p)
+#define __this_cpu_ptr(p)		(p)
+#define get_cpu_ptr(p)			(p)
+#define put_cpu_ptr(p)			do {} while(0)
+
+#define DEFINE_PER_CPU(type, name)	type name
+#define DECLARE_PER_CPU(type, name)	extern type name
+#define per_cpu(var, cpu)		((void)(cpu), (var))
+#define __get_cpu_var(var)		(var)
+#define this_cpu_read(var)		(var)
+#define this_cpu_write(var, v)		((var) = (v))
+#define this_cpu_inc(var)		((var)++)
+#define this_cpu_add(var, v)		((var) += (v))
+#define __this_cpu_inc(var)		((var)++)
+#define __this_cpu_add(var, v)		((var) += (v))
+
+#define local_bh_disable()		do {} while(0)
+#define local_bh_enable()		do {} while(0)
+#define preempt_disable()		do {} while(0)
+#define preempt_enable()		do {} while(0)
+#define in_interrupt()			0
+#define in_softirq()			0
+#define rcu_read_lock()			do {} while(0)
+#define rcu_read_unlock()		do {} while(0)
+#define synchronize_net()		do {} while(0)
+#define synchronize_rcu()		do {} while(0)
+#define msleep(ms)			do {} while(0)
+
+
+/**** locks (single threaded) ****/
+
+typedef struct { int dummy; } spinlock_t;
+typedef struct { int dummy; } rwlock_t;
+typedef struct { unsigned sequence; } seqcount_t;
+typedef struct { unsigned sequence; } seqlock_t;
+struct semaphore { int count; };
+struct rw_semaphore { int count; };
+struct mutex { int dummy; };
+
+#define __SPIN_LOCK_UNLOCKED(x)		{ 0 }
+#define DEFINE_SPINLOCK(x)		spinlock_t x = { 0 }
+#define spin_lock_init(l)		do { (void)(l); } while(0)
+#define spin_lock(l)			do { (void)(l); } while(0)
+#define spin_unlock(l)			do { (void)(l); } while(0)
+#define spin_lock_bh(l)			do { (void)(l); } while(0)
+#define spin_unlock_bh(l)		do { (void)(l); } while(0)
+#define spin_lock_irqsave(l, f)		do { (void)(l); (f) = 0; } while(0)
+#define spin_unlock_irqrestore(l, f)	do { (void)(l); (void)(f); } while(0)
+
+#define seqlock_init(l)			((l)->sequence = 0)
+#define seqcount_init(s)		((s)->sequence = 0)
+#define read_seqbegin(l)		((l)->sequence)
+#define read_seqretry(l, s)		((l)->sequence != (s))
+#define write_seqlock(l)		((l)->sequence++)
+#define write_sequnlock(l)		((l)->sequence++)
+#define read_seqcount_begin(s)		((s)->sequence)
+#define read_seqcount_retry(s, v)	((s)->sequence != (v))
+#define write_seqcount_begin(s)		((s)->sequence++)
+#define write_seqcount_end(s)		((s)->sequence++)
+#define raw_write_seqcount_begin(s)	write_seqcount_begin(s)
+#define raw_write_seqcount_end(s)	write_seqcount_end(s)
+
+#define DEFINE_SEMAPHORE(x)		struct semaphore x = { 1 }
+#define sema_init(s, n)			((s)->count = (n))
+#define down(s)				do { (void)(s); } while(0)
+#define down_interruptible(s)		((void)(s), 0)
+#define up(s)				do { (void)(s); } while(0)
+
+#define DECLARE_RWSEM(x)		struct rw_semaphore x = { 0 }
+#define down_read(s)			do { (void)(s); } while(0)
+#define up_read(s)			do { (void)(s); } while(0)
+#define down_write(s)			do { (void)(s); } while(0)
+#define up_write(s)			do { (void)(s); } while(0)
+
+#define DEFINE_MUTEX(x)			struct mutex x = { 0 }
+#define mutex_init(m)			do { (void)(m); } while(0)
+#define mutex_lock(m)			do { (void)(m); } while(0)
+#define mutex_unlock(m)			do { (void)(m); } while(0)
+
+
+/**** list ****/
+
+struct list_head
+{
+	struct list_head *next, *prev;
+};
+
+#define LIST_HEAD_INIT(name)	{ &(name), &(name) }
+#define LIST_HEAD(name)		struct list_head name = LIST_HEAD_INIT(name)
+
+static inline void INIT_LIST_HEAD(struct list_head *list)
+{
+	list->next = list;
+	list->prev = list;
+}
+
+static inline void __list_add(struct list_head *n, struct list_head *prev, struct list_head *next)
+{
+	next->prev = n;
+	n->next = next;
+	n->prev = prev;
+	prev->next = n;
+}
+
+static inline void list_add(struct list_head *n, struct list_head *head)
+{
+	__list_add(n, head, head->next);
+}
+
+static inline void list_add_tail(struct list_head *n, struct list_head *head)
+{
+	__list_add(n, head->prev, head);
+}
+
+static inline void list_del(struct list_head *entry)
+{
+	entry->next->prev = entry->prev;
+	entry->prev->next = entry->next;
+	entry->next = entry->prev = NULL;
+}
+
+static inline int list_empty(const struct list_head *head)
+{
+	return head->next == head;
+}
+
+#define list_entry(ptr, type, member)	container_of(ptr, type, member)
+#define list_for_each(pos, head)	for (pos = (head)->next; pos != (head); pos = pos->next)
+#define list_for_each_safe(pos, n, head) \
+	for (pos = (head)->next, n = pos->next; pos != (head); pos = n, n = pos->next)
+
+
+/**** bitops ****/
+
+#define BITS_PER_LONG		__BITS_PER_LONG
+#define BITS_PER_BYTE		8
+#define BIT(n)			(1UL << (n))
+#define BITS_TO_LONGS(n)	(((n) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define DECLARE_BITMAP(name, bits) unsigned long name[BITS_TO_LONGS(bits)]
+
+static inline int test_bit(long nr, const volatile unsigned long *addr)
+{
+	return 1UL & (addr[nr / BITS_PER_LONG] >> (nr % BITS_PER_LONG));
+}
+
+static inline void set_bit(long nr, volatile unsigned long *addr)
+{
+	addr[nr / BITS_PER_LONG] |= 1UL << (nr % BITS_PER_LONG);
+}
+
+static inline void clear_bit(long nr, volatile unsigned long *addr)
+{
+	addr[nr / BITS_PER_LONG] &= ~(1UL << (nr % BITS_PER_LONG));
+}
+
+static inline int test_and_set_bit(long nr, volatile unsigned long *addr)
+{
+	int old = test_bit(nr, addr);
+	set_bit(nr, addr);
+	return old;
+}
+
+#define __set_bit(nr, addr)	set_bit(nr, addr)
+#define __test_and_set_bit(nr, addr) test_and_set_bit(nr, addr)
+#define __clear_bit(nr, addr)	clear_bit(nr, addr)
+
+static inline void bitmap_zero(unsigned long *dst, long nbits)
+{
+	memset(dst, 0, BITS_TO_LONGS(nbits) * sizeof(long));
+}
+
+#define hweight8(w)		__builtin_popcount((u8)(w))
+#define hweight16(w)		__builtin_popcount((u16)(w))
+#define hweight32(w)		__builtin_popcount((u32)(w))
+#define hweight64(w)		__builtin_popcountll((u64)(w))
+#define hweight_long(w)		__builtin_popcountl((unsigned long)(w))
+#define __ffs(w)		((unsigned long)__builtin_ctzl(w))
+#define __fls(w)		((unsigned long)(BITS_PER_LONG - 1 - __builtin_clzl(w)))
+#define fls(x)			((x) ? 32 - __builtin_clz(x) : 0)
+#define fls64(x)		((x) ? 64 - __builtin_clzll(x) : 0)
+#define ilog2(n)		((n) ? 63 - __builtin_clzll(n) : -1)
+#define is_power_of_2(n)	((n) != 0 && (((n) & ((n) - 1)) == 0))
+#define roundup_pow_of_two(n)	((n) <= 1 ? 1UL : 1UL << (64 - __builtin_clzl((unsigned long)(n) - 1)))
+#define rounddown_pow_of_two(n)	(1UL << ilog2(n))
+
+/* the swap function is unused: qsort moves the elements itself */
+
+static inline void sort(void *base, size_t num, size_t size,
+			int (*cmp)(const void *, const void *),
+			void (*swap)(void *, void *, int))
+{
+	(void)swap;
+	qsort(base, num, size, cmp);
+}
+
+#define swab16(x)		__builtin_bswap16(x)
+#define swab32(x)		__builtin_bswap32(x)
+#define swab64(x)		__builtin_bswap64(x)
+
+#define rol32(w, s)		(((u32)(w) << (s)) | ((u32)(w) >> ((-(s)) & 31)))
+
+
+/**** byte order ****/
+
+#define htons(x)		__builtin_bswap16(x)
+#define ntohs(x)		__builtin_bswap16(x)
+#define htonl(x)		__builtin_bswap32(x)
+#define ntohl(x)		__builtin_bswap32(x)
+
+#define cpu_to_be16(x)		htons(x)
+#define cpu_to_be32(x)		htonl(x)
+#define be16_to_cpu(x)		ntohs(x)
+#define be32_to_cpu(x)		ntohl(x)
+#define cpu_to_be64(x)		__builtin_bswap64(x)
+#define be64_to_cpu(x)		__builtin_bswap64(x)
+#define get_unaligned(p)	({ const struct { typeof(*(p)) v; } __attribute__((packed)) *__p = (const void *)(p); __p->v; })
+#define get_unaligned_be16(p)	ntohs(get_unaligned((const u16 *)(p)))
+#define get_unaligned_be32(p)	ntohl(get_unaligned((const u32 *)(p)))
+
+
+/**** time ****/
+
+#define HZ			1000
+
+extern unsigned long jiffies;
+
+#define time_after(a, b)	((long)((b) - (a)) < 0)
+#define time_before(a, b)	time_after(b, a)
+#define msecs_to_jiffies(m)	((unsigned long)(m))
+#define jiffies_to_msecs(j)	((unsigned int)(j))
+#define NSEC_PER_SEC		1000000000L
+#define NSEC_PER_USEC		1000L
+#define NSEC_PER_MSEC		1000000L
+#define USEC_PER_SEC		1000000L
+
+extern ktime_t sim_ktime;
+
+static inline ktime_t ktime_get(void)		{ return sim_ktime; }
+static inline ktime_t ktime_get_real(void)	{ return sim_ktime; }
+static inline u64 ktime_get_ns(void)		{ return (u64)sim_ktime; }
+static inline s64 ktime_to_ns(ktime_t t)	{ return t; }
+static inline s64 ktime_to_us(ktime_t t)	{ return t / 1000; }
+static inline ktime_t ns_to_ktime(u64 ns)	{ return (ktime_t)ns; }
+static inline u64 sched_clock(void)		{ return (u64)sim_ktime; }
+static inline u64 local_clock(void)		{ return (u64)sim_ktime; }
+
+static inline cycles_t get_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+
+/**** random ****/
+
+extern u32 prandom_u32(void);
+extern void get_random_bytes(void *buf, int nbytes);
+
+#define prandom_u32_max(n)	((u32)(((u64)prandom_u32() * (n)) >> 32))
+
+
+/**** hashes ****/
+
+#define GOLDEN_RATIO_32		0x61C88647
+#define GOLDEN_RATIO_64		0x61C8864680B583EBull
+
+static inline u32 hash_32(u32 val, unsigned int bits)
+{
+	return (val * GOLDEN_RATIO_32) >> (32 - bits);
+}
+
+static inline u32 hash_64(u64 val, unsigned int bits)
+{
+	return (u32)((val * GOLDEN_RATIO_64) >> (64 - bits));
+}
+
+#define hash_long(val, bits)	hash_64(val, bits)
+#define hash_ptr(ptr, bits)	hash_long((unsigned long)(ptr), bits)
+
+#define JHASH_INITVAL		0xdeadbeef
+
+#define __jhash_mix(a, b, c)			\
+{						\
+	a -= c;  a ^= rol32(c, 4);  c += b;	\
+	b -= a;  b ^= rol32(a, 6);  a += c;	\
+	c -= b;  c ^= rol32(b, 8);  b += a;	\
+	a -= c;  a ^= rol32(c, 16); c += b;	\
+	b -= a;  b ^= rol32(a, 19); a += c;	\
+	c -= b;  c ^= rol32(b, 4);  b += a;	\
+}
+
+#define __jhash_final(a, b, c)			\
+{						\
+	c ^= b; c -= rol32(b, 14);		\
+	a ^= c; a -= rol32(c, 11);		\
+	b ^= a; b -= rol32(a, 25);		\
+	c ^= b; c -= rol32(b, 16);		\
+	a ^= c; a -= rol32(c, 4);		\
+	b ^= a; b -= rol32(a, 14);		\
+	c ^= b; c -= rol32(b, 24);		\
+}
+
+static inline u32 jhash(const void *key, u32 length, u32 initval)
+{
+	u32 a, b, c;
+	const u8 *k = key;
+
+	a = b = c = JHASH_INITVAL + length + initval;
+
+	while (length > 12) {
+		a += get_unaligned((const u32 *)k);
+		b += get_unaligned((const u32 *)(k + 4));
+		c += get_unaligned((const u32 *)(k + 8));
+		__jhash_mix(a, b, c);
+		length -= 12;
+		k += 12;
+	}
+
+	switch (length) {
+	case 12: c += (u32)k[11]<<24;
+	case 11: c += (u32)k[10]<<16;
+	case 10: c += (u32)k[9]<<8;
+	case 9:  c += k[8];
+	case 8:  b += (u32)k[7]<<24;
+	case 7:  b += (u32)k[6]<<16;
+	case 6:  b += (u32)k[5]<<8;
+	case 5:  b += k[4];
+	case 4:  a += (u32)k[3]<<24;
+	case 3:  a += (u32)k[2]<<16;
+	case 2:  a += (u32)k[1]<<8;
+	case 1:  a += k[0];
+		 __jhash_final(a, b, c);
+	case 0:
+		 break;
+	}
+
+	return c;
+}
+
+static inline u32 __jhash_nwords(u32 a, u32 b, u32 c, u32 initval)
+{
+	a += initval;
+	b += initval;
+	c += initval;
+	__jhash_final(a, b, c);
+	return c;
+}
+
+static inline u32 jhash_3words(u32 a, u32 b, u32 c, u32 initval)
+{
+	return __jhash_nwords(a, b, c, initval + JHASH_INITVAL + (3 << 2));
+}
+
+static inline u32 jhash_2words(u32 a, u32 b, u32 initval)
+{
+	return __jhash_nwords(a, b, 0, initval + JHASH_INITVAL + (2 << 2));
+}
+
+static inline u32 jhash_1word(u32 a, u32 initval)
+{
+	return __jhash_nwords(a, 0, 0, initval + JHASH_INITVAL + (1 << 2));
+}
+
+extern u16 crc16(u16 crc, const u8 *buffer, size_t len);
+
+
+
+
+/**** error pointers ****/
+
+#define MAX_ERRNO		4095
+#define IS_ERR_VALUE(x)		unlikely((unsigned long)(void *)(x) >= (unsigned long)-MAX_ERRNO)
+
+static inline void *ERR_PTR(long error) { return (void *) error; }
+static inline long PTR_ERR(const void *ptr) { return (long) ptr; }
+static inline bool IS_ERR(const void *ptr) { return IS_ERR_VALUE((unsigned long)ptr); }
+static inline bool IS_ERR_OR_NULL(const void *ptr) { return !ptr || IS_ERR_VALUE((unsigned long)ptr); }
+
+
+#include <kcompat-net.h>
+
+#endif /* __KCOMPAT__ */
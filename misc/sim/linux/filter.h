@@ -0,0 +1,2 @@
+#include_next <linux/filter.h>
+#include <kcompat.h>
@@ -0,0 +1,2 @@
+#include_next <linux/icmp.h>
+#include <kcompat.h>
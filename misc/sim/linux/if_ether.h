@@ -0,0 +1,2 @@
+#include_next <linux/if_ether.h>
+#include <kcompat.h>
@@ -0,0 +1,2 @@
+#include_next <linux/ip.h>
+#include <kcompat.h>
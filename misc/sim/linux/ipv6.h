@@ -0,0 +1,2 @@
+#include_next <linux/ipv6.h>
+#include <kcompat.h>
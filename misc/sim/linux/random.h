@@ -0,0 +1 @@
+#include <kcompat.h>
@@ -0,0 +1,2 @@
+#include_next <linux/swab.h>
+#include <kcompat.h>
@@ -0,0 +1,2 @@
+#include_next <linux/tcp.h>
+#include <kcompat.h>
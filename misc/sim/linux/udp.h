@@ -0,0 +1,2 @@
+#include_next <linux/udp.h>
+#include <kcompat.h>
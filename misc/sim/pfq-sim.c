@@ -0,0 +1,332 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+/*
+ * pfq-sim: replay pcap files through the simulated Rx path and report
+ * the cycles per packet of each computation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <linux/pf_q.h>
+
+#include "sim.h"
+
+
+#define SIM_MAX_FUNCTIONS	32
+#define SIM_MAX_SOCKETS		32
+
+
+/* classic pcap files, Ethernet only */
+
+struct pcap_file_header
+{
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t  thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t linktype;
+};
+
+struct pcap_record_header
+{
+	uint32_t ts_sec;
+	uint32_t ts_frac;
+	uint32_t caplen;
+	uint32_t len;
+};
+
+struct packet
+{
+	long long tstamp;	/* ns */
+	uint32_t  caplen;
+	unsigned char *data;
+};
+
+static struct packet *packets;
+static size_t packets_num, packets_cap;
+
+
+static uint32_t swap32(uint32_t x, int swapped)
+{
+	return swapped ? __builtin_bswap32(x) : x;
+}
+
+
+static int
+load_pcap(const char *name)
+{
+	struct pcap_file_header hdr;
+	struct pcap_record_header rec;
+	long long frac_ns;
+	int swapped;
+	FILE *f;
+
+	f = fopen(name, "rb");
+	if (f == NULL) {
+		fprintf(stderr, "pfq-sim: %s: %s\n", name, strerror(errno));
+		return -1;
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1)
+		goto bad;
+
+	switch(hdr.magic)
+	{
+	case 0xa1b2c3d4: swapped = 0; frac_ns = 1000; break;
+	case 0xd4c3b2a1: swapped = 1; frac_ns = 1000; break;
+	case 0xa1b23c4d: swapped = 0; frac_ns = 1; break;
+	case 0x4d3cb2a1: swapped = 1; frac_ns = 1; break;
+	default: goto bad;
+	}
+
+	if (swap32(hdr.linktype, swapped) != 1) {
+		fprintf(stderr, "pfq-sim: %s: not an Ethernet capture!\n", name);
+		fclose(f);
+		return -1;
+	}
+
+	while (fread(&rec, sizeof(rec), 1, f) == 1)
+	{
+		struct packet *p;
+		uint32_t caplen = swap32(rec.caplen, swapped);
+
+		if (caplen > 262144)
+			goto bad;
+
+		if (packets_num == packets_cap) {
+			packets_cap = packets_cap ? packets_cap * 2 : 4096;
+			packets = realloc(packets, packets_cap * sizeof(struct packet));
+			if (packets == NULL) {
+				fprintf(stderr, "pfq-sim: out of memory!\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		p = &packets[packets_num];
+		p->tstamp = (long long)swap32(rec.ts_sec, swapped) * 1000000000LL +
+			    (long long)swap32(rec.ts_frac, swapped) * frac_ns;
+		p->caplen = caplen;
+		p->data = malloc(caplen);
+
+		if (p->data == NULL || fread(p->data, 1, caplen, f) != caplen) {
+			free(p->data);
+			goto bad;
+		}
+
+		packets_num++;
+	}
+
+	fclose(f);
+	return 0;
+bad:
+	fprintf(stderr, "pfq-sim: %s: bad pcap file!\n", name);
+	fclose(f);
+	return -1;
+}
+
+
+/* options */
+
+static const char *functions[SIM_MAX_FUNCTIONS];
+static int functions_num;
+
+static int weights[SIM_MAX_SOCKETS];
+static int sockets_num = 1;
+
+static size_t batch_len = 64;
+static int loops = 1;
+
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-h] [-v] [-e] [-b BATCH] [-s SOCKETS] [-w W0,W1,...] [-n LOOPS] -f FUNCTION... PCAP...\n\n"
+		"  -f FUNCTION   computation of the group, e.g. 'ip >-> steer_flow' (repeatable, 'none' = no computation)\n"
+		"  -b BATCH      Rx batch length (default 64, max %d)\n"
+		"  -s SOCKETS    sockets joining the group (default 1)\n"
+		"  -w WEIGHTS    steering weights of the sockets (default 1)\n"
+		"  -n LOOPS      replay the capture LOOPS times (default 1)\n"
+		"  -e            measure the pfq-lang engine alone as well (adds the timer to the fan-out)\n"
+		"  -v            verbose (repeat for the kernel debug messages)\n",
+		name, SIM_BATCH_MAX);
+}
+
+
+static int
+parse_weights(char *arg)
+{
+	char *tok;
+	int n = 0;
+
+	for(tok = strtok(arg, ","); tok; tok = strtok(NULL, ","))
+	{
+		if (n == SIM_MAX_SOCKETS)
+			return -1;
+		weights[n] = atoi(tok);
+		if (weights[n] < 1)
+			return -1;
+		n++;
+	}
+
+	return 0;
+}
+
+
+/* replay the capture through a single group, bound to the capture device */
+
+static int
+run(const char *function)
+{
+	struct sim_group_stats gs;
+	struct sim_profile prof;
+	long long offset = 0, duration;
+	int ifindex, n, l;
+	size_t i;
+
+	if (sim_init(batch_len) < 0) {
+		fprintf(stderr, "pfq-sim: could not initialize the simulation!\n");
+		return -1;
+	}
+
+	ifindex = sim_device("sim0");
+
+	for(n = 0; n < sockets_num; n++)
+	{
+		int id = sim_open(weights[n]);
+		if (id < 0 || sim_join(id, 0, Q_CLASS_DEFAULT) < 0) {
+			fprintf(stderr, "pfq-sim: could not join the group!\n");
+			goto err;
+		}
+	}
+
+	sim_bind(0, ifindex, Q_ANY_QUEUE);
+
+	if (strcmp(function, "none") != 0 && sim_set_computation(0, function) < 0) {
+		fprintf(stderr, "pfq-sim: '%s': invalid computation!\n", function);
+		goto err;
+	}
+
+	/* successive loops keep the time going forward */
+
+	duration = packets[packets_num-1].tstamp - packets[0].tstamp + 1000000000LL;
+
+	sim_reset_profile();
+
+	for(l = 0; l < loops; l++, offset += duration)
+	{
+		for(i = 0; i < packets_num; i++)
+			sim_receive(packets[i].data, packets[i].caplen, ifindex, 0, packets[i].tstamp + offset);
+	}
+
+	sim_flush();
+
+	sim_get_profile(&prof);
+	sim_get_group_stats(0, &gs);
+
+	printf("'%s': %llu packets, batch %zu, %d sockets\n", function, prof.packets, batch_len, sockets_num);
+	printf("  fan-out : %.1f cycles/packet\n", prof.packets ? (double)prof.cycles / (double)prof.packets : 0.0);
+	if (sim_lang_profile)
+		printf("  engine  : %.1f cycles/packet\n", prof.packets ? (double)prof.lang_cycles / (double)prof.packets : 0.0);
+	printf("  group 0 : recv %lu drop %lu frwd %lu kern %lu\n", gs.recv, gs.drop, gs.frwd, gs.kern);
+
+	for(n = 0; n < sockets_num; n++)
+		printf("  socket %d: %lu (weight %d)\n", n, sim_sock_recv(n), weights[n]);
+
+	for(n = ifindex + 1; sim_device_tx(n) != 0; n++)
+		printf("  device %d: tx %lu\n", n, sim_device_tx(n));
+
+	sim_fini();
+	return 0;
+err:
+	sim_fini();
+	return -1;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	int opt, ret = 0, n;
+
+	for(n = 0; n < SIM_MAX_SOCKETS; n++)
+		weights[n] = 1;
+
+	while ((opt = getopt(argc, argv, "hvef:b:s:w:n:")) != -1)
+	{
+		switch(opt)
+		{
+		case 'v': sim_verbose++; break;
+		case 'e': sim_lang_profile = 1; break;
+		case 'f':
+			if (functions_num == SIM_MAX_FUNCTIONS) {
+				fprintf(stderr, "pfq-sim: too many functions!\n");
+				return EXIT_FAILURE;
+			}
+			functions[functions_num++] = optarg;
+			break;
+		case 'b': batch_len = (size_t)atoi(optarg); break;
+		case 's': sockets_num = atoi(optarg); break;
+		case 'w':
+			if (parse_weights(optarg) < 0) {
+				fprintf(stderr, "pfq-sim: bad weights!\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'n': loops = atoi(optarg); break;
+		case 'h': usage(argv[0]); return EXIT_SUCCESS;
+		default:  usage(argv[0]); return EXIT_FAILURE;
+		}
+	}
+
+	if (functions_num == 0 || optind == argc ||
+	    sockets_num < 1 || sockets_num > SIM_MAX_SOCKETS || loops < 1) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for(n = optind; n < argc; n++)
+	{
+		if (load_pcap(argv[n]) < 0)
+			return EXIT_FAILURE;
+	}
+
+	if (packets_num == 0) {
+		fprintf(stderr, "pfq-sim: no packets!\n");
+		return EXIT_FAILURE;
+	}
+
+	for(n = 0; n < functions_num; n++)
+	{
+		if (run(functions[n]) < 0)
+			ret = EXIT_FAILURE;
+	}
+
+	return ret;
+}
@@ -0,0 +1,469 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+#include <kcompat.h>
+
+#include <lang/engine.h>
+#include <lang/symtable.h>
+#include <lang/signature.h>
+#include <lang/string-view.h>
+
+#include <sim-lang.h>
+
+
+/* the descriptor, followed by the memory of the arguments */
+
+struct sim_lang_parser
+{
+	const char *prog;
+	const char *cur;
+
+	struct pfq_lang_computation_descr *descr;
+	size_t max_fun;
+
+	char  *pool;
+	size_t pool_len;
+	size_t pool_size;
+};
+
+
+static int
+parse_error(struct sim_lang_parser *p, const char *what)
+{
+	fprintf(stderr, "pfq-sim: %s at column %zu: '%s'\n", what,
+		(size_t)(p->cur - p->prog) + 1, p->prog);
+	return -1;
+}
+
+
+static void *
+pool_alloc(struct sim_lang_parser *p, size_t size)
+{
+	size_t off = ALIGN(p->pool_len, 8);
+	if (off + size > p->pool_size)
+		return NULL;
+	p->pool_len = off + size;
+	return p->pool + off;
+}
+
+
+static void
+skip_space(struct sim_lang_parser *p)
+{
+	while (isspace(*p->cur))
+		p->cur++;
+}
+
+
+static bool
+parse_accept(struct sim_lang_parser *p, const char *tok)
+{
+	size_t len = strlen(tok);
+	skip_space(p);
+	if (strncmp(p->cur, tok, len) != 0)
+		return false;
+	p->cur += len;
+	return true;
+}
+
+
+/* identifiers, bare strings and numbers */
+
+static size_t
+word_length(const char *s)
+{
+	size_t n = 0;
+	while (s[n] && !isspace(s[n]) && !strchr("()[],\"", s[n]))
+		n++;
+	return n;
+}
+
+
+/* strings are not aligned: consecutive ones are contiguous in the pool */
+
+static char *
+parse_string(struct sim_lang_parser *p, const char *term)
+{
+	const char *begin;
+	size_t len;
+	char *str;
+
+	skip_space(p);
+
+	if (*p->cur == '"') {
+		begin = ++p->cur;
+		while (*p->cur && *p->cur != '"')
+			p->cur++;
+		if (*p->cur != '"')
+			return NULL;
+		len = (size_t)(p->cur++ - begin);
+	}
+	else {
+		begin = p->cur;
+		len = word_length(begin);
+		if (len == 0 || strchr(term, *begin))
+			return NULL;
+		p->cur += len;
+	}
+
+	if (p->pool_len + len + 1 > p->pool_size)
+		return NULL;
+
+	str = p->pool + p->pool_len;
+	p->pool_len += len + 1;
+
+	memcpy(str, begin, len);
+	str[len] = '\0';
+	return str;
+}
+
+
+static int
+parse_number(struct sim_lang_parser *p, size_t size, void *value)
+{
+	unsigned int a, b, c, d;
+	unsigned long long n;
+	char buffer[32], *end;
+	size_t len;
+
+	skip_space(p);
+
+	len = word_length(p->cur);
+	if (len == 0 || len >= sizeof(buffer))
+		return -1;
+
+	memcpy(buffer, p->cur, len);
+	buffer[len] = '\0';
+
+	/* IPv4 addresses are in network byte order */
+
+	if (size == 4 && strchr(buffer, '.')) {
+		char tail;
+		if (sscanf(buffer, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4 ||
+		    a > 255 || b > 255 || c > 255 || d > 255)
+			return -1;
+		((u8 *)value)[0] = (u8)a;
+		((u8 *)value)[1] = (u8)b;
+		((u8 *)value)[2] = (u8)c;
+		((u8 *)value)[3] = (u8)d;
+		p->cur += len;
+		return 0;
+	}
+
+	n = buffer[0] == '-' ? (unsigned long long)strtoll(buffer, &end, 0) : strtoull(buffer, &end, 0);
+	if (*end != '\0')
+		return -1;
+
+	memcpy(value, &n, size);	/* little endian */
+	p->cur += len;
+	return 0;
+}
+
+
+static int parse_comp(struct sim_lang_parser *p, bool top);
+static int parse_term(struct sim_lang_parser *p);
+
+
+static int
+parse_arg(struct sim_lang_parser *p, struct pfq_lang_functional_arg_descr *arg, string_view_t type)
+{
+	ptrdiff_t size;
+
+	skip_space(p);
+
+	/* function */
+
+	if (pfq_lang_signature_is_function(type)) {
+		int index;
+
+		if (parse_accept(p, "(")) {
+			index = parse_comp(p, false);
+			if (index < 0)
+				return -1;
+			if (!parse_accept(p, ")"))
+				return parse_error(p, "')' expected");
+		}
+		else {
+			index = parse_term(p);
+			if (index < 0)
+				return -1;
+		}
+
+		arg->addr  = NULL;
+		arg->size  = (size_t)index;
+		arg->nelem = ~0ULL;
+		return 0;
+	}
+
+	/* String */
+
+	if (string_view_compare(type, "String") == 0) {
+		char *str = parse_string(p, "");
+		if (str == NULL)
+			return parse_error(p, "string expected");
+
+		arg->addr  = str;
+		arg->size  = 0;
+		arg->nelem = 0;
+		return 0;
+	}
+
+	/* [String]: the strings are separated by RS */
+
+	if (string_view_compare(type, "[String]") == 0) {
+		char *first = NULL;
+		size_t nelem = 0;
+
+		if (!parse_accept(p, "["))
+			return parse_error(p, "'[' expected");
+
+		do {
+			char *str = parse_string(p, "]");
+			if (str == NULL)
+				return parse_error(p, "string expected");
+			if (first)
+				str[-1] = '\x1e';
+			else
+				first = str;
+			nelem++;
+		}
+		while (parse_accept(p, ","));
+
+		if (!parse_accept(p, "]"))
+			return parse_error(p, "']' expected");
+
+		arg->addr  = first;
+		arg->size  = 0;
+		arg->nelem = nelem;
+		return 0;
+	}
+
+	/* vector of pods */
+
+	if (string_view_at(type, 0) == '[') {
+		size_t nelem = 0;
+		char *data;
+
+		size = pfq_lang_signature_sizeof(pfq_lang_signature_remove_extent(type));
+		if (size <= 0 || size > 8)
+			return parse_error(p, "unsupported vector type");
+
+		if (!parse_accept(p, "["))
+			return parse_error(p, "'[' expected");
+
+		data = pool_alloc(p, 0);
+		skip_space(p);
+
+		if (*p->cur != ']') {
+			do {
+				void *elem = pool_alloc(p, (size_t)size);
+				if (elem == NULL)
+					return parse_error(p, "computation too large");
+
+				if (parse_number(p, (size_t)size, elem) < 0)
+					return parse_error(p, "number expected");
+				nelem++;
+			}
+			while (parse_accept(p, ","));
+		}
+
+		if (!parse_accept(p, "]"))
+			return parse_error(p, "']' expected");
+
+		arg->addr  = data;
+		arg->size  = (size_t)size;
+		arg->nelem = nelem;
+		return 0;
+	}
+
+	/* pod */
+
+	size = pfq_lang_signature_sizeof(type);
+	if (size > 0 && size <= 8) {
+		void *value = pool_alloc(p, 8);
+		if (value == NULL)
+			return parse_error(p, "computation too large");
+
+		memset(value, 0, 8);
+
+		if (parse_number(p, (size_t)size, value) < 0)
+			return parse_error(p, "number expected");
+
+		arg->addr  = value;
+		arg->size  = (size_t)size;
+		arg->nelem = ~0ULL;
+		return 0;
+	}
+
+	return parse_error(p, "unsupported argument type");
+}
+
+
+static int
+parse_term(struct sim_lang_parser *p)
+{
+	struct pfq_lang_functional_descr *fun;
+	struct symtable_entry *entry;
+	char symbol[Q_FUN_SYMB_LEN];
+	size_t len;
+	int index, i;
+
+	skip_space(p);
+
+	len = word_length(p->cur);
+	if (len == 0)
+		return parse_error(p, "function expected");
+	if (len >= Q_FUN_SYMB_LEN)
+		return parse_error(p, "symbol too long");
+
+	memcpy(symbol, p->cur, len);
+	symbol[len] = '\0';
+
+	entry = pfq_lang_symtable_search(&pfq_lang_functions, symbol);
+	if (entry == NULL)
+		return parse_error(p, "unknown function");
+
+	if (p->descr->size == p->max_fun)
+		return parse_error(p, "computation too large");
+
+	index = (int)p->descr->size++;
+	fun = &p->descr->fun[index];
+
+	fun->symbol = entry->symbol;
+	fun->next = -1;
+	p->cur += len;
+
+	for(i = 0; i < (int)(sizeof(fun->arg)/sizeof(fun->arg[0])); i++)
+	{
+		string_view_t type = pfq_lang_signature_arg(make_string_view(entry->signature), i);
+		if (string_view_compare(type, "SkBuff") == 0)
+			break;
+
+		if (parse_arg(p, &fun->arg[i], type) < 0)
+			return -1;
+	}
+
+	return index;
+}
+
+
+static bool
+is_monadic(struct pfq_lang_functional_descr const *fun)
+{
+	struct symtable_entry *entry = pfq_lang_symtable_search(&pfq_lang_functions, fun->symbol);
+	size_t nargs = pfq_lang_number_of_arguments(fun);
+
+	return pfq_lang_signature_equal(pfq_lang_signature_bind(make_string_view(entry->signature), (int)nargs),
+					make_string_view("SkBuff -> Action SkBuff"));
+}
+
+
+/*
+ * A composition links each monadic function to the next one; the last
+ * function of the top level composition links past the end (as the
+ * C++ serializer does), the last of a nested one has no successor.
+ */
+
+static int
+parse_comp(struct sim_lang_parser *p, bool top)
+{
+	int first, prev;
+
+	first = prev = parse_term(p);
+	if (first < 0)
+		return -1;
+
+	while (parse_accept(p, ">->"))
+	{
+		int next;
+
+		if (!is_monadic(&p->descr->fun[prev]))
+			return parse_error(p, "monadic function expected before '>->'");
+
+		next = parse_term(p);
+		if (next < 0)
+			return -1;
+
+		if (!is_monadic(&p->descr->fun[next]))
+			return parse_error(p, "monadic function expected after '>->'");
+
+		p->descr->fun[prev].next = next;
+		prev = next;
+	}
+
+	if (top && is_monadic(&p->descr->fun[prev]))
+		p->descr->fun[prev].next = (ptrdiff_t)p->max_fun;
+
+	return first;
+}
+
+
+struct pfq_lang_computation_descr *
+sim_lang_parse(const char *prog)
+{
+	struct sim_lang_parser p;
+	size_t len = strlen(prog), size, n;
+
+	p.prog = p.cur = prog;
+	p.max_fun = len / 2 + 1;
+	p.pool_size = 16 * (len + 1);
+	p.pool_len = 0;
+
+	size = sizeof(struct pfq_lang_computation_descr) +
+	       sizeof(struct pfq_lang_functional_descr) * p.max_fun;
+
+	p.descr = kzalloc(size + p.pool_size, GFP_KERNEL);
+	if (p.descr == NULL)
+		return NULL;
+
+	p.pool = (char *)p.descr + size;
+
+	if (parse_comp(&p, true) < 0)
+		goto err;
+
+	skip_space(&p);
+	if (*p.cur != '\0') {
+		parse_error(&p, "unexpected input");
+		goto err;
+	}
+
+	/* the top level composition ends past the last function */
+
+	for(n = 0; n < p.descr->size; n++)
+	{
+		if (p.descr->fun[n].next == (ptrdiff_t)p.max_fun)
+			p.descr->fun[n].next = (ptrdiff_t)p.descr->size;
+	}
+
+	p.descr->entry_point = 0;
+	return p.descr;
+err:
+	kfree(p.descr);
+	return NULL;
+}
+
+
+void sim_lang_free(struct pfq_lang_computation_descr *descr)
+{
+	kfree(descr);
+}
@@ -0,0 +1,42 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+#ifndef PFQ_SIM_LANG_H
+#define PFQ_SIM_LANG_H
+
+#include <linux/pf_q.h>
+
+/*
+ * Textual computations, typed by the signatures of the function tables:
+ *
+ *   comp := term (">->" term)*
+ *   term := symbol arg*
+ *   arg  := number | a.b.c.d | string | "string" | [item, ...] | (comp) | term
+ *
+ * The returned descriptor is a single allocation (release it with sim_lang_free).
+ */
+
+extern struct pfq_lang_computation_descr * sim_lang_parse(const char *prog);
+extern void sim_lang_free(struct pfq_lang_computation_descr *descr);
+
+#endif /* PFQ_SIM_LANG_H */
@@ -0,0 +1,496 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+#include <kcompat.h>
+
+#include <pf_q-define.h>
+#include <pf_q-group.h>
+#include <pf_q-devmap.h>
+#include <pf_q-sock.h>
+#include <pf_q-percpu.h>
+#include <pf_q-bitops.h>
+#include <pf_q-global.h>
+#include <pf_q-stats.h>
+#include <pf_q-bpf.h>
+#include <pf_q-receive.h>
+#include <pf_q-transmit.h>
+#include <pf_q-shared-queue.h>
+#include <pf_q-endpoint.h>
+#include <pf_q-fanout.h>
+
+#include <lang/engine.h>
+#include <lang/symtable.h>
+#include <lang/GC.h>
+
+#include <sim.h>
+#include <sim-lang.h>
+
+
+int sim_lang_profile;
+
+struct pfq_percpu_data __percpu * percpu_data;
+struct pfq_percpu_sock __percpu * percpu_sock;
+
+static struct pfq_sock * sim_sock[Q_MAX_ID];
+static struct pfq_rx_queue sim_rx_queue;	/* enables the Rx of the sockets */
+static unsigned long sim_sock_count[Q_MAX_ID];
+
+static struct sim_profile sim_prof;
+static size_t sim_batch_len = 1;
+
+
+/* kernel entry points: sockets have no shared queue, devices only count packets */
+
+struct pfq_sock *
+pfq_get_sock_by_id(pfq_id_t id)
+{
+	if ((__force int)id < 0 || (__force int)id >= Q_MAX_ID)
+		return NULL;
+	return sim_sock[(__force int)id];
+}
+
+
+void pfq_free_sk_filter(struct sk_filter *filter)
+{
+	kfree(filter);
+}
+
+
+size_t pfq_flow_queue_push(struct pfq_sock *so, struct pfq_flow_stat const *recs, size_t n)
+{
+	(void)so;
+	(void)recs;
+	return n;
+}
+
+
+/* the sockets have no shared queue: the packets are only counted */
+
+size_t pfq_sk_rx_queue_recv(struct pfq_sock *so, struct pfq_skbuff_GC_queue *skbs,
+			    unsigned long long skbs_mask, int burst_len, pfq_gid_t gid, int cpu)
+{
+	(void)skbs; (void)skbs_mask; (void)gid; (void)cpu;
+	sim_sock_count[(__force int)so->id] += (unsigned long)burst_len;
+	return (size_t)burst_len;
+}
+
+
+int pfq_skb_queue_lazy_xmit_by_mask(struct pfq_skbuff_GC_queue *queue, unsigned long long mask,
+				    struct net_device *dev, int queue_index)
+{
+	(void)queue; (void)mask; (void)dev; (void)queue_index;
+	return 0;
+}
+
+
+int pfq_xmit(struct sk_buff *skb, struct net_device *dev, int queue, int more)
+{
+	(void)queue; (void)more;
+	dev->stats.tx_packets++;
+	kfree_skb(skb);
+	return 1;
+}
+
+
+int pfq_lazy_xmit(struct sk_buff __GC * skb, struct net_device *dev, int queue)
+{
+	int ret = pfq_lang_log_dev(skb, dev);
+
+	if (unlikely(ret < 0)) {
+		sparse_inc(&global_stats, ovfl);
+		return 0;
+	}
+
+	skb_set_queue_mapping(PFQ_SKB(skb), queue);
+
+	if (ret)
+		PFQ_CB(skb)->log->xmit_todo++;
+
+	return 1;
+}
+
+
+/* pf_q-fanout.c is built with PFQ_FANOUT_LANG_HOOK: the engine can be timed alone */
+
+SkBuff
+pfq_fanout_lang_run(SkBuff buff, struct pfq_lang_computation_tree *prg)
+{
+	cycles_t start;
+
+	if (!sim_lang_profile)
+		return pfq_lang_run(buff, prg).skb;
+
+	start = get_cycles();
+	buff = pfq_lang_run(buff, prg).skb;
+	sim_prof.lang_cycles += get_cycles() - start;
+	return buff;
+}
+
+
+/*
+ * pfq_receive_batch, one cpu: the packets forwarded to devices are counted
+ * by the devices, without being transmitted.
+ */
+
+static void
+sim_receive_batch(struct pfq_percpu_sock *sock, struct GC_data *GC_ptr, int cpu)
+{
+        struct sk_buff *skb;
+        long unsigned n;
+
+	__sparse_add(&global_stats, recv, GC_size(GC_ptr), cpu);
+
+	pfq_fanout_batch(sock, GC_ptr, cpu);
+
+	/* forward skbs to network devices */
+
+	if (GC_ptr->endpoints.cnt_total)
+	{
+		size_t i;
+		for(i = 0; i < GC_ptr->endpoints.num; i++)
+			GC_ptr->endpoints.dev[i]->stats.tx_packets += GC_ptr->endpoints.cnt[i];
+
+		__sparse_add(&global_stats, frwd, GC_ptr->endpoints.cnt_total, cpu);
+	}
+
+	/* forward skbs to kernel or release them */
+
+	for_each_skbuff(SKBUFF_QUEUE_ADDR(GC_ptr->pool), skb, n)
+	{
+		struct pfq_cb *cb = PFQ_CB(skb);
+
+		if (cb->direct && fwd_to_kernel(skb)) {
+		        __sparse_inc(&global_stats, kern, cpu);
+			skb_pull(skb, skb->mac_len);
+			netif_receive_skb(skb);
+		}
+		else {
+			kfree_skb(skb);
+		}
+	}
+
+	GC_reset(GC_ptr);
+}
+
+
+void sim_flush(void)
+{
+	struct pfq_percpu_data *data = this_cpu_ptr(percpu_data);
+	size_t len = GC_size(data->GC);
+	cycles_t start;
+
+	if (len == 0)
+		return;
+
+	start = get_cycles();
+
+	sim_receive_batch(this_cpu_ptr(percpu_sock), data->GC, 0);
+
+	sim_prof.cycles  += get_cycles() - start;
+	sim_prof.packets += len;
+	sim_prof.batches++;
+}
+
+
+/* pfq_receive, without the timer: the batch is flushed when full */
+
+int sim_receive(const void *pkt, size_t len, int ifindex, int queue, long long tstamp)
+{
+	struct pfq_percpu_data *data = this_cpu_ptr(percpu_data);
+	struct net_device *dev = dev_get_by_index(&init_net, ifindex);
+	struct sk_buff __GC * buff;
+	struct sk_buff *skb;
+
+	if (dev == NULL || len < ETH_HLEN || queue < 0 || queue >= Q_MAX_HW_QUEUE)
+		return -EINVAL;
+
+	sim_ktime = tstamp;
+	jiffies = (unsigned long)(tstamp / (NSEC_PER_SEC / HZ));
+
+	/* as drivers do, the IP header is aligned */
+
+	skb = alloc_skb((unsigned int)len + NET_IP_ALIGN, GFP_ATOMIC);
+	if (skb == NULL) {
+		__sparse_inc(&global_stats, lost, 0);
+		return -ENOMEM;
+	}
+
+	skb_reserve(skb, NET_IP_ALIGN);
+
+	memcpy(skb_put(skb, (unsigned int)len), pkt, len);
+
+	skb->dev = dev;
+	skb->tstamp = tstamp;
+	skb->protocol = ((const struct ethhdr *)pkt)->h_proto;
+	skb->mac_len = ETH_HLEN;
+
+	skb_reset_mac_header(skb);
+	skb_set_network_header(skb, ETH_HLEN);
+	skb_record_rx_queue(skb, (u16)queue);
+
+	buff = GC_make_buff(data->GC, skb);
+	if (buff == NULL) {
+		__sparse_inc(&global_stats, lost, 0);
+		kfree_skb(skb);
+		return -ENOMEM;
+	}
+
+	PFQ_CB(buff)->direct = 1;
+
+	if (GC_size(data->GC) >= sim_batch_len)
+		sim_flush();
+
+	return 0;
+}
+
+
+/* sockets and groups */
+
+int sim_open(int weight)
+{
+	struct pfq_sock *so;
+	int id;
+
+	if (weight < 1 || weight > Q_MAX_SOCK_MASK / Q_MAX_ID)
+		return -EINVAL;
+
+	for(id = 0; id < Q_MAX_ID; id++)
+	{
+		if (sim_sock[id] == NULL)
+			break;
+	}
+
+	if (id == Q_MAX_ID)
+		return -EBUSY;
+
+	so = kzalloc(sizeof(struct pfq_sock), GFP_KERNEL);
+	if (so == NULL)
+		return -ENOMEM;
+
+	so->stats = alloc_percpu(struct pfq_sock_stats);
+	if (so->stats == NULL) {
+		kfree(so);
+		return -ENOMEM;
+	}
+
+	so->id = (__force pfq_id_t)id;
+	so->weight = weight;
+	so->egress_type = pfq_endpoint_socket;
+
+	atomic_long_set(&so->opt.rxq[0].addr, &sim_rx_queue);
+
+	sim_sock[id] = so;
+	sim_sock_count[id] = 0;
+	return id;
+}
+
+
+void sim_close(int id)
+{
+	struct pfq_sock *so = pfq_get_sock_by_id((__force pfq_id_t)id);
+	if (so == NULL)
+		return;
+
+	pfq_leave_all_groups(so->id);
+	pfq_invalidate_percpu_eligible_mask(so->id);
+
+	sim_sock[id] = NULL;
+	free_percpu(so->stats);
+	kfree(so);
+}
+
+
+int sim_join(int id, int gid, unsigned long class_mask)
+{
+	if (pfq_get_sock_by_id((__force pfq_id_t)id) == NULL)
+		return -EINVAL;
+
+	return pfq_join_group((__force pfq_gid_t)gid, (__force pfq_id_t)id, class_mask, Q_POLICY_GROUP_SHARED);
+}
+
+
+int sim_bind(int gid, int ifindex, int queue)
+{
+	if (dev_get_by_index(&init_net, ifindex) == NULL)
+		return -EINVAL;
+
+	pfq_devmap_update(map_set, ifindex, queue, (__force pfq_gid_t)gid);
+	return 0;
+}
+
+
+/* as Q_SO_GROUP_FUNCTION */
+
+int sim_set_computation(int gid, const char *prog)
+{
+	struct pfq_lang_computation_descr *descr;
+        struct pfq_lang_computation_tree *comp = NULL;
+        void *context = NULL;
+	int err = 0;
+
+	descr = sim_lang_parse(prog);
+	if (descr == NULL)
+		return -EINVAL;
+
+	if (pfq_lang_check_computation_descr(descr) < 0) {
+		printk(KERN_INFO "[PFQ] invalid expression!\n");
+		err = -EINVAL;
+		goto error;
+	}
+
+	context = pfq_lang_context_alloc(descr);
+	if (context == NULL) {
+		err = -ENOMEM;
+		goto error;
+	}
+
+	comp = pfq_lang_computation_alloc(descr);
+	if (comp == NULL) {
+		err = -ENOMEM;
+		goto error;
+	}
+
+	if (pfq_lang_computation_rtlink(descr, comp, context) < 0) {
+		printk(KERN_INFO "[PFQ] computation aborted!\n");
+		err = -EPERM;
+		goto error;
+	}
+
+	if (pfq_lang_computation_init(comp) < 0) {
+		printk(KERN_INFO "[PFQ] initialization of computation aborted!\n");
+		pfq_lang_computation_destruct(comp);
+		err = -EPERM;
+		goto error;
+	}
+
+	if (pfq_set_group_prog((__force pfq_gid_t)gid, comp, context) < 0) {
+		err = -EPERM;
+		goto error;
+	}
+
+	sim_lang_free(descr);
+	return 0;
+
+error:	kfree(comp);
+	kfree(context);
+	sim_lang_free(descr);
+	return err;
+}
+
+
+/* counters */
+
+void sim_get_group_stats(int gid, struct sim_group_stats *stats)
+{
+	struct pfq_group *group = pfq_get_group((__force pfq_gid_t)gid);
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (group == NULL || group->stats == NULL)
+		return;
+
+	stats->recv = (unsigned long)sparse_read(group->stats, recv);
+	stats->drop = (unsigned long)sparse_read(group->stats, drop);
+	stats->frwd = (unsigned long)sparse_read(group->stats, frwd);
+	stats->kern = (unsigned long)sparse_read(group->stats, kern);
+}
+
+
+unsigned long sim_sock_recv(int id)
+{
+	if (id < 0 || id >= Q_MAX_ID)
+		return 0;
+	return sim_sock_count[id];
+}
+
+
+void sim_get_profile(struct sim_profile *prof)
+{
+	*prof = sim_prof;
+}
+
+
+void sim_reset_profile(void)
+{
+	memset(&sim_prof, 0, sizeof(sim_prof));
+}
+
+
+/* setup */
+
+int sim_init(size_t batch_len)
+{
+	struct pfq_percpu_data *data;
+
+	BUILD_BUG_ON(SIM_BATCH_MAX != Q_SKBUFF_BATCH);
+
+	if (batch_len < 1 || batch_len > Q_SKBUFF_BATCH)
+		return -EINVAL;
+
+	sim_batch_len = batch_len;
+
+	percpu_data = alloc_percpu(struct pfq_percpu_data);
+	percpu_sock = alloc_percpu(struct pfq_percpu_sock);
+	if (percpu_data == NULL || percpu_sock == NULL)
+		goto err;
+
+	data = this_cpu_ptr(percpu_data);
+	data->GC = kzalloc(sizeof(struct GC_data), GFP_KERNEL);
+	if (data->GC == NULL)
+		goto err;
+
+	GC_data_init(data->GC);
+
+	if (pfq_groups_init() < 0)
+		goto err;
+
+	pfq_lang_symtable_init();
+	return 0;
+err:
+	sim_fini();
+	return -ENOMEM;
+}
+
+
+void sim_fini(void)
+{
+	int id;
+
+	if (percpu_data && this_cpu_ptr(percpu_data)->GC)
+		sim_flush();
+
+	for(id = 0; id < Q_MAX_ID; id++)
+		sim_close(id);
+
+	if (percpu_data)
+		kfree(this_cpu_ptr(percpu_data)->GC);
+
+	pfq_lang_symtable_free();
+	pfq_groups_destruct();
+	sim_devices_reset();
+
+	free_percpu(percpu_sock);
+	free_percpu(percpu_data);
+	percpu_sock = NULL;
+	percpu_data = NULL;
+}
@@ -0,0 +1,95 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+/*
+ * User-space simulation of the PFQ Rx path: the pfq-lang engine, the
+ * built-in function tables and the group/steering fan-out of
+ * pfq_receive_batch. This header is plain C: it does not depend on the
+ * kernel shims and can be included by ordinary user-space programs.
+ */
+
+#ifndef PFQ_SIM_H
+#define PFQ_SIM_H
+
+#include <stddef.h>
+
+
+struct sim_group_stats
+{
+	unsigned long recv;		/* received by the group/computation */
+	unsigned long drop;		/* drop by computation: fanout monad */
+	unsigned long frwd;		/* forwarded to devices */
+	unsigned long kern;		/* passed to kernel */
+};
+
+
+struct sim_profile
+{
+	unsigned long long packets;
+	unsigned long long batches;
+	unsigned long long cycles;	/* whole fan-out, computations included */
+	unsigned long long lang_cycles;	/* pfq_lang_run only (sim_lang_profile) */
+};
+
+
+extern int  sim_verbose;
+extern int  sim_lang_profile;
+
+
+/* setup: the batch length is bounded by Q_SKBUFF_BATCH */
+
+#define SIM_BATCH_MAX	((int)sizeof(long)<<3)
+
+extern int  sim_init(size_t batch_len);
+extern void sim_fini(void);
+
+/* devices: every name resolves, devices are created on first use */
+
+extern int  sim_device(const char *name);
+extern unsigned long sim_device_tx(int ifindex);
+
+/* sockets and groups */
+
+extern int  sim_open(int weight);
+extern void sim_close(int id);
+
+extern int  sim_join(int id, int gid, unsigned long class_mask);
+extern int  sim_bind(int gid, int ifindex, int queue);
+
+/* computations, in the textual form: "fun arg... >-> fun arg..." */
+
+extern int  sim_set_computation(int gid, const char *prog);
+
+/* Rx path */
+
+extern int  sim_receive(const void *pkt, size_t len, int ifindex, int queue, long long tstamp);
+extern void sim_flush(void);
+
+/* counters */
+
+extern void sim_get_group_stats(int gid, struct sim_group_stats *stats);
+extern unsigned long sim_sock_recv(int id);
+extern void sim_get_profile(struct sim_profile *prof);
+extern void sim_reset_profile(void);
+
+#endif /* PFQ_SIM_H */
@@ -0,0 +1,209 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+#include <linux/pf_q.h>
+
+#include "sim.h"
+
+
+#define PACKETS	1000
+
+/* Ethernet + IPv4 + UDP/TCP: 10.0.x.y -> 192.168.0.1 */
+
+static size_t
+make_packet(unsigned char *buf, int n, int proto)
+{
+	size_t len = 14 + 20 + 20;
+
+	memset(buf, 0, len);
+
+	buf[12] = 0x08;				/* ETH_P_IP */
+	buf[13] = 0x00;
+
+	buf[14] = 0x45;				/* version, ihl */
+	buf[16] = 0;
+	buf[17] = 40;				/* tot_len */
+	buf[22] = 64;				/* ttl */
+	buf[23] = (unsigned char)proto;
+	buf[26] = 10;				/* saddr */
+	buf[27] = 0;
+	buf[28] = (unsigned char)(n >> 8);
+	buf[29] = (unsigned char)n;
+	buf[30] = 192;				/* daddr */
+	buf[31] = 168;
+	buf[32] = 0;
+	buf[33] = 1;
+
+	buf[34] = (unsigned char)((1024 + n) >> 8);	/* source port */
+	buf[35] = (unsigned char)(1024 + n);
+	buf[36] = 0;				/* dest port: 80 */
+	buf[37] = 80;
+
+	return len;
+}
+
+
+/* even packets are UDP, odd ones TCP */
+
+static void
+replay(int ifindex)
+{
+	unsigned char buf[64];
+	int n;
+
+	for(n = 0; n < PACKETS; n++)
+	{
+		size_t len = make_packet(buf, n, (n & 1) ? 6 : 17);
+		assert(sim_receive(buf, len, ifindex, 0, 1000000000LL + n * 1000LL) == 0);
+	}
+
+	sim_flush();
+}
+
+
+static int
+setup(int nsock, const int *weights)
+{
+	int ifindex, n;
+
+	assert(sim_init(SIM_BATCH_MAX) == 0);
+
+	ifindex = sim_device("sim0");
+	assert(ifindex > 0);
+
+	for(n = 0; n < nsock; n++)
+	{
+		int id = sim_open(weights ? weights[n] : 1);
+		assert(id == n);
+		assert(sim_join(id, 0, Q_CLASS_DEFAULT) == 0);
+	}
+
+	assert(sim_bind(0, ifindex, Q_ANY_QUEUE) == 0);
+	return ifindex;
+}
+
+
+int main()
+{
+	struct sim_group_stats gs;
+	struct sim_profile prof;
+	int ifindex, n;
+
+	/* no computation: every socket gets every packet */
+	{
+		ifindex = setup(3, NULL);
+		replay(ifindex);
+
+		sim_get_group_stats(0, &gs);
+		assert(gs.recv == PACKETS);
+		assert(gs.drop == 0);
+
+		for(n = 0; n < 3; n++)
+			assert(sim_sock_recv(n) == PACKETS);
+
+		sim_get_profile(&prof);
+		assert(prof.packets == PACKETS);
+		assert(prof.batches == (PACKETS + SIM_BATCH_MAX - 1) / SIM_BATCH_MAX);
+
+		sim_fini();
+	}
+
+	/* udp: odd packets dropped */
+	{
+		ifindex = setup(1, NULL);
+		assert(sim_set_computation(0, "udp") == 0);
+		replay(ifindex);
+
+		sim_get_group_stats(0, &gs);
+		assert(gs.recv == PACKETS);
+		assert(gs.drop == PACKETS/2);
+		assert(sim_sock_recv(0) == PACKETS/2);
+
+		sim_fini();
+	}
+
+	/* steer_flow: each packet to a single socket, by weight */
+	{
+		int weights[] = { 1, 3 };
+
+		ifindex = setup(2, weights);
+		assert(sim_set_computation(0, "ip >-> steer_flow") == 0);
+		replay(ifindex);
+
+		assert(sim_sock_recv(0) + sim_sock_recv(1) == PACKETS);
+		assert(sim_sock_recv(0) > 0);
+		assert(sim_sock_recv(1) > 2 * sim_sock_recv(0));
+
+		sim_fini();
+	}
+
+	/* forward: the packets are counted by the device */
+	{
+		int out;
+
+		ifindex = setup(1, NULL);
+		out = sim_device("sim1");
+		assert(out > 0 && out != ifindex);
+
+		assert(sim_set_computation(0, "tcp >-> forward sim1") == 0);
+		replay(ifindex);
+
+		assert(sim_device_tx(out) == PACKETS/2);
+		assert(sim_sock_recv(0) == PACKETS/2);
+
+		sim_fini();
+	}
+
+	/* higher order functions and arguments */
+	{
+		ifindex = setup(1, NULL);
+		assert(sim_set_computation(0, "filter (or is_udp is_tcp)") == 0);
+		replay(ifindex);
+		assert(sim_sock_recv(0) == PACKETS);
+		sim_fini();
+
+		ifindex = setup(1, NULL);
+		assert(sim_set_computation(0, "filter (has_src_addr 10.0.1.0 24) >-> udp") == 0);
+		replay(ifindex);
+		assert(sim_sock_recv(0) == 128);	/* 10.0.1.0 - 10.0.1.255, even */
+		sim_fini();
+	}
+
+	/* invalid computations */
+	{
+		setup(1, NULL);
+		assert(sim_set_computation(0, "no_such_function") < 0);
+		assert(sim_set_computation(0, "filter") < 0);
+		assert(sim_set_computation(0, "is_udp >-> udp") < 0);
+		assert(sim_set_computation(0, "udp >-> (") < 0);
+		sim_fini();
+	}
+
+	printf("All test successfully passed.\n");
+	return 0;
+}
@@ -0,0 +1,262 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <limits>
+
+#include <pfq/pfq.hpp>
+#include <pfq/queue.hpp>
+#include <pfq/util.hpp>
+#include <pfq/exception.hpp>
+
+
+namespace pfq {
+
+    namespace details
+    {
+        inline size_t
+        next_pow2(size_t value)
+        {
+            size_t n = 1;
+            while (n < value)
+                n <<= 1;
+            return n;
+        }
+    }
+
+    //! Single-producer single-consumer ring of trivially copyable values.
+
+    template <typename T>
+    class spsc_ring
+    {
+    public:
+
+        //! The size is rounded up to a power of two.
+
+        explicit spsc_ring(size_t size)
+        : mask_(details::next_pow2(size) - 1)
+        , ring_(new T[mask_ + 1])
+        , head_(0)
+        , tail_(0)
+        {}
+
+        //! Producer: push a value, return false if the ring is full.
+
+        bool
+        push(T const &value)
+        {
+            auto h = head_.load(std::memory_order_relaxed);
+            if (h - tail_.load(std::memory_order_acquire) > mask_)
+                return false;
+
+            ring_[h & mask_] = value;
+            head_.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        //! Consumer: pop up to max values, invoking fun on each of them. Return the number of values.
+
+        template <typename Fun>
+        size_t
+        pop(Fun fun, size_t max)
+        {
+            auto t = tail_.load(std::memory_order_relaxed);
+            auto h = head_.load(std::memory_order_acquire);
+
+            size_t n = 0;
+            for(; t != h && n < max; ++t, ++n)
+                fun(ring_[t & mask_]);
+
+            tail_.store(t, std::memory_order_release);
+            return n;
+        }
+
+        size_t
+        size() const
+        {
+            return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+        }
+
+    private:
+
+        // producer and consumer indexes 64 bytes apart (no false sharing)
+
+        size_t                  mask_;
+        std::unique_ptr<T[]>    ring_;
+
+        std::atomic<size_t>     head_;
+        char                    pad_[64];
+        std::atomic<size_t>     tail_;
+    };
+
+
+    //! Fan-out of the packets of a socket to worker threads (zero-copy).
+    /*!
+     * The dispatcher thread reads a batch from the socket and hands out the
+     * references to its slots to the workers, through one SPSC ring per worker.
+     * Packets are assigned by symmetric flow hash, so that a flow is always
+     * processed by the same worker.
+     *
+     * The half of the Rx queue a batch lives in is overwritten by the kernel
+     * after the next read: the dispatcher reads again only when all the
+     * workers have released the slots of the current batch. Meanwhile the
+     * kernel fills the other half.
+     *
+     * Typical use:
+     *
+     *  pfq::fanout fan(q, 4);
+     *
+     *  worker n: while (run) fan.consume(n, [](const pfq_pkthdr *h, const char *data) { ... });
+     *
+     *  dispatcher: while (run) fan.dispatch(1000);
+     */
+
+    class fanout
+    {
+    public:
+
+        //! A reference to a packet of the current batch.
+
+        struct packet
+        {
+            const pfq_pkthdr    *hdr;
+            const char          *data;
+        };
+
+        //! Create the fan-out for the given (enabled) socket and number of workers.
+
+        fanout(socket &q, size_t workers)
+        : q_(q)
+        , rings_()
+        , pending_(0)
+        {
+            if (workers == 0)
+                throw pfq_error("PFQ: fanout: no workers");
+
+            // a whole batch always fits a ring
+
+            for(size_t n = 0; n < workers; n++)
+                rings_.emplace_back(new spsc_ring<packet>(q.rx_slots()));
+        }
+
+        fanout(const fanout &) = delete;
+        fanout& operator=(const fanout &) = delete;
+
+        //! Return the number of workers.
+
+        size_t
+        workers() const
+        {
+            return rings_.size();
+        }
+
+        //! Dispatcher: read a batch from the socket and distribute it to the workers.
+        /*!
+         * Wait (bounded spin, then yield) for the workers to release the previous
+         * batch, then read with the given timeout. Return the number of packets
+         * dispatched.
+         */
+
+        size_t
+        dispatch(long int microseconds = -1)
+        {
+            for(unsigned int spin = 0; pending_.load(std::memory_order_acquire) != 0;)
+            {
+                if (spin++ < spin_budget)
+                    relax();
+                else
+                    std::this_thread::yield();
+            }
+
+            auto batch = q_.read(microseconds);
+            if (batch.size() == 0)
+                return 0;
+
+            pending_.store(batch.size(), std::memory_order_relaxed);
+
+            auto n = static_cast<uint32_t>(rings_.size());
+
+            for(auto it = batch.begin(), it_e = batch.end(); it != it_e; ++it)
+            {
+                it.prefetch();
+
+                if (!it.ready())
+                    it.wait();
+
+                auto data = static_cast<const char *>(it.data());
+                auto w = n == 1 ? 0 : fold(symmetric_hash(data), n);
+
+                rings_[w]->push(packet{ &(*it), data });
+            }
+
+            return batch.size();
+        }
+
+        //! Worker: process up to max packets of the given worker, then release them.
+        /*!
+         * The callback has the signature:
+         *
+         * void callback(const struct pfq_pkthdr *h, const char *data);
+         *
+         * The packets must not be referenced after the callback returns.
+         * Return the number of packets processed.
+         */
+
+        template <typename Fun>
+        size_t
+        consume(size_t worker, Fun callback, size_t max = std::numeric_limits<size_t>::max())
+        {
+            auto n = rings_.at(worker)->pop([&](packet const &p) {
+                        callback(p.hdr, p.data);
+                     }, max);
+
+            if (n)
+                pending_.fetch_sub(n, std::memory_order_release);
+
+            return n;
+        }
+
+        //! Return the number of packets of the current batch not yet released.
+
+        size_t
+        pending() const
+        {
+            return pending_.load(std::memory_order_acquire);
+        }
+
+    private:
+
+        socket                                      &q_;
+        std::vector<std::unique_ptr<spsc_ring<packet>>> rings_;
+        std::atomic<size_t>                         pending_;
+    };
+
+} // namespace pfq
@@ -0,0 +1,110 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#pragma once
+
+#include <cstddef>
+#include <limits>
+
+#include <pfq/pfq.hpp>
+#include <pfq/exception.hpp>
+
+#include <linux/pf_q.h>
+
+
+namespace pfq {
+
+    //! Reader of the flow records exported by the kernel.
+    /*!
+     * The records (expired flows of the flow tables of the groups) are read
+     * from the flow ring of the socket, which must be enabled with a non-zero
+     * length. \see socket::flow_ring, socket::flow_timeouts
+     */
+
+    class flow_reader
+    {
+    public:
+
+        explicit flow_reader(socket const &q)
+        : q_(q)
+        {}
+
+        //! Consume (up to max) the available records, invoking fun on each of them.
+        /*!
+         * Return the number of records read.
+         */
+
+        template <typename Fun>
+        size_t read(Fun fun, size_t max = std::numeric_limits<size_t>::max())
+        {
+            auto fq = queue();
+            auto ring = records(fq);
+
+            auto prod = __atomic_load_n(&fq->prod.index, __ATOMIC_ACQUIRE);
+            auto cons = fq->cons.index;
+
+            size_t n = 0;
+            for(; n < max && cons != prod; ++n, ++cons)
+                fun(ring[cons & (fq->len - 1)]);
+
+            __atomic_store_n(&fq->cons.index, cons, __ATOMIC_RELEASE);
+            return n;
+        }
+
+        //! Return the number of records ready to be read.
+
+        size_t available() const
+        {
+            auto fq = queue();
+            return __atomic_load_n(&fq->prod.index, __ATOMIC_ACQUIRE) - fq->cons.index;
+        }
+
+        //! Return the number of records lost (the ring was full).
+
+        unsigned long lost() const
+        {
+            return __atomic_load_n(&queue()->prod.lost, __ATOMIC_RELAXED);
+        }
+
+    private:
+
+        pfq_flow_queue *
+        queue() const
+        {
+            auto sq = static_cast<pfq_shared_queue *>(const_cast<void *>(q_.mem_addr()));
+            if (sq == nullptr || sq->flow.len == 0)
+                throw pfq_error("PFQ: flow ring not enabled");
+            return &sq->flow;
+        }
+
+        const pfq_flow_stat *
+        records(pfq_flow_queue const *fq) const
+        {
+            return reinterpret_cast<const pfq_flow_stat *>(static_cast<const char *>(q_.mem_addr()) + fq->off);
+        }
+
+        socket const &q_;
+    };
+
+} // namespace pfq
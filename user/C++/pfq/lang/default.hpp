@@ -942,6 +942,191 @@ namespace lang
                                     auto addrs = fmap(details::inet_addr, ips);
                                     return mfunction("bloom_dst_filter", m, std::move(addrs), prefix);
                                 };
+
+        //! Predicate that evaluates to \c true when the source or the destination address
+        // of the packet matches the named bloom filter of the group.
+        /*!
+         * The filter is created and updated at runtime by means of the socket
+         * (bloom_create, bloom_add, bloom_remove, bloom_load), without reinstalling the computation.
+         * Keys are IPv4 or IPv6 addresses, or 5-tuples (tested as they are), according to the filter.
+         * Example:
+         *
+         * when (bloom_table ("blacklist"), log_packet ) >> kernel
+         *
+         */
+
+        auto bloom_table     = [] (std::string name) { return predicate("bloom_table", std::move(name)); };
+
+        //! Similarly to \c bloom_table, evaluates to \c true when the source address
+        //! of the packet matches the named bloom filter.  \see bloom_table
+
+        auto bloom_table_src = [] (std::string name) { return predicate("bloom_table_src", std::move(name)); };
+
+        //! Similarly to \c bloom_table, evaluates to \c true when the destination address
+        //! of the packet matches the named bloom filter.  \see bloom_table
+
+        auto bloom_table_dst = [] (std::string name) { return predicate("bloom_table_dst", std::move(name)); };
+
+        //! Monadic counterpart of \c bloom_table function.  \see bloom_table
+
+        auto bloom_table_filter     = [] (std::string name) { return mfunction("bloom_table_filter", std::move(name)); };
+
+        //! Monadic counterpart of \c bloom_table_src function.  \see bloom_table_src
+
+        auto bloom_table_src_filter = [] (std::string name) { return mfunction("bloom_table_src_filter", std::move(name)); };
+
+        //! Monadic counterpart of \c bloom_table_dst function.  \see bloom_table_dst
+
+        auto bloom_table_dst_filter = [] (std::string name) { return mfunction("bloom_table_dst_filter", std::move(name)); };
+
+        // longest prefix match:
+
+        //! Evaluates to \c true when the source address of the packet matches
+        // a prefix of the named lpm table of the group.
+        /*!
+         * The table is created and updated by means of the socket
+         * (lpm_create, lpm_add, lpm_remove, lpm_load), without reinstalling the computation.
+         *
+         * \code{.cpp}
+         * when (lpm_src ("customers"), log_packet ) >> kernel
+         * \endcode
+         */
+
+        auto lpm_src = [] (std::string name) { return predicate("lpm_src", std::move(name)); };
+
+        //! Similarly to \c lpm_src, evaluates to \c true when the destination address
+        //! of the packet matches a prefix of the named lpm table.  \see lpm_src
+
+        auto lpm_dst = [] (std::string name) { return predicate("lpm_dst", std::move(name)); };
+
+        //! Deliver the packet to the classes (mask) of the longest matching prefix,
+        // the destination address first and then the source one; drop it otherwise.
+
+        auto lpm_class = [] (std::string name) { return mfunction("lpm_class", std::move(name)); };
+
+        //! Steer the packet with the value of the longest matching prefix,
+        // the destination address first and then the source one; drop it otherwise.
+
+        auto lpm_steer = [] (std::string name) { return mfunction("lpm_steer", std::move(name)); };
+
+        // flow table:
+
+        //! Account the packet to its flow (5-tuple) in the flow table of the group.
+        /*!
+         * The table is created by means of the socket (flow_create) and exported
+         * with flow_export. Non-IP packets are passed unchanged.
+         *
+         * \code{.cpp}
+         * flow_update >> kernel
+         * \endcode
+         */
+
+        auto flow_update = mfunction("flow_update");
+
+        //! Set the user-defined state of the flow of the packet (the flow is added if needed).
+
+        auto flow_set_state = [] (uint32_t value) { return mfunction("flow_set_state", value); };
+
+        //! Steer the packets of the flows in the table, drop the others.
+
+        auto flow_steer = mfunction("flow_steer");
+
+        //! Evaluate to \c true if the flow of the packet is in the flow table.
+
+        auto flow_match = predicate("flow_match");
+
+        //! Evaluate to \c true if the state of the flow of the packet is set to the given \c value.
+
+        auto flow_has_state = [] (uint32_t value) { return predicate("flow_has_state", value); };
+
+        //
+        // sampling functions:
+        //
+
+        //! Deterministic sampling: pass one packet every \c n (per cpu), drop the others.
+
+        auto sample_every = [] (int n) { return mfunction("sample_every", n); };
+
+        //! Probabilistic sampling: pass each packet with probability \c p, drop the others.
+
+        auto sample_rand = [] (double p) { return mfunction("sample_rand", details::sample_threshold(p)); };
+
+        //! Per-flow sampling: pass all the packets of a fraction \c p of the flows (the same flows on every cpu).
+
+        auto sample_flow = [] (double p) { return mfunction("sample_flow", details::sample_threshold(p)); };
+
+        //
+        // rate limiting and policing (token buckets, burst of 100 ms):
+        //
+
+        //! Drop the packets exceeding the given rate, in packets per second.
+
+        auto limit_pps = [] (uint64_t pps) { return mfunction("limit_pps", pps); };
+
+        //! Drop the packets exceeding the given rate, in bits per second.
+
+        auto limit_bps = [] (uint64_t bps) { return mfunction("limit_bps", bps); };
+
+        //! Re-classify the packets exceeding the given rate (packets per second) to the class \c c.
+
+        auto police = [] (uint64_t pps, int c) { return mfunction("police", pps, c); };
+
+        //! Drop the packets of each flow exceeding the given rate (packets per second). Non-IP packets are passed.
+
+        auto police_flow = [] (uint64_t pps) { return mfunction("police_flow", pps); };
+
+        //
+        // connection tracking (TCP and UDP):
+        //
+
+        //! Track the connection of the packet (SYN, SYN-ACK, FIN, RST, idle timeouts).
+
+        auto conntrack = mfunction("conntrack");
+
+        //! Evaluate to \c true if the packet belongs to an established connection (either direction).
+
+        auto is_established = predicate("is_established");
+
+        //! Evaluate to \c true if the packet is from the originator of a connection not yet established.
+
+        auto is_new_flow = predicate("is_new_flow");
+
+        //! Evaluate to \c true if the packet is from the responder of a tracked connection.
+
+        auto is_reply = predicate("is_reply");
+
+        //
+        // sketches of the group (created with socket::sketch_create):
+        //
+
+        //! Count the packet in the sketch of the group keyed by source address.
+
+        auto sketch_src = mfunction("sketch_src");
+
+        //! Count the packet in the sketch of the group keyed by destination address.
+
+        auto sketch_dst = mfunction("sketch_dst");
+
+        //! Count the packet in the sketch of the group keyed by 5-tuple.
+
+        auto sketch_flow = mfunction("sketch_flow");
+
+        //
+        // payload pattern matching (multi-pattern, hex bytes enclosed in |..|, e.g. "|de ad|"):
+        //
+
+        //! Evaluate to \c true if the payload (TCP/UDP payload, or IP payload) contains any of the patterns.
+
+        auto has_pattern = [] (std::vector<std::string> const &ps) { return predicate("has_pattern", ps); };
+
+        //! Evaluate to \c true if any of the patterns is found within \c depth bytes (0 = unbounded) from \c offset of the payload.
+
+        auto has_pattern_at = [] (int offset, int depth, std::vector<std::string> const &ps) { return predicate("has_pattern_at", offset, depth, ps); };
+
+        //! Drop the packets whose payload contains none of the patterns.
+
+        auto pattern_filter = [] (std::vector<std::string> const &ps) { return mfunction("pattern_filter", ps); };
+
         //
         // bloom filter, utility functions:
         //
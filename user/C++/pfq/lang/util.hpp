@@ -126,6 +126,18 @@ namespace pfq { namespace lang
                 throw std::runtime_error("pfq::lang::inet_pton");
             return ret;
         }
+
+        //! Probability to 32-bit threshold (UINT32_MAX stands for 1), as used by the sampling functions.
+
+        inline uint32_t
+        sample_threshold(double p)
+        {
+            if (p >= 1.0)
+                return 0xffffffff;
+            if (p <= 0.0)
+                return 0;
+            return static_cast<uint32_t>(p * 4294967296.0);
+        }
     }
 
 
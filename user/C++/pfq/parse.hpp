@@ -0,0 +1,401 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <vector>
+#include <type_traits>
+#include <algorithm>
+
+#include <pfq/queue.hpp>
+
+#include <linux/pf_q.h>
+#include <linux/if_ether.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+
+namespace pfq { namespace parse {
+
+    //! Layers to decode, selected at compile time.
+    /*!
+     * The Ethernet header (and the 802.1Q tags) is always decoded. Unselected
+     * layers are neither decoded nor stored.
+     */
+
+    enum layer : unsigned int
+    {
+        l2  = 0,
+        l3  = 1,        // IPv4/IPv6: addresses and l4 protocol
+        l4  = 2,        // TCP/UDP/SCTP: ports
+        all = l3 | l4
+    };
+
+    //! IPv6 address, network order. IPv4 addresses are IPv4-mapped (::ffff:a.b.c.d).
+
+    using address = std::array<uint8_t, 16>;
+
+    //! The IPv4 address of an IPv4-mapped address (network order).
+
+    inline uint32_t
+    ipv4(address const &addr)
+    {
+        uint32_t ret;
+        memcpy(&ret, addr.data() + 12, sizeof(ret));
+        return ret;
+    }
+
+    namespace details
+    {
+        template <typename T>
+        inline T load(const char *p)
+        {
+            T ret;
+            memcpy(&ret, p, sizeof(T));
+            return ret;
+        }
+
+        template <bool> struct l3_fields
+        {
+        };
+
+        template <> struct l3_fields<true>
+        {
+            address  saddr;
+            address  daddr;
+            uint16_t l4_off;            // offset of the l4 header (0 = not available)
+            uint8_t  proto;             // l4 protocol
+            uint8_t  family;            // AF_INET, AF_INET6 (0 = not available)
+        };
+
+        template <bool> struct l4_fields
+        {
+        };
+
+        template <> struct l4_fields<true>
+        {
+            uint16_t sport;             // network order
+            uint16_t dport;
+            uint16_t payload_off;       // offset of the payload (0 = not available)
+        };
+
+        template <bool Enable> using bool_ = std::integral_constant<bool, Enable>;
+    }
+
+    //! Compact view of the headers of a packet.
+    /*!
+     * Offsets are relative to the beginning of the packet; an offset of 0
+     * stands for a header not available (not present or not captured).
+     */
+
+    template <unsigned int Layers>
+    struct view : details::l3_fields<(Layers & (l3|l4)) != 0>
+                , details::l4_fields<(Layers & l4) != 0>
+    {
+        uint16_t ethertype;             // host order, past the 802.1Q tags
+        uint16_t vlan_tci;              // VLAN id of the innermost tag (in band, or reported by the kernel)
+        uint16_t l3_off;                // offset of the l3 header (0 = not available)
+        uint16_t caplen;
+
+        static constexpr bool has_l3 = (Layers & (l3|l4)) != 0;
+        static constexpr bool has_l4 = (Layers & l4) != 0;
+    };
+
+    namespace details
+    {
+        // the decoders below only write their output, either a view or a
+        // row of a batch (Out): the fields they depend on are passed along
+
+        template <unsigned int Layers, typename Out>
+        inline void decode_l4(Out &, const char *, size_t, uint8_t, size_t, std::false_type)
+        {
+        }
+
+        template <unsigned int Layers, typename Out>
+        inline void decode_l4(Out &v, const char *pkt, size_t caplen, uint8_t proto, size_t l4_off, std::true_type)
+        {
+            uint16_t sport = 0, dport = 0, payload_off = 0;
+
+            // TCP, UDP or SCTP: a bit test, not a chain of branches on the protocol
+
+            constexpr uint64_t mask = (1ull << IPPROTO_TCP) | (1ull << IPPROTO_UDP);
+            auto ports = ((proto < 64) & ((mask >> (proto & 63)) & 1)) | (proto == IPPROTO_SCTP);
+            if (ports && l4_off != 0 && l4_off + 4u <= caplen)
+            {
+                sport = load<uint16_t>(pkt + l4_off);
+                dport = load<uint16_t>(pkt + l4_off + 2);
+
+                // header length (a truncated TCP header leaves no payload)
+
+                size_t hlen = proto == IPPROTO_UDP ? 8u : 12u;
+                if (proto == IPPROTO_TCP)
+                    hlen = l4_off + 13u <= caplen ? static_cast<size_t>(static_cast<uint8_t>(pkt[l4_off + 12]) >> 4) << 2
+                                                  : caplen;
+
+                if (l4_off + hlen <= caplen)
+                    payload_off = static_cast<uint16_t>(l4_off + hlen);
+            }
+
+            v.sport = sport;
+            v.dport = dport;
+            v.payload_off = payload_off;
+        }
+
+        template <unsigned int Layers, typename Out>
+        inline void decode_l3(Out &, const char *, size_t, uint16_t, size_t, std::false_type)
+        {
+        }
+
+        inline void load_ipv4(address &addr, const char *p)
+        {
+            memset(addr.data(), 0, 10);
+            addr[10] = addr[11] = 0xff;
+            memcpy(addr.data() + 12, p, 4);
+        }
+
+        template <unsigned int Layers, typename Out>
+        inline void decode_l3(Out &v, const char *pkt, size_t caplen, uint16_t ethertype, size_t l3_off, std::true_type)
+        {
+            auto ip = pkt + l3_off;
+            size_t l4_off = 0;
+            uint8_t proto = 0, family = 0;
+
+            if (ethertype == ETH_P_IP && l3_off != 0 && l3_off + 20u <= caplen)
+            {
+                auto ihl = static_cast<size_t>(ip[0] & 0x0f) << 2;
+                family = AF_INET;
+                proto = static_cast<uint8_t>(ip[9]);
+                load_ipv4(v.saddr, ip + 12);
+                load_ipv4(v.daddr, ip + 16);
+
+                // the fragments past the first one carry no l4 header
+
+                if ((load<uint16_t>(ip + 6) & htons(0x1fff)) == 0 && ihl >= 20 && l3_off + ihl <= caplen)
+                    l4_off = l3_off + ihl;
+            }
+            else if (ethertype == ETH_P_IPV6 && l3_off != 0 && l3_off + 40u <= caplen)
+            {
+                family = AF_INET6;
+                proto = static_cast<uint8_t>(ip[6]);
+                memcpy(v.saddr.data(), ip + 8, 16);
+                memcpy(v.daddr.data(), ip + 24, 16);
+                l4_off = l3_off + 40;           // extension headers are not walked
+            }
+            else
+                v.saddr = v.daddr = address();
+
+            v.family = family;
+            v.proto = proto;
+            v.l4_off = static_cast<uint16_t>(l4_off);
+
+            decode_l4<Layers>(v, pkt, caplen, proto, l4_off, bool_<view<Layers>::has_l4>());
+        }
+
+        template <unsigned int Layers, typename Out>
+        inline void decode(Out &v, const char *pkt, size_t caplen, uint16_t vlan_tci)
+        {
+            uint16_t type = 0;
+            size_t l3_off = 0;
+
+            vlan_tci &= 0x0fff;
+
+            if (caplen >= ETH_HLEN)
+            {
+                size_t off = 2 * ETH_ALEN;
+                type = ntohs(load<uint16_t>(pkt + off));
+
+                // 802.1Q/802.1ad tags, stacked
+
+                while ((type == ETH_P_8021Q || type == ETH_P_8021AD) && off + 6 <= caplen)
+                {
+                    vlan_tci = ntohs(load<uint16_t>(pkt + off + 2)) & 0x0fff;
+                    off += 4;
+                    type = ntohs(load<uint16_t>(pkt + off));
+                }
+
+                off += 2;
+                if (off < caplen && type != ETH_P_8021Q && type != ETH_P_8021AD)
+                    l3_off = off;
+            }
+
+            v.caplen = static_cast<uint16_t>(caplen);
+            v.vlan_tci = vlan_tci;
+            v.ethertype = type;
+            v.l3_off = static_cast<uint16_t>(l3_off);
+
+            decode_l3<Layers>(v, pkt, caplen, type, l3_off, bool_<view<Layers>::has_l3>());
+        }
+    }
+
+    //! Decode the headers of a packet, up to the layers selected.
+
+    template <unsigned int Layers>
+    inline view<Layers>
+    decode(const void *data, size_t caplen, uint16_t vlan_tci = 0)
+    {
+        view<Layers> v;
+        details::decode<Layers>(v, static_cast<const char *>(data), caplen, vlan_tci);
+        return v;
+    }
+
+    //! Decode the headers of the packet of a net_queue slot.
+
+    template <unsigned int Layers, typename Iter>
+    inline view<Layers>
+    decode(Iter const &it)
+    {
+        return decode<Layers>(it.data(), it->caplen, it->vlan.tci);
+    }
+
+
+    namespace details
+    {
+        // a row of a batch: references to the elements of the columns
+
+        template <bool> struct l3_refs
+        {
+            template <typename Batch> l3_refs(Batch &, size_t) { }
+        };
+
+        template <> struct l3_refs<true>
+        {
+            template <typename Batch>
+            l3_refs(Batch &b, size_t n)
+            : saddr(b.saddr[n]), daddr(b.daddr[n]), l4_off(b.l4_off[n]), proto(b.proto[n]), family(b.family[n])
+            { }
+
+            address  &saddr;
+            address  &daddr;
+            uint16_t &l4_off;
+            uint8_t  &proto;
+            uint8_t  &family;
+        };
+
+        template <bool> struct l4_refs
+        {
+            template <typename Batch> l4_refs(Batch &, size_t) { }
+        };
+
+        template <> struct l4_refs<true>
+        {
+            template <typename Batch>
+            l4_refs(Batch &b, size_t n)
+            : sport(b.sport[n]), dport(b.dport[n]), payload_off(b.payload_off[n])
+            { }
+
+            uint16_t &sport;
+            uint16_t &dport;
+            uint16_t &payload_off;
+        };
+
+        template <unsigned int Layers>
+        struct row : l3_refs<view<Layers>::has_l3>
+                   , l4_refs<view<Layers>::has_l4>
+        {
+            template <typename Batch>
+            row(Batch &b, size_t n)
+            : l3_refs<view<Layers>::has_l3>(b, n)
+            , l4_refs<view<Layers>::has_l4>(b, n)
+            , ethertype(b.ethertype[n]), vlan_tci(b.vlan_tci[n]), l3_off(b.l3_off[n]), caplen(b.caplen[n])
+            { }
+
+            uint16_t &ethertype;
+            uint16_t &vlan_tci;
+            uint16_t &l3_off;
+            uint16_t &caplen;
+        };
+    }
+
+
+    //! Headers of a batch of packets, as structure of arrays.
+    /*!
+     * The arrays are sized once and reused across batches; those of the layers
+     * not selected stay empty. Fields are as in view<Layers>, and are written
+     * in place by the decoder.
+     */
+
+    template <unsigned int Layers>
+    struct batch
+    {
+        size_t size = 0;
+
+        std::vector<uint16_t> ethertype;
+        std::vector<uint16_t> vlan_tci;
+        std::vector<uint16_t> caplen;
+        std::vector<uint16_t> l3_off;
+
+        std::vector<address>  saddr;
+        std::vector<address>  daddr;
+        std::vector<uint8_t>  proto;
+        std::vector<uint8_t>  family;
+        std::vector<uint16_t> l4_off;
+
+        std::vector<uint16_t> sport;
+        std::vector<uint16_t> dport;
+        std::vector<uint16_t> payload_off;
+
+        //! Decode the packets of the queue (waiting for the slots not yet committed).
+
+        template <typename Queue>
+        size_t decode(Queue &q)
+        {
+            reserve(q.size());
+
+            size_t n = 0;
+            for(auto it = std::begin(q), it_e = std::end(q); it != it_e; ++it, ++n)
+            {
+                it.prefetch();
+                it.wait();
+
+                details::row<Layers> r(*this, n);
+                details::decode<Layers>(r, static_cast<const char *>(it.data()), it->caplen, it->vlan.tci);
+            }
+
+            return size = n;
+        }
+
+    private:
+
+        void reserve(size_t n)
+        {
+            if (ethertype.size() >= n)
+                return;
+
+            ethertype.resize(n); vlan_tci.resize(n); caplen.resize(n); l3_off.resize(n);
+
+            if (view<Layers>::has_l3) {
+                saddr.resize(n); daddr.resize(n); proto.resize(n); family.resize(n); l4_off.resize(n);
+            }
+            if (view<Layers>::has_l4) {
+                sport.resize(n); dport.resize(n); payload_off.resize(n);
+            }
+        }
+    };
+
+} // namespace parse
+} // namespace pfq
@@ -31,6 +31,7 @@
 #include <algorithm>
 #include <thread>
 #include <chrono>
+#include <cmath>
 
 #include <pfq/util.hpp>
 #include <pfq/queue.hpp>
@@ -47,6 +48,7 @@
 #include <arpa/inet.h>
 #include <net/if.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <poll.h>
 
@@ -81,6 +83,14 @@ namespace pfq {
         any           = Q_CLASS_ANY
     };
 
+    //! Combine class masks.
+
+    inline constexpr class_mask
+    operator|(class_mask a, class_mask b)
+    {
+        return static_cast<class_mask>(static_cast<unsigned long>(a) | static_cast<unsigned long>(b));
+    }
+
     //! vlan options.
     /*!
      * Special vlan ids are untag (matches with untagged vlans) and anytag.
@@ -100,6 +110,18 @@ namespace pfq {
     static constexpr int any_group   = Q_ANY_GROUP;
     static constexpr int no_kthread  = Q_NO_KTHREAD;
 
+    //! packet of a Tx batch: scatter-gather chunks and per-packet metadata.
+
+    struct tx_packet
+    {
+        const struct iovec *iov;        // chunks of the packet
+        size_t       iovcnt;
+        int          ifindex;
+        int          qindex;
+        uint64_t     nsec;              // transmission time (0 = immediate)
+        unsigned int copies;
+    };
+
     //////////////////////////////////////////////////////////////////////
 
     //! open parameters.
@@ -141,6 +163,49 @@ namespace pfq {
 
     constexpr const char * string_version = PFQ_VERSION_STRING;
 
+    //! sketch keys.
+
+    enum class sketch_key : int
+    {
+        src  = Q_SKETCH_KEY_SRC,
+        dst  = Q_SKETCH_KEY_DST,
+        flow = Q_SKETCH_KEY_FLOW
+    };
+
+    //! sketch of a group, as read from the kernel (the shards of the cpus merged).
+
+    struct sketch
+    {
+        std::vector<pfq_sketch_item> heavy_hitters;     // sorted by count
+        uint64_t total;                                 // packets (or bytes) counted
+        double   distinct;                              // hyperloglog estimate of the distinct keys
+    };
+
+    //! Estimate the number of distinct keys from the registers of a hyperloglog.
+
+    inline double
+    sketch_distinct(const uint8_t *hll)
+    {
+        const double m = Q_SKETCH_HLL_REGS;
+        double sum = 0;
+        int zeros = 0;
+
+        for(int n = 0; n < Q_SKETCH_HLL_REGS; n++)
+        {
+            sum += std::ldexp(1.0, -hll[n]);
+            zeros += hll[n] == 0;
+        }
+
+        auto e = 0.7213 / (1 + 1.079 / m) * m * m / sum;   // alpha_m m^2 / sum
+
+        // small range: linear counting
+
+        if (e <= 2.5 * m && zeros)
+            e = m * std::log(m / zeros);
+
+        return e;
+    }
+
     //! PFQ: the socket
     /*!
      * This class is the main interface to the PFQ kernel module.
@@ -411,6 +476,60 @@ namespace pfq {
             throw pfq_error("PFQ: socket not open");
         }
 
+        char * rx_queue_addr(size_t queue) const
+        {
+            // Rx sub-queues are mapped after the Tx async queues...
+
+            if (queue == 0)
+                return static_cast<char *>(data()->rx_queue_addr);
+
+            return static_cast<char *>(data()->tx_queue_addr)
+                    + data()->tx_queue_size * 2 * (1 + Q_MAX_TX_QUEUES)
+                    + data()->rx_queue_size * 2 * (queue - 1);
+        }
+
+        void
+        bloom_ctl(int gid, int op, std::string const &name, unsigned int m, int key, int prefix,
+                  const void *keys, size_t n, const char *msg)
+        {
+            pfq_group_bloom value { gid, op, {}, m, prefix, key, keys, n };
+
+            name.copy(value.name, Q_BLOOM_NAME_LEN-1);
+
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_BLOOM, &value, sizeof(value)) == -1)
+                throw pfq_error(errno, msg);
+        }
+
+        void
+        lpm_ctl(int gid, int op, std::string const &name, int family,
+                std::vector<pfq_lpm_rule> const *rules, const char *msg)
+        {
+            pfq_group_lpm value { gid, op, {}, family, rules ? rules->data() : nullptr, rules ? rules->size() : 0 };
+
+            name.copy(value.name, Q_LPM_NAME_LEN-1);
+
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_LPM, &value, sizeof(value)) == -1)
+                throw pfq_error(errno, msg);
+        }
+
+        void
+        flow_ctl(int gid, int op, size_t capacity, const char *msg)
+        {
+            pfq_group_flows value { gid, op, capacity, nullptr, 0, 0, 0 };
+
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_FLOWS, &value, sizeof(value)) == -1)
+                throw pfq_error(errno, msg);
+        }
+
+        void
+        sketch_ctl(int gid, int op, sketch_key key, uint32_t width, uint32_t topk, uint32_t flags, const char *msg)
+        {
+            pfq_group_sketch value { gid, op, static_cast<int>(key), width, topk, flags, nullptr, 0, nullptr, 0 };
+
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_SKETCH, &value, sizeof(value)) == -1)
+                throw pfq_error(errno, msg);
+        }
+
         void
         open(size_t caplen, size_t rx_slots, size_t tx_slots)
         {
@@ -642,6 +761,27 @@ namespace pfq {
            return ret;
         }
 
+        //! Enable/disable the re-insertion of the 802.1Q tag into the captured packets.
+
+        void
+        vlan_insert_enable(bool value)
+        {
+            int v = static_cast<int>(value);
+            if (::setsockopt(fd_, PF_Q, Q_SO_SET_RX_VLAN_INSERT, &v, sizeof(v)) == -1)
+                throw pfq_error(errno, "PFQ: set vlan insert mode");
+        }
+
+        //! Check whether the re-insertion of the 802.1Q tag is enabled.
+
+        bool
+        is_vlan_insert_enabled() const
+        {
+           int ret; socklen_t size = sizeof(int);
+           if (::getsockopt(fd_, PF_Q, Q_SO_GET_RX_VLAN_INSERT, &ret, &size) == -1)
+                throw pfq_error(errno, "PFQ: get vlan insert mode");
+           return ret;
+        }
+
         //! Set the weight of the socket for the steering phase.
 
         void
@@ -664,6 +804,76 @@ namespace pfq {
         }
 
 
+        //! Set the overload policy of the Rx queue.
+        /*!
+         * The policy (Q_OVERLOAD_DROP_TAIL, Q_OVERLOAD_DROP_CLASS, Q_OVERLOAD_DROP_STATE
+         * or Q_OVERLOAD_RED) is evaluated before the copy, once the fill of the queue
+         * reaches the threshold (percent of the slots).
+         */
+
+        void
+        rx_overload(pfq_rx_overload const &ovl)
+        {
+           if (::setsockopt(fd_, PF_Q, Q_SO_SET_RX_OVERLOAD, &ovl, sizeof(ovl)) == -1)
+                throw pfq_error(errno, "PFQ: set Rx overload policy");
+        }
+
+
+        //! Return the overload policy of the Rx queue.
+
+        pfq_rx_overload
+        rx_overload() const
+        {
+           pfq_rx_overload ovl; socklen_t size = sizeof(ovl);
+           if (::getsockopt(fd_, PF_Q, Q_SO_GET_RX_OVERLOAD, &ovl, &size) == -1)
+                throw pfq_error(errno, "PFQ: get Rx overload policy");
+           return ovl;
+        }
+
+
+        //! Set the wake-up watermark of the Rx queue.
+        /*!
+         * Waiters (poll/epoll on the socket, or the eventfd) are woken when the queue
+         * reaches the given packets, or the given microseconds after the first packet
+         * entered the empty queue (0 = no timeout). The default is 1 packet, and
+         * at most the Rx slots of the socket.
+         */
+
+        void
+        rx_watermark(unsigned int packets, unsigned int microseconds = 0)
+        {
+           pfq_rx_watermark wm { packets, microseconds };
+           if (::setsockopt(fd_, PF_Q, Q_SO_SET_RX_WATERMARK, &wm, sizeof(wm)) == -1)
+                throw pfq_error(errno, "PFQ: set Rx watermark");
+        }
+
+
+        //! Return the wake-up watermark of the Rx queue.
+
+        pfq_rx_watermark
+        rx_watermark() const
+        {
+           pfq_rx_watermark wm; socklen_t size = sizeof(wm);
+           if (::getsockopt(fd_, PF_Q, Q_SO_GET_RX_WATERMARK, &wm, &size) == -1)
+                throw pfq_error(errno, "PFQ: get Rx watermark");
+           return wm;
+        }
+
+
+        //! Signal the eventfd on every wake-up of the Rx queue (-1 to detach).
+        /*!
+         * The same eventfd can be shared by many sockets, so that a single
+         * descriptor in the epoll set serves all of them.
+         */
+
+        void
+        rx_eventfd(int efd)
+        {
+           if (::setsockopt(fd_, PF_Q, Q_SO_SET_RX_EVENTFD, &efd, sizeof(efd)) == -1)
+                throw pfq_error(errno, "PFQ: set Rx eventfd");
+        }
+
+
         //! Specify the capture length of packets, in bytes.
         /*!
          * Capture length must be set before the socket is enabled.
@@ -908,15 +1118,19 @@ namespace pfq {
         /*!
          * If the policy is not specified, group_policy::shared is used by default.
          * If the class mask is not specified, class_mask::default_ is used by default.
+         *
+         * Each class in 'queues' (a subset of 'mask') is delivered to a dedicated Rx
+         * sub-queue of the socket, to be read with read_queue(). Sub-queues are
+         * assigned in class order and must be requested before the socket is enabled.
          */
 
         int
-        join_group(int gid, group_policy pol = group_policy::shared, class_mask mask = class_mask::default_)
+        join_group(int gid, group_policy pol = group_policy::shared, class_mask mask = class_mask::default_, class_mask queues = class_mask{})
         {
             if (pol == group_policy::undefined)
                 throw pfq_error("PFQ: join with undefined policy!");
 
-            struct pfq_group_join group { gid, static_cast<int16_t>(pol), static_cast<unsigned long>(mask) };
+            struct pfq_group_join group { gid, static_cast<int16_t>(pol), static_cast<unsigned long>(mask), static_cast<unsigned long>(queues) };
 
             socklen_t size = sizeof(group);
 
@@ -1116,14 +1330,52 @@ namespace pfq {
 
         net_queue
         read(long int microseconds = -1)
+        {
+            return read_queue(0, microseconds);
+        }
+
+        //! Return the number of Rx sub-queues in use.
+        /*!
+         * The sub-queue 0 is the default one; the others are dedicated to
+         * the classes specified when joining groups (see join_group).
+         */
+
+        size_t
+        rx_queues() const
+        {
+            if (!data()->shm_addr)
+                throw pfq_error("PFQ: rx_queues: socket not enabled");
+
+            auto q = static_cast<struct pfq_shared_queue *>(data()->shm_addr);
+            size_t n = 1;
+            for(; n < Q_MAX_RX_QUEUES && q->rx_class[n-1].len != 0; n++)
+            { }
+            return n;
+        }
+
+        //! Read packets in place from the given Rx sub-queue.
+        /*!
+         * Same as read(), for the given sub-queue (0 is the default one).
+         */
+
+        net_queue
+        read_queue(size_t queue, long int microseconds = -1)
         {
             if (!data()->shm_addr)
                 throw pfq_error("PFQ: read: socket not enabled");
 
+            if (queue >= Q_MAX_RX_QUEUES)
+                throw pfq_error("PFQ: read: bad Rx queue");
+
             auto q = static_cast<struct pfq_shared_queue *>(data()->shm_addr);
+            auto rx = queue == 0 ? &q->rx : &q->rx_class[queue-1];
+            auto rx_addr = this->rx_queue_addr(queue);
             unsigned int data, index;
 
-            data = __atomic_load_n(&q->rx.data, __ATOMIC_RELAXED);
+            if (rx->len == 0)
+                throw pfq_error("PFQ: read: Rx queue not in use");
+
+            data = __atomic_load_n(&rx->data, __ATOMIC_RELAXED);
             index = Q_SHARED_QUEUE_INDEX(data);
 
             // at wrap-around reset Rx slots...
@@ -1131,7 +1383,7 @@ namespace pfq {
 
             if (((index+1) & 0xfe)== 0)
             {
-                auto raw = static_cast<char *>(data_->rx_queue_addr) + ((index+1) & 1) * data_->rx_queue_size;
+                auto raw = rx_addr + ((index+1) & 1) * data_->rx_queue_size;
                 auto end = raw + data_->rx_queue_size;
                 const uint8_t rst = index & 1;
                 for(; raw < end; raw += data_->rx_slot_size)
@@ -1151,14 +1403,29 @@ namespace pfq {
             // swap the net_queue...
             //
 
-            data = __atomic_exchange_n(&q->rx.data, (unsigned int)((index+1) << 24), __ATOMIC_RELAXED);
+            data = __atomic_exchange_n(&rx->data, (unsigned int)((index+1) << 24), __ATOMIC_RELAXED);
 
             auto queue_len = std::min(static_cast<size_t>(Q_SHARED_QUEUE_LEN(data)), data_->rx_slots);
 
-            return net_queue(static_cast<char *>(data_->rx_queue_addr) + (index & 1) * data_->rx_queue_size,
+            return net_queue(rx_addr + (index & 1) * data_->rx_queue_size,
                          data_->rx_slot_size, queue_len, index);
         }
 
+        //! Return the number of packets waiting in the default Rx queue.
+        /*!
+         * The length is read from the shared memory: no system call is involved.
+         */
+
+        size_t
+        available() const
+        {
+            if (!data()->shm_addr)
+                throw pfq_error("PFQ: available: socket not enabled");
+
+            auto q = static_cast<struct pfq_shared_queue *>(data()->shm_addr);
+            return Q_SHARED_QUEUE_LEN(__atomic_load_n(&q->rx.data, __ATOMIC_RELAXED));
+        }
+
         //! Return the current commit version (used internally by the memory mapped queue).
 
         uint8_t
@@ -1210,8 +1477,10 @@ namespace pfq {
             size_t n = 0;
             for(; it != it_e; ++it)
             {
-                while (!it.ready())
-                    std::this_thread::yield();
+                it.prefetch();
+
+                if (!it.ready())
+                    it.wait();
 
                 callback(user, &(*it), reinterpret_cast<const char *>(it.data()));
                 n++;
@@ -1272,6 +1541,206 @@ namespace pfq {
             });
         }
 
+        //! Create a named bloom filter for the given group.
+        /*!
+         * The filter has m bins (rounded up to a power of 2) and keys of the given
+         * type: Q_BLOOM_KEY_IPV4 and Q_BLOOM_KEY_IPV6 addresses are matched with the
+         * network prefix, Q_BLOOM_KEY_TUPLE keys are pfq_bloom_tuple.
+         * It is used by the bloom_table functions and can be updated while the
+         * computation is running.
+         */
+
+        void bloom_create(int gid, std::string const &name, unsigned int m, int prefix = 32, int key = Q_BLOOM_KEY_IPV4)
+        {
+            bloom_ctl(gid, Q_BLOOM_CREATE, name, m, key, prefix, nullptr, 0, "PFQ: bloom create");
+        }
+
+        //! Destroy a named bloom filter of the given group.
+
+        void bloom_destroy(int gid, std::string const &name)
+        {
+            bloom_ctl(gid, Q_BLOOM_DESTROY, name, 0, 0, 0, nullptr, 0, "PFQ: bloom destroy");
+        }
+
+        //! Add the keys (addresses in network order) to a named bloom filter.
+        /*!
+         * Keys are uint32_t (IPv4), in6_addr (IPv6) or pfq_bloom_tuple, according to the filter.
+         */
+
+        template <typename Key>
+        void bloom_add(int gid, std::string const &name, std::vector<Key> const &keys)
+        {
+            bloom_ctl(gid, Q_BLOOM_ADD, name, 0, 0, 0, keys.data(), keys.size(), "PFQ: bloom add");
+        }
+
+        //! Remove the keys (addresses in network order) from a named bloom filter.
+
+        template <typename Key>
+        void bloom_remove(int gid, std::string const &name, std::vector<Key> const &keys)
+        {
+            bloom_ctl(gid, Q_BLOOM_REMOVE, name, 0, 0, 0, keys.data(), keys.size(), "PFQ: bloom remove");
+        }
+
+        //! Replace the content of a named bloom filter with the given keys (addresses in network order).
+
+        template <typename Key>
+        void bloom_load(int gid, std::string const &name, std::vector<Key> const &keys)
+        {
+            bloom_ctl(gid, Q_BLOOM_LOAD, name, 0, 0, 0, keys.data(), keys.size(), "PFQ: bloom load");
+        }
+
+        //! Create a named longest-prefix-match table (family 4 or 6) for the given group.
+        /*!
+         * It is used by the lpm functions and can be updated while the
+         * computation is running.
+         */
+
+        void lpm_create(int gid, std::string const &name, int family = 4)
+        {
+            lpm_ctl(gid, Q_LPM_CREATE, name, family, nullptr, "PFQ: lpm create");
+        }
+
+        //! Destroy a named lpm table of the given group.
+
+        void lpm_destroy(int gid, std::string const &name)
+        {
+            lpm_ctl(gid, Q_LPM_DESTROY, name, 0, nullptr, "PFQ: lpm destroy");
+        }
+
+        //! Add the rules to a named lpm table: a rule with the same prefix is replaced.
+
+        void lpm_add(int gid, std::string const &name, std::vector<pfq_lpm_rule> const &rules)
+        {
+            lpm_ctl(gid, Q_LPM_ADD, name, 0, &rules, "PFQ: lpm add");
+        }
+
+        //! Remove the rules (the value is ignored) from a named lpm table.
+
+        void lpm_remove(int gid, std::string const &name, std::vector<pfq_lpm_rule> const &rules)
+        {
+            lpm_ctl(gid, Q_LPM_REMOVE, name, 0, &rules, "PFQ: lpm remove");
+        }
+
+        //! Replace the content of a named lpm table with the given rules.
+
+        void lpm_load(int gid, std::string const &name, std::vector<pfq_lpm_rule> const &rules)
+        {
+            lpm_ctl(gid, Q_LPM_LOAD, name, 0, &rules, "PFQ: lpm load");
+        }
+
+        //! Create the flow table of the given group (capacity: entries per cpu).
+        /*!
+         * The table is keyed by 5-tuple and updated by the flow functions of the
+         * computation (flow_update, flow_set_state...).
+         */
+
+        void flow_create(int gid, size_t capacity)
+        {
+            flow_ctl(gid, Q_FLOW_CREATE, capacity, "PFQ: flow create");
+        }
+
+        //! Destroy the flow table of the given group.
+
+        void flow_destroy(int gid)
+        {
+            flow_ctl(gid, Q_FLOW_DESTROY, 0, "PFQ: flow destroy");
+        }
+
+        //! Remove all the flows from the flow table of the given group.
+
+        void flow_clear(int gid)
+        {
+            flow_ctl(gid, Q_FLOW_CLEAR, 0, "PFQ: flow clear");
+        }
+
+        //! Set the active and idle timeouts (seconds, 0 = none) of the flow table of the given group.
+        /*!
+         * Expired flows are exported as records to the flow rings of the sockets
+         * of the group. \see flow_ring, pfq::flow_reader
+         */
+
+        void flow_timeouts(int gid, unsigned int active, unsigned int idle)
+        {
+            pfq_group_flows value { gid, Q_FLOW_TIMEOUTS, 0, nullptr, 0, active, idle };
+
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_FLOWS, &value, sizeof(value)) == -1)
+                throw pfq_error(errno, "PFQ: flow timeouts");
+        }
+
+        //! Specify the length of the flow records ring, in number of records (0 = disabled).
+
+        void
+        flow_ring(size_t len)
+        {
+            if (is_enabled())
+                throw pfq_error("PFQ: enabled (flow ring could not be set)");
+
+            if (::setsockopt(fd_, PF_Q, Q_SO_SET_FLOW_RING, &len, sizeof(len)) == -1)
+                throw pfq_error(errno, "PFQ: set flow ring error");
+        }
+
+        //! Export (up to max) the flows of the given group: the per-cpu entries, tagged by cpu.
+
+        std::vector<pfq_flow_stat>
+        flow_export(int gid, size_t max) const
+        {
+            std::vector<pfq_flow_stat> flows(max);
+
+            pfq_group_flows value { gid, 0, 0, flows.data(), flows.size(), 0, 0 };
+            socklen_t size = sizeof(value);
+
+            if (::getsockopt(fd_, PF_Q, Q_SO_GET_GROUP_FLOWS, &value, &size) == -1)
+                throw pfq_error(errno, "PFQ: flow export error");
+
+            flows.resize(value.n);
+            return flows;
+        }
+
+        //! Create the sketch of the given group for the given key.
+        /*!
+         * A count-min sketch (width columns) with the top-k heavy hitters per cpu,
+         * and a hyperloglog of the distinct keys, updated by the sketch functions of
+         * the computation (sketch_src, sketch_dst, sketch_flow). If bytes is true,
+         * the bytes are counted rather than the packets.
+         */
+
+        void sketch_create(int gid, sketch_key key, uint32_t width, uint32_t topk, bool bytes = false)
+        {
+            sketch_ctl(gid, Q_SKETCH_CREATE, key, width, topk, bytes ? Q_SKETCH_BYTES : 0, "PFQ: sketch create");
+        }
+
+        //! Destroy a sketch of the given group.
+
+        void sketch_destroy(int gid, sketch_key key)
+        {
+            sketch_ctl(gid, Q_SKETCH_DESTROY, key, 0, 0, 0, "PFQ: sketch destroy");
+        }
+
+        //! Reset a sketch of the given group.
+
+        void sketch_clear(int gid, sketch_key key)
+        {
+            sketch_ctl(gid, Q_SKETCH_CLEAR, key, 0, 0, 0, "PFQ: sketch clear");
+        }
+
+        //! Read a sketch of the given group: (up to max) heavy hitters, total and distinct keys.
+
+        pfq::sketch
+        group_sketch(int gid, sketch_key key, size_t max = 32) const
+        {
+            std::vector<pfq_sketch_item> items(max);
+            uint8_t hll[Q_SKETCH_HLL_REGS];
+
+            pfq_group_sketch value { gid, 0, static_cast<int>(key), 0, 0, 0, items.data(), items.size(), hll, 0 };
+            socklen_t size = sizeof(value);
+
+            if (::getsockopt(fd_, PF_Q, Q_SO_GET_GROUP_SKETCH, &value, &size) == -1)
+                throw pfq_error(errno, "PFQ: sketch read error");
+
+            items.resize(value.n);
+            return pfq::sketch { std::move(items), value.total, sketch_distinct(hll) };
+        }
+
         //! Return the socket statistics.
 
         pfq_stats
@@ -1464,6 +1933,74 @@ namespace pfq {
             return false;
         }
 
+        //! Schedule the transmission of a batch of packets.
+        /*!
+         * The packets, gathered from their chunks, are copied into a single Tx queue and
+         * published at once. If 'async' is true and 'queue' is set to any_queue, the TSS
+         * symmetric hash of the first packet selects the Tx queue of the batch.
+         * Return the number of packets enqueued (less than n if the queue is full).
+         */
+
+        size_t
+        send_batch(const tx_packet *pkts, size_t n, bool async = false, int queue = any_queue)
+        {
+            if (n == 0)
+                return 0;
+
+            return tx_batch(n, async, queue,
+                    [&] {
+                        return header_hash(pkts[0].iov, pkts[0].iovcnt);
+                    },
+                    [&](size_t i) {
+                        size_t len = 0;
+                        for(size_t j = 0; j < pkts[i].iovcnt; j++)
+                            len += pkts[i].iov[j].iov_len;
+                        return len;
+                    },
+                    [&](size_t i, struct pfq_pkthdr *hdr, size_t len) {
+                        hdr->tstamp.tv64 = pkts[i].nsec;
+                        hdr->data.copies = pkts[i].copies;
+                        hdr->ifindex     = pkts[i].ifindex;
+                        hdr->queue       = static_cast<uint8_t>(pkts[i].qindex);
+                        auto p = reinterpret_cast<char *>(hdr+1);
+                        for(size_t j = 0; j < pkts[i].iovcnt && len; j++)
+                        {
+                            auto l = std::min(pkts[i].iov[j].iov_len, len);
+                            memcpy(p, pkts[i].iov[j].iov_base, l);
+                            p += l;
+                            len -= l;
+                        }
+                    });
+        }
+
+        //! Schedule the transmission of a range of const_buffer, sharing the metadata.
+
+        template <typename Iter>
+        size_t
+        send_batch(Iter first, Iter last, int ifindex = 0, int qindex = 0, uint64_t nsec = 0, unsigned int copies = 1, bool async = false, int queue = any_queue)
+        {
+            auto n = static_cast<size_t>(std::distance(first, last));
+            if (n == 0)
+                return 0;
+
+            return tx_batch(n, async, queue,
+                    [&] {
+                        struct iovec iov = { const_cast<char *>((*first).first), (*first).second };
+                        return header_hash(&iov, 1);
+                    },
+                    [&](size_t) {
+                        return (*first).second;
+                    },
+                    [&](size_t, struct pfq_pkthdr *hdr, size_t len) {
+                        hdr->tstamp.tv64 = nsec;
+                        hdr->data.copies = copies;
+                        hdr->ifindex     = ifindex;
+                        hdr->queue       = static_cast<uint8_t>(qindex);
+                        memcpy(hdr+1, (*first).first, len);
+                        ++first;
+                    });
+        }
+
         //! Transmit the packets in the queue.
         /*!
          * Transmit the packets in the queue of the socket. 'queue = 0' is the
@@ -1476,6 +2013,89 @@ namespace pfq {
             if (::setsockopt(fd_, PF_Q, Q_SO_TX_QUEUE, &queue, sizeof(queue)) == -1)
                 throw pfq_error(errno, "PFQ: Tx queue");
         }
+
+    private:
+
+        //! Symmetric hash of a packet in chunks: the headers are gathered first.
+
+        static uint32_t
+        header_hash(const struct iovec *iov, size_t iovcnt)
+        {
+            char buf[128] = { 0 };  // Ethernet, IPv4 with options and ports
+            size_t len = 0;
+
+            for(size_t j = 0; j < iovcnt && len < sizeof(buf); j++)
+            {
+                auto l = std::min(iov[j].iov_len, sizeof(buf) - len);
+                memcpy(buf + len, iov[j].iov_base, l);
+                len += l;
+            }
+
+            return symmetric_hash(buf);
+        }
+
+        //! Reserve the space of the batch in the Tx queue, write the packets and publish them with a single release store.
+
+        template <typename Hash, typename Length, typename Write>
+        size_t
+        tx_batch(size_t n, bool async, int queue, Hash hash, Length length, Write write)
+        {
+            if (unlikely(!data_->shm_addr))
+                throw pfq_error("PFQ: send_batch: socket not enabled");
+
+            int tss;
+
+            auto tx = [&] {
+
+                if (async) {
+                    if (unlikely(data_->tx_num_async == 0))
+                        throw pfq_error("PFQ: send_batch: socket not bound to async threads");
+                    tss = static_cast<int>(fold(queue == any_queue ? hash() : static_cast<uint32_t>(queue), static_cast<uint32_t>(data_->tx_num_async)));
+                    return &static_cast<struct pfq_shared_queue *>(data_->shm_addr)->tx_async[tss];
+                }
+
+                tss = -1;
+                return &static_cast<struct pfq_shared_queue *>(data_->shm_addr)->tx;
+            }();
+
+            // swap the queue and load the offset, once per batch...
+            //
+
+            auto index = __atomic_load_n(&tx->cons.index, __ATOMIC_RELAXED);
+            if (index != __atomic_load_n(&tx->prod.index, __ATOMIC_RELAXED))
+            {
+                __atomic_store_n(&tx->prod.index, index, __ATOMIC_RELAXED);
+                __atomic_store_n((index & 1) ? &tx->prod.off1 : &tx->prod.off0, 0, __ATOMIC_RELAXED);
+            }
+
+            char * base_addr = static_cast<char *>(data_->tx_queue_addr) + data_->tx_queue_size * static_cast<size_t>(2 * (1+tss) + (index & 1 ? 1 : 0));
+
+            auto offset = __atomic_load_n((index & 1) ? &tx->prod.off1 : &tx->prod.off0, __ATOMIC_RELAXED);
+
+            size_t i = 0;
+            for(; i < n; i++)
+            {
+                auto len = std::min(length(i), data_->tx_slot_size - sizeof(struct pfq_pkthdr));
+                auto slot_size = sizeof(struct pfq_pkthdr) + align<8>(len);
+
+                if ((static_cast<size_t>(offset) + slot_size) >= data_->tx_queue_size)
+                    break;
+
+                auto hdr = (struct pfq_pkthdr *)(base_addr + offset);
+                hdr->caplen = static_cast<uint16_t>(len);
+                write(i, hdr, len);
+
+                offset += static_cast<ptrdiff_t>(slot_size);
+            }
+
+            // publish the whole batch...
+            //
+
+            if (i)
+                __atomic_store_n((index & 1) ? &tx->prod.off1 : &tx->prod.off0, offset, __ATOMIC_RELEASE);
+
+            return i;
+        }
     };
 
 
@@ -1483,7 +2103,8 @@ namespace pfq {
     typename std::basic_ostream<CharT, Traits> &
     operator<<(std::basic_ostream<CharT,Traits> &out, const pfq_stats& rhs)
     {
-        return out << rhs.recv << ' ' << rhs.lost << ' ' << rhs.drop << ' ' << rhs.sent << ' ' << rhs.disc << ' ' << rhs.frwd << ' ' << rhs.kern;
+        return out << rhs.recv << ' ' << rhs.lost << ' ' << rhs.drop << ' ' << rhs.sent << ' ' << rhs.disc << ' ' << rhs.frwd << ' ' << rhs.kern
+                   << ' ' << rhs.shed_tail << ' ' << rhs.shed_class << ' ' << rhs.shed_state << ' ' << rhs.shed_red;
     }
 
     inline pfq_stats&
@@ -1499,6 +2120,11 @@ namespace pfq {
         lhs.frwd += rhs.frwd;
         lhs.kern += rhs.kern;
 
+        lhs.shed_tail  += rhs.shed_tail;
+        lhs.shed_class += rhs.shed_class;
+        lhs.shed_state += rhs.shed_state;
+        lhs.shed_red   += rhs.shed_red;
+
         return lhs;
     }
 
@@ -1515,6 +2141,11 @@ namespace pfq {
         lhs.frwd -= rhs.frwd;
         lhs.kern -= rhs.kern;
 
+        lhs.shed_tail  -= rhs.shed_tail;
+        lhs.shed_class -= rhs.shed_class;
+        lhs.shed_state -= rhs.shed_state;
+        lhs.shed_red   -= rhs.shed_red;
+
         return lhs;
     }
 
@@ -24,12 +24,34 @@
 #pragma once
 
 #include <iterator>
+#include <thread>
 
 #include <linux/pf_q.h>
 
 
 namespace pfq {
 
+    //! Pause iterations before yielding, while waiting for a slot to be committed.
+
+    constexpr unsigned int spin_budget = 1024;
+
+    //! Slots prefetched ahead of the consumer.
+
+    constexpr size_t prefetch_slots = 4;
+
+    //! Spin-wait hint to the CPU.
+
+    inline void relax()
+    {
+#if defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+#else
+        asm volatile("" ::: "memory");
+#endif
+    }
+
     //! This class represent a queue of packets.
     /*!
      * The memory where packets are stored is not owned by this class.
@@ -57,6 +79,8 @@ namespace pfq {
             : hdr_(other.hdr_), slot_size_(other.slot_size_), index_(other.index_)
             {}
 
+            iterator & operator=(const iterator &other) = default;
+
             iterator &
             operator++()
             {
@@ -98,6 +122,30 @@ namespace pfq {
                 return b;
             }
 
+            //! Wait for the packet to be committed: bounded spin, then yield.
+
+            void
+            wait() const
+            {
+                for(unsigned int spin = 0; !ready();)
+                {
+                    if (spin++ < spin_budget)
+                        relax();
+                    else
+                        std::this_thread::yield();
+                }
+            }
+
+            //! Prefetch the header and the first bytes of the packet prefetch_slots ahead (prefetches do not fault).
+
+            void
+            prefetch() const
+            {
+                auto ahead = reinterpret_cast<const char *>(hdr_) + prefetch_slots * slot_size_;
+                __builtin_prefetch(ahead, 0, 3);
+                __builtin_prefetch(ahead + 64, 0, 3);
+            }
+
             bool
             operator==(const iterator &other) const
             {
@@ -132,6 +180,8 @@ namespace pfq {
             : hdr_(other.hdr_), slot_size_(other.slot_size_), index_(other.index_)
             {}
 
+            const_iterator & operator=(const const_iterator &other) = default;
+
             ~const_iterator() = default;
 
             const_iterator &
@@ -175,6 +225,30 @@ namespace pfq {
                 return b;
             }
 
+            //! Wait for the packet to be committed: bounded spin, then yield.
+
+            void
+            wait() const
+            {
+                for(unsigned int spin = 0; !ready();)
+                {
+                    if (spin++ < spin_budget)
+                        relax();
+                    else
+                        std::this_thread::yield();
+                }
+            }
+
+            //! Prefetch the header and the first bytes of the packet prefetch_slots ahead (prefetches do not fault).
+
+            void
+            prefetch() const
+            {
+                auto ahead = reinterpret_cast<const char *>(hdr_) + prefetch_slots * slot_size_;
+                __builtin_prefetch(ahead, 0, 3);
+                __builtin_prefetch(ahead + 64, 0, 3);
+            }
+
             bool
             operator==(const const_iterator &other) const
             {
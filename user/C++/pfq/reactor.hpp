@@ -0,0 +1,288 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include <pfq/pfq.hpp>
+#include <pfq/queue.hpp>
+#include <pfq/exception.hpp>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+
+namespace pfq {
+
+    //! Multi-socket reactor.
+    /*!
+     * The reactor owns a set of sockets and serves them from a single thread:
+     * each round visits all the sockets, starting from a rotating one, and
+     * consumes at most 'batch' packets per socket, so that a busy socket does
+     * not starve the others. A queue is swapped again only when it has been
+     * fully consumed.
+     *
+     * When no packet is available the reactor either waits on an epoll set
+     * (woken according to the Rx watermark of the sockets, \see socket::rx_watermark)
+     * or, in busy-poll mode, backs off adaptively: it yields for a few rounds
+     * and then sleeps for exponentially longer periods, up to max_backoff.
+     */
+
+    class reactor
+    {
+    public:
+
+        //! Options of the reactor.
+
+        struct options
+        {
+            size_t batch = 256;                                 //!< per-socket budget of packets, per round
+            bool   busy_poll = false;                           //!< spin instead of waiting on epoll
+            std::chrono::microseconds max_backoff {1000};       //!< busy-poll: longest sleep when idle
+        };
+
+        reactor()
+        : reactor(options())
+        {}
+
+        explicit reactor(options opt)
+        : opt_(opt)
+        , epfd_(-1)
+        , next_(0)
+        , idle_(0)
+        , stop_(false)
+        {
+            if (opt_.batch == 0)
+                throw pfq_error("PFQ: reactor: batch must be greater than 0");
+
+            epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+            if (epfd_ == -1)
+                throw pfq_error(errno, "PFQ: reactor: epoll_create");
+        }
+
+        ~reactor()
+        {
+            if (epfd_ != -1)
+                ::close(epfd_);
+        }
+
+        //! The reactor is not copyable.
+
+        reactor(const reactor &) = delete;
+        reactor& operator=(const reactor &) = delete;
+
+        //! Add a socket to the reactor (which takes the ownership) and return its index.
+
+        size_t
+        add(socket &&q)
+        {
+            if (q.fd() == -1)
+                throw pfq_error("PFQ: reactor: socket not open");
+
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u64 = entries_.size();
+
+            if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, q.fd(), &ev) == -1)
+                throw pfq_error(errno, "PFQ: reactor: epoll_ctl");
+
+            entries_.emplace_back(std::move(q));
+            return entries_.size() - 1;
+        }
+
+        //! Return the number of sockets.
+
+        size_t
+        size() const
+        {
+            return entries_.size();
+        }
+
+        //! Return the socket at the given index.
+
+        socket &
+        operator[](size_t n)
+        {
+            return entries_.at(n).q;
+        }
+
+        socket const &
+        operator[](size_t n) const
+        {
+            return entries_.at(n).q;
+        }
+
+        //! Serve the sockets once, waiting for packets if none is available.
+        /*!
+         * The callback is invoked for each packet with the signature:
+         *
+         * void callback(size_t index, const struct pfq_pkthdr *h, const char *data);
+         *
+         * A timeout in microseconds applies to the wait (epoll mode).
+         * Return the number of packets processed.
+         */
+
+        template <typename Fun>
+        size_t dispatch(Fun callback, long int microseconds = -1)
+        {
+            auto n = round(callback);
+            if (n)
+            {
+                idle_ = 0;
+                return n;
+            }
+
+            if (opt_.busy_poll)
+                backoff();
+            else
+                wait(microseconds);
+
+            return round(callback);
+        }
+
+        //! Serve the sockets until stop() is called (possibly from the callback or another thread).
+
+        template <typename Fun>
+        void run(Fun callback)
+        {
+            stop_.store(false, std::memory_order_relaxed);
+
+            while (!stop_.load(std::memory_order_relaxed))
+                dispatch(callback, 100000);
+        }
+
+        //! Stop the run loop.
+
+        void
+        stop()
+        {
+            stop_.store(true, std::memory_order_relaxed);
+        }
+
+    private:
+
+        struct entry
+        {
+            entry(socket &&s)
+            : q(std::move(s))
+            , queue()
+            , it(queue.begin())
+            {}
+
+            entry(entry &&other)
+            : q(std::move(other.q))
+            , queue(other.queue)
+            , it(other.it)
+            {}
+
+            socket                  q;
+            net_queue               queue;
+            net_queue::iterator     it;     // first packet not yet consumed
+        };
+
+        template <typename Fun>
+        size_t serve(entry &e, size_t index, Fun &callback)
+        {
+            if (e.it == e.queue.end())
+            {
+                if (e.q.available() == 0)
+                    return 0;
+
+                e.queue = e.q.read(0);
+                e.it = e.queue.begin();
+            }
+
+            size_t n = 0;
+            for(; n < opt_.batch && e.it != e.queue.end(); ++e.it, ++n)
+            {
+                e.it.prefetch();
+
+                if (!e.it.ready())
+                    e.it.wait();
+
+                callback(index, &(*e.it), reinterpret_cast<const char *>(e.it.data()));
+            }
+
+            return n;
+        }
+
+        template <typename Fun>
+        size_t round(Fun &callback)
+        {
+            auto size = entries_.size();
+            size_t n = 0;
+
+            for(size_t k = 0; k < size; k++)
+            {
+                auto i = (next_ + k) % size;
+                n += serve(entries_[i], i, callback);
+            }
+
+            if (size)
+                next_ = (next_ + 1) % size;
+
+            return n;
+        }
+
+        void
+        wait(long int microseconds)
+        {
+            struct epoll_event ev[64];
+            auto timeout = microseconds < 0 ? -1 : static_cast<int>((microseconds + 999) / 1000);
+
+            if (::epoll_wait(epfd_, ev, 64, timeout) == -1 && errno != EINTR)
+                throw pfq_error(errno, "PFQ: reactor: epoll_wait");
+        }
+
+        void
+        backoff()
+        {
+            constexpr size_t spin_rounds = 16;
+
+            if (idle_++ < spin_rounds) {
+                std::this_thread::yield();
+                return;
+            }
+
+            auto shift = std::min<size_t>(idle_ - spin_rounds, 20);
+            auto pause = std::min(std::chrono::microseconds(1 << shift), opt_.max_backoff);
+            std::this_thread::sleep_for(pause);
+        }
+
+        options                 opt_;
+        int                     epfd_;
+        std::vector<entry>      entries_;
+        size_t                  next_;
+        size_t                  idle_;
+        std::atomic<bool>       stop_;
+    };
+
+} // namespace pfq
@@ -246,7 +246,7 @@ namespace pfq {
             ih->protocol != IPPROTO_UDP)
             return (ih->saddr ^ ih->daddr);
 
-        ptr += sizeof(ih->ihl << 2);
+        ptr += ih->ihl << 2;
 
         auto uh = reinterpret_cast<const udphdr *>(ptr);
         return (ih->saddr ^ ih->daddr ^ uh->source ^ uh->dest);
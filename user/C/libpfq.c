@@ -42,6 +42,7 @@
 #include <ctype.h>
 #include <sched.h>
 #include <fcntl.h>
+#include <math.h>
 
 #include <poll.h>
 
@@ -450,6 +451,28 @@ pfq_is_timestamping_enabled(pfq_t const *q)
 }
 
 
+int
+pfq_vlan_insert_enable(pfq_t *q, int value)
+{
+	if (setsockopt(q->fd, PF_Q, Q_SO_SET_RX_VLAN_INSERT, &value, sizeof(value)) == -1) {
+		return Q_ERROR(q, "PFQ: set vlan insert mode");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_is_vlan_insert_enabled(pfq_t const *q)
+{
+	int ret; socklen_t size = sizeof(int);
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_RX_VLAN_INSERT, &ret, &size) == -1) {
+	        return Q_ERROR(q, "PFQ: get vlan insert mode");
+	}
+	return Q_VALUE(q, ret);
+}
+
+
 int
 pfq_set_weight(pfq_t *q, int value)
 {
@@ -471,6 +494,60 @@ pfq_get_weight(pfq_t const *q)
 	return Q_VALUE(q, ret);
 }
 
+
+int
+pfq_set_rx_overload(pfq_t *q, struct pfq_rx_overload const *ovl)
+{
+	if (setsockopt(q->fd, PF_Q, Q_SO_SET_RX_OVERLOAD, ovl, sizeof(*ovl)) == -1) {
+		return Q_ERROR(q, "PFQ: set Rx overload policy");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_get_rx_overload(pfq_t const *q, struct pfq_rx_overload *ovl)
+{
+	socklen_t size = sizeof(*ovl);
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_RX_OVERLOAD, ovl, &size) == -1) {
+	        return Q_ERROR(q, "PFQ: get Rx overload policy");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_set_rx_watermark(pfq_t *q, struct pfq_rx_watermark const *wm)
+{
+	if (setsockopt(q->fd, PF_Q, Q_SO_SET_RX_WATERMARK, wm, sizeof(*wm)) == -1) {
+		return Q_ERROR(q, "PFQ: set Rx watermark");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_get_rx_watermark(pfq_t const *q, struct pfq_rx_watermark *wm)
+{
+	socklen_t size = sizeof(*wm);
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_RX_WATERMARK, wm, &size) == -1) {
+	        return Q_ERROR(q, "PFQ: get Rx watermark");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_set_rx_eventfd(pfq_t *q, int efd)
+{
+	if (setsockopt(q->fd, PF_Q, Q_SO_SET_RX_EVENTFD, &efd, sizeof(efd)) == -1) {
+		return Q_ERROR(q, "PFQ: set Rx eventfd");
+	}
+	return Q_OK(q);
+}
+
 int
 pfq_ifindex(pfq_t const *q, const char *dev)
 {
@@ -818,12 +895,19 @@ pfq_group_fprog_reset(pfq_t *q, int gid)
 
 int
 pfq_join_group(pfq_t *q, int gid, unsigned long class_mask, int group_policy)
+{
+	return pfq_join_group_queues(q, gid, class_mask, 0, group_policy);
+}
+
+
+int
+pfq_join_group_queues(pfq_t *q, int gid, unsigned long class_mask, unsigned long queue_mask, int group_policy)
 {
 	if (group_policy == Q_POLICY_GROUP_UNDEFINED) {
 		return Q_ERROR(q, "PFQ: join with undefined policy!");
 	}
 
-	struct pfq_group_join group = { gid, group_policy, class_mask };
+	struct pfq_group_join group = { gid, group_policy, class_mask, queue_mask };
 
 	socklen_t size = sizeof(group);
 	if (getsockopt(q->fd, PF_Q, Q_SO_GROUP_JOIN, &group, &size) == -1) {
@@ -948,26 +1032,360 @@ int pfq_vlan_reset_filter(pfq_t *q, int gid, int vid)
 }
 
 
+static int
+pfq_bloom_ctl(pfq_t *q, int gid, int op, const char *name, unsigned int m, int key, int prefix,
+	      const void *keys, size_t n, const char *msg)
+{
+	struct pfq_group_bloom value = { gid, op, { 0 }, m, prefix, key, keys, n };
+
+	strncpy(value.name, name, Q_BLOOM_NAME_LEN-1);
+
+	if (setsockopt(q->fd, PF_Q, Q_SO_GROUP_BLOOM, &value, sizeof(value)) == -1) {
+		return Q_ERROR(q, msg);
+	}
+
+	return Q_OK(q);
+}
+
+
+int
+pfq_bloom_create(pfq_t *q, int gid, const char *name, unsigned int m, int key, int prefix)
+{
+	return pfq_bloom_ctl(q, gid, Q_BLOOM_CREATE, name, m, key, prefix, NULL, 0, "PFQ: bloom create");
+}
+
+
+int
+pfq_bloom_destroy(pfq_t *q, int gid, const char *name)
+{
+	return pfq_bloom_ctl(q, gid, Q_BLOOM_DESTROY, name, 0, 0, 0, NULL, 0, "PFQ: bloom destroy");
+}
+
+
+int
+pfq_bloom_add(pfq_t *q, int gid, const char *name, const void *keys, size_t n)
+{
+	return pfq_bloom_ctl(q, gid, Q_BLOOM_ADD, name, 0, 0, 0, keys, n, "PFQ: bloom add");
+}
+
+
+int
+pfq_bloom_remove(pfq_t *q, int gid, const char *name, const void *keys, size_t n)
+{
+	return pfq_bloom_ctl(q, gid, Q_BLOOM_REMOVE, name, 0, 0, 0, keys, n, "PFQ: bloom remove");
+}
+
+
+int
+pfq_bloom_load(pfq_t *q, int gid, const char *name, const void *keys, size_t n)
+{
+	return pfq_bloom_ctl(q, gid, Q_BLOOM_LOAD, name, 0, 0, 0, keys, n, "PFQ: bloom load");
+}
+
+
+static int
+pfq_lpm_ctl(pfq_t *q, int gid, int op, const char *name, int family,
+	    const struct pfq_lpm_rule *rules, size_t n, const char *msg)
+{
+	struct pfq_group_lpm value = { gid, op, { 0 }, family, rules, n };
+
+	strncpy(value.name, name, Q_LPM_NAME_LEN-1);
+
+	if (setsockopt(q->fd, PF_Q, Q_SO_GROUP_LPM, &value, sizeof(value)) == -1) {
+		return Q_ERROR(q, msg);
+	}
+
+	return Q_OK(q);
+}
+
+
+int
+pfq_lpm_create(pfq_t *q, int gid, const char *name, int family)
+{
+	return pfq_lpm_ctl(q, gid, Q_LPM_CREATE, name, family, NULL, 0, "PFQ: lpm create");
+}
+
+
+int
+pfq_lpm_destroy(pfq_t *q, int gid, const char *name)
+{
+	return pfq_lpm_ctl(q, gid, Q_LPM_DESTROY, name, 0, NULL, 0, "PFQ: lpm destroy");
+}
+
+
+int
+pfq_lpm_add(pfq_t *q, int gid, const char *name, const struct pfq_lpm_rule *rules, size_t n)
+{
+	return pfq_lpm_ctl(q, gid, Q_LPM_ADD, name, 0, rules, n, "PFQ: lpm add");
+}
+
+
+int
+pfq_lpm_remove(pfq_t *q, int gid, const char *name, const struct pfq_lpm_rule *rules, size_t n)
+{
+	return pfq_lpm_ctl(q, gid, Q_LPM_REMOVE, name, 0, rules, n, "PFQ: lpm remove");
+}
+
+
+int
+pfq_lpm_load(pfq_t *q, int gid, const char *name, const struct pfq_lpm_rule *rules, size_t n)
+{
+	return pfq_lpm_ctl(q, gid, Q_LPM_LOAD, name, 0, rules, n, "PFQ: lpm load");
+}
+
+
+static int
+pfq_flow_ctl(pfq_t *q, int gid, int op, size_t capacity, const char *msg)
+{
+	struct pfq_group_flows value = { gid, op, capacity, NULL, 0, 0, 0 };
+
+	if (setsockopt(q->fd, PF_Q, Q_SO_GROUP_FLOWS, &value, sizeof(value)) == -1) {
+		return Q_ERROR(q, msg);
+	}
+
+	return Q_OK(q);
+}
+
+
+int
+pfq_flow_create(pfq_t *q, int gid, size_t capacity)
+{
+	return pfq_flow_ctl(q, gid, Q_FLOW_CREATE, capacity, "PFQ: flow create");
+}
+
+
+int
+pfq_flow_destroy(pfq_t *q, int gid)
+{
+	return pfq_flow_ctl(q, gid, Q_FLOW_DESTROY, 0, "PFQ: flow destroy");
+}
+
+
+int
+pfq_flow_clear(pfq_t *q, int gid)
+{
+	return pfq_flow_ctl(q, gid, Q_FLOW_CLEAR, 0, "PFQ: flow clear");
+}
+
+
+int
+pfq_flow_set_timeouts(pfq_t *q, int gid, unsigned int active, unsigned int idle)
+{
+	struct pfq_group_flows value = { gid, Q_FLOW_TIMEOUTS, 0, NULL, 0, active, idle };
+
+	if (setsockopt(q->fd, PF_Q, Q_SO_GROUP_FLOWS, &value, sizeof(value)) == -1) {
+		return Q_ERROR(q, "PFQ: flow timeouts");
+	}
+
+	return Q_OK(q);
+}
+
+
+int
+pfq_set_flow_ring(pfq_t *q, size_t len)
+{
+	int enabled = pfq_is_enabled(q);
+	if (enabled == 1) {
+		return Q_ERROR(q, "PFQ: enabled (flow ring could not be set)");
+	}
+	if (setsockopt(q->fd, PF_Q, Q_SO_SET_FLOW_RING, &len, sizeof(len)) == -1) {
+		return Q_ERROR(q, "PFQ: set flow ring error");
+	}
+
+	return Q_OK(q);
+}
+
+
+int
+pfq_flow_read(pfq_t *q, struct pfq_flow_stat *recs, size_t n)
+{
+	struct pfq_shared_queue *sq = (struct pfq_shared_queue *)q->shm_addr;
+	struct pfq_flow_stat *ring;
+	unsigned long prod, cons;
+	size_t i;
+
+	if (sq == NULL || sq->flow.len == 0) {
+		return Q_ERROR(q, "PFQ: flow ring not enabled");
+	}
+
+	ring = (struct pfq_flow_stat *)((char *)q->shm_addr + sq->flow.off);
+
+	prod = __atomic_load_n(&sq->flow.prod.index, __ATOMIC_ACQUIRE);
+	cons = sq->flow.cons.index;
+
+	for(i = 0; i < n && cons != prod; i++, cons++)
+	{
+		recs[i] = ring[cons & (sq->flow.len - 1)];
+	}
+
+	__atomic_store_n(&sq->flow.cons.index, cons, __ATOMIC_RELEASE);
+
+	return Q_VALUE(q, (int)i);
+}
+
+
+int
+pfq_flow_export(pfq_t const *q, int gid, struct pfq_flow_stat *flows, size_t n)
+{
+	struct pfq_group_flows value = { gid, 0, 0, flows, n, 0, 0 };
+	socklen_t size = sizeof(value);
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_GROUP_FLOWS, &value, &size) == -1) {
+		return Q_ERROR(q, "PFQ: flow export error");
+	}
+
+	return Q_VALUE(q, (int)value.n);
+}
+
+
+static int
+pfq_sketch_ctl(pfq_t *q, int gid, int op, int key, uint32_t width, uint32_t topk, uint32_t flags, const char *msg)
+{
+	struct pfq_group_sketch value = { gid, op, key, width, topk, flags, NULL, 0, NULL, 0 };
+
+	if (setsockopt(q->fd, PF_Q, Q_SO_GROUP_SKETCH, &value, sizeof(value)) == -1) {
+		return Q_ERROR(q, msg);
+	}
+
+	return Q_OK(q);
+}
+
+
+int
+pfq_sketch_create(pfq_t *q, int gid, int key, uint32_t width, uint32_t topk, uint32_t flags)
+{
+	return pfq_sketch_ctl(q, gid, Q_SKETCH_CREATE, key, width, topk, flags, "PFQ: sketch create");
+}
+
+
+int
+pfq_sketch_destroy(pfq_t *q, int gid, int key)
+{
+	return pfq_sketch_ctl(q, gid, Q_SKETCH_DESTROY, key, 0, 0, 0, "PFQ: sketch destroy");
+}
+
+
+int
+pfq_sketch_clear(pfq_t *q, int gid, int key)
+{
+	return pfq_sketch_ctl(q, gid, Q_SKETCH_CLEAR, key, 0, 0, 0, "PFQ: sketch clear");
+}
+
+
+int
+pfq_sketch_read(pfq_t const *q, int gid, int key, struct pfq_sketch_item *items, size_t n,
+		uint8_t *hll, uint64_t *total)
+{
+	struct pfq_group_sketch value = { gid, 0, key, 0, 0, 0, items, n, hll, 0 };
+	socklen_t size = sizeof(value);
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_GROUP_SKETCH, &value, &size) == -1) {
+		return Q_ERROR(q, "PFQ: sketch read error");
+	}
+
+	if (total)
+		*total = value.total;
+
+	return Q_VALUE(q, (int)value.n);
+}
+
+
+double
+pfq_sketch_distinct(const uint8_t *hll)
+{
+	const double m = Q_SKETCH_HLL_REGS;
+	double sum = 0, e;
+	int n, zeros = 0;
+
+	for(n = 0; n < Q_SKETCH_HLL_REGS; n++)
+	{
+		sum += 1.0 / (double)(1ULL << hll[n]);
+		zeros += hll[n] == 0;
+	}
+
+	e = 0.7213 / (1 + 1.079 / m) * m * m / sum;  /* alpha_m m^2 / sum */
+
+	/* small range: linear counting */
+
+	if (e <= 2.5 * m && zeros)
+		e = m * log(m / zeros);
+
+	return e;
+}
+
+
 int
 pfq_read(pfq_t *q, struct pfq_net_queue *nq, long int microseconds)
+{
+	return pfq_read_queue(q, nq, 0, microseconds);
+}
+
+
+/* Rx sub-queues are mapped after the Tx async queues... */
+
+static char *
+pfq_rx_queue_addr(pfq_t const *q, int queue)
+{
+	if (queue == 0)
+		return (char *)(q->rx_queue_addr);
+
+	return (char *)(q->tx_queue_addr)
+		+ q->tx_queue_size * 2 * (1 + Q_MAX_TX_QUEUES)
+		+ q->rx_queue_size * 2 * (size_t)(queue - 1);
+}
+
+
+int
+pfq_rx_queues(pfq_t const *q)
 {
 	struct pfq_shared_queue * qd;
+	int n = 1;
+
+        if (q->shm_addr == NULL) {
+		return Q_ERROR(q, "PFQ: rx_queues: socket not enabled");
+	}
+
+	qd = (struct pfq_shared_queue *)(q->shm_addr);
+
+	for(; n < Q_MAX_RX_QUEUES && qd->rx_class[n-1].len != 0; n++)
+	{ }
+
+	return Q_VALUE(q, n);
+}
+
+
+int
+pfq_read_queue(pfq_t *q, struct pfq_net_queue *nq, int queue, long int microseconds)
+{
+	struct pfq_shared_queue * qd;
+	struct pfq_rx_queue * rx;
+	char * rx_addr;
 	unsigned int index, data;
 
         if (q->shm_addr == NULL) {
 		return Q_ERROR(q, "PFQ: read: socket not enabled");
 	}
 
+	if (queue < 0 || queue >= Q_MAX_RX_QUEUES) {
+		return Q_ERROR(q, "PFQ: read: bad Rx queue");
+	}
+
 	qd = (struct pfq_shared_queue *)(q->shm_addr);
+	rx = queue == 0 ? &qd->rx : &qd->rx_class[queue-1];
+	rx_addr = pfq_rx_queue_addr(q, queue);
 
-	data = __atomic_load_n(&qd->rx.data, __ATOMIC_RELAXED);
+	if (rx->len == 0) {
+		return Q_ERROR(q, "PFQ: read: Rx queue not in use");
+	}
+
+	data = __atomic_load_n(&rx->data, __ATOMIC_RELAXED);
 	index = Q_SHARED_QUEUE_INDEX(data);
 
         /* at wrap-around reset Rx slots... */
 
         if (((index+1) & 0xfe)== 0)
         {
-            char * raw = (char *)(q->rx_queue_addr) + ((index+1) & 1) * q->rx_queue_size;
+            char * raw = rx_addr + ((index+1) & 1) * q->rx_queue_size;
             char * end = raw + q->rx_queue_size;
             const uint8_t rst = index & 1;
             for(; raw < end; raw += q->rx_slot_size)
@@ -987,11 +1405,11 @@ pfq_read(pfq_t *q, struct pfq_net_queue *nq, long int microseconds)
 
 	/* swap the queue... */
 
-        data = __atomic_exchange_n(&qd->rx.data, (unsigned int)((index+1) << 24), __ATOMIC_RELAXED);
+        data = __atomic_exchange_n(&rx->data, (unsigned int)((index+1) << 24), __ATOMIC_RELAXED);
 
 	size_t queue_len = min(Q_SHARED_QUEUE_LEN(data), q->rx_slots);
 
-	nq->queue = (char *)(q->rx_queue_addr) + (index & 1) * q->rx_queue_size;
+	nq->queue = rx_addr + (index & 1) * q->rx_queue_size;
 	nq->index = index;
 	nq->len = queue_len;
         nq->slot_size = q->rx_slot_size;
@@ -1029,8 +1447,10 @@ pfq_dispatch(pfq_t *q, pfq_handler_t cb, long int microseconds, char *user)
 
 	for(; it != it_end; it = pfq_net_queue_next(&q->nq, it))
 	{
-		while (!pfq_pkt_ready(&q->nq, it))
-			pfq_yield();
+		pfq_pkt_prefetch(&q->nq, it);
+
+		if (!pfq_pkt_ready(&q->nq, it))
+			pfq_pkt_wait(&q->nq, it);
 
 		cb(user, pfq_pkt_header(it), pfq_pkt_data(it));
 		n++;
@@ -1137,6 +1557,118 @@ pfq_send_raw(pfq_t *q, const void *buf, size_t len, int ifindex, int qindex, uin
 	return Q_VALUE(q, -1);
 }
 
+
+/* symmetric hash of a packet in chunks: the headers are gathered first */
+
+static unsigned int
+pfq_tx_pkt_hash(const struct pfq_tx_pkt *pkt)
+{
+	char buf[128] = { 0 };	/* Ethernet, IPv4 with options and ports */
+	size_t j, len = 0;
+
+	for(j = 0; j < pkt->iovcnt && len < sizeof(buf); j++)
+	{
+		size_t l = min(pkt->iov[j].iov_len, sizeof(buf) - len);
+		memcpy(buf + len, pkt->iov[j].iov_base, l);
+		len += l;
+	}
+
+	return pfq_symmetric_hash(buf);
+}
+
+
+int
+pfq_send_batch(pfq_t *q, const struct pfq_tx_pkt *pkts, size_t n, int async, int queue)
+{
+        struct pfq_shared_queue *sh_queue = (struct pfq_shared_queue *)(q->shm_addr);
+        struct pfq_tx_queue *tx;
+        unsigned int index;
+        char *base_addr;
+        ptrdiff_t offset;
+        size_t i, j;
+        int tss;
+
+	if (unlikely(q->shm_addr == NULL))
+		return Q_ERROR(q, "PFQ: send_batch: socket not enabled");
+
+	if (n == 0)
+		return Q_VALUE(q, 0);
+
+	if (async) {
+		if (unlikely(q->tx_num_async == 0))
+			return Q_ERROR(q, "PFQ: send_batch: socket not bound to async thread");
+
+		tss = (int)pfq_fold((queue == Q_ANY_QUEUE ? pfq_tx_pkt_hash(&pkts[0]) : (unsigned int)queue),
+										      (unsigned int)q->tx_num_async);
+
+		tx = (struct pfq_tx_queue *)&sh_queue->tx_async[tss];
+	}
+	else {
+		tss = -1;
+		tx = (struct pfq_tx_queue *)&sh_queue->tx;
+	}
+
+	/* swap the queue and load the offset, once per batch */
+
+	index = __atomic_load_n(&tx->cons.index, __ATOMIC_RELAXED);
+	if (index != __atomic_load_n(&tx->prod.index, __ATOMIC_RELAXED))
+	{
+                __atomic_store_n(&tx->prod.index, index, __ATOMIC_RELAXED);
+                __atomic_store_n((index & 1) ? &tx->prod.off1 : &tx->prod.off0, 0, __ATOMIC_RELAXED);
+	}
+
+	base_addr = q->tx_queue_addr + q->tx_queue_size * (size_t)(2 * (1+tss) + (index & 1 ? 1 : 0));
+
+        offset = __atomic_load_n((index & 1) ? &tx->prod.off1 : &tx->prod.off0, __ATOMIC_RELAXED);
+
+	for(i = 0; i < n; i++)
+	{
+		const struct pfq_tx_pkt *pkt = &pkts[i];
+		struct pfq_pkthdr *hdr;
+		size_t len = 0, slot_size, maxlen;
+		char *p;
+
+		for(j = 0; j < pkt->iovcnt; j++)
+			len += pkt->iov[j].iov_len;
+
+		len = min(len, q->tx_slot_size - sizeof(struct pfq_pkthdr));
+
+		slot_size = sizeof(struct pfq_pkthdr) + ALIGN(len, 8);
+
+		if (((size_t)(offset) + slot_size) >= q->tx_queue_size)
+			break;
+
+		hdr = (struct pfq_pkthdr *)(base_addr + offset);
+		hdr->tstamp.tv64 = pkt->nsec;
+		hdr->caplen = (uint16_t)len;
+		hdr->data.copies = pkt->copies;
+		hdr->ifindex = pkt->ifindex;
+		hdr->queue = (uint8_t)pkt->qindex;
+
+		/* gather the chunks */
+
+		p = (char *)(hdr+1);
+		maxlen = len;
+		for(j = 0; j < pkt->iovcnt && maxlen; j++)
+		{
+			size_t l = min(pkt->iov[j].iov_len, maxlen);
+			memcpy(p, pkt->iov[j].iov_base, l);
+			p += l;
+			maxlen -= l;
+		}
+
+		offset += (ptrdiff_t)slot_size;
+	}
+
+	/* publish the whole batch */
+
+	if (i)
+		__atomic_store_n((index & 1) ? &tx->prod.off1 : &tx->prod.off0, offset, __ATOMIC_RELEASE);
+
+	return Q_VALUE(q, (int)i);
+}
+
+
 int
 pfq_send(pfq_t *q, const void *ptr, size_t len, size_t fhint, unsigned int copies)
 {
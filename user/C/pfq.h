@@ -25,6 +25,7 @@
 #define PFQ_H
 
 #include <stddef.h>
+#include <sys/uio.h>
 
 #include <linux/pf_q.h>
 #include <linux/if_ether.h>
@@ -47,6 +48,18 @@ typedef struct pfq_data pfq_t;
 
 typedef char * pfq_iterator_t;
 
+/*! Packet of a Tx batch: scatter-gather chunks and per-packet metadata. */
+
+struct pfq_tx_pkt
+{
+	const struct iovec *iov;	/* chunks of the packet */
+	size_t		    iovcnt;
+	int		    ifindex;
+	int		    qindex;
+	uint64_t	    nsec;	/* transmission time (0 = immediate) */
+	unsigned int	    copies;
+};
+
 /*! pfq_net_queue is a struct which represents a net queue. */
 
 struct pfq_net_queue
@@ -149,6 +162,65 @@ pfq_yield()
 #endif
 }
 
+/*! Pause iterations before yielding, while waiting for a slot to be committed. */
+
+#define PFQ_SPIN_BUDGET		1024
+
+/*! Slots prefetched ahead of the consumer. */
+
+#define PFQ_PREFETCH_SLOTS	4
+
+/*! Spin-wait hint to the CPU. */
+
+static inline
+void
+pfq_relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield" ::: "memory");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+/*! Wait for the packet to be committed. */
+/*!
+ * The producer is usually a few hundred cycles away (copying the packet on
+ * another CPU): spin for a bounded budget, then relinquish the CPU.
+ */
+
+static inline
+void
+pfq_pkt_wait(struct pfq_net_queue const *nq, pfq_iterator_t iter)
+{
+	unsigned int spin = 0;
+
+	while (!pfq_pkt_ready(nq, iter))
+	{
+		if (spin++ < PFQ_SPIN_BUDGET)
+			pfq_relax();
+		else
+			pfq_yield();
+	}
+}
+
+/*! Prefetch the header and the first bytes of the packet PFQ_PREFETCH_SLOTS ahead. */
+/*!
+ * Prefetches do not fault: the slots past the end of the queue need no check.
+ */
+
+static inline
+void
+pfq_pkt_prefetch(struct pfq_net_queue const *nq, pfq_iterator_t iter)
+{
+	pfq_iterator_t ahead = iter + PFQ_PREFETCH_SLOTS * nq->slot_size;
+
+	__builtin_prefetch(ahead, 0, 3);
+	__builtin_prefetch(ahead + 64, 0, 3);
+}
+
 /*! pfq handler: function prototype. */
 
 typedef void (*pfq_handler_t)(char *user, const struct pfq_pkthdr *h, const char *data);
@@ -173,7 +245,7 @@ unsigned int pfq_symmetric_hash(const char *buf)
             ih->protocol != IPPROTO_UDP)
             return (ih->saddr ^ ih->daddr);
 
-        ptr += sizeof(ih->ihl << 2);
+        ptr += ih->ihl << 2;
 
         struct udphdr const *uh = (struct udphdr const *)(ptr);
         return (ih->saddr ^ ih->daddr ^ uh->source ^ uh->dest);
@@ -318,6 +390,21 @@ extern int pfq_timestamping_enable(pfq_t *q, int value);
 extern int pfq_is_timestamping_enabled(pfq_t const *q);
 
 
+/*! Enable/disable the re-insertion of the 802.1Q tag into the captured packets.
+ *
+ * When enabled, the tag stripped by the driver is written back into the packet
+ * while it is copied into the slot (len and caplen account for it), and the
+ * user space does not need to rebuild it. The tci is still reported in the header.
+ */
+
+extern int pfq_vlan_insert_enable(pfq_t *q, int value);
+
+
+/*! Check whether the re-insertion of the 802.1Q tag is enabled. */
+
+extern int pfq_is_vlan_insert_enabled(pfq_t const *q);
+
+
 /*! Set the weight of the socket for the steering phase. */
 
 extern int pfq_set_weight(pfq_t *q, int value);
@@ -327,6 +414,43 @@ extern int pfq_set_weight(pfq_t *q, int value);
 extern int pfq_get_weight(pfq_t const *q);
 
 
+/*! Set the overload policy of the Rx queue. */
+/*!
+ * The policy (Q_OVERLOAD_DROP_TAIL, Q_OVERLOAD_DROP_CLASS, Q_OVERLOAD_DROP_STATE
+ * or Q_OVERLOAD_RED) is evaluated before the copy, once the fill of the queue
+ * reaches the threshold (percent of the slots).
+ */
+
+extern int pfq_set_rx_overload(pfq_t *q, struct pfq_rx_overload const *ovl);
+
+/*! Return the overload policy of the Rx queue. */
+
+extern int pfq_get_rx_overload(pfq_t const *q, struct pfq_rx_overload *ovl);
+
+
+/*! Set the wake-up watermark of the Rx queue. */
+/*!
+ * Waiters (poll/epoll on the socket, or the eventfd) are woken when the queue
+ * reaches the given packets, or the given microseconds after the first packet
+ * entered the empty queue (0 = no timeout). The default is 1 packet, and
+ * at most the Rx slots of the socket.
+ */
+
+extern int pfq_set_rx_watermark(pfq_t *q, struct pfq_rx_watermark const *wm);
+
+/*! Return the wake-up watermark of the Rx queue. */
+
+extern int pfq_get_rx_watermark(pfq_t const *q, struct pfq_rx_watermark *wm);
+
+/*! Signal the eventfd on every wake-up of the Rx queue (-1 to detach). */
+/*!
+ * The same eventfd can be shared by many sockets, so that a single
+ * descriptor in the epoll set serves all of them.
+ */
+
+extern int pfq_set_rx_eventfd(pfq_t *q, int efd);
+
+
 /*! Specify the capture length of packets, in bytes. */
 /*!
  * Capture length must be set before the socket is enabled.
@@ -435,6 +559,17 @@ extern int pfq_unbind_tx(pfq_t *q);
 extern int pfq_join_group(pfq_t *q, int gid, unsigned long class_mask, int group_policy);
 
 
+/*! Join the group, delivering some classes to dedicated Rx sub-queues. */
+/*!
+ * Each class in 'queue_mask' (a subset of 'class_mask') is delivered to a
+ * dedicated Rx sub-queue of the socket, to be read with 'pfq_read_queue'.
+ * Sub-queues are assigned in class order and must be requested before the
+ * socket is enabled.
+ */
+
+extern int pfq_join_group_queues(pfq_t *q, int gid, unsigned long class_mask, unsigned long queue_mask, int group_policy);
+
+
 /*! Leave the group specified by the group id. */
 
 extern int pfq_leave_group(pfq_t *q, int gid);
@@ -498,6 +633,156 @@ extern int pfq_vlan_set_filter(pfq_t *q, int gid, int vid);
 extern int pfq_vlan_reset_filter(pfq_t *q, int gid, int vid);
 
 
+/*! Create a named bloom filter for the given group. */
+/*!
+ * The filter has m bins (rounded up to a power of 2) and keys of the given
+ * type: Q_BLOOM_KEY_IPV4 and Q_BLOOM_KEY_IPV6 addresses are matched with the
+ * network prefix, Q_BLOOM_KEY_TUPLE keys are struct pfq_bloom_tuple.
+ * It is used by the bloom_table functions and can be updated while the
+ * computation is running.
+ */
+
+extern int pfq_bloom_create(pfq_t *q, int gid, const char *name, unsigned int m, int key, int prefix);
+
+
+/*! Destroy a named bloom filter of the given group. */
+
+extern int pfq_bloom_destroy(pfq_t *q, int gid, const char *name);
+
+
+/*! Add the keys (addresses in network order) to a named bloom filter. */
+
+extern int pfq_bloom_add(pfq_t *q, int gid, const char *name, const void *keys, size_t n);
+
+
+/*! Remove the keys (addresses in network order) from a named bloom filter. */
+
+extern int pfq_bloom_remove(pfq_t *q, int gid, const char *name, const void *keys, size_t n);
+
+
+/*! Replace the content of a named bloom filter with the given keys (addresses in network order). */
+
+extern int pfq_bloom_load(pfq_t *q, int gid, const char *name, const void *keys, size_t n);
+
+
+/*! Create a named longest-prefix-match table (family 4 or 6) for the given group. */
+/*!
+ * The table is used by the lpm functions and can be updated while the
+ * computation is running.
+ */
+
+extern int pfq_lpm_create(pfq_t *q, int gid, const char *name, int family);
+
+
+/*! Destroy a named lpm table of the given group. */
+
+extern int pfq_lpm_destroy(pfq_t *q, int gid, const char *name);
+
+
+/*! Add the rules to a named lpm table: a rule with the same prefix is replaced. */
+
+extern int pfq_lpm_add(pfq_t *q, int gid, const char *name, const struct pfq_lpm_rule *rules, size_t n);
+
+
+/*! Remove the rules (the value is ignored) from a named lpm table. */
+
+extern int pfq_lpm_remove(pfq_t *q, int gid, const char *name, const struct pfq_lpm_rule *rules, size_t n);
+
+
+/*! Replace the content of a named lpm table with the given rules. */
+
+extern int pfq_lpm_load(pfq_t *q, int gid, const char *name, const struct pfq_lpm_rule *rules, size_t n);
+
+
+/*! Create the flow table of the given group (capacity: entries per cpu). */
+/*!
+ * The table is keyed by 5-tuple and updated by the flow functions of the
+ * computation (flow_update, flow_set_state...).
+ */
+
+extern int pfq_flow_create(pfq_t *q, int gid, size_t capacity);
+
+
+/*! Destroy the flow table of the given group. */
+
+extern int pfq_flow_destroy(pfq_t *q, int gid);
+
+
+/*! Remove all the flows from the flow table of the given group. */
+
+extern int pfq_flow_clear(pfq_t *q, int gid);
+
+
+/*! Set the active and idle timeouts (seconds, 0 = none) of the flow table of the given group. */
+/*!
+ * Expired flows are exported as records to the flow rings of the sockets of
+ * the group (see pfq_set_flow_ring and pfq_flow_read).
+ */
+
+extern int pfq_flow_set_timeouts(pfq_t *q, int gid, unsigned int active, unsigned int idle);
+
+
+/*! Specify the length of the flow records ring, in number of records (0 = disabled). */
+/*!
+ * The ring is allocated in the shared memory: the length must be set before enabling the socket.
+ */
+
+extern int pfq_set_flow_ring(pfq_t *q, size_t len);
+
+
+/*! Read (up to n) records from the flow ring of the socket. */
+/*!
+ * Return the number of records read, or -1 in case of error.
+ */
+
+extern int pfq_flow_read(pfq_t *q, struct pfq_flow_stat *recs, size_t n);
+
+
+/*! Export the flow table of the given group. */
+/*!
+ * Copy up to n flows (the per-cpu entries, tagged by cpu) and return the
+ * number of the exported ones, or -1 in case of error.
+ */
+
+extern int pfq_flow_export(pfq_t const *q, int gid, struct pfq_flow_stat *flows, size_t n);
+
+
+/*! Create the sketch of the given group for the key Q_SKETCH_KEY_SRC, Q_SKETCH_KEY_DST or Q_SKETCH_KEY_FLOW. */
+/*!
+ * A count-min sketch (width columns) with the top-k heavy hitters per cpu, and a
+ * hyperloglog of the distinct keys; updated by the sketch functions of the computation
+ * (sketch_src, sketch_dst, sketch_flow). With Q_SKETCH_BYTES bytes are counted, rather than packets.
+ */
+
+extern int pfq_sketch_create(pfq_t *q, int gid, int key, uint32_t width, uint32_t topk, uint32_t flags);
+
+
+/*! Destroy a sketch of the given group. */
+
+extern int pfq_sketch_destroy(pfq_t *q, int gid, int key);
+
+
+/*! Reset a sketch of the given group. */
+
+extern int pfq_sketch_clear(pfq_t *q, int gid, int key);
+
+
+/*! Read a sketch of the given group (the shards of the cpus merged). */
+/*!
+ * Copy up to n heavy hitters (sorted by count) and return their number, or -1 in case
+ * of error. If not NULL, hll receives the Q_SKETCH_HLL_REGS registers of the hyperloglog
+ * and total the packets (or bytes) counted.
+ */
+
+extern int pfq_sketch_read(pfq_t const *q, int gid, int key, struct pfq_sketch_item *items, size_t n,
+			   uint8_t *hll, uint64_t *total);
+
+
+/*! Estimate the number of distinct keys from the registers of a hyperloglog. */
+
+extern double pfq_sketch_distinct(const uint8_t *hll);
+
+
 /*! Wait for packets. */
 /*!
  * Wait for packets available for reading. A timeout in microseconds can be specified.
@@ -518,6 +803,23 @@ extern int pfq_poll(pfq_t *q, long int microseconds /* = -1 -> infinite */);
 extern int pfq_read(pfq_t *q, struct pfq_net_queue *nq, long int microseconds);
 
 
+/*! Read packets in place from the given Rx sub-queue. */
+/*!
+ * Same as 'pfq_read', for the given sub-queue (0 is the default one).
+ */
+
+extern int pfq_read_queue(pfq_t *q, struct pfq_net_queue *nq, int queue, long int microseconds);
+
+
+/*! Return the number of Rx sub-queues in use. */
+/*!
+ * The sub-queue 0 is the default one; the others are dedicated to the
+ * classes specified when joining groups (see 'pfq_join_group_queues').
+ */
+
+extern int pfq_rx_queues(pfq_t const *q);
+
+
 /*! Receive packets in the given buffer. */
 /*!
  * Wait for packets and return the number of packets available.
@@ -588,6 +890,17 @@ extern int pfq_transmit_queue(pfq_t *q, int queue);
 extern int pfq_send_raw(pfq_t *q, const void *ptr, size_t len, int ifindex, int qindex, uint64_t nsec, unsigned int copies, int async, int queue);
 
 
+/*! Schedule the transmission of a batch of packets. */
+/*!
+ * The packets, gathered from their chunks, are copied into a single Tx queue
+ * and published at once. If 'async' is 1 and 'queue' is set to any_queue, the
+ * TSS symmetric hash of the first packet selects the Tx queue of the batch.
+ * Return the number of packets enqueued (less than n if the queue is full).
+ */
+
+extern int pfq_send_batch(pfq_t *q, const struct pfq_tx_pkt *pkts, size_t n, int async, int queue);
+
+
 /*! Store the packet and transmit the packets in the queue. */
 /*!
  * The queue is flushed every fhint packets.
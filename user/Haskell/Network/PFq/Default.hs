@@ -186,6 +186,47 @@ module Network.PFq.Default
         bloom_src_filter,
         bloom_dst_filter,
 
+        bloom_table     ,
+        bloom_table_src ,
+        bloom_table_dst ,
+
+        bloom_table_filter,
+        bloom_table_src_filter,
+        bloom_table_dst_filter,
+
+        lpm_src     ,
+        lpm_dst     ,
+        lpm_class   ,
+        lpm_steer   ,
+
+        flow_update ,
+        flow_set_state,
+        flow_steer  ,
+        flow_match  ,
+        flow_has_state,
+
+        sample_every,
+        sample_rand ,
+        sample_flow ,
+
+        limit_pps   ,
+        limit_bps   ,
+        police      ,
+        police_flow ,
+
+        conntrack   ,
+        is_established,
+        is_new_flow ,
+        is_reply    ,
+
+        sketch_src  ,
+        sketch_dst  ,
+        sketch_flow ,
+
+        has_pattern ,
+        has_pattern_at,
+        pattern_filter,
+
         bloomCalcN  ,
         bloomCalcM  ,
         bloomCalcP  ,
@@ -791,6 +832,187 @@ bloom_filter m hs p     = let ips = unsafePerformIO (mapM inet_addr hs) in MFunc
 bloom_src_filter m hs p = let ips = unsafePerformIO (mapM inet_addr hs) in MFunction "bloom_src_filter" m ips p () () () () ()
 bloom_dst_filter m hs p = let ips = unsafePerformIO (mapM inet_addr hs) in MFunction "bloom_dst_filter" m ips p () () () () ()
 
+-- | Predicate that evaluates to /True/ when the source or the destination address
+-- of the packet matches the named bloom filter of the group.
+--
+-- The filter is created and updated at runtime through the socket, without
+-- reinstalling the computation. Keys are IPv4 or IPv6 addresses, or 5-tuples
+-- (tested as they are), according to the filter. Example:
+--
+-- > when' (bloom_table "blacklist") log_packet >-> kernel
+{-# NOINLINE bloom_table #-}
+bloom_table :: String -> NetPredicate
+
+-- | Similarly to 'bloom_table', evaluates to /True/ when the source address
+-- of the packet matches the named bloom filter.
+{-# NOINLINE bloom_table_src #-}
+bloom_table_src :: String -> NetPredicate
+
+-- | Similarly to 'bloom_table', evaluates to /True/ when the destination address
+-- of the packet matches the named bloom filter.
+{-# NOINLINE bloom_table_dst #-}
+bloom_table_dst :: String -> NetPredicate
+
+-- | Monadic counterpart of 'bloom_table' function.
+{-# NOINLINE bloom_table_filter #-}
+bloom_table_filter :: String -> NetFunction
+
+-- | Monadic counterpart of 'bloom_table_src' function.
+{-# NOINLINE bloom_table_src_filter #-}
+bloom_table_src_filter :: String -> NetFunction
+
+-- | Monadic counterpart of 'bloom_table_dst' function.
+{-# NOINLINE bloom_table_dst_filter #-}
+bloom_table_dst_filter :: String -> NetFunction
+
+bloom_table n     = Predicate "bloom_table" n () () () () () () ()
+bloom_table_src n = Predicate "bloom_table_src" n () () () () () () ()
+bloom_table_dst n = Predicate "bloom_table_dst" n () () () () () () ()
+
+bloom_table_filter n     = MFunction "bloom_table_filter" n () () () () () () ()
+bloom_table_src_filter n = MFunction "bloom_table_src_filter" n () () () () () () ()
+bloom_table_dst_filter n = MFunction "bloom_table_dst_filter" n () () () () () () ()
+
+-- | Predicate that evaluates to /True/ when the source address of the packet
+-- matches a prefix of the named lpm table of the group.
+--
+-- The table is created and updated at runtime through the socket, without
+-- reinstalling the computation. Example:
+--
+-- > when' (lpm_src "customers") log_packet >-> kernel
+{-# NOINLINE lpm_src #-}
+lpm_src :: String -> NetPredicate
+
+-- | Similarly to 'lpm_src', evaluates to /True/ when the destination address
+-- of the packet matches a prefix of the named lpm table.
+{-# NOINLINE lpm_dst #-}
+lpm_dst :: String -> NetPredicate
+
+-- | Deliver the packet to the classes (mask) of the longest matching prefix,
+-- the destination address first and then the source one; drop it otherwise.
+{-# NOINLINE lpm_class #-}
+lpm_class :: String -> NetFunction
+
+-- | Steer the packet with the value of the longest matching prefix,
+-- the destination address first and then the source one; drop it otherwise.
+{-# NOINLINE lpm_steer #-}
+lpm_steer :: String -> NetFunction
+
+lpm_src n   = Predicate "lpm_src" n () () () () () () ()
+lpm_dst n   = Predicate "lpm_dst" n () () () () () () ()
+lpm_class n = MFunction "lpm_class" n () () () () () () ()
+lpm_steer n = MFunction "lpm_steer" n () () () () () () ()
+
+-- | Account the packet to its flow (5-tuple) in the flow table of the group.
+-- The table is created and exported through the socket. Non-IP packets are
+-- passed unchanged.
+--
+-- > flow_update >-> kernel
+flow_update = MFunction "flow_update" () () () () () () () () :: NetFunction
+
+-- | Set the user-defined state of the flow of the packet (the flow is added if needed).
+flow_set_state :: Word32 -> NetFunction
+flow_set_state x = MFunction "flow_set_state" x () () () () () () ()
+
+-- | Steer the packets of the flows in the table, drop the others.
+flow_steer = MFunction "flow_steer" () () () () () () () () :: NetFunction
+
+-- | Evaluate to /True/ if the flow of the packet is in the flow table.
+flow_match = Predicate "flow_match" () () () () () () () () :: NetPredicate
+
+-- | Evaluate to /True/ if the state of the flow of the packet is set to the given value.
+flow_has_state :: Word32 -> NetPredicate
+flow_has_state x = Predicate "flow_has_state" x () () () () () () ()
+
+-- sampling functions:
+
+-- | Deterministic sampling: pass one packet every /n/ (per cpu), drop the others.
+sample_every :: CInt -> NetFunction
+sample_every n = MFunction "sample_every" n () () () () () () ()
+
+-- | Probabilistic sampling: pass each packet with probability /p/, drop the others.
+--
+-- > sample_rand 0.01 >-> kernel
+sample_rand :: Double -> NetFunction
+sample_rand p = MFunction "sample_rand" (sampleThreshold p) () () () () () () ()
+
+-- | Per-flow sampling: pass all the packets of a fraction /p/ of the flows (the same flows on every cpu).
+sample_flow :: Double -> NetFunction
+sample_flow p = MFunction "sample_flow" (sampleThreshold p) () () () () () () ()
+
+sampleThreshold :: Double -> Word32
+sampleThreshold p
+    | p >= 1    = maxBound
+    | p <= 0    = 0
+    | otherwise = truncate (p * 4294967296)
+
+-- rate limiting and policing (token buckets, burst of 100 ms):
+
+-- | Drop the packets exceeding the given rate, in packets per second.
+--
+-- > limit_pps 10000 >-> kernel
+limit_pps :: Word64 -> NetFunction
+limit_pps r = MFunction "limit_pps" r () () () () () () ()
+
+-- | Drop the packets exceeding the given rate, in bits per second.
+limit_bps :: Word64 -> NetFunction
+limit_bps r = MFunction "limit_bps" r () () () () () () ()
+
+-- | Re-classify the packets exceeding the given rate (packets per second) to the given class.
+--
+-- > police 100000 2 >-> steer_flow
+police :: Word64 -> CInt -> NetFunction
+police r c = MFunction "police" r c () () () () () ()
+
+-- | Drop the packets of each flow exceeding the given rate (packets per second). Non-IP packets are passed.
+police_flow :: Word64 -> NetFunction
+police_flow r = MFunction "police_flow" r () () () () () () ()
+
+-- connection tracking (TCP and UDP):
+
+-- | Track the connection of the packet (SYN, SYN-ACK, FIN, RST, idle timeouts).
+--
+-- > conntrack >-> when' (is_established .||. is_new_flow) (forward "eth1")
+conntrack = MFunction "conntrack" () () () () () () () () :: NetFunction
+
+-- | Evaluate to /True/ if the packet belongs to an established connection (either direction).
+is_established = Predicate "is_established" () () () () () () () () :: NetPredicate
+
+-- | Evaluate to /True/ if the packet is from the originator of a connection not yet established.
+is_new_flow = Predicate "is_new_flow" () () () () () () () () :: NetPredicate
+
+-- | Evaluate to /True/ if the packet is from the responder of a tracked connection.
+is_reply = Predicate "is_reply" () () () () () () () () :: NetPredicate
+
+-- sketches of the group (count-min, top-k and hyperloglog):
+
+-- | Count the packet in the sketch of the group keyed by source address.
+--
+-- > sketch_src >-> kernel
+sketch_src = MFunction "sketch_src" () () () () () () () () :: NetFunction
+
+-- | Count the packet in the sketch of the group keyed by destination address.
+sketch_dst = MFunction "sketch_dst" () () () () () () () () :: NetFunction
+
+-- | Count the packet in the sketch of the group keyed by 5-tuple.
+sketch_flow = MFunction "sketch_flow" () () () () () () () () :: NetFunction
+
+-- payload pattern matching (multi-pattern, hex bytes enclosed in |..|):
+
+-- | Evaluate to /True/ if the payload (TCP/UDP payload, or IP payload) contains any of the patterns.
+--
+-- > when' (has_pattern ["GET /", "|de ad be ef|"]) (kernel)
+has_pattern :: [String] -> NetPredicate
+has_pattern xs = Predicate "has_pattern" xs () () () () () () ()
+
+-- | Evaluate to /True/ if any of the patterns is found within /depth/ bytes (0 = unbounded) from /offset/ of the payload.
+has_pattern_at :: CInt -> CInt -> [String] -> NetPredicate
+has_pattern_at off depth xs = Predicate "has_pattern_at" off depth xs () () () () ()
+
+-- | Drop the packets whose payload contains none of the patterns.
+pattern_filter :: [String] -> NetFunction
+pattern_filter xs = MFunction "pattern_filter" xs () () () () () () ()
+
 -- bloom filter, utility functions:
 
 bloomK = 4
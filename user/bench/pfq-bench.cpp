@@ -0,0 +1,763 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ ****************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#include <pfq/pfq.hpp>
+
+#include <more/affinity.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace pfq;
+
+
+namespace opt
+{
+    std::string tx_dev;
+    std::string rx_dev;
+    std::string function;
+    std::string tag;
+
+    size_t batch    = 16;
+    size_t caplen   = 64;
+    size_t len      = 64;
+    size_t groups   = 1;
+    size_t flows    = 1;
+    size_t slots    = 4096;
+    size_t seconds  = 5;
+    size_t warmup   = 1;
+
+    double rate     = 0.0;      // Mpps, 0 = line rate
+
+    int cpu_tx      = -1;
+    int cpu_rx      = -1;
+}
+
+
+namespace bench
+{
+    //
+    // packets carry a stamp past the UDP header: the consumers measure the
+    // latency against the same monotonic clock used by the generator.
+    //
+
+    struct stamp
+    {
+        uint32_t magic;
+        uint32_t seq;
+        uint64_t nsec;
+    };
+
+    constexpr uint32_t stamp_magic = 0x5046511b;
+    constexpr size_t   stamp_off   = 14 + 20 + 8;
+    constexpr size_t   stamp_end   = stamp_off + sizeof(stamp);
+
+    std::atomic_bool running(true);
+    std::atomic_bool measuring(false);
+
+    inline uint64_t
+    nsec()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    inline uint64_t
+    cycles()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    constexpr bool has_cycles =
+#if defined(__x86_64__) || defined(__i386__)
+        true;
+#else
+        false;
+#endif
+
+    //! Log-linear histogram (16 sub-buckets per power of two, ~6% precision).
+
+    struct histogram
+    {
+        static constexpr size_t sub = 16;
+
+        histogram()
+        : bucket()
+        , total()
+        , max()
+        {}
+
+        static size_t
+        index(uint64_t v)
+        {
+            if (v < sub)
+                return v;
+            auto msb = static_cast<size_t>(63 - __builtin_clzll(v));
+            return (msb - 3) * sub + ((v >> (msb - 4)) & (sub - 1));
+        }
+
+        static uint64_t
+        upper(size_t i)
+        {
+            if (i < sub)
+                return i;
+            auto shift = i / sub - 1;
+            return ((sub + i % sub) << shift) + (1ull << shift) - 1;
+        }
+
+        void add(uint64_t v)
+        {
+            bucket[index(v)]++;
+            total++;
+            max = std::max(max, v);
+        }
+
+        histogram &
+        operator+=(histogram const &other)
+        {
+            for(size_t i = 0; i < bucket.size(); i++)
+                bucket[i] += other.bucket[i];
+            total += other.total;
+            max = std::max(max, other.max);
+            return *this;
+        }
+
+        uint64_t
+        percentile(double p) const
+        {
+            auto target = static_cast<uint64_t>(p * static_cast<double>(total));
+            uint64_t sum = 0;
+            for(size_t i = 0; i < bucket.size(); i++)
+            {
+                sum += bucket[i];
+                if (sum > target)
+                    return std::min(upper(i), max);
+            }
+            return max;
+        }
+
+        std::array<uint64_t, 64 * sub> bucket;
+        uint64_t total;
+        uint64_t max;
+    };
+
+
+    uint16_t
+    ip_checksum(const unsigned char *ip, size_t len)
+    {
+        uint32_t sum = 0;
+        for(size_t i = 0; i < len; i += 2)
+            sum += static_cast<uint32_t>(ip[i] << 8 | ip[i+1]);
+        while (sum >> 16)
+            sum = (sum & 0xffff) + (sum >> 16);
+        return htons(static_cast<uint16_t>(~sum));
+    }
+
+    //! Build a pool of UDP packets 10.0.0.1 -> 10.0.0.2.
+
+    std::vector<char>
+    make_packets(size_t size, size_t numb)
+    {
+        std::vector<char> area(size * numb);
+
+        for(size_t i = 0; i < numb; ++i)
+        {
+            auto p = reinterpret_cast<unsigned char *>(&area[i * size]);
+
+            static const unsigned char eth[14] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                                   0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x08, 0x00 };
+            memcpy(p, eth, sizeof(eth));
+
+            auto ip = p + 14;
+            auto ip_len  = static_cast<uint16_t>(size - 14);
+            auto udp_len = static_cast<uint16_t>(size - 34);
+
+            const unsigned char iph[20] = { 0x45, 0x00, static_cast<unsigned char>(ip_len >> 8), static_cast<unsigned char>(ip_len),
+                                            0x00, 0x00, 0x40, 0x00, 0x40, IPPROTO_UDP, 0x00, 0x00,
+                                            10, 0, 0, 1, 10, 0, 0, 2 };
+            memcpy(ip, iph, sizeof(iph));
+
+            auto csum = ip_checksum(ip, 20);
+            memcpy(ip + 10, &csum, sizeof(csum));
+
+            auto udp = ip + 20;
+            const unsigned char udph[8] = { 0x13, 0x88, 0x13, 0x89,
+                                            static_cast<unsigned char>(udp_len >> 8), static_cast<unsigned char>(udp_len), 0x00, 0x00 };
+            memcpy(udp, udph, sizeof(udph));
+        }
+
+        return area;
+    }
+
+
+    //! Capture consumer: one socket per group.
+
+    struct consumer
+    {
+        consumer(int gid)
+        : m_gid(gid)
+        , m_pfq(group_policy::undefined, opt::caplen, opt::slots)
+        , m_read(0)
+        , m_hist()
+        , m_cycles(0)
+        , m_nsec(0)
+        , m_packets(0)
+        {
+            m_pfq.join_group(m_gid, group_policy::shared);
+            m_pfq.bind_group(m_gid, opt::rx_dev.c_str(), any_queue);
+
+            if (!opt::function.empty())
+                m_pfq.set_group_computation(m_gid, opt::function);
+
+            m_pfq.timestamping_enable(false);
+            m_pfq.enable();
+        }
+
+        consumer(const consumer &) = delete;
+        consumer& operator=(const consumer &) = delete;
+
+        void operator()()
+        {
+            while (running.load(std::memory_order_relaxed))
+            {
+                auto many = m_pfq.read(100000);
+                if (many.empty())
+                    continue;
+
+                auto measure = measuring.load(std::memory_order_relaxed);
+
+                auto c0 = cycles();
+                auto t0 = nsec();
+
+                // the stamp is taken once per batch: a packet waiting in the queue counts as latency
+
+                for(auto it = many.begin(), it_e = many.end(); it != it_e; ++it)
+                {
+                    it.wait();
+
+                    if (measure && it->caplen >= stamp_end)
+                    {
+                        stamp s;
+                        memcpy(&s, static_cast<const char *>(it.data()) + stamp_off, sizeof(s));
+                        if (s.magic == stamp_magic)
+                            m_hist.add(t0 > s.nsec ? t0 - s.nsec : 0);
+                    }
+                }
+
+                if (measure)
+                {
+                    m_cycles  += cycles() - c0;
+                    m_nsec    += nsec() - t0;
+                    m_packets += many.size();
+                }
+
+                m_read.fetch_add(many.size(), std::memory_order_relaxed);
+            }
+        }
+
+        pfq_stats
+        stats() const
+        {
+            return m_pfq.stats();
+        }
+
+        unsigned long long
+        read() const
+        {
+            return m_read.load(std::memory_order_relaxed);
+        }
+
+        int m_gid;
+        pfq::socket m_pfq;
+
+        std::atomic_ullong m_read;
+
+        // owned by the consumer thread, read once joined
+
+        histogram m_hist;
+        uint64_t m_cycles;
+        uint64_t m_nsec;
+        uint64_t m_packets;
+    };
+
+
+    //! Generator: batches of stamped packets, synchronous transmission.
+
+    struct generator
+    {
+        generator()
+        : m_pfq(param::list, param::tx_slots{opt::slots})
+        , m_area(make_packets(opt::len, opt::batch))
+        , m_pool()
+        , m_sent(0)
+        , m_fail(0)
+        {
+            m_pfq.bind_tx(opt::tx_dev.c_str());
+            m_pfq.enable();
+
+            for(size_t i = 0; i < opt::batch; i++)
+                m_pool.emplace_back(&m_area[i * opt::len], opt::len);
+        }
+
+        generator(const generator &) = delete;
+        generator& operator=(const generator &) = delete;
+
+        void operator()()
+        {
+            auto delta = opt::rate != 0.0 ? static_cast<uint64_t>(static_cast<double>(opt::batch) * 1000 / opt::rate) : 0;
+            auto next  = nsec();
+
+            uint32_t seq = 0;
+
+            while (running.load(std::memory_order_relaxed))
+            {
+                if (delta)
+                {
+                    while (nsec() < next)
+                    { }
+                    next += delta;
+                }
+
+                auto now = nsec();
+
+                for(size_t i = 0; i < opt::batch; i++)
+                {
+                    auto p = &m_area[i * opt::len];
+
+                    stamp s = { stamp_magic, seq, now };
+                    memcpy(p + stamp_off, &s, sizeof(s));
+
+                    auto sport = htons(static_cast<uint16_t>(5000 + seq % opt::flows));
+                    memcpy(p + 34, &sport, sizeof(sport));
+                    seq++;
+                }
+
+                auto n = m_pfq.send_batch(m_pool.begin(), m_pool.end());
+                m_pfq.transmit_queue(0);
+
+                m_sent.fetch_add(n, std::memory_order_relaxed);
+                if (n < opt::batch)
+                    m_fail.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        pfq_stats
+        stats() const
+        {
+            return m_pfq.stats();
+        }
+
+        pfq::socket m_pfq;
+
+        std::vector<char> m_area;
+        std::vector<pfq::const_buffer> m_pool;
+
+        std::atomic_ullong m_sent;
+        std::atomic_ullong m_fail;
+    };
+
+
+    std::string
+    json_string(std::string const &s)
+    {
+        std::string ret = "\"";
+        for(auto c : s)
+        {
+            if (c == '"' || c == '\\')
+                ret += '\\';
+            ret += c;
+        }
+        return ret + "\"";
+    }
+
+
+    //! Extract the value of a key from a flat, one-line JSON object.
+
+    std::string
+    json_value(std::string const &line, std::string const &key)
+    {
+        auto pos = line.find("\"" + key + "\":");
+        if (pos == std::string::npos)
+            return std::string();
+
+        pos += key.size() + 3;
+
+        if (line[pos] == '"')
+        {
+            std::string ret;
+            for(++pos; pos < line.size() && line[pos] != '"'; ++pos)
+            {
+                if (line[pos] == '\\')
+                    ++pos;
+                ret += line[pos];
+            }
+            return ret;
+        }
+
+        auto end = line.find_first_of(",}", pos);
+        return line.substr(pos, end - pos);
+    }
+
+
+    std::string
+    config_key(std::string const &line)
+    {
+        std::string ret;
+        for(auto k : { "batch", "caplen", "len", "groups", "flows", "rate", "function" })
+            ret += json_value(line, k) + "|";
+        return ret;
+    }
+
+
+    std::map<std::string, std::string>
+    load_results(std::string const &file)
+    {
+        std::ifstream in(file);
+        if (!in)
+            throw std::runtime_error("pfq-bench: could not open " + file);
+
+        std::map<std::string, std::string> ret;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.empty() || line[0] != '{')
+                continue;
+            ret[config_key(line)] = line;   // the last run of a configuration wins
+        }
+        return ret;
+    }
+
+
+    //! Compare a run against a baseline: throughput and consumer cost are gated.
+
+    int
+    check(std::string const &baseline, std::string const &current, double tolerance)
+    {
+        auto base = load_results(baseline);
+        auto curr = load_results(current);
+
+        int regressions = 0;
+
+        auto number = [](std::string const &s) {
+            return s.empty() || s == "null" ? 0.0 : std::stod(s);
+        };
+
+        for(auto const &c : curr)
+        {
+            auto b = base.find(c.first);
+            if (b == base.end())
+            {
+                std::cout << "new        " << c.first << std::endl;
+                continue;
+            }
+
+            auto pps_b = number(json_value(b->second, "rx_pps"));
+            auto pps_c = number(json_value(c.second, "rx_pps"));
+            auto cyc_b = number(json_value(b->second, "cycles_per_pkt"));
+            auto cyc_c = number(json_value(c.second, "cycles_per_pkt"));
+            auto p99_b = number(json_value(b->second, "lat_p99_ns"));
+            auto p99_c = number(json_value(c.second, "lat_p99_ns"));
+
+            auto delta = [](double b, double c) {
+                return b != 0.0 ? (c - b) * 100 / b : 0.0;
+            };
+
+            bool bad = (pps_c < pps_b * (1 - tolerance/100)) ||
+                       (cyc_b != 0.0 && cyc_c > cyc_b * (1 + tolerance/100));
+
+            regressions += bad;
+
+            std::cout << (bad ? "REGRESSION " : "ok         ") << c.first
+                      << " rx_pps " << pps_b << " -> " << pps_c << " (" << delta(pps_b, pps_c) << "%)"
+                      << " cycles/pkt " << cyc_b << " -> " << cyc_c << " (" << delta(cyc_b, cyc_c) << "%)"
+                      << " p99 " << p99_b << " -> " << p99_c << " ns" << std::endl;
+        }
+
+        std::cout << regressions << " regression(s), tolerance " << tolerance << "%" << std::endl;
+        return regressions ? 1 : 0;
+    }
+}
+
+
+bool any_strcmp(const char *arg, const char *opt)
+{
+    return strcmp(arg,opt) == 0;
+}
+template <typename ...Ts>
+bool any_strcmp(const char *arg, const char *opt, Ts&&...args)
+{
+    return (strcmp(arg,opt) == 0 ? true : any_strcmp(arg, std::forward<Ts>(args)...));
+}
+
+
+void usage(std::string name)
+{
+    throw std::runtime_error
+    (
+        "usage: " + name + " [OPTIONS]\n"
+        "       " + name + " --check BASELINE CURRENT [--tolerance PCT]\n\n"
+        " -h --help                     Display this help\n"
+        " -t --tx DEV                   Generate packets on DEV\n"
+        " -r --rx DEV                   Capture packets from DEV\n"
+        " -b --batch INT                Packets per Tx batch (default 16)\n"
+        " -c --caplen INT               Set caplen (default 64)\n"
+        " -l --len INT                  Packet length (default 64)\n"
+        " -g --groups INT               Capture groups, one consumer each (default 1)\n"
+        "    --flows INT                Distinct UDP flows (default 1)\n"
+        " -f --function FUNCTION        Computation of the capture groups\n"
+        " -s --slots INT                Set Rx/Tx slots (default 4096)\n"
+        " -R --rate DOUBLE              Tx rate in Mpps (default line rate)\n"
+        "    --seconds INT              Measurement interval (default 5)\n"
+        "    --warmup INT               Warm-up interval (default 1)\n"
+        "    --cpu-tx INT               Bind the generator to the CPU\n"
+        "    --cpu-rx INT               Bind the consumers to CPUs from INT\n"
+        "    --tag STRING               Label of the run\n\n"
+        "Emit a JSON line per run on stdout. --check compares two result files\n"
+        "and exits with 1 if rx_pps or cycles_per_pkt regressed beyond PCT (default 5)."
+    );
+}
+
+
+int
+main(int argc, char *argv[])
+try
+{
+    if (argc < 2)
+        usage(argv[0]);
+
+    std::string baseline, current;
+    double tolerance = 5.0;
+
+    auto size_arg = [&](int &i, const char *what) {
+        if (++i == argc)
+            throw std::runtime_error(std::string(what) + " missing");
+        return static_cast<size_t>(std::atoi(argv[i]));
+    };
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if (any_strcmp(argv[i], "-x", "--check"))
+        {
+            if (i + 2 >= argc)
+                throw std::runtime_error("result files missing");
+            baseline = argv[++i];
+            current  = argv[++i];
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "--tolerance"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("tolerance missing");
+            tolerance = std::atof(argv[i]);
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-t", "--tx"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("device missing");
+            opt::tx_dev = argv[i];
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-r", "--rx"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("device missing");
+            opt::rx_dev = argv[i];
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-f", "--function"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("group function missing");
+            opt::function = argv[i];
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "--tag"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("tag missing");
+            opt::tag = argv[i];
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-R", "--rate"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("rate missing");
+            opt::rate = std::atof(argv[i]);
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-b", "--batch"))   { opt::batch   = size_arg(i, "batch");   continue; }
+        if (any_strcmp(argv[i], "-c", "--caplen"))  { opt::caplen  = size_arg(i, "caplen");  continue; }
+        if (any_strcmp(argv[i], "-l", "--len"))     { opt::len     = size_arg(i, "len");     continue; }
+        if (any_strcmp(argv[i], "-g", "--groups"))  { opt::groups  = size_arg(i, "groups");  continue; }
+        if (any_strcmp(argv[i], "--flows"))         { opt::flows   = size_arg(i, "flows");   continue; }
+        if (any_strcmp(argv[i], "-s", "--slots"))   { opt::slots   = size_arg(i, "slots");   continue; }
+        if (any_strcmp(argv[i], "--seconds"))       { opt::seconds = size_arg(i, "seconds"); continue; }
+        if (any_strcmp(argv[i], "--warmup"))        { opt::warmup  = size_arg(i, "warmup");  continue; }
+        if (any_strcmp(argv[i], "--cpu-tx"))        { opt::cpu_tx  = static_cast<int>(size_arg(i, "cpu")); continue; }
+        if (any_strcmp(argv[i], "--cpu-rx"))        { opt::cpu_rx  = static_cast<int>(size_arg(i, "cpu")); continue; }
+
+        if (any_strcmp(argv[i], "-h", "-?", "--help"))
+            usage(argv[0]);
+
+        throw std::runtime_error(std::string(argv[i]) + " unknown option!");
+    }
+
+    if (!baseline.empty())
+        return bench::check(baseline, current, tolerance);
+
+    if (opt::tx_dev.empty() || opt::rx_dev.empty())
+        throw std::runtime_error("Tx and Rx devices required");
+
+    if (opt::len < 60 || opt::len > 1514)
+        throw std::runtime_error("len out of range [60,1514]");
+
+    if (opt::batch == 0 || opt::groups == 0 || opt::flows == 0 || opt::seconds == 0)
+        throw std::runtime_error("batch, groups, flows and seconds must be positive");
+
+    // consumers first, so that the warm-up sees the whole pipeline
+
+    std::vector<std::unique_ptr<bench::consumer>> consumers;
+    for(size_t g = 0; g < opt::groups; g++)
+        consumers.emplace_back(new bench::consumer(static_cast<int>(g)));
+
+    bench::generator gen;
+
+    std::vector<std::thread> threads;
+
+    for(size_t g = 0; g < consumers.size(); g++)
+    {
+        threads.emplace_back(std::ref(*consumers[g]));
+        if (opt::cpu_rx != -1)
+            more::set_affinity(threads.back(), static_cast<size_t>(opt::cpu_rx) + g);
+    }
+
+    threads.emplace_back(std::ref(gen));
+    if (opt::cpu_tx != -1)
+        more::set_affinity(threads.back(), static_cast<size_t>(opt::cpu_tx));
+
+    std::this_thread::sleep_for(std::chrono::seconds(opt::warmup));
+
+    auto snapshot = [&]() {
+        pfq_stats rx = {0,0,0,0,0,0,0,0,0,0,0};
+        unsigned long long read = 0;
+        for(auto &c : consumers)
+        {
+            rx += c->stats();
+            read += c->read();
+        }
+        return std::make_tuple(rx, read, gen.stats(), gen.m_sent.load());
+    };
+
+    auto begin = snapshot();
+    auto t0 = bench::nsec();
+
+    bench::measuring.store(true);
+
+    std::this_thread::sleep_for(std::chrono::seconds(opt::seconds));
+
+    bench::measuring.store(false);
+
+    auto end = snapshot();
+    auto t1 = bench::nsec();
+
+    bench::running.store(false);
+    for(auto &t : threads)
+        t.join();
+
+    auto secs   = static_cast<double>(t1 - t0) / 1e9;
+    auto rx     = std::get<0>(end) - std::get<0>(begin);
+    auto read   = std::get<1>(end) - std::get<1>(begin);
+    auto tx     = std::get<2>(end) - std::get<2>(begin);
+    auto queued = std::get<3>(end) - std::get<3>(begin);
+
+    auto tx_pkts = tx.sent ? tx.sent : queued;
+    auto expect  = static_cast<double>(tx_pkts) * static_cast<double>(opt::groups);
+
+    bench::histogram hist;
+    uint64_t cyc = 0, ns = 0, pkts = 0;
+    for(auto &c : consumers)
+    {
+        hist += c->m_hist;
+        cyc  += c->m_cycles;
+        ns   += c->m_nsec;
+        pkts += c->m_packets;
+    }
+
+    auto per_pkt = [&](uint64_t v) {
+        return pkts ? static_cast<double>(v) / static_cast<double>(pkts) : 0.0;
+    };
+
+    auto latency = [&](double p) {
+        return hist.total ? std::to_string(hist.percentile(p)) : std::string("null");
+    };
+
+    std::ostringstream out;
+
+    out << "{\"tag\":" << bench::json_string(opt::tag)
+        << ",\"batch\":" << opt::batch
+        << ",\"caplen\":" << opt::caplen
+        << ",\"len\":" << opt::len
+        << ",\"groups\":" << opt::groups
+        << ",\"flows\":" << opt::flows
+        << ",\"rate\":" << opt::rate
+        << ",\"function\":" << bench::json_string(opt::function)
+        << ",\"seconds\":" << secs
+        << ",\"tx_pps\":" << static_cast<uint64_t>(static_cast<double>(tx_pkts) / secs)
+        << ",\"rx_pps\":" << static_cast<uint64_t>(static_cast<double>(read) / secs)
+        << ",\"drop_rate\":" << (expect > 0 ? std::max(0.0, 1.0 - static_cast<double>(read) / expect) : 0.0)
+        << ",\"lost\":" << rx.lost
+        << ",\"shed\":" << (rx.shed_tail + rx.shed_class + rx.shed_state + rx.shed_red)
+        << ",\"tx_disc\":" << tx.disc
+        << ",\"tx_full\":" << gen.m_fail.load()
+        << ",\"cycles_per_pkt\":" << (bench::has_cycles ? std::to_string(per_pkt(cyc)) : std::string("null"))
+        << ",\"ns_per_pkt\":" << per_pkt(ns)
+        << ",\"lat_p50_ns\":" << latency(0.50)
+        << ",\"lat_p90_ns\":" << latency(0.90)
+        << ",\"lat_p99_ns\":" << latency(0.99)
+        << ",\"lat_p999_ns\":" << latency(0.999)
+        << ",\"lat_max_ns\":" << (hist.total ? std::to_string(hist.max) : std::string("null"))
+        << "}";
+
+    std::cout << out.str() << std::endl;
+    return 0;
+}
+catch(std::exception &e)
+{
+    std::cerr << e.what() << std::endl;
+    return 1;
+}
@@ -0,0 +1,71 @@
+#!/bin/bash
+#
+# Run the pfq-bench matrix over a veth pair, appending a JSON line per run.
+#
+# usage: pfq-bench.sh -e PFQ_BENCH -o OUTPUT [-d TX:RX] [-b BATCH]... [-c CAPLEN]...
+#                     [-g GROUPS]... [-f FUNCTION]... [-- PFQ_BENCH_OPTIONS]
+#
+# Lists are given by repeating the option; the matrix is their product.
+# The function 'none' runs the groups without a computation.
+# The veth pair is created (and removed on exit) if it does not exist.
+# Requires root and the pfq module loaded.
+#
+
+set -e
+
+bench=
+output=
+devs=pfqb0:pfqb1
+batch=()
+caplen=()
+groups=()
+function=()
+
+while getopts "e:o:d:b:c:g:f:" opt; do
+    case $opt in
+        e) bench=$OPTARG ;;
+        o) output=$OPTARG ;;
+        d) devs=$OPTARG ;;
+        b) batch+=("$OPTARG") ;;
+        c) caplen+=("$OPTARG") ;;
+        g) groups+=("$OPTARG") ;;
+        f) function+=("$OPTARG") ;;
+        *) exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+[ -x "$bench" ]  || { echo "pfq-bench.sh: pfq-bench executable missing (-e)" >&2; exit 2; }
+[ -n "$output" ] || { echo "pfq-bench.sh: output file missing (-o)" >&2; exit 2; }
+[ -d /proc/net/pfq ] || { echo "pfq-bench.sh: pfq module not loaded" >&2; exit 2; }
+
+[ ${#batch[@]}    -eq 0 ] && batch=(16)
+[ ${#caplen[@]}   -eq 0 ] && caplen=(64)
+[ ${#groups[@]}   -eq 0 ] && groups=(1)
+[ ${#function[@]} -eq 0 ] && function=(none)
+
+tx=${devs%%:*}
+rx=${devs##*:}
+
+if ! ip link show "$tx" > /dev/null 2>&1; then
+    ip link add "$tx" type veth peer name "$rx"
+    trap 'ip link del "$tx"' EXIT
+fi
+
+ip link set "$tx" up
+ip link set "$rx" up
+
+tag="$(uname -r) $(git -C "$(dirname "$0")" describe --always --dirty 2> /dev/null || true)"
+
+for b in "${batch[@]}"; do
+for c in "${caplen[@]}"; do
+for g in "${groups[@]}"; do
+for f in "${function[@]}"; do
+    echo "pfq-bench: batch $b caplen $c groups $g function '$f'" >&2
+    args=(-t "$tx" -r "$rx" -b "$b" -c "$c" -g "$g" --tag "$tag")
+    [ "$f" != none ] && args+=(-f "$f")
+    "$bench" "${args[@]}" "$@" | tee -a "$output"
+done
+done
+done
+done
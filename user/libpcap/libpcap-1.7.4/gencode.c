@@ -80,6 +80,9 @@
 #include "pcap/sll.h"
 #include "pcap/ipnet.h"
 #include "arcnet.h"
+#ifdef PCAP_SUPPORT_PFQ
+#include "pcap-pfq-linux.h"
+#endif
 #if defined(linux) && defined(PF_PACKET) && defined(SO_ATTACH_FILTER)
 #include <linux/types.h>
 #include <linux/if_packet.h>
@@ -508,6 +511,16 @@ pcap_compile(pcap_t *p, struct bpf_program *program,
 	program->bf_insns = icode_to_fcode(root, &len);
 	program->bf_len = len;
 
+#ifdef PCAP_SUPPORT_PFQ
+	/*
+	 * PFQ handles keep the expression along with its program: it may
+	 * be translated into an equivalent pfq-lang computation by
+	 * pcap_setfilter().
+	 */
+	if (p->md.pfq.q != NULL)
+		pfq_save_filter_expr(p, xbuf ? xbuf : "", program);
+#endif
+
 	lex_cleanup();
 	freechunks();
 
@@ -149,6 +149,13 @@ struct pcap_md {
         pfq_iterator_t		current;
         struct pfq_net_queue	nq;
         uint64_t		ifs_promisc;
+        int			nonblock;
+        int			vlan_insert;	/* 802.1Q tag re-inserted by the kernel */
+        int			filter_in_userland;	/* the group filter is not authoritative */
+        int			group_ref;		/* counted in the filter record of the group */
+        char			*filter_expr;	/* last expression compiled (pcap_compile)... */
+        struct bpf_program	filter_prog;	/* ...and its program */
+        struct pfq_pcap_pkthdr	pcap_h;		/* header returned by pcap_next_ex */
 
     } pfq;
 #endif
@@ -225,6 +232,9 @@ struct pcap_opt {
 		int tx_queue[4];
 		int tx_thread[4];
 
+		int rx_watermark[2];	/* packets, usecs */
+		int bpf_lang;		/* translate BPF expressions into pfq-lang */
+
 		const char *vlan;
 		const char *comp;
 	} pfq;
@@ -264,6 +274,12 @@ struct pcap {
 	 */
 	int (*next_packet_op)(pcap_t *, struct pcap_pkthdr *, u_char **);
 
+	/*
+	 * Method to call for pcap_next_ex() on a live capture, if the
+	 * packets can be returned in place (optional).
+	 */
+	int (*next_ex_op)(pcap_t *, struct pcap_pkthdr **, const u_char **);
+
 #ifdef WIN32
 	ADAPTER *adapter;
 	LPPACKET Packet;
@@ -65,7 +65,10 @@ static	int pfq_activate_linux(pcap_t *);
 static	int pfq_inject_linux(pcap_t *, const void *, size_t);
 static	int pfq_setdirection_linux(pcap_t *, pcap_direction_t);
 static	int pfq_read_linux(pcap_t *, int, pcap_handler, u_char *);
+static	int pfq_next_ex_linux(pcap_t *, struct pcap_pkthdr **, const u_char **);
 static	int pfq_stats_linux(pcap_t *, struct pcap_stat *);
+static	int pfq_getnonblock_linux(pcap_t *, char *);
+static	int pfq_setnonblock_linux(pcap_t *, int, char *);
 
 
 #define MUST_CLEAR_PROMISC	0x00000001
@@ -84,20 +87,254 @@ pcap_t
 }
 
 
+/*
+ * Filters of the groups, as installed by the handles of this process: the
+ * handles that share a group (e.g. one per Rx queue) install the filter once.
+ * A record lives as long as the handles of this process in the group: with
+ * the last one closed the group may be released and its gid reused.
+ */
+
+#define PFQ_PCAP_MAX_GID	64
+
+static struct pfq_group_filter
+{
+	int handles;			/* handles of this process in the group */
+	struct sock_filter *insns;	/* BPF program, or... */
+	unsigned short len;
+	char *comp;			/* ...pfq-lang computation */
+
+} pfq_group_filter[PFQ_PCAP_MAX_GID];
+
+
+static void
+group_filter_clear(int gid)
+{
+	if (gid < 0 || gid >= PFQ_PCAP_MAX_GID)
+		return;
+
+	free(pfq_group_filter[gid].insns);
+	free(pfq_group_filter[gid].comp);
+
+	pfq_group_filter[gid].insns = NULL;
+	pfq_group_filter[gid].len = 0;
+	pfq_group_filter[gid].comp = NULL;
+}
+
+
+static int
+group_filter_installed(int gid, struct sock_fprog *fcode, const char *comp)
+{
+	struct pfq_group_filter *f;
+
+	if (gid < 0 || gid >= PFQ_PCAP_MAX_GID)
+		return 0;
+
+	f = &pfq_group_filter[gid];
+
+	if (comp)
+		return f->comp && strcmp(f->comp, comp) == 0;
+
+	return f->insns && f->len == fcode->len &&
+		memcmp(f->insns, fcode->filter, fcode->len * sizeof(struct sock_filter)) == 0;
+}
+
+
+static void
+group_filter_record(int gid, struct sock_fprog *fcode, const char *comp)
+{
+	struct pfq_group_filter *f;
+
+	group_filter_clear(gid);
+
+	if (gid < 0 || gid >= PFQ_PCAP_MAX_GID)
+		return;
+
+	f = &pfq_group_filter[gid];
+
+	if (comp) {
+		f->comp = strdup(comp);
+		return;
+	}
+
+	f->insns = malloc(fcode->len * sizeof(struct sock_filter));
+	if (f->insns) {
+		memcpy(f->insns, fcode->filter, fcode->len * sizeof(struct sock_filter));
+		f->len = fcode->len;
+	}
+}
+
+
+static void
+group_filter_ref(pcap_t *handle)
+{
+	int gid = handle->opt.pfq.group;
+
+	if (gid < 0 || gid >= PFQ_PCAP_MAX_GID)
+		return;
+
+	pfq_group_filter[gid].handles++;
+	handle->md.pfq.group_ref = 1;
+}
+
+
+static void
+group_filter_unref(pcap_t *handle)
+{
+	int gid = handle->opt.pfq.group;
+
+	if (!handle->md.pfq.group_ref)
+		return;
+
+	handle->md.pfq.group_ref = 0;
+
+	if (--pfq_group_filter[gid].handles == 0)
+		group_filter_clear(gid);
+}
+
+
 static int
 set_kernel_filter(pcap_t *handle, struct sock_fprog *fcode)
 {
-	return pfq_group_fprog(handle->md.pfq.q, handle->opt.pfq.group, fcode);
+	int gid = handle->opt.pfq.group;
+
+	if (group_filter_installed(gid, fcode, NULL))
+		return 0;
+
+	/* a filter previously translated into pfq-lang is dropped */
+
+	if (gid >= 0 && gid < PFQ_PCAP_MAX_GID && pfq_group_filter[gid].comp)
+		pfq_set_group_computation_from_string(handle->md.pfq.q, gid,
+						      handle->opt.pfq.comp ? handle->opt.pfq.comp : "unit");
+
+	if (pfq_group_fprog(handle->md.pfq.q, gid, fcode) < 0)
+		return -1;
+
+	group_filter_record(gid, fcode, NULL);
+	return 0;
 }
 
 
 static int
 reset_kernel_filter(pcap_t *handle)
 {
+	group_filter_clear(handle->opt.pfq.group);
 	return pfq_group_fprog_reset(handle->md.pfq.q, handle->opt.pfq.group);
 }
 
 
+void
+pfq_save_filter_expr(pcap_t *handle, const char *expr, const struct bpf_program *program)
+{
+	size_t size = program->bf_len * sizeof(struct bpf_insn);
+
+	free(handle->md.pfq.filter_expr);
+	free(handle->md.pfq.filter_prog.bf_insns);
+
+	handle->md.pfq.filter_expr = strdup(expr);
+	handle->md.pfq.filter_prog.bf_insns = malloc(size);
+	handle->md.pfq.filter_prog.bf_len = 0;
+
+	if (handle->md.pfq.filter_prog.bf_insns) {
+		memcpy(handle->md.pfq.filter_prog.bf_insns, program->bf_insns, size);
+		handle->md.pfq.filter_prog.bf_len = program->bf_len;
+	}
+}
+
+
+/*
+ * Translate a BPF expression into an equivalent pfq-lang computation. Only
+ * conjunctions of the protocol primitives are supported:
+ *
+ *	ip, ip6, icmp, icmp6 and tcp, udp qualified by ip or ip6
+ *
+ * e.g. "ip and tcp" -> "ip >-> tcp", "ip6 && udp" -> "ip6 >-> udp6".
+ * Returns -1 if the expression cannot be translated.
+ */
+
+static int
+pfq_bpf_to_lang(const char *expr, char *comp, size_t size)
+{
+	char buf[256], *tok, *save = NULL;
+	int ip = 0, ip6 = 0, tcp = 0, udp = 0, icmp = 0, icmp6 = 0;
+	int expect_prim = 1, n;
+
+	if (strlen(expr) >= sizeof(buf))
+		return -1;
+
+	strcpy(buf, expr);
+
+	for(tok = strtok_r(buf, " \t\n", &save); tok; tok = strtok_r(NULL, " \t\n", &save))
+	{
+		if (!expect_prim) {
+			if (strcmp(tok, "and") != 0 && strcmp(tok, "&&") != 0)
+				return -1;
+			expect_prim = 1;
+			continue;
+		}
+
+		if      (strcmp(tok, "ip")    == 0) ip = 1;
+		else if (strcmp(tok, "ip6")   == 0) ip6 = 1;
+		else if (strcmp(tok, "tcp")   == 0) tcp = 1;
+		else if (strcmp(tok, "udp")   == 0) udp = 1;
+		else if (strcmp(tok, "icmp")  == 0) icmp = 1;
+		else if (strcmp(tok, "icmp6") == 0) icmp6 = 1;
+		else
+			return -1;
+
+		expect_prim = 0;
+	}
+
+	if (expect_prim)	/* empty, or a trailing "and" */
+		return -1;
+
+	/* pcap tcp/udp match both IPv4 and IPv6, pfq-lang ones do not */
+
+	if ((tcp || udp) && ip == ip6)
+		return -1;
+	if (tcp && udp)
+		return -1;
+	if ((ip6 && (icmp || ip)) || (ip && icmp6) || (icmp && icmp6))
+		return -1;
+
+	n = snprintf(comp, size, "%s%s",
+		     ip6 || icmp6 ? "ip6" : "ip",
+		     tcp   ? (ip6 ? " >-> tcp6" : " >-> tcp") :
+		     udp   ? (ip6 ? " >-> udp6" : " >-> udp") :
+		     icmp  ? " >-> icmp" :
+		     icmp6 ? " >-> icmp6" : "");
+
+	return n < 0 || (size_t)n >= size ? -1 : 0;
+}
+
+
+static int
+set_group_computation(pcap_t *handle, const char *filter)
+{
+	int gid = handle->opt.pfq.group;
+	char comp[1024];
+
+	/* the filter composes with the computation of the configuration (e.g. steering) */
+
+	if (handle->opt.pfq.comp)
+		snprintf(comp, sizeof(comp), "%s >-> %s", filter, handle->opt.pfq.comp);
+	else
+		snprintf(comp, sizeof(comp), "%s", filter);
+
+	if (group_filter_installed(gid, NULL, comp))
+		return 0;
+
+	if (pfq_set_group_computation_from_string(handle->md.pfq.q, gid, comp) < 0)
+		return -1;
+
+	pfq_group_fprog_reset(handle->md.pfq.q, gid);
+
+	group_filter_record(gid, NULL, comp);
+
+	fprintf(stdout, "[PFQ] filter translated into computation: %s\n", comp);
+	return 0;
+}
+
+
 static int
 fix_offset(struct bpf_insn *p)
 {
@@ -263,6 +500,26 @@ pfq_setfilter_linux(pcap_t *handle, struct bpf_program *filter)
 	 * installing a kernel filter succeeds.
 	 */
 	handle->md.use_bpf = 0;
+	handle->md.pfq.filter_in_userland = 1;
+
+	/*
+	 * The expression compiled for this handle can be translated into
+	 * an equivalent pfq-lang computation.
+	 */
+	if (handle->opt.pfq.bpf_lang && handle->md.pfq.filter_expr &&
+	    handle->md.pfq.filter_prog.bf_len == filter->bf_len &&
+	    memcmp(handle->md.pfq.filter_prog.bf_insns, filter->bf_insns,
+		   filter->bf_len * sizeof(struct bpf_insn)) == 0) {
+
+		char comp[256];
+
+		if (pfq_bpf_to_lang(handle->md.pfq.filter_expr, comp, sizeof(comp)) == 0 &&
+		    set_group_computation(handle, comp) == 0) {
+			handle->md.use_bpf = 1;
+			handle->md.pfq.filter_in_userland = 0;
+			return 0;
+		}
+	}
 
 	switch (fix_program(handle, &fcode, 1)) {
 
@@ -295,8 +552,9 @@ pfq_setfilter_linux(pcap_t *handle, struct bpf_program *filter)
 
 		if ((err = set_kernel_filter(handle, &fcode)) == 0) {
 
-			/* Installation succeded - using kernel filter. */
+			/* Installation succeded - using kernel filter (authoritative). */
 			handle->md.use_bpf = 1;
+			handle->md.pfq.filter_in_userland = 0;
 		}
 		else if (err == -1) {	/* Non-fatal error */
 
@@ -523,6 +781,8 @@ pfq_opt_default(pcap_t *handle)
 		.tx_async = 0,
 		.tx_queue = {-1, -1, -1, -1},
 		.tx_thread= { Q_NO_KTHREAD, Q_NO_KTHREAD, Q_NO_KTHREAD, Q_NO_KTHREAD },
+		.rx_watermark = {1, 0},
+		.bpf_lang = 0,
 		.vlan     = NULL,
 		.comp     = NULL
 	};
@@ -571,6 +831,16 @@ pfq_parse_env(struct pfq_opt *opt)
 		}
 	}
 
+	if ((var = getenv("PFQ_BPF_LANG")))
+		opt->bpf_lang = atoi(var);
+
+	if ((var = getenv("PFQ_RX_WATERMARK"))) {
+		if (pfq_parse_integers(opt->rx_watermark, 2, var) < 0) {
+			fprintf(stderr, "[PFQ] PFQ_RX_WATERMARK parse error!\n");
+			return -1;
+		}
+	}
+
 	return 0;
 }
 
@@ -587,6 +857,8 @@ pfq_parse_env(struct pfq_opt *opt)
 #define KEY_tx_thread		6
 #define KEY_vlan		7
 #define KEY_computation		8
+#define KEY_rx_watermark	9
+#define KEY_bpf_lang		10
 
 
 struct pfq_conf_key {
@@ -601,7 +873,9 @@ struct pfq_conf_key {
 	KEY(tx_fhint),
 	KEY(tx_thread),
 	KEY(vlan),
-	KEY(computation)
+	KEY(computation),
+	KEY(rx_watermark),
+	KEY(bpf_lang)
 };
 
 
@@ -672,8 +946,15 @@ pfq_parse_config(struct pfq_opt *opt, const char *filename)
 						rc = -1;
 					}
 				} break;
+				case KEY_rx_watermark: {
+					if (pfq_parse_integers(opt->rx_watermark, 2, value) < 0) {
+						fprintf(stderr, "[PFQ] %s: parse error at: %s\n", filename, tkey);
+						rc = -1;
+					}
+				} break;
 				case KEY_vlan:		opt->vlan = strdup(string_trim(value)); break;
 				case KEY_computation:	opt->comp = strdup(string_trim(value)); break;
+				case KEY_bpf_lang:	opt->bpf_lang = atoi(value); break;
 				case KEY_ERR: {
 					fprintf(stderr, "[PFQ] %s: unknown keyword '%s'\n", filename, tkey);
 					rc = -1;
@@ -751,8 +1032,8 @@ pfq_activate_linux(pcap_t *handle)
 	handle->inject_op	= pfq_inject_linux;
 	handle->setfilter_op	= pfq_setfilter_linux;
 	handle->setdirection_op	= pfq_setdirection_linux;
-	handle->getnonblock_op	= pcap_getnonblock_fd;
-	handle->setnonblock_op	= pcap_setnonblock_fd;
+	handle->getnonblock_op	= pfq_getnonblock_linux;
+	handle->setnonblock_op	= pfq_setnonblock_linux;
 	handle->stats_op	= pfq_stats_linux;
 	handle->cleanup_op	= pfq_cleanup_linux;
 	handle->set_datalink_op	= NULL;	/* can't change data link type */
@@ -762,6 +1043,13 @@ pfq_activate_linux(pcap_t *handle)
 	handle->md.pfq.current	= NULL;
 	pfq_net_queue_init(&handle->md.pfq.nq);
 	handle->md.pfq.ifs_promisc = 0;
+	handle->md.pfq.nonblock = 0;
+	handle->md.pfq.vlan_insert = 0;
+	handle->md.pfq.filter_in_userland = 0;
+	handle->md.pfq.filter_expr = NULL;
+	handle->md.pfq.filter_prog.bf_insns = NULL;
+	handle->md.pfq.filter_prog.bf_len = 0;
+	handle->next_ex_op	= pfq_next_ex_linux;
 
 	handle->fd = socket(AF_INET, SOCK_DGRAM, 0);
 	if (handle->fd == -1) {
@@ -940,6 +1228,8 @@ pfq_activate_linux(pcap_t *handle)
 		goto fail;
 	}
 
+	group_filter_ref(handle);
+
 	/* bind TX to device/queue */
 
 	if ((first_dev = string_first_token(device, ":"))) {
@@ -989,6 +1279,11 @@ pfq_activate_linux(pcap_t *handle)
 
 			fprintf(stderr, "[PFQ] error: %s\n", pfq_error(handle->md.pfq.q));
 		}
+
+		/* it replaces a filter translated by another handle */
+
+		if (handle->opt.pfq.group < PFQ_PCAP_MAX_GID && pfq_group_filter[handle->opt.pfq.group].comp)
+			group_filter_clear(handle->opt.pfq.group);
 	}
 
 	/* set vlan filters */
@@ -1023,6 +1318,31 @@ pfq_activate_linux(pcap_t *handle)
 		goto fail;
 	}
 
+	/* let the kernel re-insert the vlan tag in the slot (fall back to the rebuild in place) */
+
+	handle->md.pfq.vlan_insert = pfq_vlan_insert_enable(handle->md.pfq.q, 1) == 0;
+
+	/* wake-up watermark: by default the pcap timeout bounds the wait of a batch */
+
+	if (handle->opt.pfq.rx_watermark[0] > 1) {
+
+		struct pfq_rx_watermark wm =
+		{
+			.packets = (unsigned int)handle->opt.pfq.rx_watermark[0],
+			.usecs   = (unsigned int)handle->opt.pfq.rx_watermark[1]
+		};
+
+		if (wm.usecs == 0 && handle->opt.timeout > 0 && !handle->opt.immediate)
+			wm.usecs = (unsigned int)handle->opt.timeout * 1000;
+
+		fprintf(stdout, "[PFQ] Rx watermark = %u packets, %u usecs\n", wm.packets, wm.usecs);
+
+		if (pfq_set_rx_watermark(handle->md.pfq.q, &wm) == -1) {
+			snprintf(handle->errbuf, PCAP_ERRBUF_SIZE, "%s", pfq_error(handle->md.pfq.q));
+			goto fail;
+		}
+	}
+
 	/* enable socket */
 
 	if (pfq_enable(handle->md.pfq.q) == -1) {
@@ -1030,9 +1350,9 @@ pfq_activate_linux(pcap_t *handle)
 		goto fail;
 	}
 
-	/* handle->selectable_fd = pfq_get_fd(handle->md.pfq.q); */
+	/* the PFQ socket is pollable: readable when the Rx queue reaches the watermark */
 
-	handle->selectable_fd = -1;
+	handle->selectable_fd = pfq_get_fd(handle->md.pfq.q);
 	return 0;
 
 fail:
@@ -1112,6 +1432,14 @@ pfq_cleanup_linux(pcap_t *handle)
 		}
 	}
 
+	free(handle->md.pfq.filter_expr);
+	handle->md.pfq.filter_expr = NULL;
+	pcap_freecode(&handle->md.pfq.filter_prog);
+
+	/* the group may be released along with the last socket */
+
+	group_filter_unref(handle);
+
 	if(handle->md.pfq.q) {
 		fprintf(stdout, "[PFQ] close socket.\n");
 		pfq_close(handle->md.pfq.q);
@@ -1129,78 +1457,207 @@ pfq_cleanup_linux(pcap_t *handle)
 }
 
 
+/* non-blocking mode: the read does not wait for the Rx queue */
+
 static int
-pfq_read_linux(pcap_t *handle, int max_packets, pcap_handler callback, u_char *user)
+pfq_getnonblock_linux(pcap_t *handle, char *errbuf)
+{
+	(void)errbuf;
+	return handle->md.pfq.nonblock;
+}
+
+
+static int
+pfq_setnonblock_linux(pcap_t *handle, int nonblock, char *errbuf)
+{
+	(void)errbuf;
+	handle->md.pfq.nonblock = nonblock;
+	return 0;
+}
+
+
+/*
+ * Read a new batch of packets from the Rx queue: the packets of the previous
+ * batch remain valid until the next read.
+ */
+
+static inline int
+pfq_refill_linux(pcap_t *handle)
 {
-        int start = handle->md.packets_read;
 	struct pfq_net_queue *nq = &handle->md.pfq.nq;
-	pfq_iterator_t it = handle->md.pfq.current;
-	int n = max_packets;
 
-        if (it == pfq_net_queue_end(nq)) {
-		if (pfq_read(handle->md.pfq.q, nq, handle->md.timeout > 0 ? handle->md.timeout * 1000 : 1000000) < 0) {
-			snprintf(handle->errbuf, sizeof(handle->errbuf), "PFQ read error");
-			return PCAP_ERROR;
-		}
-		it = handle->md.pfq.current = pfq_net_queue_begin(nq);
+	if (pfq_read(handle->md.pfq.q, nq, handle->md.pfq.nonblock ? 0 :
+		     handle->md.timeout > 0 ? handle->md.timeout * 1000 : 1000000) < 0) {
+		snprintf(handle->errbuf, sizeof(handle->errbuf), "PFQ read error");
+		return PCAP_ERROR;
 	}
 
-	for(; (max_packets <= 0 || n > 0) && (it != pfq_net_queue_end(nq)); it = pfq_net_queue_next(nq, it))
-	{
-		struct pfq_pcap_pkthdr pcap_h;
-		struct pfq_pkthdr *h;
-                uint16_t vlan_tci;
-		const char *pkt;
+	handle->md.pfq.current = pfq_net_queue_begin(nq);
+	return 0;
+}
 
-		while (!pfq_pkt_ready(nq, it))
-			pfq_yield();
 
-		h = (struct pfq_pkthdr *)pfq_pkt_header(it);
+/*
+ * Fill the pcap header and return the packet, in place. Unless the kernel
+ * re-inserts the 802.1Q tag in the slot, the tag is rebuilt in front of
+ * the payload.
+ */
 
-		pcap_h.ts.tv_sec  = h->tstamp.tv.sec;
-		pcap_h.ts.tv_usec = h->tstamp.tv.nsec / 1000;
-		pcap_h.caplen     = h->caplen;
-		pcap_h.len        = h->len;
+static inline const u_char *
+pfq_packet_linux(pcap_t *handle, pfq_iterator_t it, struct pfq_pcap_pkthdr *pcap_h)
+{
+	struct pfq_pkthdr *h = (struct pfq_pkthdr *)pfq_pkt_header(it);
+	const char *pkt = pfq_pkt_data(it);
+	uint16_t vlan_tci;
 
-		/* extended pcap header */
+	pcap_h->ts.tv_sec  = h->tstamp.tv.sec;
+	pcap_h->ts.tv_usec = h->tstamp.tv.nsec / 1000;
+	pcap_h->caplen     = h->caplen;
+	pcap_h->len        = h->len;
 
-		pcap_h.data.mark  = h->data.mark;
-		pcap_h.data.state = h->data.state;
-		pcap_h.ifindex   = h->ifindex;
-		pcap_h.queue	  = h->queue;
-		pcap_h.gid	  = h->gid;
+	/* extended pcap header */
 
-		pkt = pfq_pkt_data(it);
+	pcap_h->data.mark  = h->data.mark;
+	pcap_h->data.state = h->data.state;
+	pcap_h->ifindex    = h->ifindex;
+	pcap_h->queue	   = h->queue;
+	pcap_h->gid	   = h->gid;
 
-		if ((vlan_tci = h->vlan.tci) != 0) {
+	if (!handle->md.pfq.vlan_insert && (vlan_tci = h->vlan.tci) != 0) {
 
-			struct vlan_tag *tag;
+		struct vlan_tag *tag;
 
-			pkt -= VLAN_TAG_LEN;
+		pkt -= VLAN_TAG_LEN;
 
-			memmove((char *)pkt, pkt + VLAN_TAG_LEN, 2 * ETH_ALEN);
+		memmove((char *)pkt, pkt + VLAN_TAG_LEN, 2 * ETH_ALEN);
 
-			tag = (struct vlan_tag *)(pkt + 2 * ETH_ALEN);
-			tag->vlan_tpid = htons(ETH_P_8021Q);
-			tag->vlan_tci  = htons(vlan_tci);
+		tag = (struct vlan_tag *)(pkt + 2 * ETH_ALEN);
+		tag->vlan_tpid = htons(ETH_P_8021Q);
+		tag->vlan_tci  = htons(vlan_tci);
 
-			pcap_h.len += VLAN_TAG_LEN;
-		}
+		pcap_h->len += VLAN_TAG_LEN;
+	}
+
+	return (const u_char *)pkt;
+}
+
+
+/*
+ * User-space BPF: only when the filter of the group is not authoritative
+ * (it could not be installed in the kernel).
+ */
+
+static inline int
+pfq_filter_linux(pcap_t *handle, struct pfq_pcap_pkthdr const *pcap_h, const u_char *pkt)
+{
+	if (handle->fcode.bf_insns == NULL)
+		return 1;
+
+	return bpf_filter(handle->fcode.bf_insns, pkt, pcap_h->len, pcap_h->caplen) != 0;
+}
+
+
+static int
+pfq_read_linux(pcap_t *handle, int max_packets, pcap_handler callback, u_char *user)
+{
+	struct pfq_net_queue *nq = &handle->md.pfq.nq;
+	pfq_iterator_t it = handle->md.pfq.current;
+	pfq_iterator_t end = pfq_net_queue_end(nq);
+	int n = 0;
+
+        if (it == end) {
+		if (pfq_refill_linux(handle) < 0)
+			return PCAP_ERROR;
+		it  = handle->md.pfq.current;
+		end = pfq_net_queue_end(nq);
+	}
+
+	/* batch: up to the end of the queue, or max_packets */
+
+	if (max_packets > 0 && (size_t)max_packets < (size_t)(end - it) / nq->slot_size)
+		end = it + (size_t)max_packets * nq->slot_size;
+
+	for(; it != end; it = pfq_net_queue_next(nq, it))
+	{
+		struct pfq_pcap_pkthdr pcap_h;
+		const u_char *pkt;
+
+		pfq_pkt_prefetch(nq, it);
+
+		if (!pfq_pkt_ready(nq, it))
+			pfq_pkt_wait(nq, it);
+
+		pkt = pfq_packet_linux(handle, it, &pcap_h);
+
+		if (handle->md.pfq.filter_in_userland && !pfq_filter_linux(handle, &pcap_h, pkt))
+			continue;
 
 		callback(user, (struct pcap_pkthdr *)&pcap_h, pkt);
+		n++;
 
-		handle->md.packets_read++;
-		n--;
+		if (handle->break_loop) {
+			it = pfq_net_queue_next(nq, it);
+			break;
+		}
 	}
 
 	handle->md.pfq.current = it;
+	handle->md.packets_read += n;
 
 	if (handle->break_loop) {
 		handle->break_loop = 0;
 		return PCAP_ERROR_BREAK;
 	}
 
-	return handle->md.packets_read-start;
+	return n;
+}
+
+
+/*
+ * pcap_next_ex: the packet is returned in place, in the Rx queue, together
+ * with the extended pcap header (struct pfq_pcap_pkthdr). Both remain valid
+ * until the next call.
+ */
+
+static int
+pfq_next_ex_linux(pcap_t *handle, struct pcap_pkthdr **pkt_header, const u_char **pkt_data)
+{
+	struct pfq_net_queue *nq = &handle->md.pfq.nq;
+	pfq_iterator_t it = handle->md.pfq.current;
+
+	if (handle->break_loop) {
+		handle->break_loop = 0;
+		return PCAP_ERROR_BREAK;
+	}
+
+	for(;; it = pfq_net_queue_next(nq, it))
+	{
+		if (it == pfq_net_queue_end(nq)) {
+			handle->md.pfq.current = it;
+			if (pfq_refill_linux(handle) < 0)
+				return PCAP_ERROR;
+			it = handle->md.pfq.current;
+			if (it == pfq_net_queue_end(nq))
+				return 0;
+		}
+
+		pfq_pkt_prefetch(nq, it);
+
+		if (!pfq_pkt_ready(nq, it))
+			pfq_pkt_wait(nq, it);
+
+		*pkt_data = pfq_packet_linux(handle, it, &handle->md.pfq.pcap_h);
+
+		if (!handle->md.pfq.filter_in_userland ||
+		    pfq_filter_linux(handle, &handle->md.pfq.pcap_h, *pkt_data))
+			break;
+	}
+
+	*pkt_header = (struct pcap_pkthdr *)&handle->md.pfq.pcap_h;
+
+	handle->md.pfq.current = pfq_net_queue_next(nq, it);
+	handle->md.packets_read++;
+	return 1;
 }
 
 
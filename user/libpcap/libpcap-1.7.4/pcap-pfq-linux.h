@@ -34,3 +34,4 @@
  */
 
 pcap_t * pfq_create(const char *device, char *ebuf, size_t size);
+void pfq_save_filter_expr(pcap_t *handle, const char *expr, const struct bpf_program *program);
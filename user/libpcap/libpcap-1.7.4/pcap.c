@@ -258,6 +258,13 @@ pcap_next_ex(pcap_t *p, struct pcap_pkthdr **pkt_header,
 			return (status);
 	}
 
+	/*
+	 * Live captures that keep the packets in place (in a ring
+	 * shared with the kernel) return them without the callback.
+	 */
+	if (p->next_ex_op != NULL)
+		return (p->next_ex_op(p, pkt_header, pkt_data));
+
 	/*
 	 * Return codes for pcap_read() are:
 	 *   -  0: timeout
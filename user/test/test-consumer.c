@@ -0,0 +1,234 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <pfq.h>
+
+/*
+ * Consumer loop of the Rx queue: the per-packet yield loop (the former one)
+ * versus the bounded spin with prefetch (pfq_pkt_wait, pfq_pkt_prefetch).
+ *
+ * A producer thread emulates the kernel: it copies the packets into the slots
+ * of the double-buffered queue and commits them, while the consumer walks
+ * the same queue as soon as it is published. No PFQ socket is involved.
+ *
+ * usage: test-consumer [caplen] [rounds]
+ */
+
+#define SLOTS	4096
+
+struct shared
+{
+	char		*mem;		/* two queues of SLOTS slots */
+	size_t		slot_size;
+	size_t		caplen;
+	unsigned int	rounds;
+
+	unsigned int	produced;	/* rounds started by the producer */
+	unsigned int	consumed;	/* rounds completed by the consumer */
+};
+
+
+static void
+pin(int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+
+static double
+thread_cpu(void)
+{
+	struct rusage ru;
+	getrusage(RUSAGE_THREAD, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+	       ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* wait for the other side to reach the given round */
+
+static void
+wait_round(unsigned int *counter, unsigned int r)
+{
+	unsigned int spin = 0;
+
+	while (__atomic_load_n(counter, __ATOMIC_ACQUIRE) < r)
+	{
+		if (spin++ < PFQ_SPIN_BUDGET)
+			pfq_relax();
+		else
+			pfq_yield();
+	}
+}
+
+
+static void *
+producer(void *arg)
+{
+	struct shared *s = arg;
+	char pkt[2048];
+	unsigned int r;
+	size_t n;
+
+	pin(1 % (int)sysconf(_SC_NPROCESSORS_ONLN));
+
+	memset(pkt, 0x5a, sizeof(pkt));
+
+	for(r = 1; r <= s->rounds; r++)
+	{
+		char *queue = s->mem + (r & 1) * SLOTS * s->slot_size;
+
+		/* the queue of round r was used by round r-2 */
+
+		if (r > 1)
+			wait_round(&s->consumed, r - 1);
+
+		__atomic_store_n(&s->produced, r, __ATOMIC_RELEASE);
+
+		for(n = 0; n < SLOTS; n++)
+		{
+			struct pfq_pkthdr *h = (struct pfq_pkthdr *)(queue + n * s->slot_size);
+
+			memcpy(h + 1, pkt, s->caplen);
+			h->len = h->caplen = (uint16_t)s->caplen;
+			h->ifindex = 1;
+
+			__atomic_store_n(&h->commit, (uint8_t)r, __ATOMIC_RELEASE);
+		}
+	}
+
+	return NULL;
+}
+
+
+static unsigned long
+consume(struct shared *s, int spin)
+{
+	unsigned long sum = 0;
+	unsigned int r;
+
+	for(r = 1; r <= s->rounds; r++)
+	{
+		struct pfq_net_queue nq;
+		pfq_iterator_t it, it_e;
+
+		wait_round(&s->produced, r);
+
+		nq.queue = s->mem + (r & 1) * SLOTS * s->slot_size;
+		nq.len = SLOTS;
+		nq.slot_size = s->slot_size;
+		nq.index = (uint8_t)r;
+
+		it = pfq_net_queue_begin(&nq);
+		it_e = pfq_net_queue_end(&nq);
+
+		for(; it != it_e; it = pfq_net_queue_next(&nq, it))
+		{
+			const struct pfq_pkthdr *h;
+			const char *data;
+
+			if (spin) {
+				pfq_pkt_prefetch(&nq, it);
+				if (!pfq_pkt_ready(&nq, it))
+					pfq_pkt_wait(&nq, it);
+			}
+			else {
+				while (!pfq_pkt_ready(&nq, it))
+					pfq_yield();
+			}
+
+			h = pfq_pkt_header(it);
+			data = pfq_pkt_data(it);
+
+			sum += h->len + (unsigned char)data[0] + (unsigned char)data[h->caplen - 1];
+		}
+
+		__atomic_store_n(&s->consumed, r, __ATOMIC_RELEASE);
+	}
+
+	return sum;
+}
+
+
+static void
+run(const char *name, size_t caplen, unsigned int rounds, int spin)
+{
+	struct shared s;
+	pthread_t prod;
+	double t0, c0, t, c;
+	unsigned long sum;
+
+	s.caplen = caplen;
+	s.slot_size = (sizeof(struct pfq_pkthdr) + caplen + 7) & ~(size_t)7;
+	s.rounds = rounds;
+	s.produced = 0;
+	s.consumed = 0;
+	s.mem = calloc(2 * SLOTS, s.slot_size);
+	if (s.mem == NULL) {
+		fprintf(stderr, "out of memory!\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* commit 0xff marks the slots as never written */
+
+	memset(s.mem, 0, 2 * SLOTS * s.slot_size);
+	{
+		size_t n;
+		for(n = 0; n < 2 * SLOTS; n++)
+			((struct pfq_pkthdr *)(s.mem + n * s.slot_size))->commit = 0xff;
+	}
+
+	t0 = now();
+	c0 = thread_cpu();
+
+	pthread_create(&prod, NULL, producer, &s);
+	sum = consume(&s, spin);
+	pthread_join(prod, NULL);
+
+	t = now() - t0;
+	c = thread_cpu() - c0;
+
+	printf("%-6s caplen:%4zu  %7.2f Mpps  consumer cpu:%6.3f sec  %7.2f Mpps/core  (checksum %lu)\n",
+	       name, caplen, (double)SLOTS * rounds / t / 1e6, c, (double)SLOTS * rounds / c / 1e6, sum);
+
+	free(s.mem);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	size_t caplen = argc > 1 ? (size_t)atoi(argv[1]) : 64;
+	unsigned int rounds = argc > 2 ? (unsigned int)atoi(argv[2]) : 2000;
+
+	if (caplen == 0 || caplen > 1514 || rounds == 0) {
+		fprintf(stderr, "usage: %s [caplen] [rounds]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	pin(0);
+
+	run("yield", caplen, rounds, 0);
+	run("spin", caplen, rounds, 1);
+	return 0;
+}
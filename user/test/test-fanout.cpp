@@ -0,0 +1,70 @@
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+#include <pfq/pfq.hpp>
+#include <pfq/fanout.hpp>
+
+/*
+ * Fan-out of one socket to N worker threads: packets and bytes per worker.
+ *
+ * usage: test-fanout dev [workers] [seconds]
+ */
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s dev [workers] [seconds]\n", argv[0]);
+        return 0;
+    }
+
+    size_t workers = argc > 2 ? static_cast<size_t>(atoi(argv[2])) : 4;
+    int seconds = argc > 3 ? atoi(argv[3]) : 10;
+
+    pfq::socket q(128, 8192);
+
+    q.bind(argv[1]);
+    q.enable();
+
+    pfq::fanout fan(q, workers);
+
+    std::atomic<bool> stop(false);
+    std::vector<size_t> packets(workers), bytes(workers);
+    std::vector<std::thread> threads;
+
+    for(size_t n = 0; n < workers; n++)
+    {
+        threads.emplace_back([&, n] {
+            size_t p = 0, b = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                if (fan.consume(n, [&](const pfq_pkthdr *h, const char *) { p++; b += h->len; }) == 0)
+                    pfq::relax();
+            }
+            packets[n] = p;
+            bytes[n] = b;
+        });
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    size_t total = 0;
+
+    while (std::chrono::steady_clock::now() < deadline)
+        total += fan.dispatch(100000);
+
+    stop.store(true);
+
+    for(auto &t : threads)
+        t.join();
+
+    printf("dispatched: %zu packets (%.0f pps)\n", total, double(total) / seconds);
+
+    for(size_t n = 0; n < workers; n++)
+        printf("worker %zu: %zu packets, %zu bytes\n", n, packets[n], bytes[n]);
+
+    return 0;
+}
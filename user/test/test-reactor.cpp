@@ -0,0 +1,128 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <pfq/pfq.hpp>
+#include <pfq/reactor.hpp>
+#include <pfq/lang/default.hpp>
+
+
+/*
+ * Throughput and CPU usage of the reactor, with 1 to 64 sockets of a shared
+ * group (flows are steered across the sockets).
+ *
+ * usage: test-reactor dev [seconds] [busy] [watermark]
+ */
+
+using namespace pfq;
+
+
+static double
+cpu_seconds()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+
+static void
+run(const char *dev, size_t nsock, int seconds, bool busy, unsigned int watermark)
+{
+    reactor::options opt;
+    opt.busy_poll = busy;
+
+    reactor r(opt);
+
+    int gid = -1;
+
+    for(size_t n = 0; n < nsock; n++)
+    {
+        pfq::socket q(n == 0 ? group_policy::shared : group_policy::undefined, 64, 4096);
+
+        if (n == 0)
+            gid = q.group_id();
+        else
+            q.join_group(gid, group_policy::shared);
+
+        q.rx_watermark(watermark, watermark > 1 ? 1000 : 0);
+        q.enable();
+
+        r.add(std::move(q));
+    }
+
+    r[0].bind_group(gid, dev);
+    r[0].set_group_computation(gid, lang::steer_flow);
+
+    std::vector<size_t> count(nsock);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    auto cpu0 = cpu_seconds();
+    size_t total = 0;
+
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        total += r.dispatch([&](size_t i, const pfq_pkthdr *, const char *) {
+                                count[i]++;
+                            }, 100000);
+    }
+
+    auto cpu = cpu_seconds() - cpu0;
+
+    auto mm = std::minmax_element(count.begin(), count.end());
+
+    printf("sockets:%2zu  %12.0f pps  cpu:%5.1f%%  per socket min:%zu max:%zu\n",
+           nsock, double(total) / seconds, 100.0 * cpu / seconds, *mm.first, *mm.second);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s dev [seconds] [busy] [watermark]\n", argv[0]);
+        return 0;
+    }
+
+    int seconds = argc > 2 ? atoi(argv[2]) : 5;
+    bool busy = argc > 3 && strcmp(argv[3], "busy") == 0;
+    unsigned int watermark = argc > 4 ? static_cast<unsigned int>(atoi(argv[4])) : 1;
+
+    printf("dev:%s seconds:%d mode:%s watermark:%u\n", argv[1], seconds, busy ? "busy-poll" : "epoll", watermark);
+
+    for(size_t n = 1; n <= 64; n <<= 1)
+        run(argv[1], n, seconds, busy, watermark);
+
+    return 0;
+}
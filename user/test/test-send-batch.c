@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include <pfq.h>
+
+/* Frame (98 bytes) */
+
+static const unsigned char ping[98] =
+{
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf0, 0xbf, /* L`..UF.. */
+        0x97, 0xe2, 0xff, 0xae, 0x08, 0x00, 0x45, 0x00, /* ......E. */
+        0x00, 0x54, 0xb3, 0xf9, 0x40, 0x00, 0x40, 0x01, /* .T..@.@. */
+        0xf5, 0x32, 0xc0, 0xa8, 0x00, 0x02, 0xad, 0xc2, /* .2...... */
+        0x23, 0x10, 0x08, 0x00, 0xf2, 0xea, 0x42, 0x04, /* #.....B. */
+        0x00, 0x01, 0xfe, 0xeb, 0xfc, 0x52, 0x00, 0x00, /* .....R.. */
+        0x00, 0x00, 0x06, 0xfe, 0x02, 0x00, 0x00, 0x00, /* ........ */
+        0x00, 0x00, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, /* ........ */
+        0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, /* ........ */
+        0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, /* .. !"#$% */
+        0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, /* &'()*+,- */
+        0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, /* ./012345 */
+        0x36, 0x37                                      /* 67 */
+};
+
+
+#define BATCH	64
+
+
+/* every packet is gathered from two chunks: the Ethernet header and the rest */
+
+static void make_batch(struct pfq_tx_pkt *pkts, struct iovec *iov, size_t n)
+{
+	size_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		iov[2*i].iov_base   = (void *)ping;
+		iov[2*i].iov_len    = 14;
+		iov[2*i+1].iov_base = (void *)(ping + 14);
+		iov[2*i+1].iov_len  = sizeof(ping) - 14;
+
+		pkts[i].iov     = &iov[2*i];
+		pkts[i].iovcnt  = 2;
+		pkts[i].ifindex = 0;
+		pkts[i].qindex  = 0;
+		pkts[i].nsec    = 0;
+		pkts[i].copies  = 1;
+	}
+}
+
+
+void send_packets(pfq_t *q, unsigned long long num, int async)
+{
+	struct pfq_tx_pkt pkts[BATCH];
+	struct iovec iov[2 * BATCH];
+        unsigned long long n;
+
+	make_batch(pkts, iov, BATCH);
+
+	printf("sending %llu packets in batches of %d%s:\n", num, BATCH, async ? " (async)" : "");
+
+        for(n = 0; n < num;)
+        {
+		size_t len = num - n < BATCH ? (size_t)(num - n) : BATCH;
+		int sent = pfq_send_batch(q, pkts, len, async, Q_ANY_QUEUE);
+
+		if (!async)
+			pfq_transmit_queue(q, 0);
+
+		if (sent > 0)
+			n += (unsigned long long)sent;
+        }
+}
+
+
+int
+main(int argc, char *argv[])
+{
+        if (argc < 5)
+        {
+                fprintf(stderr, "usage: %s dev queue kthread num\n", argv[0]);
+                return -1;
+        }
+
+        const char *dev = argv[1];
+        int queue  = atoi(argv[2]);
+        int kthread = atoi(argv[3]);
+        unsigned long long num = atoll(argv[4]);
+
+        pfq_t * q= pfq_open(64, 1024, 1024);
+
+        if (pfq_bind_tx(q, dev, queue, kthread) < 0) {
+		fprintf(stderr, "%s\n", pfq_error(q));
+		return -1;
+	}
+
+        pfq_enable(q);
+
+	send_packets(q, num, kthread != -1);
+
+        sleep(2);
+
+        struct pfq_stats stat;
+        pfq_get_stats(q, &stat);
+
+        fprintf(stdout, "sent: %lu - disc: %lu\n", stat.sent, stat.disc);
+
+        pfq_close(q);
+
+        return 0;
+}
@@ -23,6 +23,7 @@
 #include <unordered_set>
 
 #include <pfq/pfq.hpp>
+#include <pfq/parse.hpp>
 #include <pfq/lang/lang.hpp>
 #include <pfq/lang/default.hpp>
 #include <pfq/lang/experimental.hpp>
@@ -31,8 +32,7 @@
 #include <more/affinity.hpp>
 #include <more/vt100.hpp>
 
-#include <linux/ip.h>
-#include <linux/udp.h>
+#include <netinet/in.h>
 
 using namespace more;
 
@@ -63,14 +63,21 @@ namespace opt
 }
 
 
-typedef std::tuple<uint32_t, uint32_t, uint16_t, uint16_t> Tuple;
+typedef std::tuple<parse::address, parse::address, uint16_t, uint16_t> Tuple;
 
 struct HashTuple
 {
+    static uint32_t fold(parse::address const &a)
+    {
+        uint32_t w[4];
+        memcpy(w, a.data(), sizeof(w));
+        return w[0] ^ w[1] ^ w[2] ^ w[3];
+    }
+
     uint32_t operator()(Tuple const &t) const
     {
 
-        return std::get<0>(t) ^ std::get<1>(t) ^ std::get<2>(t) ^ (static_cast<uint32_t>(std::get<3>(t)) << 16);
+        return fold(std::get<0>(t)) ^ fold(std::get<1>(t)) ^ std::get<2>(t) ^ (static_cast<uint32_t>(std::get<3>(t)) << 16);
     }
 };
 
@@ -183,8 +190,7 @@ namespace thread
                     auto it = many.begin();
                     for(; it != many.end(); ++it)
                     {
-                        while (!it.ready())
-                            std::this_thread::yield();
+                        it.wait();
 
                         auto h = *it;
                         const char *buff = static_cast<char *>(it.data());
@@ -199,15 +205,12 @@ namespace thread
                     auto it_e = many.end();
                     for(; it != it_e; ++it)
                     {
-                        while(!it.ready())
-                            std::this_thread::yield();
+                        it.wait();
 
-                        iphdr  * ipv4 = reinterpret_cast<iphdr *> (static_cast<char *>(it.data()) + 14);
-                        if (ipv4->protocol == IPPROTO_TCP || ipv4->protocol == IPPROTO_UDP)
+                        auto v = parse::decode<parse::all>(it);
+                        if (v.proto == IPPROTO_TCP || v.proto == IPPROTO_UDP)
                         {
-                            udphdr * udp = reinterpret_cast<udphdr *>(static_cast<char *>(it.data()) + (ipv4->ihl<<2));
-
-                            if (m_set.insert(std::make_tuple(ipv4->saddr, ipv4->daddr, udp->source, udp->dest)).second)
+                            if (m_set.insert(std::make_tuple(v.saddr, v.daddr, v.sport, v.dport)).second)
                                 m_flow++;
                         }
                     }
@@ -292,7 +295,7 @@ namespace thread
         unsigned long long m_read;
         size_t m_batch;
 
-        std::unordered_set<std::tuple<uint32_t, uint32_t, uint16_t, uint16_t>, HashTuple> m_set;
+        std::unordered_set<Tuple, HashTuple> m_set;
 
         unsigned long m_flow;
 
@@ -472,7 +475,7 @@ try
         std::cout << "*** Warning: HugePages not mounted ***" << std::endl;
 
     unsigned long long sum, flow, old = 0;
-    pfq_stats sum_stats, old_stats = {0,0,0,0,0,0,0};
+    pfq_stats sum_stats, old_stats = {0,0,0,0,0,0,0,0,0,0,0};
 
     std::cout << "----------- capture started ------------\n";
 
@@ -484,7 +487,7 @@ try
 
         sum = 0;
         flow = 0;
-        sum_stats = {0,0,0,0,0,0,0};
+        sum_stats = {0,0,0,0,0,0,0,0,0,0,0};
 
         std::for_each(thread_ctx.begin(), thread_ctx.end(), [&](const thread::context *c) {
             sum += c->read();
@@ -0,0 +1,237 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ ****************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <vector>
+#include <limits>
+
+#include <pfq/pfq.hpp>
+#include <pfq/flow.hpp>
+#include <pfq/lang/lang.hpp>
+#include <pfq/lang/default.hpp>
+
+#include <arpa/inet.h>
+
+using namespace pfq;
+using namespace pfq::lang;
+
+
+namespace opt
+{
+    size_t capacity = 65536;
+    size_t ring     = 65536;
+
+    unsigned int active = 60;
+    unsigned int idle   = 15;
+
+    size_t seconds = std::numeric_limits<size_t>::max();
+
+    std::string output;
+    std::vector<std::string> devs;
+}
+
+
+bool any_strcmp(const char *arg, const char *opt)
+{
+    return strcmp(arg,opt) == 0;
+}
+template <typename ...Ts>
+bool any_strcmp(const char *arg, const char *opt, Ts&&...args)
+{
+    return (strcmp(arg,opt) == 0 ? true : any_strcmp(arg, std::forward<Ts>(args)...));
+}
+
+
+void usage(std::string name)
+{
+    throw std::runtime_error
+    (
+        "usage: " + std::move(name) + " [OPTIONS] dev[:queue]...\n\n"
+        " -h --help                     Display this help\n"
+        " -n --capacity INT             Flow entries per cpu (default 65536)\n"
+        " -a --active INT               Active timeout, in seconds (default 60)\n"
+        " -i --idle INT                 Idle timeout, in seconds (default 15)\n"
+        " -r --ring INT                 Length of the flow records ring (default 65536)\n"
+        " -w --write FILE               Write the records to file (csv)\n"
+        "    --seconds INT              Terminate after INT seconds"
+    );
+}
+
+
+std::string
+address(pfq_flow_key const &key, const uint32_t *addr)
+{
+    char buf[INET6_ADDRSTRLEN];
+    return inet_ntop(key.family == 4 ? AF_INET : AF_INET6, addr, buf, sizeof(buf));
+}
+
+
+const char *
+reason(int r)
+{
+    switch(r)
+    {
+    case Q_FLOW_EXPIRED_IDLE:   return "idle";
+    case Q_FLOW_EXPIRED_ACTIVE: return "active";
+    case Q_FLOW_EVICTED:        return "evicted";
+    }
+    return "snapshot";
+}
+
+
+void
+print(std::ostream &out, pfq_flow_stat const &f)
+{
+    out << address(f.key, f.key.saddr) << ',' << ntohs(f.key.sport) << ','
+        << address(f.key, f.key.daddr) << ',' << ntohs(f.key.dport) << ','
+        << static_cast<int>(f.key.proto) << ','
+        << f.packets << ',' << f.bytes << ','
+        << f.first << ',' << f.last << ','
+        << "0x" << std::hex << static_cast<int>(f.tcp_flags) << std::dec << ','
+        << f.state << ',' << f.cpu << ',' << reason(f.reason) << '\n';
+}
+
+
+int
+main(int argc, char *argv[])
+try
+{
+    if (argc < 2)
+        usage(argv[0]);
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if (any_strcmp(argv[i], "-n", "--capacity"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("capacity missing");
+
+            opt::capacity = static_cast<size_t>(std::atoi(argv[i]));
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-a", "--active"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("active timeout missing");
+
+            opt::active = static_cast<unsigned int>(std::atoi(argv[i]));
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-i", "--idle"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("idle timeout missing");
+
+            opt::idle = static_cast<unsigned int>(std::atoi(argv[i]));
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-r", "--ring"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("ring length missing");
+
+            opt::ring = static_cast<size_t>(std::atoi(argv[i]));
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-w", "--write"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("file missing");
+
+            opt::output.assign(argv[i]);
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "--seconds"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("seconds missing");
+
+            opt::seconds = static_cast<size_t>(std::atoi(argv[i]));
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-h", "--help"))
+            usage(argv[0]);
+
+        opt::devs.push_back(argv[i]);
+    }
+
+    if (opt::devs.empty())
+        usage(argv[0]);
+
+    // packets are aggregated in the kernel: no need for Rx slots
+    //
+
+    pfq::socket q(64, 64);
+
+    auto gid = q.group_id();
+
+    for(auto &d : opt::devs)
+    {
+        auto dq = pfq::split(d, ":");
+        auto queue = dq.size() > 1 ? std::atoi(dq[1].c_str()) : any_queue;
+
+        std::cout << "+ bind to " << dq[0] << "@" << queue << std::endl;
+        q.bind_group(gid, dq[0].c_str(), queue);
+    }
+
+    q.flow_ring(opt::ring);
+
+    q.flow_create(gid, opt::capacity);
+    q.flow_timeouts(gid, opt::active, opt::idle);
+
+    q.set_group_computation(gid, flow_update >> drop);
+
+    q.enable();
+
+    std::ofstream file;
+    if (!opt::output.empty())
+    {
+        file.open(opt::output);
+        if (!file)
+            throw std::runtime_error("pfq-flows: could not open " + opt::output);
+    }
+
+    std::ostream &out = file.is_open() ? file : std::cout;
+
+    out << "saddr,sport,daddr,dport,proto,packets,bytes,first,last,tcp_flags,state,cpu,reason\n";
+
+    pfq::flow_reader reader(q);
+
+    size_t records = 0;
+
+    auto begin = std::chrono::system_clock::now();
+
+    while (std::chrono::system_clock::now() - begin < std::chrono::seconds(opt::seconds))
+    {
+        auto n = reader.read([&](pfq_flow_stat const &f) { print(out, f); });
+        if (n == 0) {
+            out.flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        records += n;
+    }
+
+    std::cerr << "records: " << records << ", lost: " << reader.lost() << std::endl;
+    return 0;
+}
+catch(std::exception &e)
+{
+    std::cerr << e.what() << std::endl;
+}
@@ -229,7 +229,7 @@ namespace thread
         std::tuple<pfq_stats, uint64_t, uint64_t, uint64_t, uint64_t>
         stats() const
         {
-            pfq_stats ret = {0,0,0,0,0,0,0};
+            pfq_stats ret = {0,0,0,0,0,0,0,0,0,0,0};
 
             ret += m_pfq.stats();
 
@@ -301,6 +301,43 @@ namespace thread
 
             auto rc = opt::rate != 0.0;
 
+            // without rate control, the synchronous transmission enqueues flush_hint packets at once...
+
+            if (!rc && !m_async)
+            {
+                std::vector<pfq::const_buffer> pool;
+                for(size_t i = 0; i < opt::preload; i++)
+                    pool.emplace_back(reinterpret_cast<const char *>(m_packet.get() + i * opt::len), len);
+
+                for(size_t n = 0; n < opt::npackets;)
+                {
+                    idx &= (opt::preload-1);
+
+                    auto batch = std::min({opt::flush_hint, opt::preload - idx, opt::npackets - n});
+
+                    auto sent = m_pfq.send_batch(pool.begin() + static_cast<ptrdiff_t>(idx),
+                                                 pool.begin() + static_cast<ptrdiff_t>(idx + batch), 0, 0, 0, opt::copies);
+
+                    m_pfq.transmit_queue(0);
+
+                    if (sent == 0)
+                    {
+                        m_fail->fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+
+                    idx += sent;
+
+                    m_sent->fetch_add(sent, std::memory_order_relaxed);
+                    m_band->fetch_add(len * sent, std::memory_order_relaxed);
+                    m_gros->fetch_add((len+24) * sent, std::memory_order_relaxed);
+
+                    n += sent;
+                }
+
+                return;
+            }
+
             for(size_t n = 0; n < opt::npackets;)
             {
                 idx &= (opt::preload-1);
@@ -883,7 +920,7 @@ try
         t->detach();
     });
 
-    pfq_stats cur, prec = {0,0,0,0,0,0,0};
+    pfq_stats cur, prec = {0,0,0,0,0,0,0,0,0,0,0};
 
     uint64_t sent, sent_ = 0;
     uint64_t band, band_ = 0;
@@ -898,7 +935,7 @@ try
     {
         std::this_thread::sleep_for(std::chrono::seconds(1));
 
-        cur = {0,0,0,0,0,0,0};
+        cur = {0,0,0,0,0,0,0,0,0,0,0};
         sent = 0;
         band = 0;
         gros = 0;
@@ -944,7 +981,7 @@ try
     std::cout << "Shutting down sockets in 1 sec..." << std::endl;
     std::this_thread::sleep_for(std::chrono::seconds(1));
 
-    cur  = {0,0,0,0,0,0,0};
+    cur  = {0,0,0,0,0,0,0,0,0,0,0};
     sent = 0;
 
     std::for_each(thread_ctx.begin(), thread_ctx.end(), [&](const thread::context *c)
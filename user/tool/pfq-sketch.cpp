@@ -0,0 +1,257 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ ****************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <vector>
+#include <limits>
+
+#include <pfq/pfq.hpp>
+#include <pfq/lang/lang.hpp>
+#include <pfq/lang/default.hpp>
+
+#include <arpa/inet.h>
+
+using namespace pfq;
+using namespace pfq::lang;
+
+
+namespace opt
+{
+    uint32_t width  = 16384;
+    uint32_t topk   = 32;
+    size_t   top    = 10;
+    size_t   interval = 1;
+    bool     bytes  = false;
+
+    size_t seconds = std::numeric_limits<size_t>::max();
+
+    std::vector<sketch_key> keys;
+    std::vector<std::string> devs;
+}
+
+
+bool any_strcmp(const char *arg, const char *opt)
+{
+    return strcmp(arg,opt) == 0;
+}
+template <typename ...Ts>
+bool any_strcmp(const char *arg, const char *opt, Ts&&...args)
+{
+    return (strcmp(arg,opt) == 0 ? true : any_strcmp(arg, std::forward<Ts>(args)...));
+}
+
+
+void usage(std::string name)
+{
+    throw std::runtime_error
+    (
+        "usage: " + std::move(name) + " [OPTIONS] dev[:queue]...\n\n"
+        " -h --help                     Display this help\n"
+        " -k --key KEY                  Sketch key: src, dst or flow (repeatable, default all)\n"
+        " -w --width INT                Count-min columns (default 16384)\n"
+        " -t --topk INT                 Heavy hitters tracked per cpu (default 32)\n"
+        " -n --top INT                  Heavy hitters displayed (default 10)\n"
+        " -b --bytes                    Count bytes rather than packets\n"
+        " -i --interval INT             Display interval, in seconds (default 1)\n"
+        "    --seconds INT              Terminate after INT seconds"
+    );
+}
+
+
+const char *
+key_name(sketch_key k)
+{
+    switch(k)
+    {
+    case sketch_key::src:  return "src";
+    case sketch_key::dst:  return "dst";
+    case sketch_key::flow: return "flow";
+    }
+    return "?";
+}
+
+
+std::string
+address(pfq_flow_key const &key, const uint32_t *addr)
+{
+    char buf[INET6_ADDRSTRLEN];
+    return inet_ntop(key.family == 4 ? AF_INET : AF_INET6, addr, buf, sizeof(buf));
+}
+
+
+std::string
+show(sketch_key k, pfq_flow_key const &key)
+{
+    switch(k)
+    {
+    case sketch_key::src: return address(key, key.saddr);
+    case sketch_key::dst: return address(key, key.daddr);
+    case sketch_key::flow: break;
+    }
+
+    std::ostringstream out;
+    out << address(key, key.saddr) << ':' << ntohs(key.sport) << " -> "
+        << address(key, key.daddr) << ':' << ntohs(key.dport) << " (" << static_cast<int>(key.proto) << ')';
+    return out.str();
+}
+
+
+void
+print(sketch_key k, pfq::sketch const &s)
+{
+    std::cout << "[" << key_name(k) << "] total: " << s.total << (opt::bytes ? " bytes" : " packets")
+              << ", distinct: ~" << static_cast<uint64_t>(s.distinct) << std::endl;
+
+    for(size_t i = 0; i < s.heavy_hitters.size(); i++)
+    {
+        auto const &h = s.heavy_hitters[i];
+        std::cout << "  " << std::setw(3) << (i+1) << ". " << std::setw(14) << h.count << "  "
+                  << std::fixed << std::setprecision(2) << std::setw(6)
+                  << (s.total ? 100.0 * static_cast<double>(h.count) / static_cast<double>(s.total) : 0.0) << "%  "
+                  << show(k, h.key) << std::endl;
+    }
+}
+
+
+int
+main(int argc, char *argv[])
+try
+{
+    if (argc < 2)
+        usage(argv[0]);
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if (any_strcmp(argv[i], "-k", "--key"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("key missing");
+
+            if (any_strcmp(argv[i], "src"))
+                opt::keys.push_back(sketch_key::src);
+            else if (any_strcmp(argv[i], "dst"))
+                opt::keys.push_back(sketch_key::dst);
+            else if (any_strcmp(argv[i], "flow"))
+                opt::keys.push_back(sketch_key::flow);
+            else
+                throw std::runtime_error(std::string("unknown key ") + argv[i]);
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-w", "--width"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("width missing");
+
+            opt::width = static_cast<uint32_t>(std::atoi(argv[i]));
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-t", "--topk"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("topk missing");
+
+            opt::topk = static_cast<uint32_t>(std::atoi(argv[i]));
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-n", "--top"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("top missing");
+
+            opt::top = static_cast<size_t>(std::atoi(argv[i]));
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-b", "--bytes"))
+        {
+            opt::bytes = true;
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-i", "--interval"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("interval missing");
+
+            opt::interval = static_cast<size_t>(std::atoi(argv[i]));
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "--seconds"))
+        {
+            if (++i == argc)
+                throw std::runtime_error("seconds missing");
+
+            opt::seconds = static_cast<size_t>(std::atoi(argv[i]));
+            continue;
+        }
+
+        if (any_strcmp(argv[i], "-h", "--help"))
+            usage(argv[0]);
+
+        opt::devs.push_back(argv[i]);
+    }
+
+    if (opt::devs.empty())
+        usage(argv[0]);
+
+    if (opt::keys.empty())
+        opt::keys = { sketch_key::src, sketch_key::dst, sketch_key::flow };
+
+    // packets are aggregated in the kernel: no need for Rx slots
+    //
+
+    pfq::socket q(64, 64);
+
+    auto gid = q.group_id();
+
+    for(auto &d : opt::devs)
+    {
+        auto dq = pfq::split(d, ":");
+        auto queue = dq.size() > 1 ? std::atoi(dq[1].c_str()) : any_queue;
+
+        std::cout << "+ bind to " << dq[0] << "@" << queue << std::endl;
+        q.bind_group(gid, dq[0].c_str(), queue);
+    }
+
+    for(auto k : opt::keys)
+        q.sketch_create(gid, k, opt::width, opt::topk, opt::bytes);
+
+    // the functions of the keys without a sketch just pass the packet
+    //
+
+    q.set_group_computation(gid, sketch_src >> sketch_dst >> sketch_flow >> drop);
+
+    q.enable();
+
+    auto begin = std::chrono::system_clock::now();
+
+    while (std::chrono::system_clock::now() - begin < std::chrono::seconds(opt::seconds))
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(opt::interval));
+
+        for(auto k : opt::keys)
+            print(k, q.group_sketch(gid, k, opt::top));
+
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
+catch(std::exception &e)
+{
+    std::cerr << e.what() << std::endl;
+}